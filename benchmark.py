@@ -41,10 +41,15 @@ BENCHMARK("fib", r"""317811
 317811\n""")
 BENCHMARK("lit_call", "")
 BENCHMARK("c_call", "")
+BENCHMARK("method_call", r"""4344627694\n""")
+BENCHMARK("compile", r"""Generated\n""")
+BENCHMARK("game_loop", r"""14897900\nframe 199\n""")
+BENCHMARK("large_heap", r"""300298000\n""")
 
 LANGUAGES = [
 	("lit",            ["./dist/lit", "-Oall"],          ".lit"),
 	("lit (-Ono-all)", ["./dist/lit", "-Ono-all"],       ".lit"),
+	("lit (--jit)",    ["./dist/lit", "-Oall", "--jit"], ".lit"),
 	("python",         ["python2.7"],                       ".py"),
 	("lua",            ["lua"],                          ".lua"),
 	("luajit (-joff)", ["luajit", "-joff"],              ".lua"),
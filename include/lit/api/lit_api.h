@@ -5,6 +5,7 @@
 #include "lit/lit_common.h"
 #include "lit/vm/lit_object.h"
 #include "lit/api/lit_calls.h"
+#include "lit/vm/lit_vm.h"
 
 #include <string.h>
 
@@ -27,6 +28,7 @@
     klass->init_method = super_klass->init_method; \
   } \
   lit_table_add_all_ignoring(state, &super_klass->methods, &klass->methods); \
+	lit_inherit_operators(klass, (LitClass*) super_klass); \
 	lit_table_add_all_ignoring(state, &super_klass->static_fields, &klass->static_fields);
 
 #define LIT_END_CLASS_IGNORING() lit_set_global(state, klass_name, OBJECT_VALUE(klass)); \
@@ -40,8 +42,10 @@
     state->allow_gc = was_allowed; \
 	}
 
-#define LIT_BIND_METHOD(name, method) { LitString* nm = lit_copy_string(state, name, strlen(name)); lit_table_set(state, &klass->methods, nm, OBJECT_VALUE(lit_create_native_method(state, method, nm))); }
-#define LIT_BIND_PRIMITIVE(name, method) { LitString* nm = lit_copy_string(state, name, strlen(name)); lit_table_set(state, &klass->methods, nm, OBJECT_VALUE(lit_create_primitive_method(state, method, nm))); }
+#define LIT_BIND_METHOD(name, method) { LitString* nm = lit_copy_string(state, name, strlen(name)); LitValue m = OBJECT_VALUE(lit_create_native_method(state, method, nm)); lit_table_set(state, &klass->methods, nm, m); lit_update_operator(klass, nm, m); }
+// The method only calls its function arguments before returning, so the lambdas passed to it can stay on the stack
+#define LIT_BIND_BORROWING_METHOD(name, method) { LitString* nm = lit_copy_string(state, name, strlen(name)); LitNativeMethod* m = lit_create_native_method(state, method, nm); m->borrowing = true; lit_table_set(state, &klass->methods, nm, OBJECT_VALUE(m)); lit_update_operator(klass, nm, OBJECT_VALUE(m)); }
+#define LIT_BIND_PRIMITIVE(name, method) { LitString* nm = lit_copy_string(state, name, strlen(name)); LitValue m = OBJECT_VALUE(lit_create_primitive_method(state, method, nm)); lit_table_set(state, &klass->methods, nm, m); lit_update_operator(klass, nm, m); }
 #define LIT_BIND_CONSTRUCTOR(method) { LitString* nm = lit_copy_string(state, "constructor", 11); LitNativeMethod* m = lit_create_native_method(state, method, nm); klass->init_method = (LitObject*) m; lit_table_set(state, &klass->methods, nm, OBJECT_VALUE(m)); }
 #define LIT_BIND_STATIC_METHOD(name, method) { LitString* nm = lit_copy_string(state, name, strlen(name)); lit_table_set(state, &klass->static_fields, nm, OBJECT_VALUE(lit_create_native_method(state, method, nm))); }
 #define LIT_BIND_STATIC_PRIMITIVE(name, method) { LitString* nm = lit_copy_string(state, name, strlen(name)); lit_table_set(state, &klass->static_fields, nm, OBJECT_VALUE(lit_create_primitive_method(state, method, nm))); }
@@ -66,19 +70,33 @@ bool lit_global_exists(LitState* state, LitString* name);
 void lit_define_native(LitState* state, const char* name, LitNativeFunctionFn native);
 void lit_define_native_primitive(LitState* state, const char* name, LitNativePrimitiveFn native);
 
-#define LIT_CHECK_NUMBER(id) lit_check_number(vm, args, arg_count, id)
+/*
+ * The LIT_CHECK_* macros exit the native right after reporting a bad argument,
+ * so they can only be used inside of LIT_NATIVE and LIT_METHOD bodies
+ */
+#define LIT_CHECK_ARGUMENT(id, check, expected) \
+	if (arg_count <= id || !check(args[id])) { \
+		lit_argument_error(vm, args, arg_count, id, expected); \
+		return NULL_VALUE; \
+	}
+
+#define LIT_CHECK_NUMBER(id) ({ LIT_CHECK_ARGUMENT(id, IS_NUMBER, "a number") AS_NUMBER(args[id]); })
 #define LIT_GET_NUMBER(id, def) lit_get_number(vm, args, arg_count, id, def)
 
-#define LIT_CHECK_BOOL(id) lit_check_bool(vm, args, arg_count, id)
+#define LIT_CHECK_BOOL(id) ({ LIT_CHECK_ARGUMENT(id, IS_BOOL, "a boolean") AS_BOOL(args[id]); })
 #define LIT_GET_BOOL(id, def) lit_get_bool(vm, args, arg_count, id, def)
 
-#define LIT_CHECK_STRING(id) lit_check_string(vm, args, arg_count, id)
+#define LIT_CHECK_STRING(id) ({ LIT_CHECK_ARGUMENT(id, IS_STRING, "a string") AS_STRING(args[id])->chars; })
 #define LIT_GET_STRING(id, def) lit_get_string(vm, args, arg_count, id, def)
 
-#define LIT_CHECK_OBJECT_STRING(id) lit_check_object_string(vm, args, arg_count, id)
-#define LIT_CHECK_INSTANCE(id) lit_check_instance(vm, args, arg_count, id)
-#define LIT_CHECK_REFERENCE(id) lit_check_reference(vm, args, arg_count, id)
+#define LIT_CHECK_OBJECT_STRING(id) ({ LIT_CHECK_ARGUMENT(id, IS_STRING, "a string") AS_STRING(args[id]); })
+#define LIT_CHECK_INSTANCE(id) ({ LIT_CHECK_ARGUMENT(id, IS_INSTANCE, "an instance") AS_INSTANCE(args[id]); })
+#define LIT_CHECK_REFERENCE(id) ({ LIT_CHECK_ARGUMENT(id, IS_REFERENCE, "a reference") AS_REFERENCE(args[id])->slot; })
 
+// Exits the native, if it has a jump target
+bool lit_argument_error(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id, const char* expected);
+
+// The lit_check_* functions exit the native on error, natives bound with LIT_BEGIN_RETURNING_NATIVES() get a dummy value back instead
 double lit_check_number(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id);
 double lit_get_number(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id, double def);
 
@@ -92,21 +110,25 @@ LitString* lit_check_object_string(LitVm* vm, LitValue* args, uint8_t arg_count,
 LitInstance* lit_check_instance(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id);
 LitValue* lit_check_reference(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id);
 
-void lit_ensure_bool(LitVm* vm, LitValue value, const char* error);
-void lit_ensure_string(LitVm* vm, LitValue value, const char* error);
-void lit_ensure_number(LitVm* vm, LitValue value, const char* error);
-void lit_ensure_object_type(LitVm* vm, LitValue value, LitObjectType type, const char* error);
+// These return false once the error is reported
+
+bool lit_ensure_bool(LitVm* vm, LitValue value, const char* error);
+bool lit_ensure_string(LitVm* vm, LitValue value, const char* error);
+bool lit_ensure_number(LitVm* vm, LitValue value, const char* error);
+bool lit_ensure_object_type(LitVm* vm, LitValue value, LitObjectType type, const char* error);
 
-#define LIT_GET_FIELD(id) lit_get_field(vm->state, &AS_INSTANCE(instance)->fields, id)
+#define LIT_GET_FIELD(id) lit_get_instance_field(vm->state, AS_INSTANCE(instance), id)
 #define LIT_GET_MAP_FIELD(id) lit_get_map_field(vm->state, &AS_INSTANCE(instance)->fields, id)
-#define LIT_SET_FIELD(id, value) lit_set_field(vm->state, &AS_INSTANCE(instance)->fields, id, value)
+#define LIT_SET_FIELD(id, value) lit_set_instance_field(vm->state, AS_INSTANCE(instance), id, value)
 #define LIT_SET_MAP_FIELD(id, value) lit_set_map_field(vm->state, &AS_INSTANCE(instance)->fields, id, value)
 
 LitValue lit_get_field(LitState* state, LitTable* table, const char* name);
 LitValue lit_get_map_field(LitState* state, LitMap* map, const char* name);
+LitValue lit_get_instance_field(LitState* state, LitInstance* instance, const char* name);
 
 void lit_set_field(LitState* state, LitTable* table, const char* name, LitValue value);
 void lit_set_map_field(LitState* state, LitMap* map, const char* name, LitValue value);
+void lit_set_instance_field(LitState* state, LitInstance* instance, const char* name, LitValue value);
 
 #define LIT_ENSURE_ARGS(count) \
 	if (arg_count != count) { \
@@ -129,24 +151,31 @@ void lit_set_map_field(LitState* state, LitMap* map, const char* name, LitValue
 #define LIT_INSERT_DATA(type, cleanup) ({\
 	  LitUserdata* userdata = lit_create_userdata(vm->state, sizeof(type));\
 	  userdata->cleanup_fn = cleanup;\
-	  lit_table_set(vm->state, &AS_INSTANCE(instance)->fields, CONST_STRING(vm->state, "_data"), OBJECT_VALUE(userdata)); \
+	  lit_instance_set(vm->state, AS_INSTANCE(instance), CONST_STRING(vm->state, "_data"), OBJECT_VALUE(userdata)); \
 	  (type*) userdata->data;\
   })
 
-#define LIT_EXTRACT_DATA(type) ({ \
-    LitValue _d; \
-		if (!lit_table_get(&AS_INSTANCE(instance)->fields, CONST_STRING(vm->state, "_data"), &_d)) { \
-			lit_runtime_error_exiting(vm, "Failed to extract userdata");\
-		} \
-		(type*) AS_USERDATA(_d)->data; \
-	})
+#define LIT_EXTRACT_DATA(type) LIT_EXTRACT_DATA_FROM(instance, type)
 
 #define LIT_EXTRACT_DATA_FROM(from, type) ({ \
     LitValue _d; \
-		if (!lit_table_get(&AS_INSTANCE(from)->fields, CONST_STRING(vm->state, "_data"), &_d)) { \
+		if (!lit_instance_get(AS_INSTANCE(from), CONST_STRING(vm->state, "_data"), &_d)) { \
 			lit_runtime_error_exiting(vm, "Failed to extract userdata");\
+			return NULL_VALUE; \
 		} \
 		(type*) AS_USERDATA(_d)->data; \
 	})
 
+/*
+ * Natives are expected to follow the old error protocol by default, where lit_runtime_error_exiting() and
+ * the lit_check_* functions never return, so the VM sets up a jump target around every call to them.
+ * Natives bound between these return right after reporting an error instead (the LIT_CHECK_* macros do that),
+ * and are called without the setjmp
+ */
+#define LIT_BEGIN_RETURNING_NATIVES() \
+	bool was_exiting = state->exiting_natives; \
+	state->exiting_natives = false;
+
+#define LIT_END_RETURNING_NATIVES() state->exiting_natives = was_exiting;
+
 #endif
\ No newline at end of file
@@ -24,6 +24,9 @@ typedef struct {
 	bool constant;
 
 	uint8_t reg;
+
+	// The CLOSURE instruction, that created the value, as long as the local was only called (or -1)
+	int closure;
 } LitLocal;
 
 DECLARE_ARRAY(LitLocals, LitLocal, locals)
@@ -67,6 +70,9 @@ typedef struct sLitEmitter {
 
 	bool class_has_super;
 	int emit_reference;
+
+	bool emit_callee;
+	int last_closure;
 } sLitEmitter;
 
 void lit_init_emitter(LitState* state, LitEmitter* emitter);
@@ -0,0 +1,45 @@
+#ifndef LIT_JIT_H
+#define LIT_JIT_H
+
+#include "lit/lit_common.h"
+#include "lit/lit_predefines.h"
+#include "lit/lit_config.h"
+#include "lit/vm/lit_object.h"
+
+void lit_set_jit_enabled(bool enabled);
+bool lit_is_jit_enabled();
+
+#ifdef LIT_JIT
+
+#define LIT_JIT_NO_ENTRY UINT32_MAX
+
+// Takes the frame and the native address to start at, returns the offset of the instruction, that the interpreter has to continue from
+typedef uint32_t (*LitJitFn)(LitValue* registers, LitValue* constants, LitValue* privates, uint8_t* entry);
+
+typedef struct sLitJitCode {
+	uint8_t* code;
+	size_t size;
+
+	// Native offset of every instruction, or LIT_JIT_NO_ENTRY, if the native code would exit right away
+	uint32_t* entries;
+	uint entry_count;
+} LitJitCode;
+
+bool lit_jit_compile(LitState* state, LitFunction* function);
+void lit_free_jit_code(LitState* state, LitFunction* function);
+
+// Runs the native code starting at ip, and returns the instruction, that the interpreter has to pick up from
+static inline uint32_t* lit_jit_run(LitFunction* function, uint32_t* ip, LitValue* registers, LitValue* privates) {
+	LitJitCode* jit = function->jit;
+	uint32_t* code = function->chunk.code;
+	uint32_t entry = jit->entries[ip - code];
+
+	if (entry == LIT_JIT_NO_ENTRY) {
+		return ip;
+	}
+
+	return code + ((LitJitFn) jit->code)(registers, function->chunk.constants.values, privates, jit->code + entry);
+}
+
+#endif
+#endif
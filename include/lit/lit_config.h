@@ -6,7 +6,7 @@
 #define LIT_VERSION_MAJOR 0
 #define LIT_VERSION_MINOR 4
 #define LIT_VERSION_STRING "0.4"
-#define LIT_BYTECODE_VERSION 0
+#define LIT_BYTECODE_VERSION 4
 
 // #define TESTING
 
@@ -43,9 +43,18 @@
 #define LIT_REGISTERS_MAX 250 // Can't be over 255
 
 #define LIT_GC_HEAP_GROW_FACTOR 2
+#define LIT_GC_NURSERY_SIZE (512 * 1024) // Bytes allocated between two young collections
+#define LIT_GC_STEP_SIZE (64 * 1024) // Bytes allocated between two steps of an incremental collection
+#define LIT_GC_STEP_WORK 8192 // Objects visited by one step
 #define LIT_CALL_FRAMES_MAX 64
 #define LIT_INITIAL_CALL_FRAMES 4
 #define LIT_CONTAINER_OUTPUT_MAX 10
+#define LIT_INLINE_CACHE_SIZE 4 // Receiver classes remembered per call site
+#define LIT_BOUND_METHOD_CACHE_SIZE 64 // Has to be a power of two
+
+#define LIT_SHAPE_SLOTS_MAX 32 // Instances with more fields switch to dictionary mode
+#define LIT_CLASS_SHAPES_MAX 256
+#define LIT_INSTANCE_INLINE_SLOTS_MAX 8
 
 #if defined(__ANDROID__) || defined(_ANDROID_)
 #define LIT_OS_ANDROID
@@ -61,4 +70,16 @@
 #define LIT_OS_UNKNOWN
 #endif
 
+// The JIT only knows how to emit x86-64 code, and relies on mmap
+#if defined(LIT_JIT) && !(defined(__x86_64__) && defined(LIT_OS_LINUX))
+#undef LIT_JIT
+#endif
+
+// The parallel marker uses POSIX threads
+#if defined(LIT_PARALLEL_GC) && !defined(LIT_OS_UNIX_LIKE)
+#undef LIT_PARALLEL_GC
+#endif
+
+#define LIT_JIT_THRESHOLD 1000 // Loop iterations before the function gets compiled
+
 #endif
@@ -13,15 +13,100 @@
 
 #define LIT_ALLOCATE(state, type, count) (type*) lit_reallocate(state, NULL, 0, sizeof(type) * (count))
 #define LIT_FREE(state, type, pointer) lit_reallocate(state, pointer, sizeof(type), 0)
+#define LIT_FREE_OBJECT(state, type, pointer) lit_slab_free(state, pointer, sizeof(type))
 
 void* lit_reallocate(LitState* state, void* pointer, size_t old_size, size_t new_size);
 void lit_free_objects(LitState* state, LitObject* objects);
 
 uint64_t lit_collect_garbage(LitVm* vm);
+uint64_t lit_collect_young(LitVm* vm);
+bool lit_collect_step(LitVm* vm, uint64_t budget);
+bool lit_set_gc_threads(LitVm* vm, uint count);
+void lit_remember_object(LitVm* vm, LitObject* object);
 void lit_mark_object(LitVm* vm, LitObject* object);
 void lit_mark_value(LitVm* vm, LitValue value);
 void lit_free_object(LitState* state, LitObject* object);
 
 int lit_closest_power_of_two(int n);
 
+/*
+ * Old objects are not traced by young collections, so every store into an object, that might have survived
+ * a collection already, has to be followed by the write barrier, if the new value can be a young object.
+ * The remembered object is traced by the next young collection.
+ */
+#define LIT_REMEMBER_OBJECT(vm, object) \
+	if (((LitObject*) (object))->marked) { \
+		lit_remember_object(vm, (LitObject*) (object)); \
+	}
+
+#define LIT_WRITE_BARRIER(vm, object, value) \
+	if (IS_OBJECT(value) && !AS_OBJECT(value)->marked) { \
+		LIT_REMEMBER_OBJECT(vm, object) \
+	}
+
+// Native methods don't use the barrier, so their receivers are remembered after the call instead
+#define LIT_REMEMBER_VALUE(vm, value) \
+	if (IS_OBJECT(value)) { \
+		LIT_REMEMBER_OBJECT(vm, AS_OBJECT(value)) \
+	}
+
+#define LIT_SLAB_SIZE (64 * 1024)
+#define LIT_SLAB_CLASSES 32 // One for every 8 bytes
+#define LIT_SLAB_OBJECT_MAX (LIT_SLAB_CLASSES * 8)
+
+typedef struct sLitSlab {
+	struct sLitSlab* next;
+	uint8_t data[];
+} LitSlab;
+
+/*
+ * Size-class allocator for the object structs: objects of the same size share a free list, and new ones are
+ * cut out of the current slab one after another, so there is no malloc header per object, and objects,
+ * that were created together, stay close in memory. The slabs are only released with the state.
+ * In ASAN builds everything in the slabs, that isn't a live object (free list entries included), is poisoned.
+ */
+typedef struct sLitSlabAllocator {
+	LitSlab* slabs;
+
+	uint8_t* top;
+	uint8_t* end;
+
+	// Freed objects, the first bytes of each point to the next one
+	void* free_lists[LIT_SLAB_CLASSES];
+} LitSlabAllocator;
+
+void lit_init_slabs(LitSlabAllocator* slabs);
+void lit_free_slabs(LitSlabAllocator* slabs);
+
+void* lit_slab_allocate(LitState* state, size_t size);
+void lit_slab_free(LitState* state, void* pointer, size_t size);
+
+#define LIT_ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct sLitArenaBlock {
+	struct sLitArenaBlock* next;
+
+	size_t size;
+	size_t used;
+
+	uint8_t data[];
+} LitArenaBlock;
+
+/*
+ * Bump allocator for short-lived compiler data: allocations are never freed one by one,
+ * the whole arena is released at once with lit_free_arena(). Doesn't count towards the GC heap.
+ */
+typedef struct sLitArena {
+	LitArenaBlock* block;
+
+	// Only the most recent allocation can grow in place
+	void* last;
+} LitArena;
+
+void lit_init_arena(LitArena* arena);
+void lit_free_arena(LitArena* arena);
+
+void* lit_arena_allocate(LitArena* arena, size_t size);
+void* lit_arena_reallocate(LitArena* arena, void* pointer, size_t old_size, size_t new_size);
+
 #endif
\ No newline at end of file
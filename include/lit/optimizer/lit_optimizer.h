@@ -12,19 +12,51 @@ typedef struct {
 
 	bool constant;
 	bool used;
+	// Set, if the variable is never assigned and its value is known to be a number
+	bool number;
 
 	LitValue constant_value;
 	LitStatement** declaration;
+
+	// Set, if the calls to this function can be replaced with its body
+	LitFunctionStatement* function;
 } LitVariable;
 
 DECLARE_ARRAY(LitVariables, LitVariable, variables)
 
+typedef struct {
+	const char* name;
+	uint length;
+} LitName;
+
+DECLARE_ARRAY(LitNames, LitName, names)
+
+typedef struct sLitLoop {
+	struct sLitLoop* enclosing;
+	// Variables, that were declared before the loop
+	uint variables;
+	// Declarations of the expressions, that were moved out of the loop
+	LitStatements hoisted;
+} LitLoop;
+
 typedef struct sLitOptimizer {
 	LitState* state;
 
 	LitVariables variables;
+	// Variables, that are assigned or referenced anywhere in the module
+	LitNames assignments;
+	// Reads of the variables, that were not declared at that point
+	LitNames unresolved;
 	int depth;
 	bool mark_used;
+
+	// Innermost loop of the current function
+	LitLoop* loop;
+	// Variables, that were declared before the current function
+	uint function_start;
+	// Set, while optimizing an operand, callee or assignment target, that can't be moved out of the loop by itself
+	bool keep_in_place;
+	uint invariant_count;
 } sLitOptimizer;
 
 void lit_init_optimizer(LitState* state, LitOptimizer* optimizer);
@@ -51,6 +83,11 @@ typedef enum {
 	OPTIMIZATION_LINE_INFO,
 	OPTIMIZATION_PRIVATE_NAMES,
 	OPTIMIZATION_C_FOR,
+	OPTIMIZATION_PEEPHOLE,
+	OPTIMIZATION_INLINE,
+	OPTIMIZATION_CONSTANT_PROPAGATION,
+	OPTIMIZATION_STRENGTH_REDUCTION,
+	OPTIMIZATION_LOOP_INVARIANT,
 
 	OPTIMIZATION_TOTAL
 } LitOptimization;
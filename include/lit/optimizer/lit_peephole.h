@@ -0,0 +1,15 @@
+#ifndef LIT_PEEPHOLE_H
+#define LIT_PEEPHOLE_H
+
+#include "lit/lit_common.h"
+#include "lit/lit_predefines.h"
+#include "lit/vm/lit_chunk.h"
+
+/*
+ * Bytecode pass, that runs on every finished chunk: strength reduces arithmetic by constants, threads jumps, drops unreachable
+ * instructions and dead stores, and folds the moves, that the register allocator leaves
+ * around temporaries, into the instructions, that produce or consume them.
+ */
+void lit_optimize_chunk(LitState* state, LitChunk* chunk);
+
+#endif
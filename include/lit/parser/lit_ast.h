@@ -56,8 +56,12 @@ typedef struct sLitStatement {
  * Expressions
  */
 
+/*
+ * All of the AST lives in the parser arena, and is released at once, when the module is emitted
+ */
+
 DECLARE_ARRAY(LitExpressions, LitExpression*, expressions)
-void lit_free_expression(LitState* state, LitExpression* expression);
+DECLARE_ARRAY(LitKeys, LitValue, keys)
 
 typedef struct {
 	LitExpression expression;
@@ -111,6 +115,9 @@ typedef struct {
 	LitExpressions args;
 
 	LitExpression* init;
+
+	// Set by the emitter, if the result is returned right away
+	bool tail_call;
 } LitCallExpression;
 
 LitCallExpression *lit_create_call_expression(LitState* state, uint line, LitExpression* callee);
@@ -170,7 +177,7 @@ LitArrayExpression *lit_create_array_expression(LitState* state, uint line);
 typedef struct {
 	LitExpression expression;
 
-	LitValues keys;
+	LitKeys keys;
 	LitExpressions values;
 } LitObjectExpression;
 
@@ -240,7 +247,6 @@ LitReferenceExpression *lit_create_reference_expression(LitState* state, uint li
  */
 
 DECLARE_ARRAY(LitStatements, LitStatement*, stataments)
-void lit_free_statement(LitState* state, LitStatement* statement);
 
 typedef struct {
 	LitStatement statement;
@@ -374,9 +380,6 @@ typedef struct {
 LitFieldStatement *lit_create_field_statement(LitState* state, uint line, LitString* name, LitStatement* getter, LitStatement* setter, bool is_static);
 
 LitExpressions* lit_allocate_expressions(LitState* state);
-void lit_free_allocated_expressions(LitState* state, LitExpressions* expressions);
-
 LitStatements* lit_allocate_statements(LitState* state);
-void lit_free_allocated_statements(LitState* state, LitStatements* statements);
 
 #endif
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "lit/lit_predefines.h"
 #include "lit/parser/lit_ast.h"
 #include "lit/emitter/lit_emitter.h"
+#include "lit/mem/lit_mem.h"
 #include "lit/lit_config.h"
 
 typedef enum {
@@ -49,6 +50,9 @@ typedef struct sLitParser {
 
 	uint8_t expression_root_count;
 	uint8_t statement_root_count;
+
+	// Holds the AST, until the module is emitted
+	LitArena arena;
 } sLitParser;
 
 void lit_init_parser(LitState* state, LitParser* parser);
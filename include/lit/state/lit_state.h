@@ -5,6 +5,7 @@
 #include "lit/lit_predefines.h"
 #include "lit/vm/lit_object.h"
 #include "lit/event/lit_event.h"
+#include "lit/mem/lit_mem.h"
 #include "lit/lit_config.h"
 
 #include <stdarg.h>
@@ -20,8 +21,11 @@ typedef void (*LitPrintFn)(LitState* state, const char* message);
 typedef struct sLitState {
 	int64_t bytes_allocated;
 	int64_t next_gc;
+	int64_t next_full_gc;
 	bool allow_gc;
 
+	LitSlabAllocator slabs;
+
 	LitErrorFn error_fn;
 	LitPrintFn print_fn;
 
@@ -38,6 +42,8 @@ typedef struct sLitState {
 	LitEventSystem* event_system;
 
 	bool had_error;
+	// Natives created while this is set get a jump target for lit_runtime_error_exiting() around every call
+	bool exiting_natives;
 
 	LitFunction* api_function;
 	LitString* api_name;
@@ -57,6 +63,8 @@ typedef struct sLitState {
 	LitClass* range_class;
 
 	LitModule* last_module;
+	uint class_version;
+	uint shape_id;
 } sLitState;
 
 typedef enum {
@@ -37,6 +37,29 @@
 		array->count++; \
 	}
 
+// Same as DEFINE_ARRAY, but the storage is taken from an arena and is released together with it
+#define DEFINE_ARENA_ARRAY(name, type, shr, arena) \
+	void lit_init_##shr(name* array) { \
+		array->values = NULL; \
+		array->capacity = 0; \
+		array->count = 0; \
+	} \
+	\
+	void lit_free_##shr(LitState* state, name* array) { \
+		lit_init_##shr(array); \
+	} \
+	\
+	void lit_##shr##_write(LitState* state, name* array, type value) { \
+		if (array->capacity < array->count + 1) { \
+			uint old_capacity = array->capacity; \
+			array->capacity = LIT_GROW_CAPACITY(old_capacity); \
+			array->values = (type*) lit_arena_reallocate(arena, array->values, sizeof(type) * old_capacity, sizeof(type) * array->capacity); \
+		} \
+		\
+		array->values[array->count] = value; \
+		array->count++; \
+	}
+
 DECLARE_ARRAY(LitUInts, uint, uints)
 DECLARE_ARRAY(LitBytes, uint8_t, bytes)
 
@@ -43,7 +43,7 @@ uint64_t lit_read_euint64_t(LitEmulatedFile* file);
 double lit_read_edouble(LitEmulatedFile* file);
 LitString* lit_read_estring(LitState* state, LitEmulatedFile* file);
 
-void lit_save_module(LitModule* module, FILE* file);
+void lit_save_module(LitState* state, LitModule* module, FILE* file);
 LitModule* lit_load_module(LitState* state, const char* input);
 bool lit_generate_source_file(const char* file, const char* output);
 void lit_build_native_runner(const char* bytecode_file);
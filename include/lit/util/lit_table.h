@@ -30,6 +30,10 @@ LitString* lit_table_find_string(LitTable* table, const char* chars, uint length
 void lit_table_add_all(LitState* state, LitTable* from, LitTable* to);
 void lit_table_add_all_ignoring(LitState* state, LitTable* from, LitTable* to);
 
+// Returns the index of the next used entry after number (start with -1), or -1, once there are none left
+int lit_table_iterator(LitTable* table, int number);
+LitValue lit_table_iterator_key(LitTable* table, int index);
+
 void lit_table_remove_white(LitTable* table);
 void lit_mark_table(LitVm* vm, LitTable* table);
 
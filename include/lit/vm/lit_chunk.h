@@ -5,13 +5,52 @@
 #include "lit/lit_predefines.h"
 #include "lit/vm/lit_value.h"
 #include "lit/vm/lit_instruction.h"
+#include "lit/lit_config.h"
 
 #include <stdio.h>
 
+typedef struct {
+	struct sLitClass* klass;
+	uint version;
+
+	bool is_static;
+	bool found;
+
+	LitValue value;
+} LitInlineCacheEntry;
+
+typedef struct {
+	LitInlineCacheEntry entries[LIT_INLINE_CACHE_SIZE];
+	uint8_t next;
+
+	// Instance field slot (-1 if the shape has no such field), and the shape it transitions to on assignment
+	struct sLitShape* shape;
+	struct sLitShape* transition;
+	uint shape_id;
+	int slot;
+} LitInlineCache;
+
+/*
+ * Open addressing hash index over a value pool, so that adding a constant doesn't have to scan all the previous ones.
+ * Values are compared by their bits, same as the linear search did.
+ */
+typedef struct {
+	uint capacity;
+	uint count;
+
+	// Position in the pool + 1, 0 marks an empty slot
+	uint* slots;
+} LitConstantIndex;
+
+void lit_init_constant_index(LitConstantIndex* index);
+void lit_free_constant_index(LitState* state, LitConstantIndex* index);
+int lit_find_constant(LitConstantIndex* index, LitValues* values, LitValue value);
+void lit_index_constant(LitState* state, LitConstantIndex* index, LitValues* values, uint position);
+
 typedef struct {
 	uint count;
 	uint capacity;
-	uint64_t* code;
+	uint32_t* code;
 
 	bool has_line_info;
 
@@ -20,13 +59,23 @@ typedef struct {
 	uint16_t* lines;
 
 	LitValues constants;
+
+	// Only exists while the chunk is being emitted, lit_shrink_chunk() drops it
+	LitConstantIndex constant_index;
+
+	// Allocated lazily, only for the instructions that use them
+	uint16_t* cache_indices;
+	LitInlineCache* caches;
+	uint cache_count;
+	uint cache_capacity;
 } LitChunk;
 
 void lit_init_chunk(LitChunk* chunk);
 void lit_free_chunk(LitState* state, LitChunk* chunk);
-void lit_write_chunk(LitState* state, LitChunk* chunk, uint64_t word, uint16_t line);
+void lit_write_chunk(LitState* state, LitChunk* chunk, uint32_t word, uint16_t line);
 uint lit_chunk_add_constant(LitState* state, LitChunk* chunk, LitValue constant);
 uint lit_chunk_get_line(LitChunk* chunk, uint offset);
 void lit_shrink_chunk(LitState* state, LitChunk* chunk);
+LitInlineCache* lit_chunk_get_cache(LitState* state, LitChunk* chunk, uint offset);
 
 #endif
\ No newline at end of file
@@ -3,8 +3,9 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <stdint.h>
 
-#define LIT_LONGEST_OP_NAME 13
+#define LIT_LONGEST_OP_NAME 18
 
 typedef enum {
 	#define OPCODE(name, a, b) OP_##name,
@@ -16,60 +17,87 @@ typedef enum {
 	LIT_INSTRUCTION_ABC,
 	LIT_INSTRUCTION_ABX,
 	LIT_INSTRUCTION_ASBX,
+	LIT_INSTRUCTION_ABCK
 } LitInstructionType;
 
-#define LIT_OPCODE_SIZE 0x3f
+#define LIT_OPCODE_SIZE 0x7f
 #define LIT_A_ARG_SIZE 0xff
-#define LIT_B_ARG_SIZE 0x1ff
-#define LIT_C_ARG_SIZE 0x1ff
-#define LIT_BX_ARG_SIZE 0x3ffff // 18 bits max
-#define LIT_SBX_ARG_SIZE 0x1ffff // 17 bits max
+#define LIT_B_ARG_SIZE 0xff
+#define LIT_C_ARG_SIZE 0xff
+#define LIT_K_ARG_SIZE 0x1ff // B or C, with the K bit on top
+#define LIT_BX_ARG_SIZE 0x1ffff // 17 bits max
+#define LIT_SBX_ARG_SIZE 0xffff // 16 bits max
 
-#define LIT_A_ARG_POSITION 6
-#define LIT_B_ARG_POSITION 14
+#define LIT_A_ARG_POSITION 7
+#define LIT_B_ARG_POSITION 15
 #define LIT_C_ARG_POSITION 23
-#define LIT_BX_ARG_POSITION 14
-#define LIT_SBX_ARG_POSITION 15
-#define LIT_SBX_FLAG_POSITION 14
+#define LIT_K_ARG_POSITION 31
+#define LIT_BX_ARG_POSITION 15
+#define LIT_SBX_ARG_POSITION 16
+#define LIT_SBX_FLAG_POSITION 15
 
 /*
- * Instruction can follow one of the three formats:
+ * Instructions are 32 bit words, that can follow one of the four formats:
  *
- * ABC  opcode:6 bits (starting from bit 0), A:8 bits, B:9 bits, C:9 bits
- * ABx  opcode:6 bits (starting from bit 0), A:8 bits, Bx:18 bits
- * AsBx opcode:6 bits (starting from bit 0), A:8 bits, sBx:18 bits (signed)
+ * ABC  opcode:7 bits (starting from bit 0), A:8 bits, B:8 bits, C:8 bits, K:1 bit, K is the 9th bit of B
+ * ABCK opcode:7 bits (starting from bit 0), A:8 bits, B:8 bits, C:8 bits, K:1 bit, K is the 9th bit of C
+ * ABx  opcode:7 bits (starting from bit 0), A:8 bits, Bx:17 bits
+ * AsBx opcode:7 bits (starting from bit 0), A:8 bits, sBx:17 bits (signed)
+ *
+ * Only one of B and C can be a constant (or a constant index over 255), the other one has to be a register or a count
  */
 
 #define LIT_INSTRUCTION_OPCODE(instruction) (instruction & LIT_OPCODE_SIZE)
 #define LIT_INSTRUCTION_A(instruction) ((instruction >> LIT_A_ARG_POSITION) & LIT_A_ARG_SIZE)
 #define LIT_INSTRUCTION_B(instruction) ((instruction >> LIT_B_ARG_POSITION) & LIT_B_ARG_SIZE)
 #define LIT_INSTRUCTION_C(instruction) ((instruction >> LIT_C_ARG_POSITION) & LIT_C_ARG_SIZE)
+#define LIT_INSTRUCTION_BK(instruction) (LIT_INSTRUCTION_B(instruction) | ((instruction >> (LIT_K_ARG_POSITION - 8)) & 0x100))
+#define LIT_INSTRUCTION_CK(instruction) ((instruction >> LIT_C_ARG_POSITION) & LIT_K_ARG_SIZE)
 #define LIT_INSTRUCTION_BX(instruction) ((instruction >> LIT_BX_ARG_POSITION) & LIT_BX_ARG_SIZE)
-#define LIT_INSTRUCTION_SBX(instruction) (((instruction >> LIT_SBX_ARG_POSITION) & LIT_SBX_ARG_SIZE) \
+#define LIT_INSTRUCTION_SBX(instruction) ((int32_t) ((instruction >> LIT_SBX_ARG_POSITION) & LIT_SBX_ARG_SIZE) \
 	* (((instruction >> LIT_SBX_FLAG_POSITION) & 0x1) == 1 ? -1 : 1))
 
+#define LIT_INSTRUCTION_WITH_OPCODE(instruction, opcode) (((instruction) & ~((uint32_t) LIT_OPCODE_SIZE)) | (opcode))
+#define LIT_INSTRUCTION_WITH_A(instruction, a) (((instruction) & ~((uint32_t) LIT_A_ARG_SIZE << LIT_A_ARG_POSITION)) | ((uint32_t) (a) << LIT_A_ARG_POSITION))
+
 #define LIT_READ_ABC_INSTRUCTION(instruction) uint8_t a = LIT_INSTRUCTION_A(instruction); \
-	uint16_t b = LIT_INSTRUCTION_B(instruction); \
+	uint16_t b = LIT_INSTRUCTION_BK(instruction); \
 	uint16_t c = LIT_INSTRUCTION_C(instruction);
 
+#define LIT_READ_ABCK_INSTRUCTION(instruction) uint8_t a = LIT_INSTRUCTION_A(instruction); \
+	uint16_t b = LIT_INSTRUCTION_B(instruction); \
+	uint16_t c = LIT_INSTRUCTION_CK(instruction);
+
 #define LIT_READ_BX_INSTRUCTION(instruction) uint8_t a = LIT_INSTRUCTION_A(instruction); \
 	uint32_t bx = LIT_INSTRUCTION_BX(instruction);
 
 #define LIT_READ_SBX_INSTRUCTION(instruction) uint8_t a = LIT_INSTRUCTION_A(instruction); \
 	int32_t sbx = LIT_INSTRUCTION_SBX(instruction);
 
-#define LIT_FORM_ABC_INSTRUCTION(opcode, a, b, c) (((opcode) & LIT_OPCODE_SIZE) \
-	| (((a) & LIT_A_ARG_SIZE) << LIT_A_ARG_POSITION) \
-	| (((b) & LIT_B_ARG_SIZE) << LIT_B_ARG_POSITION) \
-	| (((c) & LIT_C_ARG_SIZE) << LIT_C_ARG_POSITION))
+// Works for both ABC and ABCK, the 9th bit of whichever of B and C has it goes into K
+#define LIT_FORM_ABC_INSTRUCTION(opcode, a, b, c) ((uint32_t) (((opcode) & LIT_OPCODE_SIZE) \
+	| (((uint32_t) (a) & LIT_A_ARG_SIZE) << LIT_A_ARG_POSITION) \
+	| (((uint32_t) (b) & LIT_B_ARG_SIZE) << LIT_B_ARG_POSITION) \
+	| (((uint32_t) (c) & LIT_C_ARG_SIZE) << LIT_C_ARG_POSITION) \
+	| ((((uint32_t) (b) | (uint32_t) (c)) & 0x100) << (LIT_K_ARG_POSITION - 8))))
+
+#define LIT_FORM_ABX_INSTRUCTION(opcode, a, bx) ((uint32_t) (((opcode) & LIT_OPCODE_SIZE) \
+	| (((uint32_t) (a) & LIT_A_ARG_SIZE) << LIT_A_ARG_POSITION) \
+	| (((uint32_t) (bx) & LIT_BX_ARG_SIZE) << LIT_BX_ARG_POSITION)))
+
+#define LIT_FORM_ASBX_INSTRUCTION(opcode, a, sbx) ((uint32_t) (((opcode) & LIT_OPCODE_SIZE) \
+	| (((uint32_t) (a) & LIT_A_ARG_SIZE) << LIT_A_ARG_POSITION) \
+	| (((uint32_t) abs((int) (sbx)) & LIT_SBX_ARG_SIZE) << LIT_SBX_ARG_POSITION) \
+	| ((uint32_t) ((sbx) < 0 ? 1 : 0) << LIT_SBX_FLAG_POSITION)))
 
-#define LIT_FORM_ABX_INSTRUCTION(opcode, a, bx) (((opcode) & LIT_OPCODE_SIZE) \
-	| (((a) & LIT_A_ARG_SIZE) << LIT_A_ARG_POSITION) \
-	| (((bx) & LIT_BX_ARG_SIZE) << LIT_BX_ARG_POSITION))
+static inline LitInstructionType lit_get_instruction_type(uint8_t opcode) {
+	switch (opcode) {
+		#define OPCODE(name, string_name, type) case OP_##name: return type;
+		#include "lit/vm/lit_opcodes.h"
+		#undef OPCODE
 
-#define LIT_FORM_ASBX_INSTRUCTION(opcode, a, sbx) (((opcode) & LIT_OPCODE_SIZE) \
-	| (((a) & LIT_A_ARG_SIZE) << LIT_A_ARG_POSITION) \
-	| ((abs((int) (sbx)) & LIT_SBX_ARG_SIZE) << LIT_SBX_ARG_POSITION)) \
-	| ((((sbx) < 0 ? 1 : 0) << LIT_SBX_FLAG_POSITION))
+		default: return LIT_INSTRUCTION_ABC;
+	}
+}
 
-#endif
\ No newline at end of file
+#endif
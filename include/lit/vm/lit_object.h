@@ -110,13 +110,22 @@ static const char* lit_object_type_names[] = {
 	"reference"
 };
 
+/*
+ * The header is a single word: object pointers have to fit into 48 bits for the values already (see OBJECT_VALUE()),
+ * so the link to the next object takes just as much, and the rest holds the type and the mark bit.
+ */
 typedef struct sLitObject {
-	LitObjectType type;
-	struct sLitObject* next;
+	// Use LIT_OBJECT_NEXT() and LIT_SET_OBJECT_NEXT()
+	uint64_t next : 48;
+	uint64_t type : 8;
 
-	bool marked;
+	// Stays set on the objects, that survived a collection (the old generation), see lit_collect_young()
+	uint64_t marked : 1;
 } sLitObject;
 
+#define LIT_OBJECT_NEXT(object) ((LitObject*) (uintptr_t) (object)->next)
+#define LIT_SET_OBJECT_NEXT(object, value) (object)->next = (uint64_t) (uintptr_t) (value)
+
 LitObject* lit_allocate_object(LitState* state, size_t size, LitObjectType type);
 
 typedef struct sLitString {
@@ -156,6 +165,14 @@ typedef struct {
 	bool vararg;
 
 	struct sLitModule* module;
+
+	// Set on the stack copies of closures, that are passed to borrowing natives, in case the callee turns out to keep them
+	struct sLitClosurePrototype* escape_prototype;
+
+#ifdef LIT_JIT
+	struct sLitJitCode* jit;
+	uint hotness;
+#endif
 } LitFunction;
 
 LitFunction* lit_create_function(LitState* state, LitModule* module);
@@ -166,8 +183,6 @@ typedef struct sLitUpvalue {
 
 	LitValue* location;
 	LitValue closed;
-
-	struct sLitUpvalue* next;
 } LitUpvalue;
 
 LitUpvalue* lit_create_upvalue(LitState* state, LitValue* slot);
@@ -182,7 +197,7 @@ typedef struct {
 
 LitClosure* lit_create_closure(LitState* state, LitFunction* function);
 
-typedef struct {
+typedef struct sLitClosurePrototype {
 	LitObject object;
 	LitFunction* function;
 
@@ -201,6 +216,9 @@ typedef struct {
 
 	LitNativeFunctionFn function;
 	LitString* name;
+
+	// Set unless the native returns right after reporting an error, see LIT_BEGIN_RETURNING_NATIVES()
+	bool exiting;
 } LitNativeFunction;
 
 LitNativeFunction* lit_create_native_function(LitState* state, LitNativeFunctionFn function, LitString* name);
@@ -212,6 +230,9 @@ typedef struct {
 
 	LitNativePrimitiveFn function;
 	LitString* name;
+
+	// Set unless the native returns right after reporting an error, see LIT_BEGIN_RETURNING_NATIVES()
+	bool exiting;
 } LitNativePrimitive;
 
 LitNativePrimitive* lit_create_native_primitive(LitState* state, LitNativePrimitiveFn function, LitString* name);
@@ -223,6 +244,11 @@ typedef struct {
 
 	LitNativeMethodFn method;
 	LitString* name;
+
+	// Set unless the native returns right after reporting an error, see LIT_BEGIN_RETURNING_NATIVES()
+	bool exiting;
+	// Set if the native only ever calls its function arguments before returning, see LIT_BIND_BORROWING_METHOD()
+	bool borrowing;
 } LitNativeMethod;
 
 LitNativeMethod* lit_create_native_method(LitState* state, LitNativeMethodFn function, LitString* name);
@@ -234,6 +260,9 @@ typedef struct {
 
 	LitPrimitiveMethodFn method;
 	LitString* name;
+
+	// Set unless the native returns right after reporting an error, see LIT_BEGIN_RETURNING_NATIVES()
+	bool exiting;
 } LitPrimitiveMethod;
 
 LitPrimitiveMethod* lit_create_primitive_method(LitState* state, LitPrimitiveMethodFn method, LitString* name);
@@ -242,12 +271,15 @@ typedef struct {
 	LitFunction* function;
 	LitClosure* closure;
 
-	uint64_t* ip;
+	uint32_t* ip;
 	LitValue* slots;
 	LitValue* return_address;
 
 	bool result_ignored;
 	bool return_to_c;
+
+	// How many frames were replaced by this one, only used for the stack traces
+	uint tail_calls;
 } LitCallFrame;
 
 typedef LitValue (*LitMapIndexFn)(LitVm* vm, struct sLitMap* map, LitString* index, LitValue* value);
@@ -298,7 +330,11 @@ typedef struct sLitFiber {
 	uint arg_count;
 
 	LitValue* return_address;
-	LitUpvalue* open_upvalues;
+
+	// The open upvalue of every register (or NULL), so that capturing doesn't have to search for it
+	LitUpvalue** open_upvalues;
+	uint open_upvalue_top; // All the registers from here up have no open upvalues
+
 	LitModule* module;
 	LitValue error;
 
@@ -312,6 +348,47 @@ LitFiber* lit_create_fiber_with_closure(LitState* state, LitModule* module, LitC
 
 void lit_ensure_fiber_registers(LitState* state, LitFiber* fiber, uint needed);
 
+/*
+ * Shapes describe the layout of instances: every shape maps field names to slot indexes,
+ * and instances that got the same fields in the same order share a shape.
+ * Shapes form a transition tree, owned by the class, that is freed together with it.
+ */
+typedef struct sLitShape {
+	struct sLitShape* parent;
+	struct sLitShape* children;
+	struct sLitShape* next;
+
+	// The field, added by the transition from the parent shape
+	LitString* name;
+	LitString** names;
+
+	uint slot_count;
+	// Unique across the state, so that inline caches can't hit a freed and reallocated shape
+	uint id;
+} LitShape;
+
+int lit_shape_find(LitShape* shape, LitString* name);
+
+// Methods, that the VM calls for the operators, get a fixed slot in every class
+typedef enum {
+	OPERATOR_ADD,
+	OPERATOR_SUBTRACT,
+	OPERATOR_MULTIPLY,
+	OPERATOR_DIVIDE,
+	OPERATOR_FLOOR_DIVIDE,
+	OPERATOR_MOD,
+	OPERATOR_POWER,
+	OPERATOR_EQUAL,
+	OPERATOR_LESS,
+	OPERATOR_LESS_EQUAL,
+	OPERATOR_GREATER,
+	OPERATOR_GREATER_EQUAL,
+	OPERATOR_NOT,
+	OPERATOR_SUBSCRIPT,
+
+	OPERATOR_TOTAL
+} LitOperator;
+
 typedef struct sLitClass {
 	LitObject object;
 
@@ -321,20 +398,56 @@ typedef struct sLitClass {
 	LitTable methods;
 	LitTable static_fields;
 
+	// Mirrors the operator methods from the methods table, null if the operator isn't defined
+	LitValue operators[OPERATOR_TOTAL];
+
 	struct sLitClass* super;
+
+	// Changes every time methods or static fields are modified, invalidating inline caches
+	uint version;
+
+	LitShape* shape;
+	uint shape_count;
+	// Amount of inline slots, allocated with new instances
+	uint instance_slots;
 } LitClass;
 
 LitClass* lit_create_class(LitState* state, LitString* name);
+void lit_invalidate_class(LitState* state, LitClass* klass);
+// Has to be called after a method is set, in case it is an operator
+void lit_update_operator(LitClass* klass, LitString* name, LitValue method);
+// Fills in the operators, that the class doesn't define itself
+void lit_inherit_operators(LitClass* klass, LitClass* super);
 
 typedef struct {
 	LitObject object;
 
 	LitClass* klass;
+
+	// NULL, if the instance is in dictionary mode and stores its fields in the table
+	LitShape* shape;
+	LitValue* slots;
+
+	uint slot_capacity;
+	uint inline_capacity;
+
 	LitTable fields;
+	LitValue inline_slots[];
 } LitInstance;
 
 LitInstance* lit_create_instance(LitState* state, LitClass* klass);
 
+bool lit_instance_get(LitInstance* instance, LitString* name, LitValue* value);
+bool lit_instance_get_slot(LitInstance* instance, LitString* name, LitValue** value);
+void lit_instance_set(LitState* state, LitInstance* instance, LitString* name, LitValue value);
+bool lit_instance_delete(LitState* state, LitInstance* instance, LitString* name);
+LitTable* lit_instance_make_dictionary(LitState* state, LitInstance* instance);
+
+uint lit_instance_field_count(LitInstance* instance);
+int lit_instance_next_field(LitInstance* instance, int index);
+LitString* lit_instance_field_name(LitInstance* instance, int index);
+LitValue lit_instance_field_value(LitInstance* instance, int index);
+
 typedef struct {
 	LitObject object;
 
@@ -344,6 +457,9 @@ typedef struct {
 
 LitBoundMethod* lit_create_bound_method(LitState* state, LitValue receiver, LitValue method);
 
+// Reading a method might or might not hand out a cached bound method, so those are equal, if they bind the same method to the same receiver
+bool lit_values_equal(LitValue a, LitValue b);
+
 typedef struct {
 	LitObject object;
 	LitValues values;
@@ -357,6 +473,11 @@ typedef struct {
 
 LitVarargArray* lit_create_vararg_array(LitState* state);
 
+/*
+ * Called with mark set, while the userdata is traced, and without, right before it's freed.
+ * With LIT_PARALLEL_GC the marking can run on several threads at once, so the mark call
+ * can't do anything, but lit_mark_value() and lit_mark_object() on the values it holds.
+ */
 typedef void (*LitCleanupFn)(LitState* state, LitUserdata* userdata, bool mark);
 
 typedef struct sLitUserdata {
@@ -391,8 +512,11 @@ LitField* lit_create_field(LitState* state, LitObject* getter, LitObject* setter
 typedef struct {
 	LitObject object;
 	LitValue* slot;
+
+	// The object, that holds the slot, the globals map for the global slots
+	LitObject* owner;
 } LitReference;
 
-LitReference* lit_create_reference(LitState* state, LitValue* slot);
+LitReference* lit_create_reference(LitState* state, LitObject* owner, LitValue* slot);
 
 #endif
\ No newline at end of file
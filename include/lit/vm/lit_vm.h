@@ -12,20 +12,58 @@
 
 #define INTERPRET_RUNTIME_FAIL ((LitInterpretResult) {INTERPRET_INVALID, NULL_VALUE})
 
+// Where the incremental full collection is at, see lit_collect_step()
+typedef enum {
+	LIT_GC_IDLE,
+	LIT_GC_UNMARK,
+	LIT_GC_MARK,
+	LIT_GC_SWEEP
+} LitGcPhase;
+
 typedef struct sLitVm {
 	LitState* state;
+
+	// The nursery, every new object goes here, survivors of a young collection move to old_objects
 	LitObject* objects;
+	LitObject* old_objects;
 
 	LitTable strings;
 
 	LitMap* modules;
+	// Holds the values of the globals, like any other map, global_values has a copy of each at the slot,
+	// that global_slots handed out on the first write, the slots never change, every write goes to both
 	LitMap* globals;
+	LitTable global_slots;
+	LitValues global_values;
+	LitValues global_names;
+
 	LitFiber* fiber;
 
+	// Bound methods, that were handed out recently, reused while the receiver and the method match.
+	// Weak, cleared before every collection
+	LitBoundMethod* bound_methods[LIT_BOUND_METHOD_CACHE_SIZE];
+
+	// Set only while an exiting native is running, see LIT_BEGIN_RETURNING_NATIVES()
+	jmp_buf* native_exit_jump;
+
 	// For garbage collection
 	uint gray_count;
 	uint gray_capacity;
 	LitObject** gray_stack;
+
+	// Old objects, that might point into the nursery, fibers and modules never leave it
+	uint remembered_count;
+	uint remembered_capacity;
+	LitObject** remembered;
+
+	LitGcPhase gc_phase;
+	// The last old object, that was unmarked or kept by the sweep, NULL before the first one
+	LitObject* gc_cursor;
+	// The nursery of the running cycle, swept after the old objects
+	LitObject* sweeping;
+
+	// The thread pool, that does the marking for full collections, see lit_set_gc_threads()
+	struct sLitMarker* marker;
 } sLitVm;
 
 typedef struct sLitInterpretResult {
@@ -36,6 +74,11 @@ typedef struct sLitInterpretResult {
 void lit_init_vm(LitState* state, LitVm* vm);
 void lit_free_vm(LitVm* vm);
 
+// Returns the slot of the global, creating it (with a null value), if needed, only writes should create slots
+uint lit_get_global_slot(LitState* state, LitString* name);
+bool lit_find_global_slot(LitVm* vm, LitString* name, uint* slot);
+void lit_set_global_slot(LitState* state, uint slot, LitValue value);
+
 LitInterpretResult lit_interpret_module(LitState* state, LitModule* module);
 
 LitInterpretResult lit_interpret_fiber(LitState* state, LitFiber* fiber);
@@ -44,8 +87,12 @@ bool lit_vruntime_error(LitVm* vm, const char* format, va_list args);
 bool lit_runtime_error(LitVm* vm, const char* format, ...);
 bool lit_runtime_error_exiting(LitVm* vm, const char* format, ...);
 
-extern jmp_buf jump_buffer;
-void lit_native_exit_jump();
-#define lit_set_native_exit_jump() setjmp(jump_buffer)
+void lit_native_exit_jump(LitVm* vm);
+
+// Call the native with the jump target it expects, the primitives return true on error
+LitValue lit_call_native_function(LitVm* vm, LitNativeFunction* native, uint arg_count, LitValue* args);
+bool lit_call_native_primitive(LitVm* vm, LitNativePrimitive* native, uint arg_count, LitValue* args);
+LitValue lit_call_native_method(LitVm* vm, LitNativeMethod* native, LitValue instance, uint arg_count, LitValue* args);
+bool lit_call_primitive_method(LitVm* vm, LitPrimitiveMethod* native, LitValue instance, uint arg_count, LitValue* args);
 
 #endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "lit/vm/lit_vm.h"
 #include "lit/vm/lit_chunk.h"
 #include "lit/vm/lit_object.h"
+#include "lit/mem/lit_mem.h"
 #include "lit/debug/lit_debug.h"
 
 #include <string.h>
@@ -18,13 +19,13 @@ void lit_free_api(LitState* state) {
 }
 
 LitValue lit_get_global(LitState* state, LitString* name) {
-	LitValue global;
+	uint slot;
 
-	if (!lit_table_get(&state->vm->globals->values, name, &global)) {
+	if (!lit_find_global_slot(state->vm, name, &slot)) {
 		return NULL_VALUE;
 	}
 
-	return global;
+	return state->vm->global_values.values[slot];
 }
 
 LitFunction* lit_get_global_function(LitState* state, LitString* name) {
@@ -38,10 +39,10 @@ LitFunction* lit_get_global_function(LitState* state, LitString* name) {
 }
 
 void lit_set_global(LitState* state, LitString* name, LitValue value) {
-	lit_push_root(state, (LitObject*) name);
 	lit_push_value_root(state, value);
-	lit_table_set(state, &state->vm->globals->values, name, value);
-	lit_pop_roots(state, 2);
+
+	lit_set_global_slot(state, lit_get_global_slot(state, name), value);
+	lit_pop_root(state);
 }
 
 bool lit_global_exists(LitState* state, LitString* name) {
@@ -52,20 +53,25 @@ bool lit_global_exists(LitState* state, LitString* name) {
 void lit_define_native(LitState* state, const char* name, LitNativeFunctionFn native) {
 	lit_push_root(state, (LitObject*) CONST_STRING(state, name));
 	lit_push_root(state, (LitObject*) lit_create_native_function(state, native, AS_STRING(lit_peek_root(state, 0))));
-	lit_table_set(state, &state->vm->globals->values, AS_STRING(lit_peek_root(state, 1)), lit_peek_root(state, 0));
+	lit_set_global(state, AS_STRING(lit_peek_root(state, 1)), lit_peek_root(state, 0));
 	lit_pop_roots(state, 2);
 }
 
 void lit_define_native_primitive(LitState* state, const char* name, LitNativePrimitiveFn native) {
 	lit_push_root(state, (LitObject*) CONST_STRING(state, name));
 	lit_push_root(state, (LitObject*) lit_create_native_primitive(state, native, AS_STRING(lit_peek_root(state, 0))));
-	lit_table_set(state, &state->vm->globals->values, AS_STRING(lit_peek_root(state, 1)), lit_peek_root(state, 0));
+	lit_set_global(state, AS_STRING(lit_peek_root(state, 1)), lit_peek_root(state, 0));
 	lit_pop_roots(state, 2);
 }
 
+bool lit_argument_error(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id, const char* expected) {
+	return lit_runtime_error_exiting(vm, "Expected %s as argument #%i, got a %s", expected, (int) id, id >= arg_count ? "null" : lit_get_value_type(args[id]));
+}
+
 double lit_check_number(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id) {
 	if (arg_count <= id || !IS_NUMBER(args[id])) {
-		lit_runtime_error_exiting(vm, "Expected a number as argument #%i, got a %s", (int) id, id >= arg_count ? "null" : lit_get_value_type(args[id]));
+		lit_argument_error(vm, args, arg_count, id, "a number");
+		return 0;
 	}
 
 	return AS_NUMBER(args[id]);
@@ -81,7 +87,8 @@ double lit_get_number(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id,
 
 bool lit_check_bool(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id) {
 	if (arg_count <= id || !IS_BOOL(args[id])) {
-		lit_runtime_error_exiting(vm, "Expected a boolean as argument #%i, got a %s", (int) id, id >= arg_count ? "null" : lit_get_value_type(args[id]));
+		lit_argument_error(vm, args, arg_count, id, "a boolean");
+		return false;
 	}
 
 	return AS_BOOL(args[id]);
@@ -97,7 +104,8 @@ bool lit_get_bool(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id, bool
 
 const char* lit_check_string(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id) {
 	if (arg_count <= id || !IS_STRING(args[id])) {
-		lit_runtime_error_exiting(vm, "Expected a string as argument #%i, got a %s", (int) id, id >= arg_count ? "null" : lit_get_value_type(args[id]));
+		lit_argument_error(vm, args, arg_count, id, "a string");
+		return "";
 	}
 
 	return AS_STRING(args[id])->chars;
@@ -113,7 +121,8 @@ const char* lit_get_string(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t
 
 LitString* lit_check_object_string(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id) {
 	if (arg_count <= id || !IS_STRING(args[id])) {
-		lit_runtime_error_exiting(vm, "Expected a string as argument #%i, got a %s", (int) id, id >= arg_count ? "null" : lit_get_value_type(args[id]));
+		lit_argument_error(vm, args, arg_count, id, "a string");
+		return CONST_STRING(vm->state, "");
 	}
 
 	return AS_STRING(args[id]);
@@ -121,7 +130,8 @@ LitString* lit_check_object_string(LitVm* vm, LitValue* args, uint8_t arg_count,
 
 LitInstance* lit_check_instance(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id) {
 	if (arg_count <= id || !IS_INSTANCE(args[id])) {
-		lit_runtime_error_exiting(vm, "Expected an instance as argument #%i, got a %s", (int) id, id >= arg_count ? "null" : lit_get_value_type(args[id]));
+		lit_argument_error(vm, args, arg_count, id, "an instance");
+		return NULL;
 	}
 
 	return AS_INSTANCE(args[id]);
@@ -129,34 +139,54 @@ LitInstance* lit_check_instance(LitVm* vm, LitValue* args, uint8_t arg_count, ui
 
 LitValue* lit_check_reference(LitVm* vm, LitValue* args, uint8_t arg_count, uint8_t id) {
 	if (arg_count <= id || !IS_REFERENCE(args[id])) {
-		lit_runtime_error_exiting(vm, "Expected a reference as argument #%i, got a %s", (int) id, id >= arg_count ? "null" : lit_get_value_type(args[id]));
+		lit_argument_error(vm, args, arg_count, id, "a reference");
+		return NULL;
+	}
+
+	LitReference* reference = AS_REFERENCE(args[id]);
+
+	// The native is going to write into the slot
+	if (reference->owner != NULL) {
+		LIT_REMEMBER_OBJECT(vm, reference->owner)
 	}
 
-	return AS_REFERENCE(args[id])->slot;
+	return reference->slot;
 }
 
-void lit_ensure_bool(LitVm* vm, LitValue value, const char* error){
+bool lit_ensure_bool(LitVm* vm, LitValue value, const char* error){
 	if (!IS_BOOL(value)) {
 		lit_runtime_error_exiting(vm, error);
+		return false;
 	}
+
+	return true;
 }
 
-void lit_ensure_string(LitVm* vm, LitValue value, const char* error) {
+bool lit_ensure_string(LitVm* vm, LitValue value, const char* error) {
 	if (!IS_STRING(value)) {
 		lit_runtime_error_exiting(vm, error);
+		return false;
 	}
+
+	return true;
 }
 
-void lit_ensure_number(LitVm* vm, LitValue value, const char* error) {
+bool lit_ensure_number(LitVm* vm, LitValue value, const char* error) {
 	if (!IS_NUMBER(value)) {
 		lit_runtime_error_exiting(vm, error);
+		return false;
 	}
+
+	return true;
 }
 
-void lit_ensure_object_type(LitVm* vm, LitValue value, LitObjectType type, const char* error) {
+bool lit_ensure_object_type(LitVm* vm, LitValue value, LitObjectType type, const char* error) {
 	if (!IS_OBJECT(value) || OBJECT_TYPE(value) != type) {
 		lit_runtime_error_exiting(vm, error);
+		return false;
 	}
+
+	return true;
 }
 
 LitValue lit_get_field(LitState* state, LitTable* table, const char* name) {
@@ -179,10 +209,28 @@ LitValue lit_get_map_field(LitState* state, LitMap* map, const char* name) {
 	return value;
 }
 
+LitValue lit_get_instance_field(LitState* state, LitInstance* instance, const char* name) {
+	LitValue value;
+
+	if (!lit_instance_get(instance, CONST_STRING(state, name), &value)) {
+		value = NULL_VALUE;
+	}
+
+	return value;
+}
+
 void lit_set_field(LitState* state, LitTable* table, const char* name, LitValue value) {
 	lit_table_set(state, table, CONST_STRING(state, name), value);
 }
 
 void lit_set_map_field(LitState* state, LitMap* map, const char* name, LitValue value) {
-	lit_table_set(state, &map->values, CONST_STRING(state, name), value);
+	LitString* key = CONST_STRING(state, name);
+	lit_table_set(state, &map->values, key, value);
+
+	LIT_WRITE_BARRIER(state->vm, map, OBJECT_VALUE(key))
+	LIT_WRITE_BARRIER(state->vm, map, value)
+}
+
+void lit_set_instance_field(LitState* state, LitInstance* instance, const char* name, LitValue value) {
+	lit_instance_set(state, instance, CONST_STRING(state, name), value);
 }
\ No newline at end of file
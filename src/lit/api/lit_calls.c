@@ -8,12 +8,12 @@
 
 static bool ensure_fiber(LitVm* vm, LitFiber* fiber) {
 	if (fiber == NULL) {
-		lit_runtime_error_exiting(vm, "No fiber to run on");
+		lit_runtime_error(vm, "No fiber to run on");
 		return true;
 	}
 
 	if (fiber->frame_count == LIT_CALL_FRAMES_MAX) {
-		lit_runtime_error_exiting(vm, "Stack overflow");
+		lit_runtime_error(vm, "Stack overflow");
 		return true;
 	}
 
@@ -32,7 +32,7 @@ static inline LitCallFrame* setup_call(LitState* state, LitFunction* callee, Lit
 	LitFiber* fiber = vm->fiber;
 
 	if (callee == NULL) {
-		lit_runtime_error_exiting(vm, "Attempt to call a null value");
+		lit_runtime_error(vm, "Attempt to call a null value");
 		return NULL;
 	}
 
@@ -100,6 +100,7 @@ static inline LitCallFrame* setup_call(LitState* state, LitFunction* callee, Lit
 	frame->result_ignored = false;
 	frame->return_to_c = true;
 	frame->return_address = NULL;
+	frame->tail_calls = 0;
 
 	return frame;
 }
@@ -119,6 +120,14 @@ static inline LitInterpretResult execute_call(LitState* state, LitCallFrame* fra
 	return result;
 }
 
+static inline LitInterpretResult native_result(LitVm* vm, LitFiber* fiber, LitValue value) {
+	if (vm->fiber != fiber || fiber->abort) {
+		RETURN_RUNTIME_ERROR()
+	}
+
+	RETURN_OK(value)
+}
+
 LitInterpretResult lit_call_function(LitState* state, LitFunction* callee, LitValue* arguments, uint8_t argument_count) {
 	return execute_call(state, setup_call(state, callee, arguments, argument_count));
 }
@@ -138,16 +147,23 @@ LitInterpretResult lit_call_method(LitState* state, LitValue instance, LitValue
 	LitVm* vm = state->vm;
 
 	if (IS_OBJECT(callee)) {
-		if (lit_set_native_exit_jump()) {
-			RETURN_RUNTIME_ERROR()
-		}
-
 		LitObjectType type = OBJECT_TYPE(callee);
 
-		if (type == OBJECT_FUNCTION) {
-			return lit_call_function(state, AS_FUNCTION(callee), arguments, argument_count);
-		} else if (type == OBJECT_CLOSURE) {
-			return lit_call_closure(state, AS_CLOSURE(callee), arguments, argument_count);
+		if (type == OBJECT_FUNCTION || type == OBJECT_CLOSURE) {
+			bool closure = type == OBJECT_CLOSURE;
+			LitCallFrame* frame = setup_call(state, closure ? AS_CLOSURE(callee)->function : AS_FUNCTION(callee), arguments, argument_count);
+
+			if (frame == NULL) {
+				RETURN_RUNTIME_ERROR()
+			}
+
+			if (closure) {
+				frame->closure = AS_CLOSURE(callee);
+			}
+
+			// Methods expect to find this in the first slot
+			frame->slots[0] = instance;
+			return execute_call(state, frame);
 		}
 
 		LitFiber* fiber = vm->fiber;
@@ -191,26 +207,28 @@ LitInterpretResult lit_call_method(LitState* state, LitValue instance, LitValue
 		switch (type) {
 			case OBJECT_NATIVE_FUNCTION: {
 				// For some reason, single line expression doesn't work
-				LitValue value = AS_NATIVE_FUNCTION(callee)->function(vm, argument_count, slot + 1);
-				RETURN_OK(value)
+				LitValue value = lit_call_native_function(vm, AS_NATIVE_FUNCTION(callee), argument_count, slot + 1);
+				return native_result(vm, fiber, value);
 			}
 
 			case OBJECT_NATIVE_PRIMITIVE: {
-				AS_NATIVE_PRIMITIVE(callee)->function(vm, argument_count, slot + 1);
-				RETURN_OK(NULL_VALUE)
+				lit_call_native_primitive(vm, AS_NATIVE_PRIMITIVE(callee), argument_count, slot + 1);
+				return native_result(vm, fiber, NULL_VALUE);
 			}
 
 			case OBJECT_NATIVE_METHOD: {
-				LitNativeMethod* method = AS_NATIVE_METHOD(callee);
 				// For some reason, single line expression doesn't work
-				LitValue value = method->method(vm, *slot, argument_count, slot + 1);
+				LitValue value = lit_call_native_method(vm, AS_NATIVE_METHOD(callee), instance, argument_count, slot + 1);
+				LIT_REMEMBER_VALUE(vm, instance)
 
-				RETURN_OK(value)
+				return native_result(vm, fiber, value);
 			}
 
 			case OBJECT_PRIMITIVE_METHOD: {
-				AS_PRIMITIVE_METHOD(callee)->method(vm, *slot, argument_count, slot + 1);
-				RETURN_OK(NULL_VALUE)
+				lit_call_primitive_method(vm, AS_PRIMITIVE_METHOD(callee), instance, argument_count, slot + 1);
+				LIT_REMEMBER_VALUE(vm, instance)
+
+				return native_result(vm, fiber, NULL_VALUE);
 			}
 
 			case OBJECT_CLASS: {
@@ -230,14 +248,17 @@ LitInterpretResult lit_call_method(LitState* state, LitValue instance, LitValue
 
 				if (IS_NATIVE_METHOD(method)) {
 					// For some reason, single line expression doesn't work
-					LitValue value = AS_NATIVE_METHOD(method)->method(vm, bound_method->receiver, argument_count, slot + 1);
-					RETURN_OK(value)
+					LitValue value = lit_call_native_method(vm, AS_NATIVE_METHOD(method), bound_method->receiver, argument_count, slot + 1);
+					LIT_REMEMBER_VALUE(vm, bound_method->receiver)
+
+					return native_result(vm, fiber, value);
 				} else if (IS_PRIMITIVE_METHOD(method)) {
-					AS_PRIMITIVE_METHOD(method)->method(vm, bound_method->receiver, argument_count, slot + 1);
-					RETURN_OK(NULL_VALUE)
+					lit_call_primitive_method(vm, AS_PRIMITIVE_METHOD(method), bound_method->receiver, argument_count, slot + 1);
+					LIT_REMEMBER_VALUE(vm, bound_method->receiver)
+
+					return native_result(vm, fiber, NULL_VALUE);
 				} else {
-					*slot = bound_method->receiver;
-					return lit_call_function(state, AS_FUNCTION(method), arguments, argument_count);
+					return lit_call_method(state, bound_method->receiver, method, arguments, argument_count);
 				}
 			}
 
@@ -248,9 +269,9 @@ LitInterpretResult lit_call_method(LitState* state, LitValue instance, LitValue
 	}
 
 	if (IS_NULL(callee)) {
-		lit_runtime_error_exiting(vm, "Attempt to call a null value");
+		lit_runtime_error(vm, "Attempt to call a null value");
 	} else {
-		lit_runtime_error_exiting(vm, "Can only call functions and classes");
+		lit_runtime_error(vm, "Can only call functions and classes");
 	}
 
 	RETURN_RUNTIME_ERROR()
@@ -265,14 +286,14 @@ LitInterpretResult lit_find_and_call_method(LitState* state, LitValue callee, Li
 	LitFiber* fiber = vm->fiber;
 
 	if (fiber == NULL) {
-		lit_runtime_error_exiting(vm, "No fiber to run on");
+		lit_runtime_error(vm, "No fiber to run on");
 		RETURN_RUNTIME_ERROR()
 	}
 
 	LitClass* klass = lit_get_class_for(state, callee);
 	LitValue method;
 
-	if ((IS_INSTANCE(callee) && lit_table_get(&AS_INSTANCE(callee)->fields, method_name, &method)) || lit_table_get(&klass->methods, method_name, &method)) {
+	if ((IS_INSTANCE(callee) && lit_instance_get(AS_INSTANCE(callee), method_name, &method)) || lit_table_get(&klass->methods, method_name, &method)) {
 		return lit_call_method(state, callee, method, arguments, argument_count);
 	}
 
@@ -337,6 +358,7 @@ LitString* lit_to_string(LitState* state, LitValue object, uint indentation) {
 	frame->result_ignored = false;
 	frame->return_to_c = true;
 	frame->return_address = NULL;
+	frame->tail_calls = 0;
 
 	frame->slots[0] = OBJECT_VALUE(function);
 	frame->slots[1] = object;
@@ -356,9 +378,9 @@ LitString* lit_to_string(LitState* state, LitValue object, uint indentation) {
 }
 
 LitValue lit_call_new(LitVm* vm, const char* name, LitValue* args, uint argument_count) {
-	LitValue value;
+	LitValue value = lit_get_global(vm->state, CONST_STRING(vm->state, name));
 
-	if (!lit_table_get(&vm->globals->values, CONST_STRING(vm->state, name), &value)) {
+	if (!IS_CLASS(value)) {
 		lit_runtime_error_exiting(vm, "Failed to create instance of class %s: class not found", name);
 		return NULL_VALUE;
 	}
@@ -9,6 +9,7 @@
 #include "lit/optimizer/lit_optimizer.h"
 #include "lit/preprocessor/lit_preprocessor.h"
 #include "lit/debug/lit_debug.h"
+#include "lit/jit/lit_jit.h"
 
 #include <stdio.h>
 #include <signal.h>
@@ -155,6 +156,8 @@ static void show_help() {
 	printf("\t-i --interactive\tStarts an interactive shell.\n");
 	printf("\t-d --dump\t\tDumps all the bytecode chunks from the given file.\n");
 	printf("\t-t --time\t\tMeasures and prints the compilation timings.\n");
+	printf("\t-j --jit\t\tCompiles hot loops into native code (only if lit was built with LIT_JIT).\n");
+	printf("\t-g --gc-threads [count]\tMarks the heap with the given amount of threads (only if lit was built with LIT_PARALLEL_GC).\n");
 	printf("\t-c --test\t\tRuns all tests (useful for code coverage testing).\n");
 	printf("\t-h --help\t\tI wonder, what this option does.\n");
 	printf("\tIf no code to run is provided, lit will try to run either main.lbc or main.lit and, if fails, default to an interactive shell will start.\n");
@@ -196,7 +199,7 @@ int main(int argc, const char* argv[]) {
 		const char* arg = argv[i];
 
 		if (arg[0] == '-') {
-			if (match_arg(arg, "-e", "--eval") || match_arg(arg, "-o", "--output") || match_arg(arg, "-n", "--native")) {
+			if (match_arg(arg, "-e", "--eval") || match_arg(arg, "-o", "--output") || match_arg(arg, "-n", "--native") || match_arg(arg, "-g", "--gc-threads")) {
 				// It takes an extra argument, count it or we will use it as the file name to run :P
 				i++;
 			} else if (match_arg(arg, "-p", "--pass")) {
@@ -307,6 +310,28 @@ int main(int argc, const char* argv[]) {
 			showed_help = true;
 		} else if (match_arg(arg, "-t", "--time")) {
 			lit_enable_compilation_time_measurement();
+		} else if (match_arg(arg, "-j", "--jit")) {
+			#ifdef LIT_JIT
+				lit_set_jit_enabled(true);
+			#else
+				fprintf(stderr, "Lit was built without the JIT, running in the interpreter.\n");
+			#endif
+		} else if (match_arg(arg, "-g", "--gc-threads")) {
+			if (args_left == 0) {
+				fprintf(stderr, "Expected the amount of the gc threads.\n");
+				return LIT_EXIT_CODE_ARGUMENT_ERROR;
+			}
+
+			int count = atoi(argv[++i]);
+
+			if (count < 1) {
+				fprintf(stderr, "Expected a positive amount of the gc threads.\n");
+				return LIT_EXIT_CODE_ARGUMENT_ERROR;
+			}
+
+			if (!lit_set_gc_threads(state->vm, (uint) count)) {
+				fprintf(stderr, "Lit was built without LIT_PARALLEL_GC, marking on a single thread.\n");
+			}
 		} else if (match_arg(arg, "-i", "--interactive")) {
 			show_repl = true;
 		} else if (match_arg(arg, "-c", "--test")) {
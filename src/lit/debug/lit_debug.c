@@ -53,7 +53,7 @@ void lit_disassemble_chunk(LitChunk* chunk, const char* name, const char* source
 	printf("%shex:%s\n", COLOR_MAGENTA, COLOR_RESET);
 
 	for (uint offset = 0; offset < chunk->count; offset++) {
-		printf("%08lX ", chunk->code[offset]);
+		printf("%08X ", chunk->code[offset]);
 	}
 
 	printf("\n");
@@ -61,18 +61,22 @@ void lit_disassemble_chunk(LitChunk* chunk, const char* name, const char* source
 	printf("vv %s vv\n", name);
 }
 
-typedef void (*LitDebugInstructionFn)(uint64_t instruction, const char* name);
+typedef void (*LitDebugInstructionFn)(uint32_t instruction, const char* name);
 
-static void print_abc_instruction(uint64_t instruction, const char* name) {
-	printf("%s%s%s%*s %lu \t%lu \t%lu\n", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction), LIT_INSTRUCTION_B(instruction), LIT_INSTRUCTION_C(instruction));
+static void print_abc_instruction(uint32_t instruction, const char* name) {
+	printf("%s%s%s%*s %u \t%u \t%u\n", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction), LIT_INSTRUCTION_BK(instruction), LIT_INSTRUCTION_C(instruction));
 }
 
-static void print_abx_instruction(uint64_t instruction, const char* name) {
-	printf("%s%s%s%*s %lu \t%lu\n", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction), LIT_INSTRUCTION_BX(instruction));
+static void print_abck_instruction(uint32_t instruction, const char* name) {
+	printf("%s%s%s%*s %u \t%u \t%u\n", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction), LIT_INSTRUCTION_B(instruction), LIT_INSTRUCTION_CK(instruction));
 }
 
-static void print_asbx_instruction(uint64_t instruction, const char* name) {
-	printf("%s%s%s%*s %lu \t%li\n", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction), LIT_INSTRUCTION_SBX(instruction));
+static void print_abx_instruction(uint32_t instruction, const char* name) {
+	printf("%s%s%s%*s %u \t%u\n", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction), LIT_INSTRUCTION_BX(instruction));
+}
+
+static void print_asbx_instruction(uint32_t instruction, const char* name) {
+	printf("%s%s%s%*s %u \t%i\n", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction), LIT_INSTRUCTION_SBX(instruction));
 }
 
 static void print_register(uint16_t reg) {
@@ -95,22 +99,27 @@ static void print_constant_or_register(LitChunk* chunk, uint16_t arg) {
 	}
 }
 
-static void print_unary_instruction(LitChunk* chunk, uint64_t instruction, const char* name) {
-	printf("%s%s%s%*s %lu", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction));
-	print_constant_or_register(chunk, LIT_INSTRUCTION_B(instruction));
+static void print_unary_instruction(LitChunk* chunk, uint32_t instruction, const char* name) {
+	printf("%s%s%s%*s %u", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction));
+	print_constant_or_register(chunk, LIT_INSTRUCTION_BK(instruction));
 	printf("\n");
 }
 
-static void print_binary_instruction(LitChunk* chunk, uint64_t instruction, const char* name) {
-	printf("%s%s%s%*s %lu", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction));
+static void print_binary_instruction(LitChunk* chunk, uint32_t instruction, const char* name) {
+	printf("%s%s%s%*s %u", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "", LIT_INSTRUCTION_A(instruction));
 
-	print_constant_or_register(chunk, LIT_INSTRUCTION_B(instruction));
-	print_constant_or_register(chunk, LIT_INSTRUCTION_C(instruction));
+	if (lit_get_instruction_type(LIT_INSTRUCTION_OPCODE(instruction)) == LIT_INSTRUCTION_ABCK) {
+		print_constant_or_register(chunk, LIT_INSTRUCTION_B(instruction));
+		print_constant_or_register(chunk, LIT_INSTRUCTION_CK(instruction));
+	} else {
+		print_constant_or_register(chunk, LIT_INSTRUCTION_BK(instruction));
+		print_constant_or_register(chunk, LIT_INSTRUCTION_C(instruction));
+	}
 
 	printf("\n");
 }
 
-static void print_global_instruction(LitChunk* chunk, uint64_t instruction, const char* name) {
+static void print_global_instruction(LitChunk* chunk, uint32_t instruction, const char* name) {
 	printf("%s%s%s%*s", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "");
 
 	print_constant_arg(chunk, LIT_INSTRUCTION_BX(instruction), false);
@@ -119,10 +128,20 @@ static void print_global_instruction(LitChunk* chunk, uint64_t instruction, cons
 	printf("\n");
 }
 
+static void print_set_global_instruction(LitChunk* chunk, uint32_t instruction, const char* name) {
+	printf("%s%s%s%*s", COLOR_YELLOW, name, COLOR_RESET, LIT_LONGEST_OP_NAME - (int) strlen(name), "");
+
+	print_constant_arg(chunk, LIT_INSTRUCTION_C(instruction), false);
+	print_constant_or_register(chunk, LIT_INSTRUCTION_BK(instruction));
+
+	printf("\n");
+}
+
 static LitDebugInstructionFn debug_instruction_functions[] = {
 	print_abc_instruction,
 	print_abx_instruction,
-	print_asbx_instruction
+	print_asbx_instruction,
+	print_abck_instruction
 };
 
 void lit_disassemble_instruction(LitChunk* chunk, uint offset, const char* source, bool force_line) {
@@ -162,7 +181,7 @@ void lit_disassemble_instruction(LitChunk* chunk, uint offset, const char* sourc
 		printf("%s%4d%s ", COLOR_BLUE, line, COLOR_RESET);
 	}
 
-	uint64_t instruction = chunk->code[offset];
+	uint32_t instruction = chunk->code[offset];
 	uint8_t opcode = LIT_INSTRUCTION_OPCODE(instruction);
 
 	switch (opcode) {
@@ -178,7 +197,29 @@ void lit_disassemble_instruction(LitChunk* chunk, uint offset, const char* sourc
 		case OP_LESS: print_binary_instruction(chunk, instruction, "LESS"); break;
 		case OP_LESS_EQUAL: print_binary_instruction(chunk, instruction, "LESS_EQUAL"); break;
 
-		case OP_SET_GLOBAL: print_global_instruction(chunk, instruction, "SET_GLOBAL"); break;
+		case OP_EQUAL_JUMP: print_binary_instruction(chunk, instruction, "EQUAL_JUMP"); break;
+		case OP_LESS_JUMP: print_binary_instruction(chunk, instruction, "LESS_JUMP"); break;
+		case OP_LESS_EQUAL_JUMP: print_binary_instruction(chunk, instruction, "LESS_EQUAL_JUMP"); break;
+		case OP_GREATER_JUMP: print_binary_instruction(chunk, instruction, "GREATER_JUMP"); break;
+		case OP_GREATER_EQUAL_JUMP: print_binary_instruction(chunk, instruction, "GREATER_EQUAL_JUMP"); break;
+		case OP_ADD_CONSTANT: print_binary_instruction(chunk, instruction, "ADD_CONSTANT"); break;
+		case OP_SUBTRACT_CONSTANT: print_binary_instruction(chunk, instruction, "SUBTRACT_CONSTANT"); break;
+
+		case OP_ADD_NUM: print_binary_instruction(chunk, instruction, "ADD_NUM"); break;
+		case OP_SUBTRACT_NUM: print_binary_instruction(chunk, instruction, "SUBTRACT_NUM"); break;
+		case OP_MULTIPLY_NUM: print_binary_instruction(chunk, instruction, "MULTIPLY_NUM"); break;
+		case OP_DIVIDE_NUM: print_binary_instruction(chunk, instruction, "DIVIDE_NUM"); break;
+		case OP_LESS_NUM: print_binary_instruction(chunk, instruction, "LESS_NUM"); break;
+		case OP_LESS_EQUAL_NUM: print_binary_instruction(chunk, instruction, "LESS_EQUAL_NUM"); break;
+		case OP_GREATER_NUM: print_binary_instruction(chunk, instruction, "GREATER_NUM"); break;
+		case OP_GREATER_EQUAL_NUM: print_binary_instruction(chunk, instruction, "GREATER_EQUAL_NUM"); break;
+
+		case OP_SQUARE: print_binary_instruction(chunk, instruction, "SQUARE"); break;
+		case OP_DIVIDE_POWER_OF_TWO: print_binary_instruction(chunk, instruction, "DIVIDE_POWER_OF_TWO"); break;
+		case OP_FLOOR_DIVIDE_POWER_OF_TWO: print_binary_instruction(chunk, instruction, "FLOOR_DIVIDE_POWER_OF_TWO"); break;
+		case OP_MOD_POWER_OF_TWO: print_binary_instruction(chunk, instruction, "MOD_POWER_OF_TWO"); break;
+
+		case OP_SET_GLOBAL: print_set_global_instruction(chunk, instruction, "SET_GLOBAL"); break;
 		case OP_GET_GLOBAL: print_global_instruction(chunk, instruction, "GET_GLOBAL"); break;
 
 		default: {
@@ -5,14 +5,17 @@
 #include "lit/vm/lit_object.h"
 #include "lit/vm/lit_vm.h"
 #include "lit/scanner/lit_scanner.h"
+#include "lit/parser/lit_parser.h"
 #include "lit/util/lit_table.h"
 #include "lit/optimizer/lit_optimizer.h"
+#include "lit/optimizer/lit_peephole.h"
 
 #include <math.h>
 #include <string.h>
 
 DEFINE_ARRAY(LitPrivates, LitPrivate, privates)
-DEFINE_ARRAY(LitLocals, LitLocal, locals)
+// Locals only live until the function is emitted, together with the AST
+DEFINE_ARENA_ARRAY(LitLocals, LitLocal, locals, &state->parser->arena)
 
 static void emit_expression(LitEmitter* emitter, LitExpression* expression, uint8_t reg);
 static bool emit_statement(LitEmitter* emitter, LitStatement* statement);
@@ -28,6 +31,8 @@ void lit_init_emitter(LitState* state, LitEmitter* emitter) {
 	emitter->state = state;
 	emitter->loop_start = 0;
 	emitter->emit_reference = 0;
+	emitter->emit_callee = false;
+	emitter->last_closure = -1;
 	emitter->class_name = NULL;
 	emitter->compiler = NULL;
 	emitter->chunk = NULL;
@@ -56,7 +61,7 @@ static uint emit_tmp_instruction(LitEmitter* emitter) {
 	return emitter->chunk->count - 1;
 }
 
-static void patch_instruction(LitEmitter* emitter, uint64_t position, uint64_t instruction) {
+static void patch_instruction(LitEmitter* emitter, uint position, uint32_t instruction) {
 	emitter->chunk->code[position] = instruction;
 }
 
@@ -138,15 +143,132 @@ static void init_compiler(LitEmitter* emitter, LitCompiler* compiler, LitFunctio
 
 	if (type == FUNCTION_METHOD || type == FUNCTION_STATIC_METHOD || type == FUNCTION_CONSTRUCTOR) {
 		lit_locals_write(emitter->state, &compiler->locals, (LitLocal) {
-			"this", 4, -1, false, false, reserve_register(emitter)
+			"this", 4, -1, false, false, reserve_register(emitter), -1
 		});
 	} else {
 		lit_locals_write(emitter->state, &compiler->locals, (LitLocal) {
-			"", 0, -1, false, false, reserve_register(emitter)
+			"", 0, -1, false, false, reserve_register(emitter), -1
 		});
 	}
 }
 
+// A closure can live on the stack, if all of its upvalues are locals of the function, that creates it
+static bool can_stay_on_stack(LitClosurePrototype* prototype) {
+	LitFunction* function = prototype->function;
+	LitChunk* body = &function->chunk;
+
+	for (uint i = 0; i < function->upvalue_count; i++) {
+		if (!prototype->local[i]) {
+			return false;
+		}
+	}
+
+	// Nested closures and references would need real upvalues
+	for (uint i = 0; i < body->count; i++) {
+		uint8_t opcode = LIT_INSTRUCTION_OPCODE(body->code[i]);
+
+		if (opcode == OP_CLOSURE || opcode == OP_REFERENCE_UPVALUE) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void read_parent_locals(LitClosurePrototype* prototype, LitChunk* body) {
+	for (uint i = 0; i < body->count; i++) {
+		uint32_t code = body->code[i];
+		uint8_t opcode = LIT_INSTRUCTION_OPCODE(code);
+
+		if (opcode == OP_GET_UPVALUE) {
+			body->code[i] = LIT_FORM_ABX_INSTRUCTION(OP_GET_PARENT_LOCAL, LIT_INSTRUCTION_A(code), prototype->indexes[LIT_INSTRUCTION_BX(code)]);
+		} else if (opcode == OP_SET_UPVALUE) {
+			body->code[i] = LIT_FORM_ABC_INSTRUCTION(OP_SET_PARENT_LOCAL, 0, LIT_INSTRUCTION_BK(code), prototype->indexes[LIT_INSTRUCTION_C(code)]);
+		}
+	}
+}
+
+// A closure, that is only ever called right from the function, that created it, can't outlive that frame,
+// so it doesn't need to be allocated, and can access the captured locals in the caller registers directly
+static void emit_stack_closure(LitEmitter* emitter, LitLocal* local) {
+	if (local->closure == -1) {
+		return;
+	}
+
+	LitChunk* chunk = emitter->chunk;
+	uint32_t* instruction = &chunk->code[local->closure];
+	uint constant = LIT_INSTRUCTION_BX(*instruction);
+
+	local->closure = -1;
+
+	// The function has to fit into a MOVE
+	if (constant > 0xff) {
+		return;
+	}
+
+	LitClosurePrototype* prototype = AS_CLOSURE_PROTOTYPE(chunk->constants.values[constant]);
+
+	if (!can_stay_on_stack(prototype)) {
+		return;
+	}
+
+	read_parent_locals(prototype, &prototype->function->chunk);
+
+	chunk->constants.values[constant] = OBJECT_VALUE(prototype->function);
+	*instruction = LIT_FORM_ABC_INSTRUCTION(OP_MOVE, LIT_INSTRUCTION_A(*instruction), constant | 0x100, 0);
+}
+
+// A lambda, that is passed right to a method call, is put on the stack too, but as a copy,
+// because the VM has to create the real closure from the prototype, if the method is not a borrowing native
+static bool emit_borrowed_closure(LitEmitter* emitter, int offset) {
+	LitChunk* chunk = emitter->chunk;
+	uint32_t* instruction = &chunk->code[offset];
+	LitClosurePrototype* prototype = AS_CLOSURE_PROTOTYPE(chunk->constants.values[LIT_INSTRUCTION_BX(*instruction)]);
+
+	// The copy has to fit into a MOVE too
+	if (chunk->constants.count > 0xff || !can_stay_on_stack(prototype)) {
+		return false;
+	}
+
+	LitState* state = emitter->state;
+	LitFunction* function = prototype->function;
+	LitFunction* copy = lit_create_function(state, function->module);
+
+	copy->name = function->name;
+	copy->arg_count = function->arg_count;
+	copy->upvalue_count = function->upvalue_count;
+	copy->max_registers = function->max_registers;
+	copy->vararg = function->vararg;
+	copy->escape_prototype = prototype;
+
+	LitChunk* body = &function->chunk;
+	LitChunk* copy_body = &copy->chunk;
+
+	copy_body->code = LIT_ALLOCATE(state, uint32_t, body->count);
+	copy_body->count = copy_body->capacity = body->count;
+	memcpy(copy_body->code, body->code, sizeof(uint32_t) * body->count);
+
+	copy_body->has_line_info = body->has_line_info;
+
+	if (body->lines != NULL) {
+		copy_body->lines = LIT_ALLOCATE(state, uint16_t, body->line_capacity);
+		copy_body->line_count = body->line_count;
+		copy_body->line_capacity = body->line_capacity;
+		memcpy(copy_body->lines, body->lines, sizeof(uint16_t) * body->line_capacity);
+	}
+
+	for (uint i = 0; i < body->constants.count; i++) {
+		lit_values_write(state, &copy_body->constants, body->constants.values[i]);
+	}
+
+	read_parent_locals(prototype, copy_body);
+
+	uint constant = lit_chunk_add_constant(state, chunk, OBJECT_VALUE(copy));
+	*instruction = LIT_FORM_ABC_INSTRUCTION(OP_MOVE, LIT_INSTRUCTION_A(*instruction), constant | 0x100, 0);
+
+	return true;
+}
+
 static LitFunction* end_compiler(LitEmitter* emitter, LitString* name) {
 	free_register(emitter, 0);
 
@@ -173,8 +295,19 @@ static LitFunction* end_compiler(LitEmitter* emitter, LitString* name) {
 	}
 
 	LitFunction* function = emitter->compiler->function;
+	LitLocals* locals = &emitter->compiler->locals;
+
+	for (uint i = 0; i < locals->count; i++) {
+		emit_stack_closure(emitter, &locals->values[i]);
+	}
+
+	lit_free_locals(emitter->state, locals);
+
+	if (!emitter->state->had_error && (lit_is_optimization_enabled(OPTIMIZATION_PEEPHOLE) || lit_is_optimization_enabled(OPTIMIZATION_STRENGTH_REDUCTION))) {
+		lit_optimize_chunk(emitter->state, &function->chunk);
+	}
 
-	lit_free_locals(emitter->state, &emitter->compiler->locals);
+	lit_shrink_chunk(emitter->state, &function->chunk);
 
 	emitter->compiler = (LitCompiler*) emitter->compiler->enclosing;
 	emitter->chunk = emitter->compiler == NULL ? NULL : &emitter->compiler->function->chunk;
@@ -208,6 +341,7 @@ static void end_scope(LitEmitter* emitter) {
 
 	while (locals->count > 0 && locals->values[locals->count - 1].depth > compiler->scope_depth) {
 		LitLocal* local = &locals->values[locals->count - 1];
+		emit_stack_closure(emitter, local);
 
 		if (local->captured) {
 			emit_abc_instruction(emitter, emitter->last_line, OP_CLOSE_UPVALUE, local->reg, 0, 0);
@@ -301,7 +435,7 @@ static int add_local(LitEmitter* emitter, const char* name, uint length, uint li
 	}
 
 	lit_locals_write(emitter->state, locals, (LitLocal) {
-		name, length, UINT16_MAX, false, constant, reg
+		name, length, UINT16_MAX, false, constant, reg, -1
 	});
 
 	return (int) locals->count - 1;
@@ -355,8 +489,13 @@ static int resolve_upvalue(LitEmitter* emitter, LitCompiler* compiler, const cha
 	int local = resolve_local(emitter, (LitCompiler*) compiler->enclosing, name, length, line);
 
 	if (local != -1) {
-		((LitCompiler*) compiler->enclosing)->locals.values[local].captured = true;
-		return add_upvalue(emitter, compiler, (uint8_t) local, line, true);
+		LitLocal* captured = &((LitCompiler*) compiler->enclosing)->locals.values[local];
+
+		captured->captured = true;
+		captured->closure = -1;
+
+		// The VM captures the register, that isn't always the same as the index of the local
+		return add_upvalue(emitter, compiler, captured->reg, line, true);
 	}
 
 	int upvalue = resolve_upvalue(emitter, (LitCompiler*) compiler->enclosing, name, length, line);
@@ -462,7 +601,10 @@ static uint16_t parse_argument(LitEmitter* emitter, LitExpression* expression, u
 		int index = resolve_local(emitter, emitter->compiler, expr->name, expr->length, expression->line);
 
 		if (index != -1) {
-			return emitter->compiler->locals.values[index].reg;
+			LitLocal* local = &emitter->compiler->locals.values[index];
+
+			local->closure = -1;
+			return local->reg;
 		}
 	}
 
@@ -470,6 +612,38 @@ static uint16_t parse_argument(LitEmitter* emitter, LitExpression* expression, u
 	return reg;
 }
 
+// A has no room for the constant flag, so it goes into the top bit of Bx
+static void emit_set_private(LitEmitter* emitter, uint16_t line, uint16_t value, uint16_t index) {
+	if (IS_BIT_SET(value, 8)) {
+		emit_abx_instruction(emitter, line, OP_SET_PRIVATE, value & 0xff, index | (1 << 16));
+	} else {
+		emit_abx_instruction(emitter, line, OP_SET_PRIVATE, value, index);
+	}
+}
+
+// B of the ABCK instructions has no room for the constant flag, so a constant has to be moved into a register first
+static uint16_t emit_register_argument(LitEmitter* emitter, uint16_t line, uint16_t argument, uint8_t reg) {
+	if (!IS_BIT_SET(argument, 8)) {
+		return argument;
+	}
+
+	emit_abc_instruction(emitter, line, OP_MOVE, reg, argument, 0);
+	return reg;
+}
+
+// Whole steps on the same register are stored right in the instruction, other numbers still skip the constant check
+static void emit_constant_arithmetic(LitEmitter* emitter, uint16_t line, LitOpCode opcode, uint8_t reg, uint16_t b, double value) {
+	if (b == reg && value > 0 && value <= LIT_SBX_ARG_SIZE && value == (int32_t) value) {
+		emit_asbx_instruction(emitter, line, OP_INCREMENT_LOCAL, reg, opcode == OP_ADD ? (int32_t) value : -((int32_t) value));
+		return;
+	}
+
+	uint16_t constant = add_constant(emitter, line, NUMBER_VALUE(value));
+	SET_BIT(constant, 8)
+
+	emit_abc_instruction(emitter, line, opcode == OP_ADD ? OP_ADD_CONSTANT : OP_SUBTRACT_CONSTANT, reg, b, constant);
+}
+
 static void emit_binary_expression(LitEmitter* emitter, LitBinaryExpression* expr, uint8_t reg, bool swap) {
 	LitTokenType op = expr->op;
 
@@ -493,17 +667,100 @@ static void emit_binary_expression(LitEmitter* emitter, LitBinaryExpression* exp
 			LitVarExpression* e = (LitVarExpression*) expr->right;
 
 			int constant = add_constant(emitter, expr->expression.line, OBJECT_VALUE(lit_copy_string(emitter->state, e->name, e->length)));
+
+			b = emit_register_argument(emitter, expr->expression.line, b, reg);
 			emit_abc_instruction(emitter, expr->expression.line, opcode, reg, b, constant);
+		} else if ((opcode == OP_ADD || opcode == OP_SUBTRACT) && !swap && !IS_BIT_SET(b, 8)
+			&& expr->right->type == LITERAL_EXPRESSION && IS_NUMBER(((LitLiteralExpression*) expr->right)->value)) {
+
+			emit_constant_arithmetic(emitter, expr->expression.line, opcode, reg, b, AS_NUMBER(((LitLiteralExpression*) expr->right)->value));
 		} else {
 			uint16_t rc = reserve_register(emitter);
 			uint16_t c = parse_argument(emitter, expr->right, rc);
 
-			emit_abc_instruction(emitter, expr->expression.line, opcode, reg, swap ? c : b, swap ? b : c);
+			if (swap) {
+				uint16_t tmp = b;
+
+				b = c;
+				c = tmp;
+			}
+
+			if (IS_BIT_SET(b, 8)) {
+				uint8_t rb = reserve_register(emitter);
+
+				emit_abc_instruction(emitter, expr->expression.line, opcode, reg, emit_register_argument(emitter, expr->expression.line, b, rb), c);
+				free_register(emitter, rb);
+			} else {
+				emit_abc_instruction(emitter, expr->expression.line, opcode, reg, b, c);
+			}
+
 			free_register(emitter, rc);
 		}
 	}
 }
 
+// Comparisons are fused with the FALSE_JUMP, that the caller has to emit right after the condition
+static void emit_condition(LitEmitter* emitter, LitExpression* expression, uint8_t reg) {
+	if (expression != NULL && expression->type == BINARY_EXPRESSION) {
+		LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+		LitOpCode opcode;
+
+		switch (expr->op) {
+			case LTOKEN_EQUAL_EQUAL: opcode = OP_EQUAL_JUMP; break;
+			case LTOKEN_LESS: opcode = OP_LESS_JUMP; break;
+			case LTOKEN_LESS_EQUAL: opcode = OP_LESS_EQUAL_JUMP; break;
+			case LTOKEN_GREATER: opcode = OP_GREATER_JUMP; break;
+			case LTOKEN_GREATER_EQUAL: opcode = OP_GREATER_EQUAL_JUMP; break;
+
+			default: {
+				emit_expression(emitter, expression, reg);
+				return;
+			}
+		}
+
+		uint16_t b = parse_argument(emitter, expr->left, reg);
+		uint16_t rc = reserve_register(emitter);
+		uint16_t c = parse_argument(emitter, expr->right, rc);
+
+		if (IS_BIT_SET(b, 8)) {
+			uint8_t rb = reserve_register(emitter);
+
+			emit_abc_instruction(emitter, expression->line, opcode, reg, emit_register_argument(emitter, expression->line, b, rb), c);
+			free_register(emitter, rb);
+		} else {
+			emit_abc_instruction(emitter, expression->line, opcode, reg, b, c);
+		}
+
+		free_register(emitter, rc);
+
+		return;
+	}
+
+	emit_expression(emitter, expression, reg);
+}
+
+// Calls of plain functions, which result is returned right away, can reuse the frame of the caller
+static void mark_tail_call(LitEmitter* emitter, LitExpression* expression) {
+	LitFunctionType type = emitter->compiler->type;
+
+	if (expression->type == IF_EXPRESSION) {
+		// Both branches of the ternary end up in the return register
+		mark_tail_call(emitter, ((LitIfExpression*) expression)->if_branch);
+		mark_tail_call(emitter, ((LitIfExpression*) expression)->else_branch);
+
+		return;
+	}
+
+	if (expression->type != CALL_EXPRESSION || type == FUNCTION_SCRIPT || type == FUNCTION_CONSTRUCTOR) {
+		return;
+	}
+
+	LitCallExpression* expr = (LitCallExpression*) expression;
+	LitExpressionType callee_type = expr->callee->type;
+
+	expr->tail_call = callee_type != GET_EXPRESSION && callee_type != SUPER_EXPRESSION && expr->init == NULL;
+}
+
 static bool emit_parameters(LitEmitter* emitter, LitParameters* parameters, uint line) {
 	for (uint i = 0; i < parameters->count; i++) {
 		LitParameter* parameter = &parameters->values[i];
@@ -605,11 +862,14 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 		case VAR_EXPRESSION: {
 			LitVarExpression* expr = (LitVarExpression*) expression;
 			bool ref = emitter->emit_reference > 0;
+			bool callee = emitter->emit_callee;
 
 			if (ref) {
 				emitter->emit_reference--;
 			}
 
+			emitter->emit_callee = false;
+
 			int index = resolve_local(emitter, emitter->compiler, expr->name, expr->length, expression->line);
 
 			if (index == -1) {
@@ -641,7 +901,12 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 					}
 				}
 			} else {
-				uint16_t r = emitter->compiler->locals.values[index].reg;
+				LitLocal* local = &emitter->compiler->locals.values[index];
+				uint16_t r = local->reg;
+
+				if (!callee) {
+					local->closure = -1;
+				}
 
 				if (ref) {
 					emit_abc_instruction(emitter, expression->line, OP_REFERENCE_LOCAL, reg, r, 0);
@@ -669,20 +934,16 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 
 						if (index == -1) {
 							uint16_t constant = add_constant(emitter, expression->line, OBJECT_VALUE(lit_copy_string(emitter->state, e->name, e->length)));
-							emit_abx_instruction(emitter, expression->line, OP_SET_GLOBAL, constant, r);
+							emit_abc_instruction(emitter, expression->line, OP_SET_GLOBAL, 0, r, constant);
 						} else {
 							if (emitter->privates.values[index].constant) {
 								error(emitter, expression->line, ERROR_CONSTANT_MODIFIED, e->length, e->name);
 							}
 
-							if (IS_BIT_SET(r, 8)) {
-								SET_BIT(index, 16);
-							}
-
-							emit_abx_instruction(emitter, expression->line, OP_SET_PRIVATE, r, index);
+							emit_set_private(emitter, expression->line, r, index);
 						}
 					} else {
-						emit_abx_instruction(emitter, expression->line, OP_SET_UPVALUE, index, r);
+						emit_abc_instruction(emitter, expression->line, OP_SET_UPVALUE, 0, r, index);
 					}
 
 					if (!ignored && reg != r) {
@@ -691,6 +952,7 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 
 					break;
 				} else {
+					emitter->compiler->locals.values[index].closure = -1;
 					LitLocal local = emitter->compiler->locals.values[index];
 
 					if (local.constant) {
@@ -763,9 +1025,14 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 				((LitSuperExpression*) expr->callee)->ignore_emit = true;
 			}
 
+			// A tail call would replace the frame, that the closure reads its upvalues from
+			emitter->emit_callee = expr->callee->type == VAR_EXPRESSION && !expr->tail_call;
+
 			emit_expression(emitter, expr->callee, reg);
 			uint8_t tmp_reg = super ? reserve_register(emitter) : 0;
 
+			bool borrowed = false;
+
 			for (uint i = 0; i < arg_count; i++) {
 				uint16_t arg_reg = reserve_register(emitter);
 				LitExpression* e = expr->args.values[i];
@@ -775,7 +1042,12 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 				}
 
 				arg_regs[i] = arg_reg;
+				emitter->last_closure = -1;
 				emit_expression(emitter, e, arg_reg);
+
+				if (method && e->type == LAMBDA_EXPRESSION && emitter->last_closure != -1 && emit_borrowed_closure(emitter, emitter->last_closure)) {
+					borrowed = true;
+				}
 			}
 
 			if (method) {
@@ -786,7 +1058,7 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 				LitGetExpression *e = (LitGetExpression*) expr->callee;
 
 				int constant = add_constant(emitter, emitter->last_line, OBJECT_VALUE(lit_copy_string(emitter->state, e->name, e->length)));
-				emit_abc_instruction(emitter, expression->line, OP_INVOKE, reg, arg_count + 1, constant);
+				emit_abc_instruction(emitter, expression->line, borrowed ? OP_INVOKE_BORROWED : OP_INVOKE, reg, arg_count + 1, constant);
 			} else if (super) {
 				assert(tmp_reg == reg + 1);
 
@@ -799,7 +1071,7 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 
 				free_register(emitter, tmp_reg);
 			} else {
-				emit_abc_instruction(emitter, expression->line, OP_CALL, reg, arg_count + 1, 1);
+				emit_abc_instruction(emitter, expression->line, expr->tail_call ? OP_TAIL_CALL : OP_CALL, reg, arg_count + 1, 1);
 			}
 
 			for (uint i = 0; i < arg_count; i++) {
@@ -969,6 +1241,7 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 					uint8_t r = reserve_register(emitter);
 					compiler.skip_return = true;
 
+					mark_tail_call(emitter, ((LitExpressionStatement*) expr->body)->expression);
 					emit_expression(emitter, ((LitExpressionStatement*) expr->body)->expression, r);
 					emit_abc_instruction(emitter, expr->body->line, OP_RETURN, r, 0, 0);
 					free_register(emitter, r);
@@ -1002,6 +1275,8 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 				}
 
 				uint16_t constant_index = add_constant(emitter, expression->line, OBJECT_VALUE(closure_prototype));
+
+				emitter->last_closure = emitter->chunk->count;
 				emit_abx_instruction(emitter, expression->line, OP_CLOSURE, function_reg, constant_index);
 			} else {
 				function_reg = add_constant(emitter, expression->line, OBJECT_VALUE(function));
@@ -1073,7 +1348,7 @@ static void emit_expression_full(LitEmitter* emitter, LitExpression* expression,
 			LitIfExpression* expr = (LitIfExpression*) expression;
 			uint8_t condition_reg = reserve_register(emitter);
 
-			emit_expression(emitter, expr->condition, condition_reg);
+			emit_condition(emitter, expr->condition, condition_reg);
 
 			uint condition_branch_skip = emit_tmp_instruction(emitter);
 			free_register(emitter, condition_reg);
@@ -1170,6 +1445,13 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			LitStatements* statements = &((LitBlockStatement*) statement)->statements;
 			bool ended_scope = false;
 
+			// Only the module privates are declared in advance, so the variables in the blocks at the top of the module have to be locals
+			bool scoped = emitter->compiler->enclosing == NULL && emitter->compiler->scope_depth == 0;
+
+			if (scoped) {
+				begin_scope(emitter);
+			}
+
 			for (uint i = 0; i < statements->count; i++) {
 				if (emit_statement(emitter, statements->values[i])) {
 					ended_scope = true;
@@ -1182,6 +1464,10 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 				return true;
 			}
 
+			if (scoped) {
+				end_scope(emitter);
+			}
+
 			break;
 		}
 
@@ -1191,6 +1477,8 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 
 			bool private = emitter->compiler->enclosing == NULL && emitter->compiler->scope_depth == 0;
 
+			emitter->last_closure = -1;
+
 			if (stmt->init == NULL) {
 				emit_abc_instruction(emitter, statement->line, OP_LOAD_NULL, reg, 0, 0);
 			} else {
@@ -1203,10 +1491,14 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 
 			if (private) {
 				mark_private_initialized(emitter, index);
-				emit_abx_instruction(emitter, statement->line, OP_SET_PRIVATE, reg, index);
+				emit_set_private(emitter, statement->line, reg, index);
 				free_register(emitter, reg);
 			} else {
 				mark_local_initialized(emitter, index);
+
+				if (stmt->init != NULL && stmt->init->type == LAMBDA_EXPRESSION) {
+					emitter->compiler->locals.values[index].closure = emitter->last_closure;
+				}
 			}
 
 			break;
@@ -1214,26 +1506,29 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 
 		case IF_STATEMENT: {
 			LitIfStatement* stmt = (LitIfStatement*) statement;
-			uint16_t condition_reg = reserve_register(emitter);
+			uint else_skip = 0;
 
-			emit_expression(emitter, stmt->condition, condition_reg);
+			// The optimizer removes the condition, if it is always false
+			if (stmt->condition != NULL) {
+				uint16_t condition_reg = reserve_register(emitter);
+				emit_condition(emitter, stmt->condition, condition_reg);
 
-			uint condition_branch_skip = emit_tmp_instruction(emitter);
-			uint else_skip = 0;
+				uint condition_branch_skip = emit_tmp_instruction(emitter);
+				free_register(emitter, condition_reg);
 
-			free_register(emitter, condition_reg);
+				int64_t start = emitter->chunk->count;
+				emit_statement_scoped(emitter, stmt->if_branch);
 
-			int64_t start = emitter->chunk->count;
-			emit_statement_scoped(emitter, stmt->if_branch);
+				// Skips the else-ifs and the else
+				if (stmt->else_branch || stmt->elseif_branches != NULL) {
+					else_skip = emit_tmp_instruction(emitter);
+				}
 
-			if (stmt->else_branch) {
-				else_skip = emit_tmp_instruction(emitter);
+				patch_instruction(emitter, condition_branch_skip, LIT_FORM_ABX_INSTRUCTION(OP_FALSE_JUMP, condition_reg, (int64_t) emitter->chunk->count - start));
 			}
 
-			patch_instruction(emitter, condition_branch_skip, LIT_FORM_ABX_INSTRUCTION(OP_FALSE_JUMP, condition_reg, (int64_t) emitter->chunk->count - start));
-
 			uint end_jump_count = stmt->elseif_branches == NULL ? 0 : stmt->elseif_branches->count;
-			uint64_t end_jumps[end_jump_count];
+			uint end_jumps[end_jump_count];
 
 			if (stmt->elseif_branches != NULL) {
 				for (uint i = 0; i < stmt->elseif_branches->count; i++) {
@@ -1244,8 +1539,8 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 					}
 
 					uint8_t elseif_condition_reg = reserve_register(emitter);
-					emit_expression(emitter, e, elseif_condition_reg);
-					uint64_t next_jump = emit_tmp_instruction(emitter);
+					emit_condition(emitter, e, elseif_condition_reg);
+					uint next_jump = emit_tmp_instruction(emitter);
 					free_register(emitter, elseif_condition_reg);
 
 					emit_statement_scoped(emitter, stmt->elseif_branches->values[i]);
@@ -1257,6 +1552,9 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			if (stmt->else_branch) {
 				int64_t else_start = emitter->chunk->count;
 				emit_statement_scoped(emitter, stmt->else_branch);
+			}
+
+			if (else_skip != 0) {
 				patch_instruction(emitter, else_skip, LIT_FORM_ASBX_INSTRUCTION(OP_JUMP, 0, (int64_t) emitter->chunk->count - else_skip - 1));
 			}
 
@@ -1327,6 +1625,8 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 				}
 
 				uint16_t constant_index = add_constant(emitter, statement->line, OBJECT_VALUE(closure_prototype));
+
+				emitter->last_closure = emitter->chunk->count;
 				emit_abx_instruction(emitter, statement->line, OP_CLOSURE, function_reg, constant_index);
 			} else {
 				function_reg = add_constant(emitter, statement->line, OBJECT_VALUE(function));
@@ -1335,15 +1635,16 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 
 			if (export) {
 				uint16_t name_constant = add_constant(emitter, statement->line, OBJECT_VALUE(function->name));
-				emit_abx_instruction(emitter, statement->line, OP_SET_GLOBAL, name_constant, function_reg);
+				emit_abc_instruction(emitter, statement->line, OP_SET_GLOBAL, 0, function_reg, name_constant);
 			} else if (private) {
-				if (!closure) {
-					SET_BIT(index, 16);
-				}
-
-				emit_abx_instruction(emitter, statement->line, OP_SET_PRIVATE, function_reg, index);
+				emit_set_private(emitter, statement->line, function_reg, index);
 			} else {
 				emit_abc_instruction(emitter, statement->line, OP_MOVE, reg, function_reg, 0);
+
+				// Recursive functions capture themselves
+				if (closure && !emitter->compiler->locals.values[index].captured) {
+					emitter->compiler->locals.values[index].closure = emitter->last_closure;
+				}
 			}
 
 			if (closure) {
@@ -1360,6 +1661,7 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			if (stmt->expression == NULL) {
 				emit_abc_instruction(emitter, statement->line, OP_LOAD_NULL, reg, 0, 0);
 			} else {
+				mark_tail_call(emitter, stmt->expression);
 				emit_expression(emitter, stmt->expression, reg);
 			}
 
@@ -1379,7 +1681,7 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			emitter->loop_start = before_condition;
 			emitter->compiler->loop_depth++;
 
-			emit_expression(emitter, stmt->condition, reg);
+			emit_condition(emitter, stmt->condition, reg);
 
 			uint tmp_instruction = emit_tmp_instruction(emitter);
 			emit_statement_scoped(emitter, stmt->body);
@@ -1414,7 +1716,7 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 
 				if (stmt->condition != NULL) {
 					condition_reg = reserve_register(emitter);
-					emit_expression(emitter, stmt->condition, condition_reg);
+					emit_condition(emitter, stmt->condition, condition_reg);
 					exit_jump = emit_tmp_instruction(emitter);
 				}
 
@@ -1463,47 +1765,59 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 					free_register(emitter, condition_reg);
 				}
 			} else {
+				// FOR_ITER expects the iterator right after the sequence
 				uint sequence = reserve_register(emitter);
 				mark_local_initialized(emitter, add_local(emitter, "seq ", 4, statement->line, false, sequence));
 
+				uint iterator = reserve_register(emitter);
+				mark_local_initialized(emitter, add_local(emitter, "iter ", 5, statement->line, false, iterator));
+
 				uint8_t condition_reg = reserve_register(emitter);
 
 				emit_expression(emitter, stmt->condition, condition_reg);
 				emit_abc_instruction(emitter, emitter->last_line, OP_MOVE, sequence, condition_reg, 0);
-
-				uint iterator = reserve_register(emitter);
-				mark_local_initialized(emitter, add_local(emitter, "iter ", 5, statement->line, false, iterator));
-
 				emit_abc_instruction(emitter, emitter->last_line, OP_LOAD_NULL, iterator, 0, 0);
 
-				uint start = emitter->chunk->count;
-				emitter->loop_start = emitter->chunk->count;
-
-				// iter = seq.iterator(iter)
 				uint8_t tmp_reg_a = reserve_register(emitter);
 				uint8_t tmp_reg_b = reserve_register(emitter);
 
+				begin_scope(emitter);
+
+				LitVarStatement* var = (LitVarStatement*) stmt->var;
+				uint local = reserve_register(emitter);
+
+				mark_local_initialized(emitter, add_local(emitter, var->name, var->length, statement->line, false, local));
+
+				// The iterator protocol is only used for sequences, that FOR_ITER can't handle itself, so it lives out of the way
+				uint start_jump = emit_tmp_instruction(emitter);
+				uint protocol_start = emitter->chunk->count;
+
+				// iter = seq.iterator(iter)
 				emit_abc_instruction(emitter, emitter->last_line, OP_MOVE, tmp_reg_a, sequence, 0);
 				emit_abc_instruction(emitter, emitter->last_line, OP_MOVE, tmp_reg_b, iterator, 0);
 				emit_abc_instruction(emitter, emitter->last_line, OP_INVOKE, tmp_reg_a, 2, add_constant(emitter, emitter->last_line, OBJECT_CONST_STRING(emitter->state, "iterator")));
 				emit_abc_instruction(emitter, emitter->last_line, OP_MOVE, iterator, tmp_reg_a, 0);
 
 				// If iter is null, just get out of the loop
-				uint exit_jump = emit_tmp_instruction(emitter);
-
-				begin_scope(emitter);
+				uint protocol_exit_jump = emit_tmp_instruction(emitter);
 
 				// var i = seq.iteratorValue(iter)
-				LitVarStatement* var = (LitVarStatement*) stmt->var;
-				uint local = reserve_register(emitter);
-
-				mark_local_initialized(emitter, add_local(emitter, var->name, var->length, statement->line, false, local));
-
 				emit_abc_instruction(emitter, emitter->last_line, OP_MOVE, tmp_reg_a, sequence, 0);
 				emit_abc_instruction(emitter, emitter->last_line, OP_MOVE, tmp_reg_b, iterator, 0);
 				emit_abc_instruction(emitter, emitter->last_line, OP_INVOKE, tmp_reg_a, 2, add_constant(emitter, emitter->last_line, OBJECT_CONST_STRING(emitter->state, "iteratorValue")));
 				emit_abc_instruction(emitter, emitter->last_line, OP_MOVE, local, tmp_reg_a, 0);
 
+				uint body_jump = emit_tmp_instruction(emitter);
+
+				uint start = emitter->chunk->count;
+				emitter->loop_start = start;
+
+				patch_instruction(emitter, start_jump, LIT_FORM_ASBX_INSTRUCTION(OP_JUMP, 0, (int64_t) start - start_jump - 1));
+				emit_abc_instruction(emitter, emitter->last_line, OP_FOR_ITER, sequence, local, start - protocol_start);
+
+				uint exit_jump = emit_tmp_instruction(emitter);
+				patch_instruction(emitter, body_jump, LIT_FORM_ASBX_INSTRUCTION(OP_JUMP, 0, (int64_t) emitter->chunk->count - body_jump - 1));
+
 				if (stmt->body != NULL) {
 					if (stmt->body->type == BLOCK_STATEMENT) {
 						LitStatements *statements = &((LitBlockStatement*) stmt->body)->statements;
@@ -1520,7 +1834,9 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 				end_scope(emitter);
 
 				emit_asbx_instruction(emitter, statement->line, OP_JUMP, 0, (int) start - emitter->chunk->count - 1);
-				patch_instruction(emitter, exit_jump, LIT_FORM_ABX_INSTRUCTION(OP_NULL_JUMP, iterator, (int64_t) emitter->chunk->count - exit_jump - 1));
+
+				patch_instruction(emitter, exit_jump, LIT_FORM_ASBX_INSTRUCTION(OP_JUMP, 0, (int64_t) emitter->chunk->count - exit_jump - 1));
+				patch_instruction(emitter, protocol_exit_jump, LIT_FORM_ABX_INSTRUCTION(OP_NULL_JUMP, iterator, (int64_t) emitter->chunk->count - protocol_exit_jump - 1));
 
 				free_register(emitter, tmp_reg_a);
 				free_register(emitter, tmp_reg_b);
@@ -1571,15 +1887,15 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			uint8_t class_register = reserve_register(emitter);
 			emitter->class_register = class_register;
 
-			emit_abc_instruction(emitter, statement->line, OP_CLASS, name_constant, has_parent ? b + 1 : 0, class_register);
+			emit_abc_instruction(emitter, statement->line, OP_CLASS, class_register, has_parent ? b + 1 : 0, name_constant);
 
 			if (has_parent) {
-				free_register(emitter, b);
 				emitter->class_has_super = true;
 
 				begin_scope(emitter);
 
-				uint8_t super = add_local(emitter, "super", 5, emitter->last_line, false, reserve_register(emitter));
+				// The register, that holds the parent class, becomes the super local
+				uint8_t super = add_local(emitter, "super", 5, emitter->last_line, false, b);
 				mark_local_initialized(emitter, super);
 			}
 
@@ -1637,11 +1953,10 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			function->max_registers += function->arg_count;
 			function->vararg = vararg;
 
-			uint16_t function_reg;
+			uint8_t function_reg = reserve_register(emitter);
 			bool closure = function->upvalue_count > 0;
 
 			if (closure) {
-				function_reg = reserve_register(emitter);
 				LitClosurePrototype* closure_prototype = lit_create_closure_prototype(emitter->state, function);
 
 				for (uint i = 0; i < function->upvalue_count; i++) {
@@ -1654,16 +1969,16 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 				uint16_t constant_index = add_constant(emitter, statement->line, OBJECT_VALUE(closure_prototype));
 				emit_abx_instruction(emitter, statement->line, OP_CLOSURE, function_reg, constant_index);
 			} else {
-				function_reg = add_constant(emitter, statement->line, OBJECT_VALUE(function));
-				SET_BIT(function_reg, 8);
+				uint16_t constant = add_constant(emitter, statement->line, OBJECT_VALUE(function));
+				SET_BIT(constant, 8);
+
+				// C is only wide enough for a register
+				emit_abc_instruction(emitter, statement->line, OP_MOVE, function_reg, constant, 0);
 			}
 
 			int field_name_constant = add_constant(emitter, statement->line, OBJECT_VALUE(stmt->name));
 			emit_abc_instruction(emitter, statement->line, stmt->is_static ? OP_STATIC_FIELD : OP_METHOD, emitter->class_register, field_name_constant, function_reg);
-
-			if (closure) {
-				free_register(emitter, function_reg);
-			}
+			free_register(emitter, function_reg);
 
 			break;
 		}
@@ -1719,7 +2034,11 @@ static bool emit_statement(LitEmitter* emitter, LitStatement* statement) {
 			int constant = add_constant(emitter, statement->line, OBJECT_VALUE(field));
 			SET_BIT(constant, 8);
 
-			emit_abc_instruction(emitter, statement->line, stmt->is_static ? OP_STATIC_FIELD : OP_METHOD, emitter->class_register, add_constant(emitter, statement->line, OBJECT_VALUE(stmt->name)),constant);
+			uint8_t reg = reserve_register(emitter);
+
+			emit_abc_instruction(emitter, statement->line, OP_MOVE, reg, constant, 0);
+			emit_abc_instruction(emitter, statement->line, stmt->is_static ? OP_STATIC_FIELD : OP_METHOD, emitter->class_register, add_constant(emitter, statement->line, OBJECT_VALUE(stmt->name)), reg);
+			free_register(emitter, reg);
 
 			break;
 		}
@@ -1813,6 +2132,9 @@ LitModule* lit_emit(LitEmitter* emitter, LitStatements* statements, LitString* m
 		lit_free_table(emitter->state, &emitter->module->private_names->values);
 	}
 
+	// An already loaded module might have gotten new names
+	LIT_REMEMBER_OBJECT(state->vm, module->private_names)
+
 	if (new && !state->had_error) {
 		lit_table_set(state, &state->vm->modules->values, module_name, OBJECT_VALUE(module));
 	}
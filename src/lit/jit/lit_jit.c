@@ -0,0 +1,630 @@
+#include "lit/jit/lit_jit.h"
+
+static bool jit_enabled = false;
+
+void lit_set_jit_enabled(bool enabled) {
+	jit_enabled = enabled;
+}
+
+bool lit_is_jit_enabled() {
+	return jit_enabled;
+}
+
+#ifdef LIT_JIT
+
+#include "lit/mem/lit_mem.h"
+#include "lit/util/lit_array.h"
+#include "lit/vm/lit_instruction.h"
+
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+ * Baseline compiler: every instruction is turned into a fixed template of x86-64 code.
+ * The templates only handle numbers, booleans and null, anything else (or an instruction
+ * without a template) leaves the native code at that instruction, so that the interpreter
+ * can run it, report the error or call the operator method. Nothing is written before the
+ * guards pass, so the interpreter always sees the frame in the same state, as if it ran
+ * the previous instructions itself.
+ */
+
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSI 6
+#define RDI 7
+#define R12 12
+#define R13 13
+#define R14 14
+
+#define XMM0 0
+#define XMM1 1
+
+// The frame lives in callee-saved registers, so that the runtime helpers don't clobber it
+#define REGISTERS RBX
+#define CONSTANTS R12
+#define PRIVATES R13
+#define NAN_MASK R14
+
+#define CONDITION_B 0x2
+#define CONDITION_AE 0x3
+#define CONDITION_E 0x4
+#define CONDITION_NE 0x5
+#define CONDITION_BE 0x6
+#define CONDITION_A 0x7
+#define NO_CONDITION -1
+
+typedef struct {
+	uint32_t at;
+	uint32_t target;
+
+	// Jumps into the exit stub of the target instruction instead of its code
+	bool exit;
+} LitJitPatch;
+
+DECLARE_ARRAY(LitJitPatches, LitJitPatch, jit_patches)
+DEFINE_ARRAY(LitJitPatches, LitJitPatch, jit_patches)
+
+typedef struct {
+	LitState* state;
+	LitFunction* function;
+
+	LitBytes code;
+	LitJitPatches patches;
+
+	uint32_t* labels;
+	uint32_t epilogue;
+} LitJit;
+
+static void emit_byte(LitJit* jit, uint8_t byte) {
+	lit_bytes_write(jit->state, &jit->code, byte);
+}
+
+static void emit_bytes(LitJit* jit, uint8_t a, uint8_t b) {
+	emit_byte(jit, a);
+	emit_byte(jit, b);
+}
+
+static void emit_int32(LitJit* jit, uint32_t value) {
+	for (uint i = 0; i < 4; i++) {
+		emit_byte(jit, (uint8_t) (value >> (i * 8)));
+	}
+}
+
+static void emit_int64(LitJit* jit, uint64_t value) {
+	emit_int32(jit, (uint32_t) value);
+	emit_int32(jit, (uint32_t) (value >> 32));
+}
+
+static void patch_int32(LitJit* jit, uint32_t at, uint32_t value) {
+	for (uint i = 0; i < 4; i++) {
+		jit->code.values[at + i] = (uint8_t) (value >> (i * 8));
+	}
+}
+
+static void emit_rex(LitJit* jit, bool wide, uint8_t reg, uint8_t rm) {
+	uint8_t rex = 0x40 | (wide ? 0x8 : 0) | (reg >= 8 ? 0x4 : 0) | (rm >= 8 ? 0x1 : 0);
+
+	if (rex != 0x40) {
+		emit_byte(jit, rex);
+	}
+}
+
+// [base + offset], always with a 32 bit offset, to keep the templates simple
+static void emit_memory_operand(LitJit* jit, uint8_t reg, uint8_t base, int32_t offset) {
+	emit_byte(jit, 0x80 | ((reg & 7) << 3) | (base & 7));
+
+	if ((base & 7) == 4) {
+		emit_byte(jit, 0x24);
+	}
+
+	emit_int32(jit, (uint32_t) offset);
+}
+
+// op rm, reg on 64 bit registers
+static void emit_register_operation(LitJit* jit, uint8_t op, uint8_t reg, uint8_t rm) {
+	emit_rex(jit, true, reg, rm);
+	emit_bytes(jit, op, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void emit_load(LitJit* jit, uint8_t to, uint8_t base, int32_t offset) {
+	emit_rex(jit, true, to, base);
+	emit_byte(jit, 0x8b);
+	emit_memory_operand(jit, to, base, offset);
+}
+
+static void emit_store(LitJit* jit, uint8_t base, int32_t offset, uint8_t from) {
+	emit_rex(jit, true, from, base);
+	emit_byte(jit, 0x89);
+	emit_memory_operand(jit, from, base, offset);
+}
+
+static void emit_store_xmm(LitJit* jit, uint8_t base, int32_t offset, uint8_t from) {
+	emit_byte(jit, 0x66);
+	emit_rex(jit, false, from, base);
+	emit_bytes(jit, 0x0f, 0xd6);
+	emit_memory_operand(jit, from, base, offset);
+}
+
+static void emit_load_immediate(LitJit* jit, uint8_t to, uint64_t value) {
+	emit_rex(jit, true, 0, to);
+	emit_byte(jit, 0xb8 + (to & 7));
+	emit_int64(jit, value);
+}
+
+static void emit_move_to_xmm(LitJit* jit, uint8_t to, uint8_t from) {
+	emit_byte(jit, 0x66);
+	emit_rex(jit, true, to, from);
+	emit_bytes(jit, 0x0f, 0x6e);
+	emit_byte(jit, 0xc0 | ((to & 7) << 3) | (from & 7));
+}
+
+// addsd, subsd, mulsd, divsd and friends
+static void emit_double_operation(LitJit* jit, uint8_t prefix, uint8_t op, uint8_t to, uint8_t from) {
+	emit_byte(jit, prefix);
+	emit_bytes(jit, 0x0f, op);
+	emit_byte(jit, 0xc0 | (to << 3) | from);
+}
+
+static void emit_jump(LitJit* jit, int condition, uint32_t target, bool exit) {
+	if (condition == NO_CONDITION) {
+		emit_byte(jit, 0xe9);
+	} else {
+		emit_bytes(jit, 0x0f, 0x80 | condition);
+	}
+
+	lit_jit_patches_write(jit->state, &jit->patches, (LitJitPatch) { jit->code.count, target, exit });
+	emit_int32(jit, 0);
+}
+
+static void emit_exit(LitJit* jit, uint32_t offset) {
+	emit_byte(jit, 0xb8);
+	emit_int32(jit, offset);
+
+	emit_byte(jit, 0xe9);
+	emit_int32(jit, jit->epilogue - (jit->code.count + 4));
+}
+
+static bool is_constant(uint16_t rc) {
+	return IS_BIT_SET(rc, 8);
+}
+
+static LitValue get_constant(LitJit* jit, uint16_t rc) {
+	return jit->function->chunk.constants.values[rc & 0xff];
+}
+
+static void emit_load_rc(LitJit* jit, uint8_t to, uint16_t rc) {
+	if (is_constant(rc)) {
+		emit_load(jit, to, CONSTANTS, (rc & 0xff) * sizeof(LitValue));
+	} else {
+		emit_load(jit, to, REGISTERS, rc * sizeof(LitValue));
+	}
+}
+
+// Leaves the native code, unless the value is a number. Returns false, if it is a constant, that never is one
+static bool emit_load_number(LitJit* jit, uint8_t to, uint16_t rc, uint32_t offset) {
+	if (is_constant(rc)) {
+		if (!IS_NUMBER(get_constant(jit, rc))) {
+			return false;
+		}
+
+		emit_load_rc(jit, to, rc);
+		return true;
+	}
+
+	emit_load_rc(jit, to, rc);
+
+	emit_register_operation(jit, 0x89, to, RDX); // mov rdx, to
+	emit_register_operation(jit, 0x21, NAN_MASK, RDX); // and rdx, r14
+	emit_register_operation(jit, 0x39, NAN_MASK, RDX); // cmp rdx, r14
+	emit_jump(jit, CONDITION_E, offset, true);
+
+	return true;
+}
+
+// Leaves the native code, if the value is an object, since those might have operator methods
+static void emit_object_guard(LitJit* jit, uint8_t reg, uint32_t offset) {
+	emit_load_immediate(jit, RDX, SIGN_BIT | QNAN);
+	emit_register_operation(jit, 0x21, reg, RDX); // and rdx, reg
+	emit_load_immediate(jit, RSI, SIGN_BIT | QNAN);
+	emit_register_operation(jit, 0x39, RSI, RDX); // cmp rdx, rsi
+	emit_jump(jit, CONDITION_E, offset, true);
+}
+
+// Loads both operands into xmm0 and xmm1
+static bool emit_load_numbers(LitJit* jit, uint16_t b, uint16_t c, uint32_t offset) {
+	if (!emit_load_number(jit, RAX, b, offset) || !emit_load_number(jit, RCX, c, offset)) {
+		return false;
+	}
+
+	emit_move_to_xmm(jit, XMM0, RAX);
+	emit_move_to_xmm(jit, XMM1, RCX);
+
+	return true;
+}
+
+static bool emit_arithmetic(LitJit* jit, uint32_t instruction, uint8_t op, uint32_t offset) {
+	if (!emit_load_numbers(jit, LIT_INSTRUCTION_B(instruction), LIT_INSTRUCTION_CK(instruction), offset)) {
+		return false;
+	}
+
+	emit_double_operation(jit, 0xf2, op, XMM0, XMM1);
+	emit_store_xmm(jit, REGISTERS, LIT_INSTRUCTION_A(instruction) * sizeof(LitValue), XMM0);
+
+	return true;
+}
+
+static double floor_divide(double a, double b) {
+	return floor(a / b);
+}
+
+// Operations, that aren't worth inlining, call back into the C runtime
+static bool emit_runtime_arithmetic(LitJit* jit, uint32_t instruction, double (*helper)(double, double), uint32_t offset) {
+	if (!emit_load_numbers(jit, LIT_INSTRUCTION_B(instruction), LIT_INSTRUCTION_CK(instruction), offset)) {
+		return false;
+	}
+
+	emit_load_immediate(jit, RAX, (uint64_t) (uintptr_t) helper);
+	emit_bytes(jit, 0xff, 0xd0); // call rax
+	emit_store_xmm(jit, REGISTERS, LIT_INSTRUCTION_A(instruction) * sizeof(LitValue), XMM0);
+
+	return true;
+}
+
+// Compares xmm0 to xmm1, the condition has to be true, when the comparison holds.
+// ucomisd sets CF and ZF on NaN, so only the above conditions are used, to keep NaN comparisons false
+static void emit_compare(LitJit* jit, bool swap) {
+	emit_byte(jit, 0x66);
+	emit_bytes(jit, 0x0f, 0x2e);
+	emit_byte(jit, swap ? 0xc8 : 0xc1); // ucomisd xmm1, xmm0 or xmm0, xmm1
+}
+
+static void emit_store_condition(LitJit* jit, int condition, uint8_t a) {
+	emit_bytes(jit, 0x0f, 0x90 | condition); // setcc al
+	emit_byte(jit, 0xc0);
+	emit_bytes(jit, 0x0f, 0xb6); // movzx eax, al
+	emit_byte(jit, 0xc0);
+
+	// true follows false
+	emit_load_immediate(jit, RCX, FALSE_VALUE);
+	emit_register_operation(jit, 0x01, RCX, RAX);
+	emit_store(jit, REGISTERS, a * sizeof(LitValue), RAX);
+}
+
+static bool emit_comparison(LitJit* jit, uint32_t instruction, int condition, bool swap, uint32_t offset) {
+	if (!emit_load_numbers(jit, LIT_INSTRUCTION_B(instruction), LIT_INSTRUCTION_CK(instruction), offset)) {
+		return false;
+	}
+
+	emit_compare(jit, swap);
+	emit_store_condition(jit, condition, LIT_INSTRUCTION_A(instruction));
+
+	return true;
+}
+
+// The fused jumps take their offset from the FALSE_JUMP, that follows them
+static bool emit_comparison_jump(LitJit* jit, uint32_t instruction, int false_condition, bool swap, uint32_t offset) {
+	if (!emit_load_numbers(jit, LIT_INSTRUCTION_B(instruction), LIT_INSTRUCTION_CK(instruction), offset)) {
+		return false;
+	}
+
+	emit_compare(jit, swap);
+	emit_jump(jit, false_condition, offset + 2 + LIT_INSTRUCTION_BX(jit->function->chunk.code[offset + 1]), false);
+	emit_jump(jit, NO_CONDITION, offset + 2, false);
+
+	return true;
+}
+
+// Jumps to target, if the value in rax is false, null or zero
+static void emit_falsey_jump(LitJit* jit, uint32_t target) {
+	emit_register_operation(jit, 0x89, RAX, RCX);
+	emit_register_operation(jit, 0x01, RCX, RCX); // Only 0 and -0 are left with no bits after the sign is shifted out
+	emit_jump(jit, CONDITION_E, target, false);
+
+	emit_load_immediate(jit, RCX, FALSE_VALUE);
+	emit_register_operation(jit, 0x39, RCX, RAX);
+	emit_jump(jit, CONDITION_E, target, false);
+
+	emit_load_immediate(jit, RCX, NULL_VALUE);
+	emit_register_operation(jit, 0x39, RCX, RAX);
+	emit_jump(jit, CONDITION_E, target, false);
+}
+
+// Returns false, if there is no template for the instruction
+static bool compile_instruction(LitJit* jit, uint32_t instruction, uint32_t offset) {
+	uint8_t a = LIT_INSTRUCTION_A(instruction);
+	int32_t register_offset = a * sizeof(LitValue);
+
+	switch (LIT_INSTRUCTION_OPCODE(instruction)) {
+		case OP_MOVE: {
+			emit_load_rc(jit, RAX, LIT_INSTRUCTION_BK(instruction));
+			emit_store(jit, REGISTERS, register_offset, RAX);
+
+			return true;
+		}
+
+		case OP_LOAD_NULL: {
+			emit_load_immediate(jit, RAX, NULL_VALUE);
+			emit_store(jit, REGISTERS, register_offset, RAX);
+
+			return true;
+		}
+
+		case OP_LOAD_BOOL: {
+			emit_load_immediate(jit, RAX, BOOL_VALUE(LIT_INSTRUCTION_B(instruction) != 0));
+			emit_store(jit, REGISTERS, register_offset, RAX);
+
+			return true;
+		}
+
+		case OP_GET_PRIVATE: {
+			emit_load(jit, RAX, PRIVATES, LIT_INSTRUCTION_BX(instruction) * sizeof(LitValue));
+			emit_store(jit, REGISTERS, register_offset, RAX);
+
+			return true;
+		}
+
+		case OP_SET_PRIVATE: {
+			uint32_t bx = LIT_INSTRUCTION_BX(instruction);
+
+			emit_load(jit, RAX, IS_BIT_SET(bx, 16) ? CONSTANTS : REGISTERS, register_offset);
+			emit_store(jit, PRIVATES, (uint16_t) bx * sizeof(LitValue), RAX);
+
+			return true;
+		}
+
+		case OP_ADD: case OP_ADD_NUM: case OP_ADD_CONSTANT: return emit_arithmetic(jit, instruction, 0x58, offset);
+		case OP_SUBTRACT: case OP_SUBTRACT_NUM: case OP_SUBTRACT_CONSTANT: return emit_arithmetic(jit, instruction, 0x5c, offset);
+		case OP_MULTIPLY: case OP_MULTIPLY_NUM: return emit_arithmetic(jit, instruction, 0x59, offset);
+		case OP_DIVIDE: case OP_DIVIDE_NUM: return emit_arithmetic(jit, instruction, 0x5e, offset);
+
+		case OP_DIVIDE_POWER_OF_TWO: return emit_arithmetic(jit, instruction, 0x5e, offset);
+
+		case OP_FLOOR_DIVIDE: case OP_FLOOR_DIVIDE_POWER_OF_TWO: return emit_runtime_arithmetic(jit, instruction, floor_divide, offset);
+		case OP_MOD: case OP_MOD_POWER_OF_TWO: return emit_runtime_arithmetic(jit, instruction, fmod, offset);
+		case OP_POWER: return emit_runtime_arithmetic(jit, instruction, pow, offset);
+		// x * x, to get the same result, as the interpreter
+		case OP_SQUARE: return emit_arithmetic(jit, LIT_FORM_ABC_INSTRUCTION(OP_MULTIPLY, a, LIT_INSTRUCTION_B(instruction), LIT_INSTRUCTION_B(instruction)), 0x59, offset);
+
+		case OP_INCREMENT_LOCAL: {
+			emit_load_number(jit, RAX, a, offset);
+			emit_move_to_xmm(jit, XMM0, RAX);
+
+			emit_load_immediate(jit, RAX, NUMBER_VALUE(LIT_INSTRUCTION_SBX(instruction)));
+			emit_move_to_xmm(jit, XMM1, RAX);
+
+			emit_double_operation(jit, 0xf2, 0x58, XMM0, XMM1);
+			emit_store_xmm(jit, REGISTERS, register_offset, XMM0);
+
+			return true;
+		}
+
+		case OP_NEGATE: {
+			if (!emit_load_number(jit, RAX, LIT_INSTRUCTION_BK(instruction), offset)) {
+				return false;
+			}
+
+			emit_load_immediate(jit, RCX, SIGN_BIT);
+			emit_register_operation(jit, 0x31, RCX, RAX);
+			emit_store(jit, REGISTERS, register_offset, RAX);
+
+			return true;
+		}
+
+		case OP_EQUAL: {
+			emit_load_rc(jit, RAX, LIT_INSTRUCTION_B(instruction));
+			emit_object_guard(jit, RAX, offset);
+			emit_load_rc(jit, RCX, LIT_INSTRUCTION_CK(instruction));
+
+			emit_register_operation(jit, 0x39, RCX, RAX);
+			emit_store_condition(jit, CONDITION_E, a);
+
+			return true;
+		}
+
+		case OP_LESS: case OP_LESS_NUM: return emit_comparison(jit, instruction, CONDITION_A, true, offset);
+		case OP_LESS_EQUAL: case OP_LESS_EQUAL_NUM: return emit_comparison(jit, instruction, CONDITION_AE, true, offset);
+		case OP_GREATER: case OP_GREATER_NUM: return emit_comparison(jit, instruction, CONDITION_A, false, offset);
+		case OP_GREATER_EQUAL: case OP_GREATER_EQUAL_NUM: return emit_comparison(jit, instruction, CONDITION_AE, false, offset);
+
+		case OP_LESS_JUMP: return emit_comparison_jump(jit, instruction, CONDITION_BE, true, offset);
+		case OP_LESS_EQUAL_JUMP: return emit_comparison_jump(jit, instruction, CONDITION_B, true, offset);
+		case OP_GREATER_JUMP: return emit_comparison_jump(jit, instruction, CONDITION_BE, false, offset);
+		case OP_GREATER_EQUAL_JUMP: return emit_comparison_jump(jit, instruction, CONDITION_B, false, offset);
+
+		case OP_EQUAL_JUMP: {
+			emit_load_rc(jit, RAX, LIT_INSTRUCTION_B(instruction));
+			emit_object_guard(jit, RAX, offset);
+			emit_load_rc(jit, RCX, LIT_INSTRUCTION_CK(instruction));
+
+			emit_register_operation(jit, 0x39, RCX, RAX);
+			emit_jump(jit, CONDITION_NE, offset + 2 + LIT_INSTRUCTION_BX(jit->function->chunk.code[offset + 1]), false);
+			emit_jump(jit, NO_CONDITION, offset + 2, false);
+
+			return true;
+		}
+
+		case OP_JUMP: {
+			emit_jump(jit, NO_CONDITION, offset + 1 + LIT_INSTRUCTION_SBX(instruction), false);
+			return true;
+		}
+
+		case OP_FALSE_JUMP: {
+			emit_load(jit, RAX, REGISTERS, register_offset);
+			emit_falsey_jump(jit, offset + 1 + LIT_INSTRUCTION_BX(instruction));
+
+			return true;
+		}
+
+		case OP_TRUE_JUMP: {
+			emit_load(jit, RAX, REGISTERS, register_offset);
+			emit_falsey_jump(jit, offset + 1);
+			emit_jump(jit, NO_CONDITION, offset + 1 + LIT_INSTRUCTION_BX(instruction), false);
+
+			return true;
+		}
+
+		case OP_NULL_JUMP: case OP_NON_NULL_JUMP: {
+			emit_load(jit, RAX, REGISTERS, register_offset);
+			emit_load_immediate(jit, RCX, NULL_VALUE);
+			emit_register_operation(jit, 0x39, RCX, RAX);
+			emit_jump(jit, LIT_INSTRUCTION_OPCODE(instruction) == OP_NULL_JUMP ? CONDITION_E : CONDITION_NE, offset + 1 + LIT_INSTRUCTION_BX(instruction), false);
+
+			return true;
+		}
+
+		default: return false;
+	}
+}
+
+static void emit_prologue(LitJit* jit) {
+	emit_byte(jit, 0x53); // push rbx
+	emit_bytes(jit, 0x41, 0x54); // push r12
+	emit_bytes(jit, 0x41, 0x55); // push r13
+	emit_bytes(jit, 0x41, 0x56); // push r14
+
+	// Keep the stack aligned for the runtime calls
+	emit_bytes(jit, 0x48, 0x83);
+	emit_bytes(jit, 0xec, 0x08);
+
+	emit_register_operation(jit, 0x89, RDI, REGISTERS);
+	emit_register_operation(jit, 0x89, RSI, CONSTANTS);
+	emit_register_operation(jit, 0x89, RDX, PRIVATES);
+	emit_load_immediate(jit, NAN_MASK, QNAN);
+
+	emit_bytes(jit, 0xff, 0xe1); // jmp rcx
+
+	jit->epilogue = jit->code.count;
+
+	emit_bytes(jit, 0x48, 0x83);
+	emit_bytes(jit, 0xc4, 0x08);
+
+	emit_bytes(jit, 0x41, 0x5e); // pop r14
+	emit_bytes(jit, 0x41, 0x5d); // pop r13
+	emit_bytes(jit, 0x41, 0x5c); // pop r12
+	emit_byte(jit, 0x5b); // pop rbx
+	emit_byte(jit, 0xc3); // ret
+}
+
+bool lit_jit_compile(LitState* state, LitFunction* function) {
+	if (!jit_enabled) {
+		return false;
+	}
+
+	LitChunk* chunk = &function->chunk;
+	uint count = chunk->count;
+
+	LitJit jit;
+
+	jit.state = state;
+	jit.function = function;
+	jit.labels = LIT_ALLOCATE(state, uint32_t, count);
+
+	lit_init_bytes(&jit.code);
+	lit_init_jit_patches(&jit.patches);
+
+	uint32_t* entries = LIT_ALLOCATE(state, uint32_t, count);
+	uint32_t* exits = LIT_ALLOCATE(state, uint32_t, count);
+
+	emit_prologue(&jit);
+
+	for (uint i = 0; i < count; i++) {
+		uint32_t start = jit.code.count;
+
+		jit.labels[i] = start;
+		exits[i] = LIT_JIT_NO_ENTRY;
+
+		if (compile_instruction(&jit, chunk->code[i], i)) {
+			entries[i] = start;
+		} else {
+			// Drop whatever the template managed to emit, and hand the instruction to the interpreter
+			jit.code.count = start;
+			entries[i] = LIT_JIT_NO_ENTRY;
+
+			for (uint j = jit.patches.count; j > 0 && jit.patches.values[j - 1].at >= start; j--) {
+				jit.patches.count--;
+			}
+
+			emit_exit(&jit, i);
+		}
+	}
+
+	bool success = true;
+
+	for (uint i = 0; i < jit.patches.count; i++) {
+		LitJitPatch* patch = &jit.patches.values[i];
+		uint32_t target;
+
+		if (patch->target >= count) {
+			// Broken bytecode, leave it to the interpreter
+			success = false;
+			break;
+		} else if (patch->exit) {
+			if (exits[patch->target] == LIT_JIT_NO_ENTRY) {
+				exits[patch->target] = jit.code.count;
+				emit_exit(&jit, patch->target);
+			}
+
+			target = exits[patch->target];
+		} else {
+			target = jit.labels[patch->target];
+		}
+
+		patch_int32(&jit, patch->at, target - (patch->at + 4));
+	}
+
+	uint8_t* code = NULL;
+
+	if (success) {
+		code = mmap(NULL, jit.code.count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		success = code != MAP_FAILED;
+	}
+
+	if (success) {
+		memcpy(code, jit.code.values, jit.code.count);
+
+		if (mprotect(code, jit.code.count, PROT_READ | PROT_EXEC) != 0) {
+			munmap(code, jit.code.count);
+			success = false;
+		}
+	}
+
+	if (success) {
+		LitJitCode* jit_code = LIT_ALLOCATE(state, LitJitCode, 1);
+
+		jit_code->code = code;
+		jit_code->size = jit.code.count;
+		jit_code->entries = entries;
+		jit_code->entry_count = count;
+
+		function->jit = jit_code;
+	} else {
+		LIT_FREE_ARRAY(state, uint32_t, entries, count);
+	}
+
+	LIT_FREE_ARRAY(state, uint32_t, exits, count);
+	LIT_FREE_ARRAY(state, uint32_t, jit.labels, count);
+	lit_free_bytes(state, &jit.code);
+	lit_free_jit_patches(state, &jit.patches);
+
+	return success;
+}
+
+void lit_free_jit_code(LitState* state, LitFunction* function) {
+	LitJitCode* jit = function->jit;
+
+	if (jit == NULL) {
+		return;
+	}
+
+	munmap(jit->code, jit->size);
+
+	LIT_FREE_ARRAY(state, uint32_t, jit->entries, jit->entry_count);
+	LIT_FREE(state, LitJitCode, jit);
+
+	function->jit = NULL;
+}
+
+#endif
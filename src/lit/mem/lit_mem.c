@@ -4,24 +4,73 @@
 #include "lit/emitter/lit_emitter.h"
 #include "lit/parser/lit_parser.h"
 #include "lit/preprocessor/lit_preprocessor.h"
+#include "lit/jit/lit_jit.h"
 
 #include <stdlib.h>
 #include <time.h>
 #include <stdio.h>
 #include <errno.h>
+#include <string.h>
 
-void* lit_reallocate(LitState* state, void* pointer, size_t old_size, size_t new_size) {
+#ifdef LIT_PARALLEL_GC
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// GCC defines __SANITIZE_ADDRESS__, clang only has the feature check
+#if defined(__SANITIZE_ADDRESS__)
+#define LIT_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define LIT_ASAN
+#endif
+#endif
+
+#ifdef LIT_ASAN
+#include <sanitizer/asan_interface.h>
+
+#define LIT_POISON(pointer, size) ASAN_POISON_MEMORY_REGION(pointer, size)
+#define LIT_UNPOISON(pointer, size) ASAN_UNPOISON_MEMORY_REGION(pointer, size)
+#else
+#define LIT_POISON(pointer, size)
+#define LIT_UNPOISON(pointer, size)
+#endif
+
+static bool collect_step(LitVm* vm, int64_t work, uint64_t budget);
+
+static inline void count_allocation(LitState* state, size_t old_size, size_t new_size) {
 	state->bytes_allocated += (int64_t) new_size - (int64_t) old_size;
 
 	if (new_size > old_size) {
 #ifdef LIT_STRESS_TEST_GC
-		lit_collect_garbage(state->vm);
+		if (state->vm->gc_phase == LIT_GC_IDLE) {
+			lit_collect_young(state->vm);
+		} else {
+			collect_step(state->vm, 16, 0);
+		}
 #endif
 
 		if (state->bytes_allocated > state->next_gc) {
-			lit_collect_garbage(state->vm);
+			// Young collections are put on hold, while a full collection is in progress
+			if (state->vm->gc_phase != LIT_GC_IDLE || state->bytes_allocated > state->next_full_gc) {
+#ifdef LIT_PARALLEL_GC
+				// Incremental marking is single-threaded, so with the marker threads running, new cycles stop the world instead
+				if (state->vm->gc_phase == LIT_GC_IDLE && state->vm->marker != NULL) {
+					lit_collect_garbage(state->vm);
+					return;
+				}
+#endif
+
+				collect_step(state->vm, LIT_GC_STEP_WORK, 0);
+			} else {
+				lit_collect_young(state->vm);
+			}
 		}
 	}
+}
+
+void* lit_reallocate(LitState* state, void* pointer, size_t old_size, size_t new_size) {
+	count_allocation(state, old_size, new_size);
 
 	if (new_size == 0) {
 		free(pointer);
@@ -38,6 +87,194 @@ void* lit_reallocate(LitState* state, void* pointer, size_t old_size, size_t new
 	return ptr;
 }
 
+void lit_init_slabs(LitSlabAllocator* slabs) {
+	slabs->slabs = NULL;
+	slabs->top = NULL;
+	slabs->end = NULL;
+
+	memset(slabs->free_lists, 0, sizeof(slabs->free_lists));
+}
+
+void lit_free_slabs(LitSlabAllocator* slabs) {
+	LitSlab* slab = slabs->slabs;
+
+	while (slab != NULL) {
+		LitSlab* next = slab->next;
+
+		LIT_UNPOISON(slab->data, LIT_SLAB_SIZE);
+		free(slab);
+		slab = next;
+	}
+
+	lit_init_slabs(slabs);
+}
+
+void* lit_slab_allocate(LitState* state, size_t size) {
+	if (size > LIT_SLAB_OBJECT_MAX) {
+		return lit_reallocate(state, NULL, 0, size);
+	}
+
+	count_allocation(state, 0, size);
+
+	LitSlabAllocator* slabs = &state->slabs;
+	uint index = (size - 1) >> 3;
+	void* pointer = slabs->free_lists[index];
+
+	if (pointer != NULL) {
+		// Only the requested bytes are unpoisoned, the rest of the size class stays off-limits
+		LIT_UNPOISON(pointer, size);
+		slabs->free_lists[index] = *((void**) pointer);
+
+		return pointer;
+	}
+
+	size_t class_size = (index + 1) << 3;
+
+	if (slabs->top == NULL || (size_t) (slabs->end - slabs->top) < class_size) {
+		LitSlab* slab = (LitSlab*) malloc(sizeof(LitSlab) + LIT_SLAB_SIZE);
+
+		if (slab == NULL) {
+			lit_error(state, RUNTIME_ERROR, "Fatal error:\nOut of memory\nProgram terminated");
+			exit(111);
+		}
+
+		slab->next = slabs->slabs;
+		slabs->slabs = slab;
+
+		slabs->top = slab->data;
+		slabs->end = slab->data + LIT_SLAB_SIZE;
+
+		LIT_POISON(slab->data, LIT_SLAB_SIZE);
+	}
+
+	pointer = slabs->top;
+	LIT_UNPOISON(pointer, size);
+	slabs->top += class_size;
+
+	return pointer;
+}
+
+void lit_slab_free(LitState* state, void* pointer, size_t size) {
+	if (size > LIT_SLAB_OBJECT_MAX) {
+		lit_reallocate(state, pointer, size, 0);
+		return;
+	}
+
+	state->bytes_allocated -= size;
+
+	LitSlabAllocator* slabs = &state->slabs;
+	uint index = (size - 1) >> 3;
+
+	*((void**) pointer) = slabs->free_lists[index];
+	slabs->free_lists[index] = pointer;
+
+	// The whole entry, the next pointer included, so that use-after-free is caught, the allocator unpoisons it first
+	LIT_POISON(pointer, (index + 1) << 3);
+}
+
+void lit_init_arena(LitArena* arena) {
+	arena->block = NULL;
+	arena->last = NULL;
+}
+
+void lit_free_arena(LitArena* arena) {
+	LitArenaBlock* block = arena->block;
+
+	while (block != NULL) {
+		LitArenaBlock* next = block->next;
+
+		free(block);
+		block = next;
+	}
+
+	lit_init_arena(arena);
+}
+
+void* lit_arena_allocate(LitArena* arena, size_t size) {
+	size = (size + 7) & ~((size_t) 7);
+	LitArenaBlock* block = arena->block;
+
+	if (block == NULL || block->used + size > block->size) {
+		size_t block_size = size > LIT_ARENA_BLOCK_SIZE ? size : LIT_ARENA_BLOCK_SIZE;
+		block = (LitArenaBlock*) malloc(sizeof(LitArenaBlock) + block_size);
+
+		if (block == NULL) {
+			fprintf(stderr, "Fatal error:\nOut of memory\nProgram terminated\n");
+			exit(111);
+		}
+
+		block->size = block_size;
+		block->used = size;
+
+		// Keep filling the current block, if an oversized allocation got a block of its own
+		if (arena->block != NULL && size > LIT_ARENA_BLOCK_SIZE) {
+			block->next = arena->block->next;
+			arena->block->next = block;
+			arena->last = NULL;
+
+			return block->data;
+		}
+
+		block->used = 0;
+		block->next = arena->block;
+		arena->block = block;
+	}
+
+	void* pointer = block->data + block->used;
+	block->used += size;
+	arena->last = pointer;
+
+	return pointer;
+}
+
+void* lit_arena_reallocate(LitArena* arena, void* pointer, size_t old_size, size_t new_size) {
+	if (pointer == NULL) {
+		return lit_arena_allocate(arena, new_size);
+	}
+
+	if (new_size <= old_size) {
+		return pointer;
+	}
+
+	LitArenaBlock* block = arena->block;
+
+	if (pointer == arena->last) {
+		size_t start = (uint8_t*) pointer - block->data;
+		size_t size = (new_size + 7) & ~((size_t) 7);
+
+		if (start + size <= block->size) {
+			block->used = start + size;
+			return pointer;
+		}
+	}
+
+	void* new_pointer = lit_arena_allocate(arena, new_size);
+	memcpy(new_pointer, pointer, old_size);
+
+	return new_pointer;
+}
+
+static void free_shape(LitState* state, LitShape* shape) {
+	if (shape == NULL) {
+		return;
+	}
+
+	LitShape* child = shape->children;
+
+	while (child != NULL) {
+		LitShape* next = child->next;
+
+		free_shape(state, child);
+		child = next;
+	}
+
+	if (shape->slot_count > 0) {
+		LIT_FREE_ARRAY(state, LitString*, shape->names, shape->slot_count);
+	}
+
+	LIT_FREE(state, LitShape, shape);
+}
+
 void lit_free_object(LitState* state, LitObject* object) {
 #ifdef LIT_LOG_ALLOCATION
 	printf("(%s) %p free %s\n", lit_object_type_names[object->type], (void*) object, lit_object_type_names[object->type]);
@@ -48,7 +285,7 @@ void lit_free_object(LitState* state, LitObject* object) {
 			LitString* string = (LitString*) object;
 
 			LIT_FREE_ARRAY(state, char, string->chars, string->length + 1);
-			LIT_FREE(state, LitString, object);
+			LIT_FREE_OBJECT(state, LitString, object);
 
 			break;
 		}
@@ -57,27 +294,31 @@ void lit_free_object(LitState* state, LitObject* object) {
 			LitFunction* function = (LitFunction*) object;
 			lit_free_chunk(state, &function->chunk);
 
-			LIT_FREE(state, LitFunction, object);
+#ifdef LIT_JIT
+			lit_free_jit_code(state, function);
+#endif
+
+			LIT_FREE_OBJECT(state, LitFunction, object);
 			break;
 		}
 
 		case OBJECT_NATIVE_FUNCTION: {
-			LIT_FREE(state, LitNativeFunction, object);
+			LIT_FREE_OBJECT(state, LitNativeFunction, object);
 			break;
 		}
 
 		case OBJECT_NATIVE_PRIMITIVE: {
-			LIT_FREE(state, LitNativePrimitive, object);
+			LIT_FREE_OBJECT(state, LitNativePrimitive, object);
 			break;
 		}
 
 		case OBJECT_NATIVE_METHOD: {
-			LIT_FREE(state, LitNativeMethod, object);
+			LIT_FREE_OBJECT(state, LitNativeMethod, object);
 			break;
 		}
 
 		case OBJECT_PRIMITIVE_METHOD: {
-			LIT_FREE(state, LitPrimitiveMethod, object);
+			LIT_FREE_OBJECT(state, LitPrimitiveMethod, object);
 			break;
 		}
 
@@ -86,7 +327,8 @@ void lit_free_object(LitState* state, LitObject* object) {
 
 			LIT_FREE_ARRAY(state, LitCallFrame, fiber->frames, fiber->frame_capacity);
 			LIT_FREE_ARRAY(state, LitValue, fiber->registers, fiber->registers_allocated);
-			LIT_FREE(state, LitFiber, object);
+			LIT_FREE_ARRAY(state, LitUpvalue*, fiber->open_upvalues, fiber->registers_allocated);
+			LIT_FREE_OBJECT(state, LitFiber, object);
 
 			break;
 		}
@@ -95,7 +337,7 @@ void lit_free_object(LitState* state, LitObject* object) {
 			LitModule* module = (LitModule*) object;
 
 			LIT_FREE_ARRAY(state, LitValue, module->privates, module->private_count);
-			LIT_FREE(state, LitModule, object);
+			LIT_FREE_OBJECT(state, LitModule, object);
 
 			break;
 		}
@@ -104,7 +346,7 @@ void lit_free_object(LitState* state, LitObject* object) {
 			LitClosure* closure = (LitClosure*) object;
 
 			LIT_FREE_ARRAY(state, LitUpvalue*, closure->upvalues, closure->upvalue_count);
-			LIT_FREE(state, LitClosure, object);
+			LIT_FREE_OBJECT(state, LitClosure, object);
 
 			break;
 		}
@@ -115,13 +357,13 @@ void lit_free_object(LitState* state, LitObject* object) {
 			LIT_FREE_ARRAY(state, uint8_t, closure_prototype->indexes, closure_prototype->upvalue_count);
 			LIT_FREE_ARRAY(state, bool, closure_prototype->local, closure_prototype->upvalue_count);
 
-			LIT_FREE(state, LitClosurePrototype, object);
+			LIT_FREE_OBJECT(state, LitClosurePrototype, object);
 
 			break;
 		}
 
 		case OBJECT_UPVALUE: {
-			LIT_FREE(state, LitUpvalue, object);
+			LIT_FREE_OBJECT(state, LitUpvalue, object);
 			break;
 		}
 
@@ -131,40 +373,47 @@ void lit_free_object(LitState* state, LitObject* object) {
 			lit_free_table(state, &klass->methods);
 			lit_free_table(state, &klass->static_fields);
 
-			LIT_FREE(state, LitClass, object);
+			free_shape(state, klass->shape);
+			LIT_FREE_OBJECT(state, LitClass, object);
 
 			break;
 		}
 
 		case OBJECT_INSTANCE: {
-			lit_free_table(state, &((LitInstance*) object)->fields);
-			LIT_FREE(state, LitInstance, object);
+			LitInstance* instance = (LitInstance*) object;
+
+			if (instance->slots != instance->inline_slots) {
+				LIT_FREE_ARRAY(state, LitValue, instance->slots, instance->slot_capacity);
+			}
+
+			lit_free_table(state, &instance->fields);
+			lit_slab_free(state, object, sizeof(LitInstance) + sizeof(LitValue) * instance->inline_capacity);
 
 			break;
 		}
 
 		case OBJECT_BOUND_METHOD: {
-			LIT_FREE(state, LitBoundMethod, object);
+			LIT_FREE_OBJECT(state, LitBoundMethod, object);
 			break;
 		}
 
 		case OBJECT_ARRAY: {
 			lit_free_values(state, &((LitArray*) object)->values);
-			LIT_FREE(state, LitArray, object);
+			LIT_FREE_OBJECT(state, LitArray, object);
 
 			break;
 		}
 
 		case OBJECT_VARARG_ARRAY: {
 			lit_free_values(state, &((LitVarargArray*) object)->array.values);
-			LIT_FREE(state, LitVarargArray, object);
+			LIT_FREE_OBJECT(state, LitVarargArray, object);
 
 			break;
 		}
 
 		case OBJECT_MAP: {
 			lit_free_table(state, &((LitMap*) object)->values);
-			LIT_FREE(state, LitMap, object);
+			LIT_FREE_OBJECT(state, LitMap, object);
 
 			break;
 		}
@@ -180,22 +429,22 @@ void lit_free_object(LitState* state, LitObject* object) {
 				lit_reallocate(state, data->data, data->size, 0);
 			}
 
-			LIT_FREE(state, LitUserdata, object);
+			LIT_FREE_OBJECT(state, LitUserdata, object);
 			break;
 		}
 
 		case OBJECT_RANGE: {
-			LIT_FREE(state, LitRange, object);
+			LIT_FREE_OBJECT(state, LitRange, object);
 			break;
 		}
 
 		case OBJECT_FIELD: {
-			LIT_FREE(state, LitField, object);
+			LIT_FREE_OBJECT(state, LitField, object);
 			break;
 		}
 
 		case OBJECT_REFERENCE: {
-			LIT_FREE(state, LitReference, object);
+			LIT_FREE_OBJECT(state, LitReference, object);
 			break;
 		}
 
@@ -209,17 +458,128 @@ void lit_free_objects(LitState* state, LitObject* objects) {
 	LitObject* object = objects;
 
 	while (object != NULL) {
-		LitObject* next = object->next;
+		LitObject* next = LIT_OBJECT_NEXT(object);
 		lit_free_object(state, object);
 		object = next;
 	}
 
 	free(state->vm->gray_stack);
+	state->vm->gray_stack = NULL;
 	state->vm->gray_capacity = 0;
+
+	free(state->vm->remembered);
+	state->vm->remembered = NULL;
+	state->vm->remembered_count = 0;
+	state->vm->remembered_capacity = 0;
+}
+
+static void push_remembered(LitVm* vm, LitObject* object) {
+	if (vm->remembered_capacity < vm->remembered_count + 1) {
+		vm->remembered_capacity = LIT_GROW_CAPACITY(vm->remembered_capacity);
+		vm->remembered = realloc(vm->remembered, sizeof(LitObject*) * vm->remembered_capacity);
+	}
+
+	vm->remembered[vm->remembered_count++] = object;
+}
+
+void lit_remember_object(LitVm* vm, LitObject* object) {
+	// Every object is black during the sweep, and there is nothing young to point to, unmarking it would get it freed
+	if (vm->gc_phase == LIT_GC_SWEEP) {
+		return;
+	}
+
+	// Unmarked, the object looks young to the barrier, so it is remembered only once.
+	// While marking, that also turns it gray again, so that it gets traced once more
+	object->marked = false;
+	push_remembered(vm, object);
+}
+
+#ifdef LIT_PARALLEL_GC
+#define LIT_MARK_BATCH 64 // Objects, that a marker gives away at once
+
+typedef struct sLitMarkWorker {
+	struct sLitMarker* marker;
+	pthread_t thread;
+
+	// Only the owner touches these
+	LitObject** stack;
+	uint count;
+	uint capacity;
+
+	// Work, that any of the other markers can take
+	pthread_mutex_t lock;
+	LitObject* shared[LIT_MARK_BATCH];
+	uint shared_count;
+} LitMarkWorker;
+
+typedef struct sLitMarker {
+	LitVm* vm;
+
+	// The first worker is the thread, that started the collection
+	LitMarkWorker* workers;
+	uint worker_count;
+
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+
+	uint round;
+	uint finished;
+	uint idle;
+	bool shutdown;
+} LitMarker;
+
+typedef uint64_t __attribute__((may_alias)) LitHeaderWord;
+
+static _Thread_local LitMarkWorker* current_worker;
+static uint64_t mark_bit;
+
+static void push_gray(LitMarkWorker* worker, LitObject* object) {
+	if (worker->capacity < worker->count + 1) {
+		worker->capacity = LIT_GROW_CAPACITY(worker->capacity);
+		worker->stack = realloc(worker->stack, sizeof(LitObject*) * worker->capacity);
+	}
+
+	worker->stack[worker->count++] = object;
+}
+
+static void mark_in_parallel(LitMarkWorker* worker, LitObject* object) {
+	LitHeaderWord* header = (LitHeaderWord*) object;
+
+	// The mark bit shares the word with the type and the link, but nobody else writes to those during the marking
+	if ((__atomic_load_n(header, __ATOMIC_RELAXED) & mark_bit) != 0 || (__atomic_fetch_or(header, mark_bit, __ATOMIC_RELAXED) & mark_bit) != 0) {
+		return;
+	}
+
+	push_gray(worker, object);
+
+	if (worker->count > LIT_MARK_BATCH * 2 && __atomic_load_n(&worker->shared_count, __ATOMIC_RELAXED) == 0) {
+		pthread_mutex_lock(&worker->lock);
+
+		if (worker->shared_count == 0) {
+			worker->count -= LIT_MARK_BATCH;
+			memcpy(worker->shared, worker->stack + worker->count, sizeof(LitObject*) * LIT_MARK_BATCH);
+			__atomic_store_n(&worker->shared_count, LIT_MARK_BATCH, __ATOMIC_RELAXED);
+		}
+
+		pthread_mutex_unlock(&worker->lock);
+	}
 }
+#endif
 
 void lit_mark_object(LitVm* vm, LitObject* object) {
-	if (object == NULL || object->marked) {
+	if (object == NULL) {
+		return;
+	}
+
+#ifdef LIT_PARALLEL_GC
+	if (current_worker != NULL) {
+		mark_in_parallel(current_worker, object);
+		return;
+	}
+#endif
+
+	if (object->marked) {
 		return;
 	}
 
@@ -272,7 +632,12 @@ static void mark_roots(LitVm* vm) {
 	lit_mark_table(vm, &state->preprocessor->defined);
 
 	lit_mark_table(vm, &vm->modules->values);
-	lit_mark_table(vm, &vm->globals->values);
+	lit_mark_object(vm, (LitObject*) vm->globals);
+	lit_mark_table(vm, &vm->global_slots);
+
+	for (uint i = 0; i < vm->global_values.count; i++) {
+		lit_mark_value(vm, vm->global_values.values[i]);
+	}
 
 	LitEvent* event = state->event_system->events;
 
@@ -288,6 +653,18 @@ static void mark_array(LitVm* vm, LitValues* array) {
 	}
 }
 
+static void mark_shape(LitVm* vm, LitShape* shape) {
+	if (shape == NULL) {
+		return;
+	}
+
+	lit_mark_object(vm, (LitObject*) shape->name);
+
+	for (LitShape* child = shape->children; child != NULL; child = child->next) {
+		mark_shape(vm, child);
+	}
+}
+
 static void blacken_object(LitVm* vm, LitObject* object) {
 #ifdef LIT_LOG_BLACKING
 	printf("%p blacken ", (void*) object);
@@ -319,6 +696,7 @@ static void blacken_object(LitVm* vm, LitObject* object) {
 			LitFunction* function = (LitFunction*) object;
 
 			lit_mark_object(vm, (LitObject*) function->name);
+			lit_mark_object(vm, (LitObject*) function->escape_prototype);
 			mark_array(vm, &function->chunk.constants);
 
 			break;
@@ -327,6 +705,11 @@ static void blacken_object(LitVm* vm, LitObject* object) {
 		case OBJECT_FIBER: {
 			LitFiber* fiber = (LitFiber*) object;
 
+			// Registers are written without the barrier, so the fiber is traced again before the sweep
+			if (vm->gc_phase == LIT_GC_MARK) {
+				push_remembered(vm, object);
+			}
+
 			for (uint i = 0; i < fiber->registers_allocated; i++) {
 				lit_mark_value(vm, fiber->registers[i]);
 			}
@@ -341,8 +724,8 @@ static void blacken_object(LitVm* vm, LitObject* object) {
 				}
 			}
 
-			for (LitUpvalue* upvalue = fiber->open_upvalues; upvalue != NULL; upvalue = upvalue->next) {
-				lit_mark_object(vm, (LitObject*) upvalue);
+			for (uint i = 0; i < fiber->open_upvalue_top; i++) {
+				lit_mark_object(vm, (LitObject*) fiber->open_upvalues[i]);
 			}
 
 			lit_mark_value(vm, fiber->error);
@@ -355,6 +738,10 @@ static void blacken_object(LitVm* vm, LitObject* object) {
 		case OBJECT_MODULE: {
 			LitModule* module = (LitModule*) object;
 
+			if (vm->gc_phase == LIT_GC_MARK) {
+				push_remembered(vm, object);
+			}
+
 			lit_mark_value(vm, module->return_value);
 
 			lit_mark_object(vm, (LitObject*) module->name);
@@ -402,6 +789,11 @@ static void blacken_object(LitVm* vm, LitObject* object) {
 			lit_mark_table(vm, &klass->methods);
 			lit_mark_table(vm, &klass->static_fields);
 
+			for (uint i = 0; i < OPERATOR_TOTAL; i++) {
+				lit_mark_value(vm, klass->operators[i]);
+			}
+
+			mark_shape(vm, klass->shape);
 			break;
 		}
 
@@ -409,6 +801,13 @@ static void blacken_object(LitVm* vm, LitObject* object) {
 			LitInstance* instance = (LitInstance*) object;
 
 			lit_mark_object(vm, (LitObject*) instance->klass);
+
+			if (instance->shape != NULL) {
+				for (uint i = 0; i < instance->shape->slot_count; i++) {
+					lit_mark_value(vm, instance->slots[i]);
+				}
+			}
+
 			lit_mark_table(vm, &instance->fields);
 
 			break;
@@ -448,12 +847,16 @@ static void blacken_object(LitVm* vm, LitObject* object) {
 		}
 
 		case OBJECT_REFERENCE: {
-			lit_mark_value(vm, *((LitReference*) object)->slot);
+			LitReference* reference = (LitReference*) object;
+
+			lit_mark_object(vm, reference->owner);
+			lit_mark_value(vm, *reference->slot);
+
 			break;
 		}
 
 		default: {
-			lit_runtime_error_exiting(vm, "Unknown object with type %i", object->type);
+			lit_runtime_error(vm, "Unknown object with type %i", object->type);
 			break;
 		}
 	}
@@ -466,31 +869,257 @@ static void trace_references(LitVm* vm) {
 	}
 }
 
-static void sweep(LitVm* vm) {
-	LitObject* previous = NULL;
-	LitObject* object = vm->objects;
+#ifdef LIT_PARALLEL_GC
+static bool take_shared(LitMarkWorker* worker, LitMarkWorker* from) {
+	pthread_mutex_lock(&from->lock);
+	uint count = from->shared_count;
 
-	while (object != NULL) {
-		if (object->marked) {
-			object->marked = false;
-			previous = object;
-			object = object->next;
-		} else {
-			LitObject* unreached = object;
-			object = object->next;
+	for (uint i = 0; i < count; i++) {
+		push_gray(worker, from->shared[i]);
+	}
 
-			if (previous != NULL) {
-				previous->next = object;
-			} else {
-				vm->objects = object;
+	__atomic_store_n(&from->shared_count, 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&from->lock);
+
+	return count > 0;
+}
+
+static void drain(LitMarkWorker* worker) {
+	LitMarker* marker = worker->marker;
+	LitVm* vm = marker->vm;
+
+	while (true) {
+		while (worker->count > 0) {
+			blacken_object(vm, worker->stack[--worker->count]);
+		}
+
+		if (take_shared(worker, worker)) {
+			continue;
+		}
+
+		// A marker is idle only with nothing left in its own stack and its shared part, so once all of them are, the marking is over
+		__atomic_add_fetch(&marker->idle, 1, __ATOMIC_SEQ_CST);
+
+		while (true) {
+			if (__atomic_load_n(&marker->idle, __ATOMIC_SEQ_CST) == marker->worker_count) {
+				return;
+			}
+
+			bool stolen = false;
+
+			for (uint i = 0; i < marker->worker_count && !stolen; i++) {
+				LitMarkWorker* victim = &marker->workers[i];
+
+				if (victim == worker || __atomic_load_n(&victim->shared_count, __ATOMIC_RELAXED) == 0) {
+					continue;
+				}
+
+				__atomic_sub_fetch(&marker->idle, 1, __ATOMIC_SEQ_CST);
+				stolen = take_shared(worker, victim);
+
+				if (!stolen) {
+					__atomic_add_fetch(&marker->idle, 1, __ATOMIC_SEQ_CST);
+				}
+			}
+
+			if (stolen) {
+				break;
 			}
 
-			lit_free_object(vm->state, unreached);
+			sched_yield();
 		}
 	}
 }
 
-uint64_t lit_collect_garbage(LitVm* vm) {
+static void* run_worker(void* data) {
+	LitMarkWorker* worker = (LitMarkWorker*) data;
+	LitMarker* marker = worker->marker;
+	uint round = 0;
+
+	current_worker = worker;
+	pthread_mutex_lock(&marker->lock);
+
+	while (true) {
+		while (marker->round == round && !marker->shutdown) {
+			pthread_cond_wait(&marker->start, &marker->lock);
+		}
+
+		if (marker->shutdown) {
+			break;
+		}
+
+		round = marker->round;
+		pthread_mutex_unlock(&marker->lock);
+
+		drain(worker);
+
+		pthread_mutex_lock(&marker->lock);
+
+		if (++marker->finished == marker->worker_count - 1) {
+			pthread_cond_signal(&marker->done);
+		}
+	}
+
+	pthread_mutex_unlock(&marker->lock);
+	return NULL;
+}
+
+// The mutator is stopped, the calling thread takes part in the marking as the first worker
+static void trace_in_parallel(LitVm* vm) {
+	LitMarker* marker = vm->marker;
+
+	for (uint i = 0; i < vm->gray_count; i++) {
+		push_gray(&marker->workers[i % marker->worker_count], vm->gray_stack[i]);
+	}
+
+	vm->gray_count = 0;
+	marker->idle = 0;
+
+	pthread_mutex_lock(&marker->lock);
+	marker->finished = 0;
+	marker->round++;
+	pthread_cond_broadcast(&marker->start);
+	pthread_mutex_unlock(&marker->lock);
+
+	current_worker = &marker->workers[0];
+	drain(current_worker);
+	current_worker = NULL;
+
+	pthread_mutex_lock(&marker->lock);
+
+	while (marker->finished < marker->worker_count - 1) {
+		pthread_cond_wait(&marker->done, &marker->lock);
+	}
+
+	pthread_mutex_unlock(&marker->lock);
+}
+
+static void stop_marker(LitMarker* marker) {
+	pthread_mutex_lock(&marker->lock);
+	marker->shutdown = true;
+	pthread_cond_broadcast(&marker->start);
+	pthread_mutex_unlock(&marker->lock);
+
+	for (uint i = 0; i < marker->worker_count; i++) {
+		LitMarkWorker* worker = &marker->workers[i];
+
+		if (i > 0) {
+			pthread_join(worker->thread, NULL);
+		}
+
+		pthread_mutex_destroy(&worker->lock);
+		free(worker->stack);
+	}
+
+	pthread_mutex_destroy(&marker->lock);
+	pthread_cond_destroy(&marker->start);
+	pthread_cond_destroy(&marker->done);
+
+	free(marker->workers);
+	free(marker);
+}
+
+static LitMarker* start_marker(LitVm* vm, uint count) {
+	// The layout of the header bitfield is up to the compiler
+	LitObject probe;
+
+	memset(&probe, 0, sizeof(LitObject));
+	probe.marked = true;
+	memcpy(&mark_bit, &probe, sizeof(uint64_t));
+
+	LitMarker* marker = (LitMarker*) calloc(1, sizeof(LitMarker));
+
+	marker->vm = vm;
+	marker->workers = (LitMarkWorker*) calloc(count, sizeof(LitMarkWorker));
+
+	pthread_mutex_init(&marker->lock, NULL);
+	pthread_cond_init(&marker->start, NULL);
+	pthread_cond_init(&marker->done, NULL);
+
+	for (uint i = 0; i < count; i++) {
+		LitMarkWorker* worker = &marker->workers[i];
+
+		worker->marker = marker;
+		pthread_mutex_init(&worker->lock, NULL);
+
+		if (i > 0 && pthread_create(&worker->thread, NULL, run_worker, worker) != 0) {
+			pthread_mutex_destroy(&worker->lock);
+			break;
+		}
+
+		marker->worker_count++;
+	}
+
+	if (marker->worker_count < 2) {
+		stop_marker(marker);
+		return NULL;
+	}
+
+	return marker;
+}
+#endif
+
+/*
+ * Full collections trace the heap with the given amount of threads (including the one, that runs the collection),
+ * 1 goes back to tracing on a single thread. While the threads are set, the allocator runs full collections
+ * in one go too, instead of the incremental steps. Returns false, if lit was built without LIT_PARALLEL_GC.
+ */
+bool lit_set_gc_threads(LitVm* vm, uint count) {
+#ifdef LIT_PARALLEL_GC
+	if (vm->marker != NULL) {
+		stop_marker(vm->marker);
+		vm->marker = NULL;
+	}
+
+	if (count > 1) {
+		vm->marker = start_marker(vm, count);
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Fibers and modules are written to all the time, so the barrier isn't used for them at all
+static bool is_always_remembered(LitObject* object) {
+	return object->type == OBJECT_FIBER || object->type == OBJECT_MODULE;
+}
+
+static void promote(LitVm* vm, LitObject* object) {
+	LIT_SET_OBJECT_NEXT(object, vm->old_objects);
+	vm->old_objects = object;
+
+	if (is_always_remembered(object)) {
+		lit_remember_object(vm, object);
+	}
+}
+
+static void free_dead_object(LitVm* vm, LitObject* object) {
+	// Looking up just the dead strings is way cheaper, than scanning the whole table after every young collection
+	if (object->type == OBJECT_STRING) {
+		lit_table_delete(&vm->strings, (LitString*) object);
+	}
+
+	lit_free_object(vm->state, object);
+}
+
+// Survivors are moved into the old generation and stay marked
+static void sweep(LitVm* vm, LitObject* object) {
+	while (object != NULL) {
+		LitObject* next = LIT_OBJECT_NEXT(object);
+
+		if (object->marked) {
+			promote(vm, object);
+		} else {
+			free_dead_object(vm, object);
+		}
+
+		object = next;
+	}
+}
+
+static uint64_t collect(LitVm* vm, bool full) {
 	if (!vm->state->allow_gc) {
 		return 0;
 	}
@@ -499,16 +1128,63 @@ uint64_t lit_collect_garbage(LitVm* vm) {
 	uint64_t before = vm->state->bytes_allocated;
 
 #ifdef LIT_LOG_GC
-	printf("-- gc begin\n");
+	printf("-- %s gc begin\n", full ? "full" : "young");
 	clock_t t = clock();
 #endif
 
+	memset(vm->bound_methods, 0, sizeof(vm->bound_methods));
+
+	if (full) {
+		vm->remembered_count = 0;
+
+		for (LitObject* object = vm->old_objects; object != NULL; object = LIT_OBJECT_NEXT(object)) {
+			object->marked = false;
+		}
+	} else {
+		for (uint i = 0; i < vm->remembered_count; i++) {
+			lit_mark_object(vm, vm->remembered[i]);
+		}
+	}
+
 	mark_roots(vm);
+
+#ifdef LIT_PARALLEL_GC
+	// Waking the other markers up isn't worth it for the nursery
+	if (full && vm->marker != NULL) {
+		trace_in_parallel(vm);
+	}
+#endif
+
 	trace_references(vm);
-	lit_table_remove_white(&vm->strings);
-	sweep(vm);
 
-	vm->state->next_gc = vm->state->bytes_allocated * LIT_GC_HEAP_GROW_FACTOR;
+	LitObject* objects = vm->objects;
+	vm->objects = NULL;
+
+	if (full) {
+		LitObject* old_objects = vm->old_objects;
+		vm->old_objects = NULL;
+
+		sweep(vm, old_objects);
+	} else {
+		uint count = vm->remembered_count;
+		vm->remembered_count = 0;
+
+		for (uint i = 0; i < count; i++) {
+			LitObject* object = vm->remembered[i];
+
+			if (is_always_remembered(object)) {
+				lit_remember_object(vm, object);
+			}
+		}
+	}
+
+	sweep(vm, objects);
+
+	if (full) {
+		vm->state->next_full_gc = vm->state->bytes_allocated * LIT_GC_HEAP_GROW_FACTOR;
+	}
+
+	vm->state->next_gc = vm->state->bytes_allocated + LIT_GC_NURSERY_SIZE;
 	vm->state->allow_gc = true;
 
 	uint64_t collected = before - vm->state->bytes_allocated;
@@ -520,6 +1196,248 @@ uint64_t lit_collect_garbage(LitVm* vm) {
 	return collected;
 }
 
+static void begin_cycle(LitVm* vm) {
+	// Leaves only the old (marked) objects around, and the remembered set with just the fibers and the modules
+	collect(vm, false);
+
+	vm->remembered_count = 0;
+	vm->gc_phase = LIT_GC_UNMARK;
+	vm->gc_cursor = NULL;
+
+#ifdef LIT_LOG_GC
+	printf("-- incremental gc begin\n");
+#endif
+}
+
+// The only step, that can't be split, its cost depends on the remembered set and the roots
+static void finish_marking(LitVm* vm) {
+	uint count = vm->remembered_count;
+
+	for (uint i = 0; i < count; i++) {
+		LitObject* object = vm->remembered[i];
+
+		if (object->marked) {
+			blacken_object(vm, object);
+		} else {
+			lit_mark_object(vm, object);
+		}
+	}
+
+	mark_roots(vm);
+	trace_references(vm);
+
+	memset(vm->bound_methods, 0, sizeof(vm->bound_methods));
+
+	vm->gc_phase = LIT_GC_SWEEP;
+	vm->gc_cursor = NULL;
+	vm->sweeping = vm->objects;
+	vm->objects = NULL;
+}
+
+static void finish_cycle(LitVm* vm) {
+	vm->gc_phase = LIT_GC_IDLE;
+
+	// Every live fiber and module got into the remembered set, while being marked
+	uint count = vm->remembered_count;
+	vm->remembered_count = 0;
+
+	for (uint i = 0; i < count; i++) {
+		LitObject* object = vm->remembered[i];
+
+		if (is_always_remembered(object)) {
+			LIT_REMEMBER_OBJECT(vm, object)
+		}
+	}
+
+	// Everything, that was created during the sweep, is black already
+	LitObject* object = vm->objects;
+	vm->objects = NULL;
+
+	while (object != NULL) {
+		LitObject* next = LIT_OBJECT_NEXT(object);
+
+		promote(vm, object);
+		object = next;
+	}
+
+	vm->state->next_full_gc = vm->state->bytes_allocated * LIT_GC_HEAP_GROW_FACTOR;
+	vm->state->next_gc = vm->state->bytes_allocated + LIT_GC_NURSERY_SIZE;
+
+#ifdef LIT_LOG_GC
+	printf("-- incremental gc end\n");
+#endif
+}
+
+static inline LitObject* next_to_visit(LitVm* vm) {
+	return vm->gc_cursor == NULL ? vm->old_objects : LIT_OBJECT_NEXT(vm->gc_cursor);
+}
+
+// Returns true, once the cycle is over
+static bool do_work(LitVm* vm, uint work) {
+	switch (vm->gc_phase) {
+		case LIT_GC_IDLE: {
+			return true;
+		}
+
+		case LIT_GC_UNMARK: {
+			LitObject* object = next_to_visit(vm);
+
+			for (; work > 0 && object != NULL; work--) {
+				object->marked = false;
+
+				vm->gc_cursor = object;
+				object = LIT_OBJECT_NEXT(object);
+			}
+
+			if (object == NULL) {
+				vm->gc_phase = LIT_GC_MARK;
+				mark_roots(vm);
+			}
+
+			return false;
+		}
+
+		case LIT_GC_MARK: {
+			for (; work > 0 && vm->gray_count > 0; work--) {
+				blacken_object(vm, vm->gray_stack[--vm->gray_count]);
+			}
+
+			if (vm->gray_count == 0) {
+				finish_marking(vm);
+			}
+
+			return false;
+		}
+
+		case LIT_GC_SWEEP: {
+			LitObject* object = next_to_visit(vm);
+
+			// The old objects are swept in place, nothing is added to that list, until they are all visited
+			for (; work > 0 && object != NULL; work--) {
+				LitObject* next = LIT_OBJECT_NEXT(object);
+
+				if (object->marked) {
+					vm->gc_cursor = object;
+				} else {
+					if (vm->gc_cursor == NULL) {
+						vm->old_objects = next;
+					} else {
+						LIT_SET_OBJECT_NEXT(vm->gc_cursor, next);
+					}
+
+					free_dead_object(vm, object);
+				}
+
+				object = next;
+			}
+
+			// The survivors are added after the cursor, so that it stays at the end of the list
+			for (; work > 0 && object == NULL && vm->sweeping != NULL; work--) {
+				LitObject* young = vm->sweeping;
+				vm->sweeping = LIT_OBJECT_NEXT(young);
+
+				if (young->marked) {
+					LIT_SET_OBJECT_NEXT(young, NULL);
+
+					if (vm->gc_cursor == NULL) {
+						vm->old_objects = young;
+					} else {
+						LIT_SET_OBJECT_NEXT(vm->gc_cursor, young);
+					}
+
+					vm->gc_cursor = young;
+				} else {
+					free_dead_object(vm, young);
+				}
+			}
+
+			if (object == NULL && vm->sweeping == NULL) {
+				finish_cycle(vm);
+				return true;
+			}
+
+			return false;
+		}
+	}
+
+	return false;
+}
+
+// Stops after the given amount of work, or once the budget (in microseconds) runs out, if there is one
+static bool collect_step(LitVm* vm, int64_t work, uint64_t budget) {
+	if (!vm->state->allow_gc) {
+		return vm->gc_phase == LIT_GC_IDLE;
+	}
+
+	clock_t deadline = clock() + (clock_t) (budget * CLOCKS_PER_SEC / 1000000);
+
+	if (vm->gc_phase == LIT_GC_IDLE) {
+		begin_cycle(vm);
+	}
+
+	vm->state->allow_gc = false;
+	bool done = false;
+
+#ifdef LIT_LOG_GC
+	clock_t t = clock();
+#endif
+
+	while (!done) {
+		done = do_work(vm, 256);
+		work -= 256;
+
+		if (budget > 0 ? clock() >= deadline : work <= 0) {
+			break;
+		}
+	}
+
+	if (!done) {
+		vm->state->next_gc = vm->state->bytes_allocated + LIT_GC_STEP_SIZE;
+	}
+
+#ifdef LIT_LOG_GC
+	printf("-- gc step in %gms\n", (double) (clock() - t) / CLOCKS_PER_SEC * 1000);
+#endif
+
+	vm->state->allow_gc = true;
+	return done;
+}
+
+uint64_t lit_collect_garbage(LitVm* vm) {
+	uint64_t before = vm->state->bytes_allocated;
+
+	// Whatever the running cycle found already is collected first
+	if (vm->gc_phase != LIT_GC_IDLE) {
+		collect_step(vm, INT64_MAX, 0);
+	}
+
+	collect(vm, true);
+	return before - vm->state->bytes_allocated;
+}
+
+/*
+ * Does a part of a full collection, starting a new one, if needed, and returns true, once it's done.
+ * The budget is in microseconds: a host, that has to keep up the frame rate, can spend the time left
+ * in a frame on this, instead of having a full collection stop everything.
+ */
+bool lit_collect_step(LitVm* vm, uint64_t budget) {
+	return collect_step(vm, budget > 0 ? INT64_MAX : 256, budget);
+}
+
+/*
+ * Collects only the nursery: old objects are never freed here, and the marking stops at them,
+ * so the cost depends on the amount of the young objects, the roots and the remembered objects.
+ * Everything, that survives, gets promoted right away.
+ */
+uint64_t lit_collect_young(LitVm* vm) {
+	// The nursery belongs to the running full collection
+	if (vm->gc_phase != LIT_GC_IDLE) {
+		return 0;
+	}
+
+	return collect(vm, false);
+}
+
 // http://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2Float
 int lit_closest_power_of_two(int n) {
 	n--;
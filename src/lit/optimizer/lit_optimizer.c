@@ -4,6 +4,7 @@
 #include <math.h>
 
 DEFINE_ARRAY(LitVariables, LitVariable, variables)
+DEFINE_ARRAY(LitNames, LitName, names)
 
 static void optimize_expression(LitOptimizer* optimizer, LitExpression** slot);
 static void optimize_expressions(LitOptimizer* optimizer, LitExpressions* expressions);
@@ -26,7 +27,12 @@ static const char* optimization_names[OPTIMIZATION_TOTAL] = {
 	"empty-body",
 	"line-info",
 	"private-names",
-	"c-for"
+	"c-for",
+	"peephole",
+	"inline",
+	"constant-propagation",
+	"strength-reduction",
+	"loop-invariant"
 };
 
 static const char* optimization_descriptions[OPTIMIZATION_TOTAL] = {
@@ -37,9 +43,24 @@ static const char* optimization_descriptions[OPTIMIZATION_TOTAL] = {
 	"Removes loops with empty bodies.",
 	"Removes line information from chunks to save on space.",
 	"Removes names of the private locals from modules (they are indexed by id at runtime).",
-	"Replaces for-in loops with c-style for loops where it can."
+	"Replaces for-in loops with c-style for loops where it can.",
+	"Removes redundant moves, dead stores and unreachable instructions from the bytecode, and threads jumps.",
+	"Replaces calls to small module-level functions with their bodies.",
+	"Replaces variables, that are never assigned after their declaration, with their values.",
+	"Replaces ** 2 with a multiplication, and division, floor division and modulo by powers of two with cheaper instructions.",
+	"Moves expressions, that give the same value on every iteration, out of the loops."
 };
 
+// Max size (in expression nodes) of the function body, that can be inlined, per optimization level
+static uint inline_thresholds[OPTIMIZATION_LEVEL_TOTAL] = {
+	8, 8, 8, 16, 32
+};
+
+static uint inline_threshold = 8;
+
+// Max amount of the values, that are moved out of a single loop, each of them takes a register
+#define MAX_HOISTED 8
+
 static bool optimization_states[OPTIMIZATION_TOTAL];
 
 static bool optimization_states_setup = false;
@@ -52,7 +73,55 @@ void lit_init_optimizer(LitState* state, LitOptimizer* optimizer) {
 	optimizer->depth = -1;
 	optimizer->mark_used = false;
 
+	optimizer->loop = NULL;
+	optimizer->function_start = 0;
+	optimizer->keep_in_place = false;
+	optimizer->invariant_count = 0;
+
 	lit_init_variables(&optimizer->variables);
+	lit_init_names(&optimizer->assignments);
+	lit_init_names(&optimizer->unresolved);
+}
+
+// Expressions, that can be evaluated any amount of times and in any order
+static bool is_constant_argument(LitExpression* expression) {
+	return expression->type == LITERAL_EXPRESSION || expression->type == THIS_EXPRESSION;
+}
+
+// Expressions without side effects, variables still have to be read before anything could assign them
+static bool is_simple_argument(LitExpression* expression) {
+	return is_constant_argument(expression) || expression->type == VAR_EXPRESSION;
+}
+
+static bool is_pure(LitExpression* expression) {
+	return is_simple_argument(expression) || expression->type == LAMBDA_EXPRESSION;
+}
+
+
+
+static bool find_name(LitNames* names, const char* name, uint length) {
+	for (uint i = 0; i < names->count; i++) {
+		LitName* entry = &names->values[i];
+
+		if (entry->length == length && memcmp(entry->name, name, length) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// The same names get assigned over and over, and every lookup is linear, so keep the list short
+static void add_name(LitOptimizer* optimizer, LitNames* names, LitExpression* expression) {
+	LitVarExpression* expr = (LitVarExpression*) expression;
+
+	if (!find_name(names, expr->name, expr->length)) {
+		lit_names_write(optimizer->state, names, (LitName) { expr->name, expr->length });
+	}
+}
+
+static bool is_unresolved(LitOptimizer* optimizer, const char* name, uint length) {
+	return find_name(&optimizer->unresolved, name, length);
 }
 
 static void begin_scope(LitOptimizer* optimizer) {
@@ -66,11 +135,21 @@ static void end_scope(LitOptimizer* optimizer) {
 	bool remove_unused = lit_is_optimization_enabled(OPTIMIZATION_UNUSED_VAR);
 
 	while (variables->count > 0 && variables->values[variables->count - 1].depth > optimizer->depth) {
-		if (remove_unused && !variables->values[variables->count - 1].used) {
-			LitVariable* variable = &variables->values[variables->count - 1];
+		LitVariable* variable = &variables->values[variables->count - 1];
+
+		if (remove_unused && !variable->used && !(variable->depth == 0 && is_unresolved(optimizer, variable->name, variable->length))) {
+			LitStatement* declaration = *variable->declaration;
 
-			lit_free_statement(optimizer->state, *variable->declaration);
 			*variable->declaration = NULL;
+
+			if (declaration->type == VAR_STATEMENT) {
+				LitVarStatement* stmt = (LitVarStatement*) declaration;
+
+				// The value is never read, but computing it still might have side effects
+				if (stmt->init != NULL && !is_pure(stmt->init)) {
+					*variable->declaration = (LitStatement*) lit_create_expression_statement(optimizer->state, declaration->line, stmt->init);
+				}
+			}
 		}
 
 		variables->count--;
@@ -79,207 +158,1022 @@ static void end_scope(LitOptimizer* optimizer) {
 
 static LitVariable* add_variable(LitOptimizer* optimizer, const char* name, uint length, bool constant, LitStatement** declaration) {
 	lit_variables_write(optimizer->state, &optimizer->variables, (LitVariable) {
-		name, length, optimizer->depth, constant, optimizer->mark_used, NULL_VALUE, declaration
+		name, length, optimizer->depth, constant, optimizer->mark_used, false, NULL_VALUE, declaration, NULL
 	});
 
-	return &optimizer->variables.values[optimizer->variables.count - 1];
-}
+	return &optimizer->variables.values[optimizer->variables.count - 1];
+}
+
+static void add_parameters(LitOptimizer* optimizer, LitParameters* parameters) {
+	for (uint i = 0; i < parameters->count; i++) {
+		LitParameter* parameter = &parameters->values[i];
+
+		// Parameters can't be optimized-out, but they still shadow the outer variables
+		add_variable(optimizer, parameter->name, parameter->length, false, NULL)->used = true;
+	}
+}
+
+static LitVariable* resolve_variable(LitOptimizer* optimizer, const char* name, uint length) {
+	LitVariables* variables = &optimizer->variables;
+
+	for (int i = variables->count - 1; i >= 0; i--) {
+		LitVariable* variable = &variables->values[i];
+
+		if (length == variable->length && memcmp(variable->name, name, length) == 0) {
+			return variable;
+		}
+	}
+
+	return NULL;
+}
+
+static bool is_empty(LitStatement* statement) {
+	return statement == NULL || (statement->type == BLOCK_STATEMENT && ((LitBlockStatement*) statement)->statements.count == 0);
+}
+
+static LitValue evaluate_unary_op(LitValue value, LitTokenType op) {
+	switch (op) {
+		case LTOKEN_MINUS: {
+			if (IS_NUMBER(value)) {
+				return NUMBER_VALUE(-AS_NUMBER(value));
+			}
+
+			break;
+		}
+
+		case LTOKEN_BANG: {
+			return BOOL_VALUE(lit_is_falsey(value));
+		}
+
+		case LTOKEN_TILDE: {
+			if (IS_NUMBER(value)) {
+				return NUMBER_VALUE(~((int) AS_NUMBER(value)));
+			}
+
+			break;
+		}
+
+		default: {
+			break;
+		}
+	}
+
+	return NULL_VALUE;
+}
+
+static LitValue evaluate_binary_op(LitValue a, LitValue b, LitTokenType op) {
+	#define BINARY_OP(op) \
+		if (IS_NUMBER(a) && IS_NUMBER(b)) { \
+			return NUMBER_VALUE(AS_NUMBER(a) op AS_NUMBER(b)); \
+	  } \
+		return NULL_VALUE;
+
+	#define COMPARISON_OP(op) \
+		if (IS_NUMBER(a) && IS_NUMBER(b)) { \
+			return BOOL_VALUE(AS_NUMBER(a) op AS_NUMBER(b)); \
+	  } \
+		return NULL_VALUE;
+
+	#define BITWISE_OP(op) \
+		if (IS_NUMBER(a) && IS_NUMBER(b)) { \
+			return NUMBER_VALUE((int) AS_NUMBER(a) op (int) AS_NUMBER(b)); \
+	  } \
+		return NULL_VALUE;
+
+	#define FN_OP(fn) \
+		if (IS_NUMBER(a) && IS_NUMBER(b)) { \
+			return NUMBER_VALUE(fn(AS_NUMBER(a), AS_NUMBER(b))); \
+	  } \
+		return NULL_VALUE;
+
+	switch (op) {
+		case LTOKEN_PLUS: BINARY_OP(+)
+		case LTOKEN_MINUS: BINARY_OP(-)
+		case LTOKEN_STAR: BINARY_OP(*)
+		case LTOKEN_SLASH: BINARY_OP(/)
+		case LTOKEN_STAR_STAR: FN_OP(pow)
+		case LTOKEN_PERCENT: FN_OP(fmod)
+
+		case LTOKEN_GREATER: COMPARISON_OP(>)
+		case LTOKEN_GREATER_EQUAL: COMPARISON_OP(>=)
+		case LTOKEN_LESS: COMPARISON_OP(<)
+		case LTOKEN_LESS_EQUAL: COMPARISON_OP(<=)
+		case LTOKEN_LESS_LESS: BITWISE_OP(<<)
+		case LTOKEN_GREATER_GREATER: BITWISE_OP(>>)
+		case LTOKEN_BAR: BITWISE_OP(|)
+		case LTOKEN_AMPERSAND: BITWISE_OP(&)
+		case LTOKEN_CARET: BITWISE_OP(^)
+
+		case LTOKEN_SHARP: {
+			if (IS_NUMBER(a) && IS_NUMBER(b)) {
+				return NUMBER_VALUE(floor(AS_NUMBER(a) / AS_NUMBER(b)));
+		  }
+
+			return NULL_VALUE;
+		}
+
+		case LTOKEN_EQUAL_EQUAL: {
+			return BOOL_VALUE(a == b);
+		}
+
+		case LTOKEN_BANG_EQUAL: {
+			return BOOL_VALUE(a != b);
+		}
+
+		case LTOKEN_IS:
+		default: {
+			break;
+		}
+	}
+
+	#undef FN_OP
+	#undef BITWISE_OP
+	#undef COMPARISON_OP
+	#undef BINARY_OP
+
+	return NULL_VALUE;
+}
+
+static LitValue attempt_to_optimize_binary(LitOptimizer* optimizer, LitBinaryExpression* expression, LitValue value, bool left) {
+	LitTokenType op = expression->op;
+	LitExpression* branch = left ? expression->left : expression->right;
+
+	if (IS_NUMBER(value)) {
+		double number = AS_NUMBER(value);
+
+		if (op == LTOKEN_STAR) {
+			if (number == 0) {
+				return NUMBER_VALUE(0);
+			} else if (number == 1) {
+				expression->left = branch;
+				expression->right = NULL;
+			}
+		} else if ((op == LTOKEN_PLUS || op == LTOKEN_MINUS) && number == 0) {
+			expression->left = branch;
+			expression->right = NULL;
+		} else if (((left && op == LTOKEN_SLASH) || op == LTOKEN_STAR_STAR) && number == 1) {
+			expression->left = branch;
+			expression->right = NULL;
+		}
+	}
+
+	return NULL_VALUE;
+}
+
+static LitValue evaluate_expression(LitOptimizer* optimizer, LitExpression* expression) {
+	if (expression == NULL) {
+		return NULL_VALUE;
+	}
+
+	switch (expression->type) {
+		case LITERAL_EXPRESSION: {
+			return ((LitLiteralExpression*) expression)->value;
+		}
+
+		case UNARY_EXPRESSION: {
+			LitUnaryExpression* expr = (LitUnaryExpression*) expression;
+			LitValue branch = evaluate_expression(optimizer, expr->right);
+
+			if (branch != NULL_VALUE) {
+				return evaluate_unary_op(branch, expr->op);
+			}
+
+			break;
+		}
+
+		case BINARY_EXPRESSION: {
+			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+
+			LitValue a = evaluate_expression(optimizer, expr->left);
+			LitValue b = evaluate_expression(optimizer, expr->right);
+
+			if (a != NULL_VALUE && b != NULL_VALUE) {
+				return evaluate_binary_op(a, b, expr->op);
+			} else if (a != NULL_VALUE) {
+				return attempt_to_optimize_binary(optimizer, expr, a, false);
+			} else if (b != NULL_VALUE) {
+				return attempt_to_optimize_binary(optimizer, expr, b, true);
+			}
+
+			break;
+		}
+
+		default: {
+			return NULL_VALUE;
+		}
+	}
+
+	return NULL_VALUE;
+}
+
+static void collect_assignments(LitOptimizer* optimizer, LitStatement* statement);
+static void collect_expression_assignments(LitOptimizer* optimizer, LitExpression* expression);
+
+static void collect_expressions_assignments(LitOptimizer* optimizer, LitExpressions* expressions) {
+	for (uint i = 0; i < expressions->count; i++) {
+		collect_expression_assignments(optimizer, expressions->values[i]);
+	}
+}
+
+static void collect_statements_assignments(LitOptimizer* optimizer, LitStatements* statements) {
+	for (uint i = 0; i < statements->count; i++) {
+		collect_assignments(optimizer, statements->values[i]);
+	}
+}
+
+static void collect_expression_assignments(LitOptimizer* optimizer, LitExpression* expression) {
+	if (expression == NULL) {
+		return;
+	}
+
+	switch (expression->type) {
+		case BINARY_EXPRESSION: {
+			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+
+			collect_expression_assignments(optimizer, expr->left);
+			collect_expression_assignments(optimizer, expr->right);
+
+			break;
+		}
+
+		case UNARY_EXPRESSION: {
+			collect_expression_assignments(optimizer, ((LitUnaryExpression*) expression)->right);
+			break;
+		}
+
+		case ASSIGN_EXPRESSION: {
+			LitAssignExpression* expr = (LitAssignExpression*) expression;
+
+			if (expr->to->type == VAR_EXPRESSION) {
+				add_name(optimizer, &optimizer->assignments, expr->to);
+			} else {
+				collect_expression_assignments(optimizer, expr->to);
+			}
+
+			collect_expression_assignments(optimizer, expr->value);
+			break;
+		}
+
+		case CALL_EXPRESSION: {
+			LitCallExpression* expr = (LitCallExpression*) expression;
+
+			collect_expression_assignments(optimizer, expr->callee);
+			collect_expressions_assignments(optimizer, &expr->args);
+			collect_expression_assignments(optimizer, expr->init);
+
+			break;
+		}
+
+		case SET_EXPRESSION: {
+			LitSetExpression* expr = (LitSetExpression*) expression;
+
+			collect_expression_assignments(optimizer, expr->where);
+			collect_expression_assignments(optimizer, expr->value);
+
+			break;
+		}
+
+		case GET_EXPRESSION: {
+			collect_expression_assignments(optimizer, ((LitGetExpression*) expression)->where);
+			break;
+		}
+
+		case LAMBDA_EXPRESSION: {
+			collect_assignments(optimizer, ((LitLambdaExpression*) expression)->body);
+			break;
+		}
+
+		case ARRAY_EXPRESSION: {
+			collect_expressions_assignments(optimizer, &((LitArrayExpression*) expression)->values);
+			break;
+		}
+
+		case OBJECT_EXPRESSION: {
+			collect_expressions_assignments(optimizer, &((LitObjectExpression*) expression)->values);
+			break;
+		}
+
+		case SUBSCRIPT_EXPRESSION: {
+			LitSubscriptExpression* expr = (LitSubscriptExpression*) expression;
+
+			collect_expression_assignments(optimizer, expr->array);
+			collect_expression_assignments(optimizer, expr->index);
+
+			break;
+		}
+
+		case RANGE_EXPRESSION: {
+			LitRangeExpression* expr = (LitRangeExpression*) expression;
+
+			collect_expression_assignments(optimizer, expr->from);
+			collect_expression_assignments(optimizer, expr->to);
+
+			break;
+		}
+
+		case IF_EXPRESSION: {
+			LitIfExpression* expr = (LitIfExpression*) expression;
+
+			collect_expression_assignments(optimizer, expr->condition);
+			collect_expression_assignments(optimizer, expr->if_branch);
+			collect_expression_assignments(optimizer, expr->else_branch);
+
+			break;
+		}
+
+		case INTERPOLATION_EXPRESSION: {
+			collect_expressions_assignments(optimizer, &((LitInterpolationExpression*) expression)->expressions);
+			break;
+		}
+
+		case REFERENCE_EXPRESSION: {
+			LitExpression* to = ((LitReferenceExpression*) expression)->to;
+
+			// The reference can be used to change the variable from anywhere
+			if (to->type == VAR_EXPRESSION) {
+				add_name(optimizer, &optimizer->assignments, to);
+			} else {
+				collect_expression_assignments(optimizer, to);
+			}
+
+			break;
+		}
+
+		case LITERAL_EXPRESSION:
+		case VAR_EXPRESSION:
+		case THIS_EXPRESSION:
+		case SUPER_EXPRESSION: {
+			break;
+		}
+	}
+}
+
+// Collects all the variables, that are changed after their declaration, the scope is ignored
+static void collect_assignments(LitOptimizer* optimizer, LitStatement* statement) {
+	if (statement == NULL) {
+		return;
+	}
+
+	switch (statement->type) {
+		case EXPRESSION_STATEMENT: {
+			collect_expression_assignments(optimizer, ((LitExpressionStatement*) statement)->expression);
+			break;
+		}
+
+		case BLOCK_STATEMENT: {
+			collect_statements_assignments(optimizer, &((LitBlockStatement*) statement)->statements);
+			break;
+		}
+
+		case IF_STATEMENT: {
+			LitIfStatement* stmt = (LitIfStatement*) statement;
+
+			collect_expression_assignments(optimizer, stmt->condition);
+			collect_assignments(optimizer, stmt->if_branch);
+			collect_assignments(optimizer, stmt->else_branch);
+
+			if (stmt->elseif_conditions != NULL) {
+				collect_expressions_assignments(optimizer, stmt->elseif_conditions);
+				collect_statements_assignments(optimizer, stmt->elseif_branches);
+			}
+
+			break;
+		}
+
+		case WHILE_STATEMENT: {
+			LitWhileStatement* stmt = (LitWhileStatement*) statement;
+
+			collect_expression_assignments(optimizer, stmt->condition);
+			collect_assignments(optimizer, stmt->body);
+
+			break;
+		}
+
+		case FOR_STATEMENT: {
+			LitForStatement* stmt = (LitForStatement*) statement;
+
+			collect_expression_assignments(optimizer, stmt->init);
+			collect_assignments(optimizer, stmt->var);
+			collect_expression_assignments(optimizer, stmt->condition);
+			collect_expression_assignments(optimizer, stmt->increment);
+			collect_assignments(optimizer, stmt->body);
+
+			break;
+		}
+
+		case VAR_STATEMENT: {
+			collect_expression_assignments(optimizer, ((LitVarStatement*) statement)->init);
+			break;
+		}
+
+		case FUNCTION_STATEMENT: {
+			collect_assignments(optimizer, ((LitFunctionStatement*) statement)->body);
+			break;
+		}
+
+		case RETURN_STATEMENT: {
+			collect_expression_assignments(optimizer, ((LitReturnStatement*) statement)->expression);
+			break;
+		}
+
+		case METHOD_STATEMENT: {
+			collect_assignments(optimizer, ((LitMethodStatement*) statement)->body);
+			break;
+		}
+
+		case CLASS_STATEMENT: {
+			collect_statements_assignments(optimizer, &((LitClassStatement*) statement)->fields);
+			break;
+		}
+
+		case FIELD_STATEMENT: {
+			LitFieldStatement* stmt = (LitFieldStatement*) statement;
+
+			collect_assignments(optimizer, stmt->getter);
+			collect_assignments(optimizer, stmt->setter);
+
+			break;
+		}
+
+		case CONTINUE_STATEMENT:
+		case BREAK_STATEMENT: {
+			break;
+		}
+	}
+}
+
+static bool is_assigned(LitOptimizer* optimizer, const char* name, uint length) {
+	return find_name(&optimizer->assignments, name, length);
+}
+
+/*
+ * Returns the expression, that the function returns, if its body consists only of the return statement,
+ * and it has no default or vararg parameters
+ */
+static LitExpression* get_inline_body(LitFunctionStatement* function) {
+	LitStatement* body = function->body;
+
+	if (body != NULL && body->type == BLOCK_STATEMENT) {
+		LitStatements* statements = &((LitBlockStatement*) body)->statements;
+		body = statements->count == 1 ? statements->values[0] : NULL;
+	}
+
+	if (body == NULL || body->type != RETURN_STATEMENT) {
+		return NULL;
+	}
+
+	for (uint i = 0; i < function->parameters.count; i++) {
+		LitParameter* parameter = &function->parameters.values[i];
+
+		if (parameter->default_value != NULL || (parameter->length == 3 && memcmp(parameter->name, "...", 3) == 0)) {
+			return NULL;
+		}
+	}
+
+	return ((LitReturnStatement*) body)->expression;
+}
+
+typedef struct {
+	LitParameters* parameters;
+	LitExpressions* args;
+
+	uint size;
+	int last_argument;
+	uint arguments_used;
+
+	bool ran_code;
+	bool conditional;
+} LitInliner;
+
+static int find_parameter(LitParameters* parameters, LitVarExpression* expression) {
+	for (uint i = 0; i < parameters->count; i++) {
+		LitParameter* parameter = &parameters->values[i];
+
+		if (parameter->length == expression->length && memcmp(parameter->name, expression->name, expression->length) == 0) {
+			return (int) i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * A variable argument is read at the call site after the arguments before it and before the ones after it,
+ * so in the body it can be read any amount of times, but only before any code runs, and only once exactly
+ * the arguments before it were evaluated
+ */
+static bool can_read_variable(LitInliner* inliner, int index) {
+	if (inliner->ran_code || index <= inliner->last_argument) {
+		return false;
+	}
+
+	for (int i = inliner->last_argument + 1; i < index; i++) {
+		if (!is_simple_argument(inliner->args->values[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Walks the body in the order of its evaluation. Only parameters can be referenced in it
+ * (anything else could be shadowed at the call site), and the arguments, that are not simple,
+ * have to be evaluated exactly once, in their original order, before any code can run
+ */
+static bool can_inline(LitInliner* inliner, LitExpression* expression) {
+	if (expression == NULL) {
+		return true;
+	}
+
+	if (++inliner->size > inline_threshold) {
+		return false;
+	}
+
+	switch (expression->type) {
+		case LITERAL_EXPRESSION: {
+			return true;
+		}
+
+		case VAR_EXPRESSION: {
+			int index = find_parameter(inliner->parameters, (LitVarExpression*) expression);
+
+			if (index == -1) {
+				return false;
+			}
+
+			LitExpression* argument = inliner->args->values[index];
+
+			if (is_constant_argument(argument)) {
+				return true;
+			}
+
+			if (argument->type == VAR_EXPRESSION) {
+				return can_read_variable(inliner, index);
+			}
+
+			if (inliner->ran_code || inliner->conditional || index <= inliner->last_argument) {
+				return false;
+			}
+
+			inliner->last_argument = index;
+			inliner->arguments_used++;
+
+			return true;
+		}
+
+		case UNARY_EXPRESSION: {
+			if (!can_inline(inliner, ((LitUnaryExpression*) expression)->right)) {
+				return false;
+			}
+
+			break;
+		}
+
+		case BINARY_EXPRESSION: {
+			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+
+			if (expr->ignore_left || !can_inline(inliner, expr->left)) {
+				return false;
+			}
+
+			bool conditional = inliner->conditional;
+			inliner->conditional |= expr->op == LTOKEN_AMPERSAND_AMPERSAND || expr->op == LTOKEN_BAR_BAR || expr->op == LTOKEN_QUESTION_QUESTION;
+
+			bool result = can_inline(inliner, expr->right);
+			inliner->conditional = conditional;
+
+			if (!result) {
+				return false;
+			}
+
+			break;
+		}
+
+		case GET_EXPRESSION: {
+			if (!can_inline(inliner, ((LitGetExpression*) expression)->where)) {
+				return false;
+			}
+
+			break;
+		}
+
+		case SUBSCRIPT_EXPRESSION: {
+			LitSubscriptExpression* expr = (LitSubscriptExpression*) expression;
+
+			if (!can_inline(inliner, expr->array) || !can_inline(inliner, expr->index)) {
+				return false;
+			}
+
+			break;
+		}
+
+		case CALL_EXPRESSION: {
+			LitCallExpression* expr = (LitCallExpression*) expression;
+
+			// Only method calls, the method is looked up after the arguments are evaluated
+			if (expr->callee->type != GET_EXPRESSION || expr->init != NULL || !can_inline(inliner, ((LitGetExpression*) expr->callee)->where)) {
+				return false;
+			}
+
+			inliner->size++;
+
+			for (uint i = 0; i < expr->args.count; i++) {
+				if (!can_inline(inliner, expr->args.values[i])) {
+					return false;
+				}
+			}
+
+			break;
+		}
+
+		case IF_EXPRESSION: {
+			LitIfExpression* expr = (LitIfExpression*) expression;
+
+			if (!can_inline(inliner, expr->condition)) {
+				return false;
+			}
+
+			bool conditional = inliner->conditional;
+			inliner->conditional = true;
+
+			bool result = can_inline(inliner, expr->if_branch) && can_inline(inliner, expr->else_branch);
+			inliner->conditional = conditional;
+
+			return result;
+		}
+
+		default: {
+			return false;
+		}
+	}
+
+	// Operators, getters and methods can be overloaded
+	inliner->ran_code = true;
+	return inliner->size <= inline_threshold;
+}
+
+static LitExpression* clone_expression(LitOptimizer* optimizer, LitInliner* inliner, LitExpression* expression, uint line) {
+	if (expression == NULL) {
+		return NULL;
+	}
+
+	LitState* state = optimizer->state;
+
+	switch (expression->type) {
+		case LITERAL_EXPRESSION: {
+			return (LitExpression*) lit_create_literal_expression(state, line, ((LitLiteralExpression*) expression)->value);
+		}
+
+		case THIS_EXPRESSION: {
+			return (LitExpression*) lit_create_this_expression(state, line);
+		}
+
+		case VAR_EXPRESSION: {
+			LitVarExpression* expr = (LitVarExpression*) expression;
+
+			if (inliner != NULL) {
+				int index = find_parameter(inliner->parameters, expr);
+				LitExpression* argument = inliner->args->values[index];
+
+				if (is_simple_argument(argument)) {
+					return clone_expression(optimizer, NULL, argument, line);
+				}
+
+				// It's used only once, so it can be moved out of the call
+				inliner->args->values[index] = NULL;
+				return argument;
+			}
+
+			return (LitExpression*) lit_create_var_expression(state, line, expr->name, expr->length);
+		}
+
+		case UNARY_EXPRESSION: {
+			LitUnaryExpression* expr = (LitUnaryExpression*) expression;
+			return (LitExpression*) lit_create_unary_expression(state, line, clone_expression(optimizer, inliner, expr->right, line), expr->op);
+		}
+
+		case BINARY_EXPRESSION: {
+			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+			LitExpression* left = clone_expression(optimizer, inliner, expr->left, line);
+
+			return (LitExpression*) lit_create_binary_expression(state, line, left, clone_expression(optimizer, inliner, expr->right, line), expr->op);
+		}
+
+		case GET_EXPRESSION: {
+			LitGetExpression* expr = (LitGetExpression*) expression;
+			return (LitExpression*) lit_create_get_expression(state, line, clone_expression(optimizer, inliner, expr->where, line), expr->name, expr->length, expr->jump != -1, expr->ignore_result);
+		}
+
+		case SUBSCRIPT_EXPRESSION: {
+			LitSubscriptExpression* expr = (LitSubscriptExpression*) expression;
+			LitExpression* array = clone_expression(optimizer, inliner, expr->array, line);
+
+			return (LitExpression*) lit_create_subscript_expression(state, line, array, clone_expression(optimizer, inliner, expr->index, line));
+		}
+
+		case CALL_EXPRESSION: {
+			LitCallExpression* expr = (LitCallExpression*) expression;
+			LitCallExpression* call = lit_create_call_expression(state, line, clone_expression(optimizer, inliner, expr->callee, line));
+
+			for (uint i = 0; i < expr->args.count; i++) {
+				lit_expressions_write(state, &call->args, clone_expression(optimizer, inliner, expr->args.values[i], line));
+			}
+
+			return (LitExpression*) call;
+		}
+
+		case IF_EXPRESSION: {
+			LitIfExpression* expr = (LitIfExpression*) expression;
+
+			LitExpression* condition = clone_expression(optimizer, inliner, expr->condition, line);
+			LitExpression* if_branch = clone_expression(optimizer, inliner, expr->if_branch, line);
+
+			return (LitExpression*) lit_create_if_experssion(state, line, condition, if_branch, clone_expression(optimizer, inliner, expr->else_branch, line));
+		}
+
+		default: {
+			UNREACHABLE
+		}
+	}
+
+	return NULL;
+}
+
+static bool inline_call(LitOptimizer* optimizer, LitExpression** slot) {
+	LitCallExpression* expr = (LitCallExpression*) *slot;
+
+	if (expr->callee->type != VAR_EXPRESSION || expr->init != NULL) {
+		return false;
+	}
+
+	LitVarExpression* callee = (LitVarExpression*) expr->callee;
+	LitVariable* variable = resolve_variable(optimizer, callee->name, callee->length);
+
+	if (variable == NULL || variable->function == NULL || variable->function->parameters.count != expr->args.count) {
+		return false;
+	}
+
+	LitFunctionStatement* function = variable->function;
+	LitExpression* body = get_inline_body(function);
+
+	if (body == NULL) {
+		return false;
+	}
+
+	LitInliner inliner = { &function->parameters, &expr->args, 0, -1, 0, false, false };
 
-static LitVariable* resolve_variable(LitOptimizer* optimizer, const char* name, uint length) {
-	LitVariables* variables = &optimizer->variables;
+	if (!can_inline(&inliner, body)) {
+		return false;
+	}
 
-	for (int i = variables->count - 1; i >= 0; i--) {
-		LitVariable* variable = &variables->values[i];
+	uint complex_arguments = 0;
 
-		if (length == variable->length && memcmp(variable->name, name, length) == 0) {
-			return variable;
+	for (uint i = 0; i < expr->args.count; i++) {
+		if (!is_simple_argument(expr->args.values[i])) {
+			complex_arguments++;
 		}
 	}
 
-	return NULL;
-}
+	// Arguments with side effects can't be dropped
+	if (inliner.arguments_used != complex_arguments) {
+		return false;
+	}
 
-static bool is_empty(LitStatement* statement) {
-	return statement == NULL || (statement->type == BLOCK_STATEMENT && ((LitBlockStatement*) statement)->statements.count == 0);
+	// Functions declared above can still call it, since module privates are hoisted
+	variable->used = true;
+	*slot = clone_expression(optimizer, &inliner, body, expr->expression.line);
+
+	// Now the literals, that were passed in, can be folded
+	optimize_expression(optimizer, slot);
+	return true;
 }
 
-static LitValue evaluate_unary_op(LitValue value, LitTokenType op) {
+static bool is_arithmetic(LitTokenType op) {
 	switch (op) {
-		case LTOKEN_MINUS: {
-			if (IS_NUMBER(value)) {
-				return NUMBER_VALUE(-AS_NUMBER(value));
-			}
+		case LTOKEN_PLUS:
+		case LTOKEN_MINUS:
+		case LTOKEN_STAR:
+		case LTOKEN_SLASH:
+		case LTOKEN_SHARP:
+		case LTOKEN_PERCENT:
+		case LTOKEN_STAR_STAR:
+		case LTOKEN_LESS_LESS:
+		case LTOKEN_GREATER_GREATER:
+		case LTOKEN_BAR:
+		case LTOKEN_AMPERSAND:
+		case LTOKEN_CARET: {
+			return true;
+		}
 
-			break;
+		default: {
+			return false;
 		}
+	}
+}
 
-		case LTOKEN_BANG: {
-			return BOOL_VALUE(lit_is_falsey(value));
+// Expressions, that either give a number or fail, an operator with a number on the left never calls a method
+static bool is_number(LitOptimizer* optimizer, LitExpression* expression) {
+	switch (expression->type) {
+		case LITERAL_EXPRESSION: {
+			return IS_NUMBER(((LitLiteralExpression*) expression)->value);
 		}
 
-		case LTOKEN_TILDE: {
-			if (IS_NUMBER(value)) {
-				return NUMBER_VALUE(~((int) AS_NUMBER(value)));
-			}
+		case VAR_EXPRESSION: {
+			LitVarExpression* expr = (LitVarExpression*) expression;
+			LitVariable* variable = resolve_variable(optimizer, expr->name, expr->length);
 
-			break;
+			return variable != NULL && variable->number;
+		}
+
+		case UNARY_EXPRESSION: {
+			LitTokenType op = ((LitUnaryExpression*) expression)->op;
+			return op == LTOKEN_MINUS || op == LTOKEN_TILDE;
+		}
+
+		case BINARY_EXPRESSION: {
+			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+			return is_arithmetic(expr->op) && is_number(optimizer, expr->left);
 		}
 
 		default: {
-			break;
+			return false;
 		}
 	}
-
-	return NULL_VALUE;
 }
 
-static LitValue evaluate_binary_op(LitValue a, LitValue b, LitTokenType op) {
-	#define BINARY_OP(op) \
-		if (IS_NUMBER(a) && IS_NUMBER(b)) { \
-			return NUMBER_VALUE(AS_NUMBER(a) op AS_NUMBER(b)); \
-	  } \
-		return NULL_VALUE;
-
-	#define BITWISE_OP(op) \
-		if (IS_NUMBER(a) && IS_NUMBER(b)) { \
-			return NUMBER_VALUE((int) AS_NUMBER(a) op (int) AS_NUMBER(b)); \
-	  } \
-		return NULL_VALUE;
+/*
+ * Reads of the variables, that are never assigned, and arithmetic on the numbers, that is made of them,
+ * can't run any user code and give the same value every time. Last is set to the index of the latest
+ * variable, that is read
+ */
+static bool is_invariant(LitOptimizer* optimizer, LitExpression* expression, bool number, int* last) {
+	switch (expression->type) {
+		case LITERAL_EXPRESSION: {
+			return !number || IS_NUMBER(((LitLiteralExpression*) expression)->value);
+		}
 
-	#define FN_OP(fn) \
-		if (IS_NUMBER(a) && IS_NUMBER(b)) { \
-			return NUMBER_VALUE(fn(AS_NUMBER(a), AS_NUMBER(b))); \
-	  } \
-		return NULL_VALUE;
+		case VAR_EXPRESSION: {
+			LitVarExpression* expr = (LitVarExpression*) expression;
+			LitVariable* variable = resolve_variable(optimizer, expr->name, expr->length);
 
-	switch (op) {
-		case LTOKEN_PLUS: BINARY_OP(+)
-		case LTOKEN_MINUS: BINARY_OP(-)
-		case LTOKEN_STAR: BINARY_OP(*)
-		case LTOKEN_SLASH: BINARY_OP(/)
-		case LTOKEN_STAR_STAR: FN_OP(pow)
-		case LTOKEN_PERCENT: FN_OP(fmod)
+			if (variable == NULL || (number && !variable->number) || is_assigned(optimizer, expr->name, expr->length)) {
+				return false;
+			}
 
-		case LTOKEN_GREATER: BINARY_OP(>)
-		case LTOKEN_GREATER_EQUAL: BINARY_OP(>=)
-		case LTOKEN_LESS: BINARY_OP(<)
-		case LTOKEN_LESS_EQUAL: BINARY_OP(<=)
-		case LTOKEN_LESS_LESS: BITWISE_OP(<<)
-		case LTOKEN_GREATER_GREATER: BITWISE_OP(>>)
-		case LTOKEN_BAR: BITWISE_OP(|)
-		case LTOKEN_AMPERSAND: BITWISE_OP(&)
-		case LTOKEN_CARET: BITWISE_OP(^)
+			int index = (int) (variable - optimizer->variables.values);
 
-		case LTOKEN_SHARP: {
-			if (IS_NUMBER(a) && IS_NUMBER(b)) {
-				return NUMBER_VALUE(floor(AS_NUMBER(a) / AS_NUMBER(b)));
-		  }
+			if (index > *last) {
+				*last = index;
+			}
 
-			return NULL_VALUE;
+			return true;
 		}
 
-		case LTOKEN_EQUAL_EQUAL: {
-			return BOOL_VALUE(a == b);
+		case UNARY_EXPRESSION: {
+			LitUnaryExpression* expr = (LitUnaryExpression*) expression;
+			return (expr->op == LTOKEN_MINUS || expr->op == LTOKEN_TILDE) && is_invariant(optimizer, expr->right, true, last);
 		}
 
-		case LTOKEN_BANG_EQUAL: {
-			return BOOL_VALUE(a != b);
+		case BINARY_EXPRESSION: {
+			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
+
+			return is_arithmetic(expr->op) && is_invariant(optimizer, expr->left, true, last)
+				&& (expr->right == NULL || is_invariant(optimizer, expr->right, true, last));
 		}
 
-		case LTOKEN_IS:
 		default: {
-			break;
+			return false;
 		}
 	}
-
-	#undef FN_OP
-	#undef BITWISE_OP
-	#undef BINARY_OP
-
-	return NULL_VALUE;
 }
 
-static LitValue attempt_to_optimize_binary(LitOptimizer* optimizer, LitBinaryExpression* expression, LitValue value, bool left) {
-	LitTokenType op = expression->op;
-	LitExpression* branch = left ? expression->left : expression->right;
+// Declares the value in front of the outermost loop, that doesn't declare any of the variables, that it reads
+static bool hoist_expression(LitOptimizer* optimizer, LitExpression** slot, int last) {
+	LitLoop* target = NULL;
 
-	if (IS_NUMBER(value)) {
-		double number = AS_NUMBER(value);
+	for (LitLoop* loop = optimizer->loop; loop != NULL && (int) loop->variables > last; loop = loop->enclosing) {
+		target = loop;
+	}
 
-		if (op == LTOKEN_STAR) {
-			if (number == 0) {
-				return NUMBER_VALUE(0);
-			} else if (number == 1) {
-				lit_free_expression(optimizer->state, left ? expression->right : expression->left);
+	if (target == NULL || target->hoisted.count >= MAX_HOISTED) {
+		return false;
+	}
 
-				expression->left = branch;
-				expression->right = NULL;
-			}
-		} else if ((op == LTOKEN_PLUS || op == LTOKEN_MINUS) && number == 0) {
-			lit_free_expression(optimizer->state, left ? expression->right : expression->left);
+	LitState* state = optimizer->state;
+	LitExpression* expression = *slot;
 
-			expression->left = branch;
-			expression->right = NULL;
-		} else if (((left && op == LTOKEN_SLASH) || op == LTOKEN_STAR_STAR) && number == 1) {
-			lit_free_expression(optimizer->state, left ? expression->right : expression->left);
+	// The space makes sure, that it can't clash with any user variable
+	LitString* name = AS_STRING(lit_string_format(state, "invariant #", (double) optimizer->invariant_count++));
 
-			expression->left = branch;
-			expression->right = NULL;
-		}
-	}
+	lit_stataments_write(state, &target->hoisted, (LitStatement*) lit_create_var_statement(state, expression->line, name->chars, name->length, expression, false));
+	*slot = (LitExpression*) lit_create_var_expression(state, expression->line, name->chars, name->length);
 
-	return NULL_VALUE;
+	return true;
 }
 
-static LitValue evaluate_expression(LitOptimizer* optimizer, LitExpression* expression) {
+// Moves the biggest invariant parts of the expression out of the loops
+static void hoist_invariants(LitOptimizer* optimizer, LitExpression** slot) {
+	LitExpression* expression = *slot;
+
 	if (expression == NULL) {
-		return NULL_VALUE;
+		return;
 	}
 
-	switch (expression->type) {
-		case LITERAL_EXPRESSION: {
-			return ((LitLiteralExpression*) expression)->value;
+	int last = -1;
+
+	if (is_invariant(optimizer, expression, false, &last)) {
+		if (expression->type == LITERAL_EXPRESSION) {
+			return;
 		}
 
-		case UNARY_EXPRESSION: {
-			LitUnaryExpression* expr = (LitUnaryExpression*) expression;
-			LitValue branch = evaluate_expression(optimizer, expr->right);
+		// Locals are in the registers already, only the module privates and upvalues need loading
+		if (expression->type == VAR_EXPRESSION && optimizer->variables.values[last].depth > 0 && last >= (int) optimizer->function_start) {
+			return;
+		}
 
-			if (branch != NULL_VALUE) {
-				return evaluate_unary_op(branch, expr->op);
-			}
+		hoist_expression(optimizer, slot, last);
+		return;
+	}
 
+	switch (expression->type) {
+		case UNARY_EXPRESSION: {
+			hoist_invariants(optimizer, &((LitUnaryExpression*) expression)->right);
 			break;
 		}
 
 		case BINARY_EXPRESSION: {
 			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
 
-			LitValue a = evaluate_expression(optimizer, expr->left);
-			LitValue b = evaluate_expression(optimizer, expr->right);
-
-			if (a != NULL_VALUE && b != NULL_VALUE) {
-				return evaluate_binary_op(a, b, expr->op);
-			} else if (a != NULL_VALUE) {
-				return attempt_to_optimize_binary(optimizer, expr, a, false);
-			} else if (b != NULL_VALUE) {
-				return attempt_to_optimize_binary(optimizer, expr, b, true);
+			// The left side of a compound assignment is also its target
+			if (!expr->ignore_left) {
+				hoist_invariants(optimizer, &expr->left);
 			}
 
+			hoist_invariants(optimizer, &expr->right);
 			break;
 		}
 
 		default: {
-			return NULL_VALUE;
+			break;
 		}
 	}
+}
 
-	return NULL_VALUE;
+static void begin_loop(LitOptimizer* optimizer, LitLoop* loop, uint variables) {
+	loop->enclosing = optimizer->loop;
+	loop->variables = variables;
+	lit_init_stataments(&loop->hoisted);
+
+	if (lit_is_optimization_enabled(OPTIMIZATION_LOOP_INVARIANT)) {
+		optimizer->loop = loop;
+	}
+}
+
+// Wraps the loop into a block, that declares the hoisted values first
+static void end_loop(LitOptimizer* optimizer, LitLoop* loop, LitStatement** slot) {
+	LitState* state = optimizer->state;
+	optimizer->loop = loop->enclosing;
+
+	if (loop->hoisted.count > 0 && *slot != NULL) {
+		LitBlockStatement* block = lit_create_block_statement(state, (*slot)->line);
+
+		for (uint i = 0; i < loop->hoisted.count; i++) {
+			lit_stataments_write(state, &block->statements, loop->hoisted.values[i]);
+		}
+
+		lit_stataments_write(state, &block->statements, *slot);
+		*slot = (LitStatement*) block;
+	}
+}
+
+// The loops of the enclosing function can't take expressions out of a nested one
+static void begin_function(LitOptimizer* optimizer, LitLoop** loop, uint* function_start) {
+	*loop = optimizer->loop;
+	*function_start = optimizer->function_start;
+
+	optimizer->loop = NULL;
+	optimizer->function_start = optimizer->variables.count;
+}
+
+static void end_function(LitOptimizer* optimizer, LitLoop* loop, uint function_start) {
+	optimizer->loop = loop;
+	optimizer->function_start = function_start;
+}
+
+// Operands, callees and assignment targets stay, where they are, only the whole expression can be hoisted
+static void optimize_in_place(LitOptimizer* optimizer, LitExpression** slot) {
+	optimizer->keep_in_place = true;
+	optimize_expression(optimizer, slot);
 }
 
 static void optimize_expression(LitOptimizer* optimizer, LitExpression** slot) {
 	LitExpression* expression = *slot;
 
+	// Only applies to this expression, not to its children
+	bool hoist = optimizer->loop != NULL && !optimizer->keep_in_place;
+	optimizer->keep_in_place = false;
+
 	if (expression == NULL) {
 		return;
 	}
@@ -289,27 +1183,18 @@ static void optimize_expression(LitOptimizer* optimizer, LitExpression** slot) {
 	switch (expression->type) {
 		case UNARY_EXPRESSION:
 		case BINARY_EXPRESSION: {
-			if (lit_is_optimization_enabled(OPTIMIZATION_LITERAL_FOLDING)) {
-				LitValue optimized = evaluate_expression(optimizer, expression);
-
-				if (optimized != NULL_VALUE) {
-					*slot = (LitExpression*) lit_create_literal_expression(state, expression->line, optimized);
-					lit_free_expression(state, expression);
-					break;
-				}
-			}
-
+			// The operands go first, so that the propagated variables can be folded too
 			switch (expression->type) {
 				case UNARY_EXPRESSION: {
-					optimize_expression(optimizer, &((LitUnaryExpression*) expression)->right);
+					optimize_in_place(optimizer, &((LitUnaryExpression*) expression)->right);
 					break;
 				}
 
 				case BINARY_EXPRESSION: {
 					LitBinaryExpression* expr = (LitBinaryExpression*) expression;
 
-					optimize_expression(optimizer, &expr->left);
-					optimize_expression(optimizer, &expr->right);
+					optimize_in_place(optimizer, &expr->left);
+					optimize_in_place(optimizer, &expr->right);
 
 					break;
 				}
@@ -319,13 +1204,25 @@ static void optimize_expression(LitOptimizer* optimizer, LitExpression** slot) {
 				}
 			}
 
+			if (lit_is_optimization_enabled(OPTIMIZATION_LITERAL_FOLDING)) {
+				LitValue optimized = evaluate_expression(optimizer, expression);
+
+				if (optimized != NULL_VALUE) {
+					*slot = (LitExpression*) lit_create_literal_expression(state, expression->line, optimized);
+				}
+			}
+
+			if (hoist) {
+				hoist_invariants(optimizer, slot);
+			}
+
 			break;
 		}
 
 		case ASSIGN_EXPRESSION: {
 			LitAssignExpression* expr = (LitAssignExpression*) expression;
 
-			optimize_expression(optimizer, &expr->to);
+			optimize_in_place(optimizer, &expr->to);
 			optimize_expression(optimizer, &expr->value);
 
 			break;
@@ -333,10 +1230,13 @@ static void optimize_expression(LitOptimizer* optimizer, LitExpression** slot) {
 
 		case CALL_EXPRESSION: {
 			LitCallExpression* expr = (LitCallExpression*) expression;
-
-			optimize_expression(optimizer, &expr->callee);
 			optimize_expressions(optimizer, &expr->args);
 
+			if (lit_is_optimization_enabled(OPTIMIZATION_INLINE) && inline_call(optimizer, slot)) {
+				break;
+			}
+
+			optimize_in_place(optimizer, &expr->callee);
 			break;
 		}
 
@@ -355,9 +1255,17 @@ static void optimize_expression(LitOptimizer* optimizer, LitExpression** slot) {
 		}
 
 		case LAMBDA_EXPRESSION: {
+			LitLambdaExpression* expr = (LitLambdaExpression*) expression;
+
+			LitLoop* loop;
+			uint function_start;
+
+			begin_function(optimizer, &loop, &function_start);
 			begin_scope(optimizer);
-			optimize_statement(optimizer, &((LitLambdaExpression*) expression)->body);
+			add_parameters(optimizer, &expr->parameters);
+			optimize_statement(optimizer, &expr->body);
 			end_scope(optimizer);
+			end_function(optimizer, loop, function_start);
 
 			break;
 		}
@@ -392,19 +1300,18 @@ static void optimize_expression(LitOptimizer* optimizer, LitExpression** slot) {
 
 		case IF_EXPRESSION: {
 			LitIfExpression* expr = (LitIfExpression*) expression;
+
+			optimize_expression(optimizer, &expr->condition);
 			LitValue optimized = evaluate_expression(optimizer, expr->condition);
 
 			if (optimized != NULL_VALUE) {
 				if (lit_is_falsey(optimized)) {
 					*slot = expr->else_branch;
-					expr->else_branch = NULL; // So that it doesn't get freed
 				} else {
 					*slot = expr->if_branch;
-					expr->if_branch = NULL; // So that it doesn't get freed
 				}
 
 				optimize_expression(optimizer, slot);
-				lit_free_expression(state, expression);
 			} else {
 				optimize_expression(optimizer, &expr->if_branch);
 				optimize_expression(optimizer, &expr->else_branch);
@@ -422,14 +1329,22 @@ static void optimize_expression(LitOptimizer* optimizer, LitExpression** slot) {
 			LitVarExpression* expr = (LitVarExpression*) expression;
 			LitVariable* variable = resolve_variable(optimizer, expr->name, expr->length);
 
-			if (variable != NULL) {
-				variable->used = true;
+			if (variable == NULL) {
+				// Could be a module private, that is declared further down
+				add_name(optimizer, &optimizer->unresolved, expression);
+			} else {
+				// Locals with all their reads replaced can be removed, but module privates
+				// still can be read by the functions declared above them
+				if (variable->constant || variable->constant_value == NULL_VALUE || variable->depth == 0) {
+					variable->used = true;
+				}
 
 				// Not checking here for the enable-ness of constant-folding, since if its off
 				// the constant_value would be NULL_VALUE anyway (:thinkaboutit:)
-				if (variable->constant && variable->constant_value != NULL_VALUE) {
+				if (variable->constant_value != NULL_VALUE) {
 					*slot = (LitExpression*) lit_create_literal_expression(state, expression->line, variable->constant_value);
-					lit_free_expression(state, expression);
+				} else if (hoist) {
+					hoist_invariants(optimizer, slot);
 				}
 			}
 
@@ -437,7 +1352,7 @@ static void optimize_expression(LitOptimizer* optimizer, LitExpression** slot) {
 		}
 
 		case REFERENCE_EXPRESSION: {
-			optimize_expression(optimizer, &((LitReferenceExpression*) expression)->to);
+			optimize_in_place(optimizer, &((LitReferenceExpression*) expression)->to);
 			break;
 		}
 
@@ -475,7 +1390,6 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 			LitBlockStatement* stmt = (LitBlockStatement*) statement;
 
 			if (stmt->statements.count == 0) {
-				lit_free_statement(state, statement);
 				*slot = NULL;
 
 				break;
@@ -495,15 +1409,6 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 
 					if (step->type == RETURN_STATEMENT) {
 						// Remove all the statements post return
-						for (uint j = i + 1; j < stmt->statements.count; j++) {
-							step = stmt->statements.values[j];
-
-							if (step != NULL) {
-								lit_free_statement(state, step);
-								stmt->statements.values[j] = NULL;
-							}
-						}
-
 						stmt->statements.count = i + 1;
 						break;
 					}
@@ -511,7 +1416,6 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 			}
 
 			if (!found && lit_is_optimization_enabled(OPTIMIZATION_EMPTY_BODY)) {
-				lit_free_statement(optimizer->state, statement);
 				*slot = NULL;
 			}
 
@@ -524,16 +1428,25 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 			optimize_expression(optimizer, &stmt->condition);
 			optimize_statement(optimizer, &stmt->if_branch);
 
+			if (lit_is_optimization_enabled(OPTIMIZATION_UNREACHABLE_CODE) && (stmt->if_branch == NULL
+				|| (stmt->if_branch->type != VAR_STATEMENT && stmt->if_branch->type != FUNCTION_STATEMENT))) {
+
+				LitValue optimized = evaluate_expression(optimizer, stmt->condition);
+
+				// The other branches will never be reached
+				if (optimized != NULL_VALUE && !lit_is_falsey(optimized)) {
+					*slot = stmt->if_branch;
+					break;
+				}
+			}
+
 			bool empty = lit_is_optimization_enabled(OPTIMIZATION_EMPTY_BODY);
 			bool dead = lit_is_optimization_enabled(OPTIMIZATION_UNREACHABLE_CODE);
 
 			LitValue optimized = empty ? evaluate_expression(optimizer, stmt->condition) : NULL_VALUE;
 
 			if ((optimized != NULL_VALUE && lit_is_falsey(optimized)) || (dead && is_empty(stmt->if_branch))) {
-				lit_free_expression(state, stmt->condition);
 				stmt->condition = NULL;
-
-				lit_free_statement(state, stmt->if_branch);
 				stmt->if_branch = NULL;
 			}
 
@@ -544,10 +1457,7 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 				if (dead || empty) {
 					for (uint i = 0; i < stmt->elseif_conditions->count; i++) {
 						if (empty && is_empty(stmt->elseif_branches->values[i])) {
-							lit_free_expression(state, stmt->elseif_conditions->values[i]);
 							stmt->elseif_conditions->values[i] = NULL;
-
-							lit_free_statement(state, stmt->elseif_branches->values[i]);
 							stmt->elseif_branches->values[i] = NULL;
 
 							continue;
@@ -557,10 +1467,7 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 							LitValue value = evaluate_expression(optimizer, stmt->elseif_conditions->values[i]);
 
 							if (value != NULL_VALUE && lit_is_falsey(value)) {
-								lit_free_expression(state, stmt->elseif_conditions->values[i]);
 								stmt->elseif_conditions->values[i] = NULL;
-
-								lit_free_statement(state, stmt->elseif_branches->values[i]);
 								stmt->elseif_branches->values[i] = NULL;
 							}
 						}
@@ -574,30 +1481,36 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 
 		case WHILE_STATEMENT: {
 			LitWhileStatement* stmt = (LitWhileStatement*) statement;
+			LitLoop loop;
+
+			begin_loop(optimizer, &loop, optimizer->variables.count);
 			optimize_expression(optimizer, &stmt->condition);
 
 			if (lit_is_optimization_enabled(OPTIMIZATION_UNREACHABLE_CODE)) {
 				LitValue optimized = evaluate_expression(optimizer, stmt->condition);
 
 				if (optimized != NULL_VALUE && lit_is_falsey(optimized)) {
-					lit_free_statement(optimizer->state, statement);
 					*slot = NULL;
-					break;
 				}
 			}
 
-			optimize_statement(optimizer, &stmt->body);
+			if (*slot != NULL) {
+				optimize_statement(optimizer, &stmt->body);
 
-			if (lit_is_optimization_enabled(OPTIMIZATION_EMPTY_BODY) && is_empty(stmt->body)) {
-				lit_free_statement(optimizer->state, statement);
-				*slot = NULL;
+				if (lit_is_optimization_enabled(OPTIMIZATION_EMPTY_BODY) && is_empty(stmt->body)) {
+					*slot = NULL;
+				}
 			}
 
+			end_loop(optimizer, &loop, slot);
 			break;
 		}
 
 		case FOR_STATEMENT: {
 			LitForStatement* stmt = (LitForStatement*) statement;
+			// The loop variable is declared inside of the loop, since it changes every iteration
+			uint variables = optimizer->variables.count;
+			LitLoop loop;
 
 			begin_scope(optimizer);
 			// This is required, so that optimizer doesn't optimize out our i variable (and such)
@@ -610,17 +1523,17 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 			optimize_statement(optimizer, &stmt->var);
 			optimizer->mark_used = false;
 
+			begin_loop(optimizer, &loop, variables);
 			optimize_statement(optimizer, &stmt->body);
 			end_scope(optimizer);
 
 			if (lit_is_optimization_enabled(OPTIMIZATION_EMPTY_BODY) && is_empty(stmt->body)) {
-				lit_free_statement(optimizer->state, statement);
 				*slot = NULL;
-
-				break;
 			}
 
-			if (stmt->c_style || !lit_is_optimization_enabled(OPTIMIZATION_C_FOR) || stmt->condition->type != RANGE_EXPRESSION) {
+			end_loop(optimizer, &loop, slot);
+
+			if (*slot == NULL || stmt->c_style || !lit_is_optimization_enabled(OPTIMIZATION_C_FOR) || stmt->condition->type != RANGE_EXPRESSION) {
 				break;
 			}
 
@@ -640,40 +1553,45 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 			// var i = from
 			var->init = range->from;
 
-			// i <= to
-			stmt->condition = (LitExpression*) lit_create_binary_expression(state, line, (LitExpression*) lit_create_var_expression(state, line, var->name, var->length), range->to, LTOKEN_LESS_EQUAL);
+			// i <= to (or i >= to)
+			stmt->condition = (LitExpression*) lit_create_binary_expression(state, line, (LitExpression*) lit_create_var_expression(state, line, var->name, var->length), range->to, reverse ? LTOKEN_GREATER_EQUAL : LTOKEN_LESS_EQUAL);
 
 			// i++ (or i--)
 			LitExpression* var_get = (LitExpression*) lit_create_var_expression(state, line, var->name, var->length);
-			LitBinaryExpression* assign_value = lit_create_binary_expression(state, line, var_get, (LitExpression*) lit_create_literal_expression(state, line, NUMBER_VALUE(1)), reverse ? LTOKEN_MINUS_MINUS : LTOKEN_PLUS);
+			LitBinaryExpression* assign_value = lit_create_binary_expression(state, line, var_get, (LitExpression*) lit_create_literal_expression(state, line, NUMBER_VALUE(1)), reverse ? LTOKEN_MINUS : LTOKEN_PLUS);
 			assign_value->ignore_left = true;
 
 			LitExpression* increment = (LitExpression*) lit_create_assign_expression(state, line, var_get, (LitExpression*) assign_value);
 			stmt->increment = (LitExpression*) increment;
 
-			range->from = NULL;
-			range->to = NULL;
-
 			stmt->c_style = true;
-			lit_free_expression(state, (LitExpression*) range);
 
 			break;
 		}
 
 		case VAR_STATEMENT: {
 			LitVarStatement* stmt = (LitVarStatement*) statement;
-			LitVariable* variable = add_variable(optimizer, stmt->name, stmt->length, stmt->constant, slot);
 
+			add_variable(optimizer, stmt->name, stmt->length, stmt->constant, slot);
+			uint index = optimizer->variables.count - 1;
+
+			// Lambdas in the init can grow the variables array
 			optimize_expression(optimizer, &stmt->init);
 
-			if (stmt->constant && lit_is_optimization_enabled(OPTIMIZATION_CONSTANT_FOLDING)) {
+			bool propagate = !stmt->constant && lit_is_optimization_enabled(OPTIMIZATION_CONSTANT_PROPAGATION) && !is_assigned(optimizer, stmt->name, stmt->length);
+
+			if ((stmt->constant && lit_is_optimization_enabled(OPTIMIZATION_CONSTANT_FOLDING)) || propagate) {
 				LitValue value = evaluate_expression(optimizer, stmt->init);
 
 				if (value != NULL_VALUE) {
-					variable->constant_value = value;
+					optimizer->variables.values[index].constant_value = value;
 				}
 			}
 
+			if (lit_is_optimization_enabled(OPTIMIZATION_LOOP_INVARIANT) && stmt->init != NULL && !is_assigned(optimizer, stmt->name, stmt->length)) {
+				optimizer->variables.values[index].number = is_number(optimizer, stmt->init);
+			}
+
 			break;
 		}
 
@@ -686,9 +1604,24 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 				variable->used = true;
 			}
 
+			uint index = optimizer->variables.count - 1;
+
+			LitLoop* loop;
+			uint function_start;
+
+			begin_function(optimizer, &loop, &function_start);
 			begin_scope(optimizer);
+			add_parameters(optimizer, &stmt->parameters);
 			optimize_statement(optimizer, &stmt->body);
 			end_scope(optimizer);
+			end_function(optimizer, loop, function_start);
+
+			// Exported functions can be changed by other modules
+			if (optimizer->depth == 0 && !stmt->exported && lit_is_optimization_enabled(OPTIMIZATION_INLINE) && get_inline_body(stmt) != NULL
+				&& !is_assigned(optimizer, stmt->name, stmt->length)) {
+
+				optimizer->variables.values[index].function = stmt;
+			}
 
 			break;
 		}
@@ -699,9 +1632,17 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 		}
 
 		case METHOD_STATEMENT: {
+			LitMethodStatement* stmt = (LitMethodStatement*) statement;
+
+			LitLoop* loop;
+			uint function_start;
+
+			begin_function(optimizer, &loop, &function_start);
 			begin_scope(optimizer);
-			optimize_statement(optimizer, &((LitMethodStatement*) statement)->body);
+			add_parameters(optimizer, &stmt->parameters);
+			optimize_statement(optimizer, &stmt->body);
 			end_scope(optimizer);
+			end_function(optimizer, loop, function_start);
 
 			break;
 		}
@@ -714,6 +1655,11 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 		case FIELD_STATEMENT: {
 			LitFieldStatement* stmt = (LitFieldStatement*) statement;
 
+			LitLoop* loop;
+			uint function_start;
+
+			begin_function(optimizer, &loop, &function_start);
+
 			if (stmt->getter != NULL) {
 				begin_scope(optimizer);
 				optimize_statement(optimizer, &stmt->getter);
@@ -722,10 +1668,13 @@ static void optimize_statement(LitOptimizer* optimizer, LitStatement** slot) {
 
 			if (stmt->setter != NULL) {
 				begin_scope(optimizer);
+				add_variable(optimizer, "value", 5, false, NULL)->used = true;
 				optimize_statement(optimizer, &stmt->setter);
 				end_scope(optimizer);
 			}
 
+			end_function(optimizer, loop, function_start);
+
 			break;
 		}
 
@@ -752,11 +1701,18 @@ void lit_optimize(LitOptimizer* optimizer, LitStatements* statements) {
 		return;
 	}
 
+	if (lit_is_optimization_enabled(OPTIMIZATION_INLINE) || lit_is_optimization_enabled(OPTIMIZATION_CONSTANT_PROPAGATION)
+		|| lit_is_optimization_enabled(OPTIMIZATION_LOOP_INVARIANT)) {
+		collect_statements_assignments(optimizer, statements);
+	}
+
 	begin_scope(optimizer);
 	optimize_statements(optimizer, statements);
 	end_scope(optimizer);
 
 	lit_free_variables(optimizer->state, &optimizer->variables);
+	lit_free_names(optimizer->state, &optimizer->assignments);
+	lit_free_names(optimizer->state, &optimizer->unresolved);
 }
 
 static void setup_optimization_states() {
@@ -801,6 +1757,10 @@ void lit_set_all_optimization_enabled(bool enabled) {
 }
 
 void lit_set_optimization_level(LitOptimizationLevel level) {
+	if (level < OPTIMIZATION_LEVEL_TOTAL) {
+		inline_threshold = inline_thresholds[(int) level];
+	}
+
 	switch (level) {
 		case OPTIMIZATION_LEVEL_NONE: {
 			lit_set_all_optimization_enabled(false);
@@ -815,6 +1775,10 @@ void lit_set_optimization_level(LitOptimizationLevel level) {
 			lit_set_optimization_enabled(OPTIMIZATION_EMPTY_BODY, false);
 			lit_set_optimization_enabled(OPTIMIZATION_LINE_INFO, false);
 			lit_set_optimization_enabled(OPTIMIZATION_PRIVATE_NAMES, false);
+			// Functions can be redefined by the lines, that come later
+			lit_set_optimization_enabled(OPTIMIZATION_INLINE, false);
+			lit_set_optimization_enabled(OPTIMIZATION_CONSTANT_PROPAGATION, false);
+			lit_set_optimization_enabled(OPTIMIZATION_LOOP_INVARIANT, false);
 
 			break;
 		}
@@ -0,0 +1,969 @@
+#include "lit/optimizer/lit_peephole.h"
+#include "lit/optimizer/lit_optimizer.h"
+#include "lit/vm/lit_object.h"
+#include "lit/vm/lit_instruction.h"
+#include "lit/mem/lit_mem.h"
+
+#include <string.h>
+#include <math.h>
+
+#define MAX_ROUNDS 8
+#define MAX_JUMP_CHAIN 16
+
+/*
+ * Works on a single chunk at a time: the chunk is split by its jumps, register liveness is
+ * computed over that graph, and then the following rewrites are applied until nothing changes:
+ *
+ * - jumps to jumps go straight to the final target, jumps to the next instruction are removed
+ * - instructions, that can't be reached, are removed
+ * - MOVE T, S followed by an instruction, that reads T for the last time, reads S directly
+ * - an instruction, that writes T, followed by MOVE L, T writes L directly
+ * - loads into registers, that are never read afterwards, are removed
+ *
+ * Before that, arithmetic by constants is strength reduced (if enabled): ** 2 becomes a multiplication,
+ * and division, floor division and modulo by powers of two get instructions, that avoid the division.
+ *
+ * Registers, that are captured by closures or references, are considered to be always live,
+ * since they can be read from outside of the chunk.
+ */
+
+typedef struct {
+	uint64_t bits[4];
+} LitRegisterSet;
+
+typedef struct {
+	LitState* state;
+	LitChunk* chunk;
+	LitRegisterSet escaped;
+
+	// Reached by anything but falling through from the previous instruction
+	bool* target;
+	bool* reachable;
+	bool* removed;
+
+	// Registers, that are live right after the instruction
+	LitRegisterSet* live;
+} LitPeephole;
+
+static inline void set_add(LitRegisterSet* set, uint reg) {
+	set->bits[(reg >> 6) & 3] |= 1ull << (reg & 63);
+}
+
+static inline void set_add_rc(LitRegisterSet* set, uint16_t rc) {
+	if (!IS_BIT_SET(rc, 8)) {
+		set_add(set, rc);
+	}
+}
+
+static inline void set_add_all(LitRegisterSet* set) {
+	memset(set, 0xff, sizeof(LitRegisterSet));
+}
+
+static inline bool set_has(LitRegisterSet* set, uint reg) {
+	return (set->bits[(reg >> 6) & 3] & (1ull << (reg & 63))) != 0;
+}
+
+static inline bool set_has_above(LitRegisterSet* set, uint reg) {
+	for (uint i = reg + 1; i <= LIT_REGISTERS_MAX; i++) {
+		if (set_has(set, i)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static inline bool set_merge(LitRegisterSet* set, LitRegisterSet* other) {
+	bool changed = false;
+
+	for (uint i = 0; i < 4; i++) {
+		uint64_t bits = set->bits[i] | other->bits[i];
+
+		changed |= bits != set->bits[i];
+		set->bits[i] = bits;
+	}
+
+	return changed;
+}
+
+static bool is_comparison_jump(uint8_t opcode) {
+	return opcode >= OP_EQUAL_JUMP && opcode <= OP_GREATER_EQUAL_JUMP;
+}
+
+static bool is_conditional_jump(uint8_t opcode) {
+	return opcode == OP_TRUE_JUMP || opcode == OP_FALSE_JUMP || opcode == OP_NULL_JUMP || opcode == OP_NON_NULL_JUMP;
+}
+
+// Instructions, that read RC(B) and RC(C) and store the result in R(A)
+static bool is_binary(uint8_t opcode) {
+	return (opcode >= OP_ADD && opcode <= OP_BOR) || (opcode >= OP_EQUAL && opcode <= OP_GREATER_EQUAL)
+		|| (opcode >= OP_ADD_NUM && opcode <= OP_GREATER_EQUAL_NUM) || (opcode >= OP_SQUARE && opcode <= OP_MOD_POWER_OF_TWO);
+}
+
+// B and C with the constant flag on whichever of them has the K bit
+static inline void get_bc(uint32_t instruction, uint16_t* b, uint16_t* c) {
+	if (lit_get_instruction_type(LIT_INSTRUCTION_OPCODE(instruction)) == LIT_INSTRUCTION_ABCK) {
+		*b = LIT_INSTRUCTION_B(instruction);
+		*c = LIT_INSTRUCTION_CK(instruction);
+	} else {
+		*b = LIT_INSTRUCTION_BK(instruction);
+		*c = LIT_INSTRUCTION_C(instruction);
+	}
+}
+
+// Registers, that the instruction reads, and the register, that it always overwrites (or -1)
+static void get_registers(uint32_t instruction, LitRegisterSet* uses, int* def) {
+	uint8_t opcode = LIT_INSTRUCTION_OPCODE(instruction);
+	uint8_t a = LIT_INSTRUCTION_A(instruction);
+	uint16_t b;
+	uint16_t c;
+
+	get_bc(instruction, &b, &c);
+
+	memset(uses, 0, sizeof(LitRegisterSet));
+	*def = -1;
+
+	if (is_binary(opcode) || opcode == OP_RANGE) {
+		set_add_rc(uses, b);
+		set_add_rc(uses, c);
+		*def = a;
+
+		return;
+	}
+
+	switch (opcode) {
+		case OP_MOVE:
+		case OP_NEGATE:
+		case OP_BNOT:
+		case OP_IS: {
+			set_add_rc(uses, b);
+			*def = a;
+
+			break;
+		}
+
+		// The operator method leaves its result in B, so A is not always written
+		case OP_NOT: {
+			set_add_rc(uses, b);
+			break;
+		}
+
+		case OP_LOAD_NULL:
+		case OP_LOAD_BOOL:
+		case OP_CLOSURE:
+		case OP_ARRAY:
+		case OP_OBJECT:
+		case OP_GET_GLOBAL:
+		case OP_GET_GLOBAL_SLOT:
+		case OP_GET_UPVALUE:
+		case OP_GET_PRIVATE:
+		case OP_GET_PARENT_LOCAL:
+		case OP_REFERENCE_GLOBAL:
+		case OP_REFERENCE_PRIVATE:
+		case OP_REFERENCE_UPVALUE:
+		case OP_REFERENCE_LOCAL: {
+			*def = a;
+			break;
+		}
+
+		// Without two numbers, the generic comparison stores the result in A for the FALSE_JUMP
+		case OP_EQUAL_JUMP:
+		case OP_LESS_JUMP:
+		case OP_LESS_EQUAL_JUMP:
+		case OP_GREATER_JUMP:
+		case OP_GREATER_EQUAL_JUMP: {
+			set_add_rc(uses, b);
+			set_add_rc(uses, c);
+
+			break;
+		}
+
+		case OP_ADD_CONSTANT:
+		case OP_SUBTRACT_CONSTANT:
+		case OP_GET_FIELD:
+		case OP_REFERENCE_FIELD: {
+			set_add(uses, b);
+			*def = a;
+
+			break;
+		}
+
+		case OP_INCREMENT_LOCAL: {
+			set_add(uses, a);
+			*def = a;
+
+			break;
+		}
+
+		case OP_RETURN:
+		case OP_TRUE_JUMP:
+		case OP_FALSE_JUMP:
+		case OP_NULL_JUMP:
+		case OP_NON_NULL_JUMP:
+		case OP_CLOSE_UPVALUE: {
+			set_add(uses, a);
+			break;
+		}
+
+		case OP_JUMP: {
+			break;
+		}
+
+		case OP_SET_GLOBAL:
+		case OP_SET_GLOBAL_SLOT:
+		case OP_SET_UPVALUE:
+		case OP_SET_PARENT_LOCAL: {
+			set_add_rc(uses, b);
+			break;
+		}
+
+		case OP_SET_PRIVATE: {
+			if (!IS_BIT_SET(LIT_INSTRUCTION_BX(instruction), 16)) {
+				set_add(uses, a);
+			}
+
+			break;
+		}
+
+		case OP_CALL:
+		case OP_INVOKE:
+		case OP_INVOKE_BORROWED:
+		case OP_TAIL_CALL: {
+			for (uint i = 0; i < b; i++) {
+				set_add(uses, a + i);
+			}
+
+			if (opcode != OP_TAIL_CALL) {
+				*def = a;
+			}
+
+			break;
+		}
+
+		case OP_STATIC_FIELD:
+		case OP_METHOD: {
+			set_add(uses, a);
+			set_add_rc(uses, c);
+
+			break;
+		}
+
+		case OP_GET_SUPER_METHOD: {
+			set_add(uses, a);
+			set_add(uses, b);
+			*def = a;
+
+			break;
+		}
+
+		// Setters take the value from the register right after the instance
+		case OP_SET_FIELD: {
+			set_add(uses, a);
+			set_add(uses, a + 1);
+			set_add(uses, c);
+
+			break;
+		}
+
+		case OP_SUBSCRIPT_GET: {
+			set_add(uses, a);
+			set_add(uses, a + 1);
+			set_add_rc(uses, b);
+			*def = a;
+
+			break;
+		}
+
+		case OP_SUBSCRIPT_SET: {
+			set_add(uses, a);
+			set_add(uses, a + 1);
+			set_add(uses, a + 2);
+			set_add_rc(uses, b);
+			set_add_rc(uses, c);
+			*def = a;
+
+			break;
+		}
+
+		case OP_PUSH_ARRAY_ELEMENT: {
+			set_add(uses, a);
+			set_add_rc(uses, LIT_INSTRUCTION_BX(instruction));
+
+			break;
+		}
+
+		case OP_PUSH_OBJECT_ELEMENT: {
+			set_add(uses, a);
+			set_add(uses, c);
+
+			break;
+		}
+
+		case OP_SET_REFERENCE: {
+			set_add(uses, a);
+			set_add(uses, b);
+
+			break;
+		}
+
+		case OP_FOR_ITER: {
+			set_add(uses, a);
+			set_add(uses, a + 1);
+
+			break;
+		}
+
+		default: {
+			set_add_all(uses);
+			break;
+		}
+	}
+}
+
+static uint get_successors(LitChunk* chunk, uint offset, uint* successors) {
+	uint32_t instruction = chunk->code[offset];
+	uint8_t opcode = LIT_INSTRUCTION_OPCODE(instruction);
+	uint count = 0;
+
+	if (opcode == OP_RETURN) {
+		return 0;
+	} else if (opcode == OP_JUMP) {
+		successors[count++] = offset + 1 + LIT_INSTRUCTION_SBX(instruction);
+	} else if (is_conditional_jump(opcode)) {
+		successors[count++] = offset + 1;
+		successors[count++] = offset + 1 + LIT_INSTRUCTION_BX(instruction);
+	} else if (is_comparison_jump(opcode)) {
+		// Either runs the FALSE_JUMP after it, or skips it, or takes its offset
+		successors[count++] = offset + 1;
+		successors[count++] = offset + 2;
+		successors[count++] = offset + 2 + LIT_INSTRUCTION_BX(chunk->code[offset + 1]);
+	} else if (opcode == OP_FOR_ITER) {
+		successors[count++] = offset + 1;
+		successors[count++] = offset + 2;
+		successors[count++] = offset - LIT_INSTRUCTION_C(instruction);
+	} else {
+		successors[count++] = offset + 1;
+	}
+
+	uint valid = 0;
+
+	for (uint i = 0; i < count; i++) {
+		if (successors[i] < chunk->count) {
+			successors[valid++] = successors[i];
+		}
+	}
+
+	return valid;
+}
+
+// Closures and references can read and write the captured registers at any time
+static void find_escaped(LitChunk* chunk, LitRegisterSet* escaped) {
+	memset(escaped, 0, sizeof(LitRegisterSet));
+
+	for (uint i = 0; i < chunk->count; i++) {
+		uint32_t instruction = chunk->code[i];
+
+		if (LIT_INSTRUCTION_OPCODE(instruction) == OP_REFERENCE_LOCAL) {
+			set_add(escaped, LIT_INSTRUCTION_B(instruction));
+		}
+	}
+
+	for (uint i = 0; i < chunk->constants.count; i++) {
+		LitValue constant = chunk->constants.values[i];
+
+		if (IS_CLOSURE_PROTOTYPE(constant)) {
+			LitClosurePrototype* prototype = AS_CLOSURE_PROTOTYPE(constant);
+
+			for (uint j = 0; j < prototype->upvalue_count; j++) {
+				if (prototype->local[j]) {
+					set_add(escaped, prototype->indexes[j]);
+				}
+			}
+		} else if (IS_FUNCTION(constant)) {
+			// Closures, that live on the stack, access our registers directly
+			LitChunk* body = &AS_FUNCTION(constant)->chunk;
+
+			for (uint j = 0; j < body->count; j++) {
+				uint32_t instruction = body->code[j];
+				uint8_t opcode = LIT_INSTRUCTION_OPCODE(instruction);
+
+				if (opcode == OP_GET_PARENT_LOCAL) {
+					set_add(escaped, LIT_INSTRUCTION_BX(instruction));
+				} else if (opcode == OP_SET_PARENT_LOCAL) {
+					set_add(escaped, LIT_INSTRUCTION_C(instruction));
+				}
+			}
+		}
+	}
+}
+
+static uint follow_jumps(LitChunk* chunk, uint target) {
+	for (uint i = 0; i < MAX_JUMP_CHAIN && target < chunk->count; i++) {
+		uint32_t instruction = chunk->code[target];
+
+		if (LIT_INSTRUCTION_OPCODE(instruction) != OP_JUMP) {
+			break;
+		}
+
+		uint next = target + 1 + LIT_INSTRUCTION_SBX(instruction);
+
+		if (next == target) {
+			break;
+		}
+
+		target = next;
+	}
+
+	return target;
+}
+
+static void thread_jumps(LitChunk* chunk) {
+	for (uint i = 0; i < chunk->count; i++) {
+		uint32_t instruction = chunk->code[i];
+		uint8_t opcode = LIT_INSTRUCTION_OPCODE(instruction);
+
+		if (opcode == OP_JUMP) {
+			uint target = follow_jumps(chunk, i + 1 + LIT_INSTRUCTION_SBX(instruction));
+			chunk->code[i] = LIT_FORM_ASBX_INSTRUCTION(OP_JUMP, 0, (int64_t) target - i - 1);
+		} else if (is_conditional_jump(opcode)) {
+			uint target = follow_jumps(chunk, i + 1 + LIT_INSTRUCTION_BX(instruction));
+
+			// These can only jump forward
+			if (target > i) {
+				chunk->code[i] = LIT_FORM_ABX_INSTRUCTION(opcode, LIT_INSTRUCTION_A(instruction), target - i - 1);
+			}
+		}
+	}
+}
+
+static void find_reachable(LitPeephole* peephole) {
+	LitChunk* chunk = peephole->chunk;
+	uint* queue = LIT_ALLOCATE(peephole->state, uint, chunk->count);
+	uint queue_count = 0;
+
+	queue[queue_count++] = 0;
+	peephole->reachable[0] = true;
+
+	while (queue_count > 0) {
+		uint offset = queue[--queue_count];
+		uint successors[3];
+		uint count = get_successors(chunk, offset, successors);
+
+		for (uint i = 0; i < count; i++) {
+			uint successor = successors[i];
+
+			if (successor != offset + 1) {
+				peephole->target[successor] = true;
+			}
+
+			if (!peephole->reachable[successor]) {
+				peephole->reachable[successor] = true;
+				queue[queue_count++] = successor;
+			}
+		}
+	}
+
+	LIT_FREE_ARRAY(peephole->state, uint, queue, chunk->count);
+}
+
+static void find_live_registers(LitPeephole* peephole) {
+	LitChunk* chunk = peephole->chunk;
+	LitRegisterSet* live_in = LIT_ALLOCATE(peephole->state, LitRegisterSet, chunk->count);
+
+	for (uint i = 0; i < chunk->count; i++) {
+		live_in[i] = peephole->escaped;
+		peephole->live[i] = peephole->escaped;
+	}
+
+	bool changed = true;
+
+	while (changed) {
+		changed = false;
+
+		for (int i = (int) chunk->count - 1; i >= 0; i--) {
+			uint successors[3];
+			uint count = get_successors(chunk, i, successors);
+			LitRegisterSet* live = &peephole->live[i];
+
+			for (uint j = 0; j < count; j++) {
+				set_merge(live, &live_in[successors[j]]);
+			}
+
+			LitRegisterSet uses;
+			int def;
+
+			get_registers(chunk->code[i], &uses, &def);
+
+			LitRegisterSet in = *live;
+
+			if (def != -1 && !set_has(&peephole->escaped, def)) {
+				in.bits[(def >> 6) & 3] &= ~(1ull << (def & 63));
+			}
+
+			set_merge(&in, &uses);
+			changed |= set_merge(&live_in[i], &in);
+		}
+	}
+
+	LIT_FREE_ARRAY(peephole->state, LitRegisterSet, live_in, chunk->count);
+}
+
+// Makes the instruction read the register (or constant) to instead of from, fails, if from is read in a way, that can't be redirected
+static bool replace_register(uint32_t* instruction, uint8_t from, uint16_t to) {
+	uint32_t code = *instruction;
+	uint8_t opcode = LIT_INSTRUCTION_OPCODE(code);
+	uint8_t a = LIT_INSTRUCTION_A(code);
+	uint16_t b;
+	uint16_t c;
+	bool constant = IS_BIT_SET(to, 8);
+
+	get_bc(code, &b, &c);
+
+	if (is_binary(opcode) || is_comparison_jump(opcode) || opcode == OP_RANGE) {
+		// Operator methods get the operands copied into A and A + 1, so C can't be A,
+		// and only one of the operands has the K bit (C, or B for the RANGE)
+		if (to == a || (constant && (opcode == OP_RANGE ? c : b) == from)) {
+			return false;
+		}
+
+		*instruction = LIT_FORM_ABC_INSTRUCTION(opcode, a, b == from ? to : b, c == from ? to : c);
+		return true;
+	}
+
+	switch (opcode) {
+		case OP_MOVE:
+		case OP_NEGATE:
+		case OP_BNOT:
+		case OP_SET_GLOBAL:
+		case OP_SET_GLOBAL_SLOT:
+		case OP_SET_UPVALUE:
+		case OP_SET_PARENT_LOCAL: {
+			*instruction = LIT_FORM_ABC_INSTRUCTION(opcode, a, b == from ? to : b, c);
+			return true;
+		}
+
+		case OP_STATIC_FIELD:
+		case OP_METHOD: {
+			if (constant) {
+				return false;
+			}
+
+			*instruction = LIT_FORM_ABC_INSTRUCTION(opcode, a, b, c == from ? to : c);
+			return true;
+		}
+
+		case OP_PUSH_ARRAY_ELEMENT: {
+			*instruction = LIT_FORM_ABX_INSTRUCTION(opcode, a, to);
+			return true;
+		}
+
+		case OP_IS:
+		case OP_GET_FIELD:
+		case OP_ADD_CONSTANT:
+		case OP_SUBTRACT_CONSTANT: {
+			if (constant) {
+				return false;
+			}
+
+			*instruction = LIT_FORM_ABC_INSTRUCTION(opcode, a, to, c);
+			return true;
+		}
+
+		case OP_RETURN: {
+			if (constant) {
+				return false;
+			}
+
+			*instruction = LIT_FORM_ABC_INSTRUCTION(opcode, to, b, c);
+			return true;
+		}
+
+		case OP_TRUE_JUMP:
+		case OP_FALSE_JUMP:
+		case OP_NULL_JUMP:
+		case OP_NON_NULL_JUMP: {
+			if (constant) {
+				return false;
+			}
+
+			*instruction = LIT_FORM_ABX_INSTRUCTION(opcode, to, LIT_INSTRUCTION_BX(code));
+			return true;
+		}
+
+		default: return false;
+	}
+}
+
+// Instructions, that only write A, and can write it to any other register, may_call is set for the ones, that can end up calling a method at A
+static bool can_retarget(uint8_t opcode, bool* may_call) {
+	*may_call = false;
+
+	switch (opcode) {
+		case OP_MOVE:
+		case OP_LOAD_NULL:
+		case OP_LOAD_BOOL:
+		case OP_GET_GLOBAL:
+		case OP_GET_UPVALUE:
+		case OP_GET_PRIVATE:
+		case OP_GET_PARENT_LOCAL:
+		case OP_NEGATE:
+		case OP_BNOT:
+		case OP_IS:
+		case OP_RANGE: {
+			return true;
+		}
+
+		case OP_GET_FIELD:
+		case OP_ADD_CONSTANT:
+		case OP_SUBTRACT_CONSTANT: {
+			*may_call = true;
+			return true;
+		}
+
+		default: {
+			*may_call = true;
+			return is_binary(opcode);
+		}
+	}
+}
+
+// Loads, that can be dropped, if nobody reads the result
+static bool is_pure_load(uint8_t opcode) {
+	return opcode == OP_MOVE || opcode == OP_LOAD_NULL || opcode == OP_LOAD_BOOL || opcode == OP_GET_PRIVATE || opcode == OP_GET_UPVALUE;
+}
+
+// MOVE T, S followed by the last read of T
+static bool propagate_copy(LitPeephole* peephole, uint offset) {
+	LitChunk* chunk = peephole->chunk;
+	uint32_t move = chunk->code[offset];
+	uint next = offset + 1;
+
+	uint8_t temp = LIT_INSTRUCTION_A(move);
+	uint16_t source = LIT_INSTRUCTION_BK(move);
+
+	if (next >= chunk->count || peephole->target[next] || set_has(&peephole->escaped, temp)) {
+		return false;
+	}
+
+	uint32_t instruction = chunk->code[next];
+	LitRegisterSet uses;
+	int def;
+
+	get_registers(instruction, &uses, &def);
+
+	if (!set_has(&uses, temp) || (def != temp && set_has(&peephole->live[next], temp))) {
+		return false;
+	}
+
+	if (!replace_register(&instruction, temp, source)) {
+		return false;
+	}
+
+	get_registers(instruction, &uses, &def);
+
+	if (set_has(&uses, temp)) {
+		return false;
+	}
+
+	chunk->code[next] = instruction;
+	peephole->removed[offset] = true;
+
+	return true;
+}
+
+// An instruction, that writes T, followed by MOVE L, T
+static bool coalesce_move(LitPeephole* peephole, uint offset) {
+	LitChunk* chunk = peephole->chunk;
+	uint32_t instruction = chunk->code[offset];
+	uint next = offset + 1;
+	bool may_call;
+
+	if (next >= chunk->count || peephole->target[next] || !can_retarget(LIT_INSTRUCTION_OPCODE(instruction), &may_call)) {
+		return false;
+	}
+
+	uint32_t move = chunk->code[next];
+	uint8_t temp = LIT_INSTRUCTION_A(instruction);
+	uint8_t local = LIT_INSTRUCTION_A(move);
+
+	if (LIT_INSTRUCTION_OPCODE(move) != OP_MOVE || LIT_INSTRUCTION_BK(move) != temp || local == temp
+		|| set_has(&peephole->escaped, temp) || set_has(&peephole->escaped, local) || set_has(&peephole->live[next], temp)) {
+
+		return false;
+	}
+
+	if (may_call) {
+		// The method frame starts at A, so nothing above the new A can be alive
+		LitRegisterSet uses;
+		int def;
+
+		get_registers(instruction, &uses, &def);
+
+		if (set_has(&uses, local) || set_has_above(&peephole->live[next], local)) {
+			return false;
+		}
+	}
+
+	chunk->code[offset] = LIT_INSTRUCTION_WITH_A(instruction, local);
+	peephole->removed[next] = true;
+
+	return true;
+}
+
+static void rebuild_lines(LitPeephole* peephole) {
+	LitChunk* chunk = peephole->chunk;
+
+	if (!chunk->has_line_info || chunk->lines == NULL) {
+		return;
+	}
+
+	uint16_t* lines = LIT_ALLOCATE(peephole->state, uint16_t, chunk->count);
+	uint count = 0;
+
+	for (uint index = 0; index <= chunk->line_count && count < chunk->count; index += 2) {
+		for (uint i = 0; i < chunk->lines[index + 1] && count < chunk->count; i++) {
+			lines[count++] = chunk->lines[index];
+		}
+	}
+
+	// Same encoding, as in lit_write_chunk(), there can't be more runs, than before
+	chunk->line_count = 0;
+	chunk->lines[0] = 0;
+	chunk->lines[1] = 0;
+
+	for (uint i = 0; i < count; i++) {
+		if (peephole->removed[i]) {
+			continue;
+		}
+
+		uint16_t line = lines[i];
+
+		if (chunk->lines[chunk->line_count] != 0 && chunk->lines[chunk->line_count] != line) {
+			chunk->line_count += 2;
+			chunk->lines[chunk->line_count + 1] = 0;
+		}
+
+		chunk->lines[chunk->line_count] = line;
+		chunk->lines[chunk->line_count + 1]++;
+	}
+
+	LIT_FREE_ARRAY(peephole->state, uint16_t, lines, chunk->count);
+}
+
+static void remove_instructions(LitPeephole* peephole) {
+	LitChunk* chunk = peephole->chunk;
+	uint* offsets = LIT_ALLOCATE(peephole->state, uint, chunk->count + 1);
+	uint count = 0;
+
+	// Removed instructions map onto the next one, that stays
+	for (uint i = 0; i < chunk->count; i++) {
+		offsets[i] = count;
+
+		if (!peephole->removed[i]) {
+			count++;
+		}
+	}
+
+	offsets[chunk->count] = count;
+
+	for (uint i = 0; i < chunk->count; i++) {
+		if (peephole->removed[i]) {
+			continue;
+		}
+
+		uint32_t instruction = chunk->code[i];
+		uint8_t opcode = LIT_INSTRUCTION_OPCODE(instruction);
+
+		if (opcode == OP_JUMP) {
+			uint target = offsets[i + 1 + LIT_INSTRUCTION_SBX(instruction)];
+			instruction = LIT_FORM_ASBX_INSTRUCTION(OP_JUMP, 0, (int64_t) target - offsets[i] - 1);
+		} else if (is_conditional_jump(opcode)) {
+			uint target = offsets[i + 1 + LIT_INSTRUCTION_BX(instruction)];
+			instruction = LIT_FORM_ABX_INSTRUCTION(opcode, LIT_INSTRUCTION_A(instruction), target - offsets[i] - 1);
+		} else if (opcode == OP_FOR_ITER) {
+			uint target = offsets[i - LIT_INSTRUCTION_C(instruction)];
+			instruction = LIT_FORM_ABC_INSTRUCTION(opcode, LIT_INSTRUCTION_A(instruction), LIT_INSTRUCTION_B(instruction), offsets[i] - target);
+		}
+
+		chunk->code[i] = instruction;
+	}
+
+	rebuild_lines(peephole);
+
+	for (uint i = 0; i < chunk->count; i++) {
+		if (!peephole->removed[i]) {
+			chunk->code[offsets[i]] = chunk->code[i];
+		}
+	}
+
+	LIT_FREE_ARRAY(peephole->state, uint, offsets, chunk->count + 1);
+	chunk->count = count;
+}
+
+static bool optimize_round(LitPeephole* peephole) {
+	LitChunk* chunk = peephole->chunk;
+	uint count = chunk->count;
+
+	peephole->target = LIT_ALLOCATE(peephole->state, bool, count);
+	peephole->reachable = LIT_ALLOCATE(peephole->state, bool, count);
+	peephole->removed = LIT_ALLOCATE(peephole->state, bool, count);
+	peephole->live = LIT_ALLOCATE(peephole->state, LitRegisterSet, count);
+
+	memset(peephole->target, 0, sizeof(bool) * count);
+	memset(peephole->reachable, 0, sizeof(bool) * count);
+	memset(peephole->removed, 0, sizeof(bool) * count);
+
+	find_reachable(peephole);
+	find_live_registers(peephole);
+
+	bool changed = false;
+
+	for (uint i = 0; i < count; i++) {
+		uint32_t instruction = chunk->code[i];
+		uint8_t opcode = LIT_INSTRUCTION_OPCODE(instruction);
+
+		if (!peephole->reachable[i]) {
+			peephole->removed[i] = true;
+		} else if (opcode == OP_MOVE && LIT_INSTRUCTION_BK(instruction) == LIT_INSTRUCTION_A(instruction)) {
+			peephole->removed[i] = true;
+		} else if (opcode == OP_JUMP && LIT_INSTRUCTION_SBX(instruction) == 0 && (i == 0 || LIT_INSTRUCTION_OPCODE(chunk->code[i - 1]) != OP_FOR_ITER)) {
+			peephole->removed[i] = true;
+		} else if (opcode == OP_MOVE && propagate_copy(peephole, i)) {
+			// The next instruction was rewritten, it will be looked at in the next round
+			i++;
+		} else if (coalesce_move(peephole, i)) {
+			i++;
+		} else if (is_pure_load(opcode) && !set_has(&peephole->live[i], LIT_INSTRUCTION_A(instruction))) {
+			peephole->removed[i] = true;
+		} else {
+			continue;
+		}
+
+		changed = true;
+	}
+
+	if (changed) {
+		remove_instructions(peephole);
+	}
+
+	LIT_FREE_ARRAY(peephole->state, bool, peephole->target, count);
+	LIT_FREE_ARRAY(peephole->state, bool, peephole->reachable, count);
+	LIT_FREE_ARRAY(peephole->state, bool, peephole->removed, count);
+	LIT_FREE_ARRAY(peephole->state, LitRegisterSet, peephole->live, count);
+
+	return changed;
+}
+
+// Both, the divisor and its reciprocal, are stored next to each other, so that the generic instruction still finds the divisor in C
+static uint add_reciprocal(LitState* state, LitChunk* chunk, double divisor) {
+	LitValue value = NUMBER_VALUE(divisor);
+	LitValue reciprocal = NUMBER_VALUE(1.0 / divisor);
+	LitValues* constants = &chunk->constants;
+
+	for (uint i = 0; i + 1 < constants->count; i++) {
+		if (constants->values[i] == value && constants->values[i + 1] == reciprocal) {
+			return i;
+		}
+	}
+
+	lit_values_write(state, constants, value);
+	lit_values_write(state, constants, reciprocal);
+
+	return constants->count - 2;
+}
+
+// Only the powers of two, that have an exact reciprocal
+static bool is_power_of_two(LitValue value) {
+	if (!IS_NUMBER(value) || AS_NUMBER(value) == 0) {
+		return false;
+	}
+
+	int exponent;
+	double mantissa = frexp(AS_NUMBER(value), &exponent);
+
+	return fabs(mantissa) == 0.5 && exponent > -1000 && exponent < 1000;
+}
+
+static void reduce_strength(LitState* state, LitChunk* chunk) {
+	for (uint i = 0; i < chunk->count; i++) {
+		uint32_t instruction = chunk->code[i];
+		uint8_t opcode = LIT_INSTRUCTION_OPCODE(instruction);
+		uint16_t c = LIT_INSTRUCTION_CK(instruction);
+
+		if ((opcode != OP_POWER && opcode != OP_DIVIDE && opcode != OP_FLOOR_DIVIDE && opcode != OP_MOD) || !IS_BIT_SET(c, 8)) {
+			continue;
+		}
+
+		LitValue constant = chunk->constants.values[c & 0xff];
+
+		if (!is_power_of_two(constant)) {
+			continue;
+		}
+
+		double number = AS_NUMBER(constant);
+
+		switch (opcode) {
+			case OP_POWER: {
+				if (number == 2) {
+					chunk->code[i] = LIT_INSTRUCTION_WITH_OPCODE(instruction, OP_SQUARE);
+				}
+
+				break;
+			}
+
+			case OP_DIVIDE:
+			case OP_FLOOR_DIVIDE: {
+				// The reciprocal has to be reachable with a constant operand too
+				if (chunk->constants.count + 2 > 256) {
+					break;
+				}
+
+				uint index = add_reciprocal(state, chunk, number);
+
+				chunk->code[i] = LIT_FORM_ABC_INSTRUCTION(opcode == OP_DIVIDE ? OP_DIVIDE_POWER_OF_TWO : OP_FLOOR_DIVIDE_POWER_OF_TWO,
+					LIT_INSTRUCTION_A(instruction), LIT_INSTRUCTION_B(instruction), index | 0x100);
+
+				break;
+			}
+
+			case OP_MOD: {
+				if (number >= 2 && number <= 4503599627370496.0) {
+					chunk->code[i] = LIT_INSTRUCTION_WITH_OPCODE(instruction, OP_MOD_POWER_OF_TWO);
+				}
+
+				break;
+			}
+
+			default: break;
+		}
+	}
+}
+
+void lit_optimize_chunk(LitState* state, LitChunk* chunk) {
+	if (chunk->count == 0) {
+		return;
+	}
+
+	if (lit_is_optimization_enabled(OPTIMIZATION_STRENGTH_REDUCTION)) {
+		reduce_strength(state, chunk);
+	}
+
+	if (!lit_is_optimization_enabled(OPTIMIZATION_PEEPHOLE)) {
+		return;
+	}
+
+	LitPeephole peephole;
+
+	peephole.state = state;
+	peephole.chunk = chunk;
+
+	find_escaped(chunk, &peephole.escaped);
+
+	for (uint i = 0; i < MAX_ROUNDS; i++) {
+		thread_jumps(chunk);
+
+		if (!optimize_round(&peephole)) {
+			break;
+		}
+	}
+}
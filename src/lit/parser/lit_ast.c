@@ -3,212 +3,18 @@
 #include "lit/mem/lit_mem.h"
 #include "lit/state/lit_state.h"
 
-DEFINE_ARRAY(LitExpressions, LitExpression*, expressions)
-DEFINE_ARRAY(LitStatements, LitStatement*, stataments)
-DEFINE_ARRAY(LitParameters, LitParameter, parameters);
+#define ARENA &state->parser->arena
 
-#define FREE_EXPRESSION(type) lit_reallocate(state, expression, sizeof(type), 0);
-
-static void free_parameters(LitState* state, LitParameters* parameters) {
-	for (uint i = 0; i < parameters->count; i++) {
-		lit_free_expression(state, parameters->values[i].default_value);
-	}
-
-	lit_free_parameters(state, parameters);
-}
-
-void free_expressions(LitState* state, LitExpressions* expressions) {
-	if (expressions == NULL) {
-		return;
-	}
-
-	for (uint i = 0; i < expressions->count; i++) {
-		lit_free_expression(state, expressions->values[i]);
-	}
-
-	lit_free_expressions(state, expressions);
-}
-
-void free_statements(LitState* state, LitStatements* statements) {
-	if (statements == NULL) {
-		return;
-	}
-
-	for (uint i = 0; i < statements->count; i++) {
-		lit_free_statement(state, statements->values[i]);
-	}
-
-	lit_free_stataments(state, statements);
-}
-
-void lit_free_expression(LitState* state, LitExpression* expression) {
-	if (expression == NULL) {
-		return;
-	}
-
-	switch (expression->type) {
-		case LITERAL_EXPRESSION: {
-			FREE_EXPRESSION(LitLiteralExpression)
-			break;
-		}
-
-		case BINARY_EXPRESSION: {
-			LitBinaryExpression* expr = (LitBinaryExpression*) expression;
-
-			if (!expr->ignore_left) {
-				lit_free_expression(state, expr->left);
-			}
-
-			lit_free_expression(state, expr->right);
-
-			FREE_EXPRESSION(LitBinaryExpression)
-			break;
-		}
-
-		case UNARY_EXPRESSION: {
-			lit_free_expression(state, ((LitUnaryExpression*) expression)->right);
-			FREE_EXPRESSION(LitUnaryExpression)
-
-			break;
-		}
-
-		case VAR_EXPRESSION: {
-			FREE_EXPRESSION(LitVarExpression)
-			break;
-		}
-
-		case ASSIGN_EXPRESSION: {
-			LitAssignExpression *expr = (LitAssignExpression*) expression;
-
-			lit_free_expression(state, expr->to);
-			lit_free_expression(state, expr->value);
-
-			FREE_EXPRESSION(LitAssignExpression)
-			break;
-		}
-
-		case CALL_EXPRESSION: {
-			LitCallExpression* expr = (LitCallExpression*) expression;
-
-			lit_free_expression(state, expr->callee);
-			lit_free_expression(state, expr->init);
-
-			free_expressions(state, &expr->args);
-
-			FREE_EXPRESSION(LitCallExpression)
-			break;
-		}
-
-		case GET_EXPRESSION: {
-			lit_free_expression(state, ((LitGetExpression*) expression)->where);
-			FREE_EXPRESSION(LitGetExpression)
-			break;
-		}
-
-		case SET_EXPRESSION: {
-			LitSetExpression* expr = (LitSetExpression*) expression;
-
-			lit_free_expression(state, expr->where);
-			lit_free_expression(state, expr->value);
-
-			FREE_EXPRESSION(LitSetExpression)
-			break;
-		}
-
-		case LAMBDA_EXPRESSION: {
-			LitLambdaExpression* expr = (LitLambdaExpression*) expression;
-
-			free_parameters(state, &expr->parameters);
-			lit_free_statement(state, expr->body);
-
-			FREE_EXPRESSION(LitLambdaExpression)
-			break;
-		}
-
-		case ARRAY_EXPRESSION: {
-			free_expressions(state, &((LitArrayExpression*) expression)->values);
-			FREE_EXPRESSION(LitArrayExpression)
-
-			break;
-		}
-
-		case OBJECT_EXPRESSION: {
-			LitObjectExpression* map = (LitObjectExpression*) expression;
-
-			lit_free_values(state, &map->keys);
-			free_expressions(state, &map->values);
-
-			FREE_EXPRESSION(LitObjectExpression)
-			break;
-		}
-
-		case SUBSCRIPT_EXPRESSION: {
-			LitSubscriptExpression* expr = (LitSubscriptExpression*) expression;
-
-			lit_free_expression(state, expr->array);
-			lit_free_expression(state, expr->index);
-
-			FREE_EXPRESSION(LitSubscriptExpression)
-			break;
-		}
-
-		case THIS_EXPRESSION: {
-			FREE_EXPRESSION(LitThisExpression)
-			break;
-		}
-
-		case SUPER_EXPRESSION: {
-			FREE_EXPRESSION(LitSuperExpression)
-			break;
-		}
-
-		case RANGE_EXPRESSION: {
-			LitRangeExpression* expr = (LitRangeExpression*) expression;
-
-			lit_free_expression(state, expr->from);
-			lit_free_expression(state, expr->to);
-
-			FREE_EXPRESSION(LitRangeExpression)
-			break;
-		}
-
-		case IF_EXPRESSION: {
-			LitIfExpression* expr = (LitIfExpression*) expression;
-
-			lit_free_expression(state, expr->condition);
-			lit_free_expression(state, expr->if_branch);
-			lit_free_expression(state, expr->else_branch);
-
-			FREE_EXPRESSION(LitIfExpression)
-			break;
-		}
-
-		case INTERPOLATION_EXPRESSION: {
-			free_expressions(state, &((LitInterpolationExpression*) expression)->expressions);
-			FREE_EXPRESSION(LitInterpolationExpression)
-
-			break;
-		}
-
-		case REFERENCE_EXPRESSION: {
-			lit_free_expression(state, ((LitReferenceExpression*) expression)->to);
-			FREE_EXPRESSION(LitReferenceExpression)
-
-			break;
-		}
-
-		default: {
-			lit_error(state, COMPILE_ERROR, "Unknown expression type %d", (int) expression->type);
-			break;
-		}
-	}
-}
+DEFINE_ARENA_ARRAY(LitExpressions, LitExpression*, expressions, ARENA)
+DEFINE_ARENA_ARRAY(LitKeys, LitValue, keys, ARENA)
+DEFINE_ARENA_ARRAY(LitStatements, LitStatement*, stataments, ARENA)
+DEFINE_ARENA_ARRAY(LitParameters, LitParameter, parameters, ARENA)
 
 #define ALLOCATE_EXPRESSION(state, type, object_type) \
     (type*) allocate_expression(state, line, sizeof(type), object_type)
 
 static LitExpression* allocate_expression(LitState* state, uint64_t line, size_t size, LitExpressionType type) {
-	LitExpression* object = (LitExpression*) lit_reallocate(state, NULL, 0, size);
+	LitExpression* object = (LitExpression*) lit_arena_allocate(ARENA, size);
 
 	object->type = type;
 	object->line = line;
@@ -265,6 +71,7 @@ LitCallExpression *lit_create_call_expression(LitState* state, uint line, LitExp
 
 	expression->callee = callee;
 	expression->init = NULL;
+	expression->tail_call = false;
 
 	lit_init_expressions(&expression->args);
 
@@ -313,7 +120,7 @@ LitArrayExpression *lit_create_array_expression(LitState* state, uint line) {
 LitObjectExpression *lit_create_object_expression(LitState* state, uint line) {
 	LitObjectExpression* expression = ALLOCATE_EXPRESSION(state, LitObjectExpression, OBJECT_EXPRESSION);
 
-	lit_init_values(&expression->keys);
+	lit_init_keys(&expression->keys);
 	lit_init_expressions(&expression->values);
 
 	return expression;
@@ -373,137 +180,11 @@ LitReferenceExpression *lit_create_reference_expression(LitState* state, uint li
 	return expression;
 }
 
-#define FREE_STATEMENT(type) lit_reallocate(state, statement, sizeof(type), 0);
-
-void lit_free_statement(LitState* state, LitStatement* statement) {
-	if (statement == NULL) {
-		return;
-	}
-
-	switch (statement->type) {
-		case EXPRESSION_STATEMENT: {
-			lit_free_expression(state, ((LitExpressionStatement*) statement)->expression);
-			FREE_STATEMENT(LitExpressionStatement)
-			break;
-		}
-
-		case BLOCK_STATEMENT: {
-			free_statements(state, &((LitBlockStatement*) statement)->statements);
-			FREE_STATEMENT(LitBlockStatement)
-			break;
-		}
-
-		case VAR_STATEMENT: {
-			lit_free_expression(state, ((LitVarStatement*) statement)->init);
-			FREE_STATEMENT(LitVarStatement)
-			break;
-		}
-
-		case IF_STATEMENT: {
-			LitIfStatement* stmt = (LitIfStatement*) statement;
-
-			lit_free_expression(state, stmt->condition);
-			lit_free_statement(state, stmt->if_branch);
-
-			lit_free_allocated_expressions(state, stmt->elseif_conditions);
-			lit_free_allocated_statements(state, stmt->elseif_branches);
-
-			lit_free_statement(state, stmt->else_branch);
-
-			FREE_STATEMENT(LitIfStatement)
-			break;
-		}
-
-		case WHILE_STATEMENT: {
-			LitWhileStatement* stmt = (LitWhileStatement*) statement;
-
-			lit_free_expression(state, stmt->condition);
-			lit_free_statement(state, stmt->body);
-
-			FREE_STATEMENT(LitWhileStatement)
-			break;
-		}
-
-		case FOR_STATEMENT: {
-			LitForStatement* stmt = (LitForStatement*) statement;
-
-			lit_free_expression(state, stmt->increment);
-			lit_free_expression(state, stmt->condition);
-			lit_free_expression(state, stmt->init);
-
-			lit_free_statement(state, stmt->var);
-			lit_free_statement(state, stmt->body);
-
-			FREE_STATEMENT(LitForStatement)
-			break;
-		}
-
-		case CONTINUE_STATEMENT: {
-			FREE_STATEMENT(LitContinueStatement)
-			break;
-		}
-
-		case BREAK_STATEMENT: {
-			FREE_STATEMENT(LitBreakStatement)
-			break;
-		}
-
-		case FUNCTION_STATEMENT: {
-			LitFunctionStatement* stmt = (LitFunctionStatement*) statement;
-
-			lit_free_statement(state, stmt->body);
-			free_parameters(state, &stmt->parameters);
-
-			FREE_STATEMENT(LitFunctionStatement)
-			break;
-		}
-
-		case RETURN_STATEMENT: {
-			lit_free_expression(state, ((LitReturnStatement*) statement)->expression);
-			FREE_STATEMENT(LitReturnStatement)
-
-			break;
-		}
-
-		case METHOD_STATEMENT: {
-			LitMethodStatement* stmt = (LitMethodStatement*) statement;
-
-			free_parameters(state, &stmt->parameters);
-			lit_free_statement(state, stmt->body);
-
-			FREE_STATEMENT(LitMethodStatement)
-
-			break;
-		}
-
-		case CLASS_STATEMENT: {
-			free_statements(state, &((LitClassStatement*) statement)->fields);
-			FREE_STATEMENT(LitClassStatement)
-			break;
-		}
-
-		case FIELD_STATEMENT: {
-			LitFieldStatement* stmt = (LitFieldStatement*) statement;
-
-			lit_free_statement(state, stmt->getter);
-			lit_free_statement(state, stmt->setter);
-
-			FREE_STATEMENT(LitFieldStatement)
-			break;
-		}
-
-		default: {
-			lit_error(state, COMPILE_ERROR, "Unknown statement type %d", (int) statement->type);
-			break;
-		}
-	}
-}
-
 #define ALLOCATE_STATEMENT(state, type, object_type) \
     (type*) allocate_statement(state, line, sizeof(type), object_type)
 
 static LitStatement* allocate_statement(LitState* state, uint64_t line, size_t size, LitStatementType type) {
-	LitStatement* object = (LitStatement*) lit_reallocate(state, NULL, 0, size);
+	LitStatement* object = (LitStatement*) lit_arena_allocate(ARENA, size);
 
 	object->type = type;
 	object->line = line;
@@ -631,39 +312,13 @@ LitFieldStatement *lit_create_field_statement(LitState* state, uint line, LitStr
 }
 
 LitExpressions* lit_allocate_expressions(LitState* state) {
-	LitExpressions* expressions = (LitExpressions*) lit_reallocate(state, NULL, 0, sizeof(LitExpressions));
+	LitExpressions* expressions = (LitExpressions*) lit_arena_allocate(ARENA, sizeof(LitExpressions));
 	lit_init_expressions(expressions);
 	return expressions;
 }
 
-void lit_free_allocated_expressions(LitState* state, LitExpressions* expressions) {
-	if (expressions == NULL) {
-		return;
-	}
-
-	for (uint i = 0; i < expressions->count; i++) {
-		lit_free_expression(state, expressions->values[i]);
-	}
-
-	lit_free_expressions(state, expressions);
-	lit_reallocate(state, expressions, sizeof(LitExpressions), 0);
-}
-
 LitStatements* lit_allocate_statements(LitState* state) {
-	LitStatements* statements = (LitStatements*) lit_reallocate(state, NULL, 0, sizeof(LitStatements));
+	LitStatements* statements = (LitStatements*) lit_arena_allocate(ARENA, sizeof(LitStatements));
 	lit_init_stataments(statements);
 	return statements;
-}
-
-void lit_free_allocated_statements(LitState* state, LitStatements* statements) {
-	if (statements == NULL) {
-		return;
-	}
-
-	for (uint i = 0; i < statements->count; i++) {
-		lit_free_statement(state, statements->values[i]);
-	}
-
-	lit_free_stataments(state, statements);
-	lit_reallocate(state, statements, sizeof(LitStatements), 0);
 }
\ No newline at end of file
@@ -58,10 +58,12 @@ void lit_init_parser(LitState* state, LitParser* parser) {
 	parser->state = state;
 	parser->had_error = false;
 	parser->panic_mode = false;
+
+	lit_init_arena(&parser->arena);
 }
 
 void lit_free_parser(LitParser* parser) {
-
+	lit_free_arena(&parser->arena);
 }
 
 static void string_error(LitParser* parser, LitToken* token, const char* message) {
@@ -519,7 +521,7 @@ static LitExpression* parse_object(LitParser* parser, bool can_assign) {
 	while (!check(parser, LTOKEN_RIGHT_BRACE)) {
 		ignore_new_lines(parser);
 		consume(parser, LTOKEN_IDENTIFIER, "key string after '{'");
-		lit_values_write(parser->state, &object->keys, OBJECT_VALUE(lit_copy_string(parser->state, parser->previous.start, parser->previous.length)));
+		lit_keys_write(parser->state, &object->keys, OBJECT_VALUE(lit_copy_string(parser->state, parser->previous.start, parser->previous.length)));
 
 		ignore_new_lines(parser);
 		consume(parser, LTOKEN_COLON, "':' after key string");
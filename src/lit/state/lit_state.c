@@ -49,15 +49,21 @@ LitState* lit_new_state() {
 	state->bytes_allocated = 0;
 
 	state->next_gc = 256 * 1024;
+	state->next_full_gc = 256 * 1024;
 	state->allow_gc = false;
 
+	lit_init_slabs(&state->slabs);
+
 	state->error_fn = default_error;
 	state->print_fn = default_printf;
 	state->had_error = false;
+	state->exiting_natives = true;
 	state->roots = NULL;
 	state->root_count = 0;
 	state->root_capacity = 0;
 	state->last_module = NULL;
+	state->class_version = 0;
+	state->shape_id = 0;
 
 	state->preprocessor = (LitPreprocessor*) malloc(sizeof(LitPreprocessor));
 	lit_init_preprocessor(state, state->preprocessor);
@@ -112,6 +118,8 @@ int64_t lit_free_state(LitState* state) {
 	lit_free_vm(state->vm);
 	free(state->vm);
 
+	lit_free_slabs(&state->slabs);
+
 	int64_t amount = state->bytes_allocated;
 	free(state);
 
@@ -200,14 +208,6 @@ LitClass* lit_get_class_for(LitState* state, LitValue value) {
 	return NULL;
 }
 
-static void free_statements(LitState* state, LitStatements* statements) {
-	for (uint i = 0; i < statements->count; i++) {
-		lit_free_statement(state, statements->values[i]);
-	}
-
-	lit_free_stataments(state, statements);
-}
-
 LitInterpretResult lit_interpret(LitState* state, const char* module_name, char* code) {
 	return lit_internal_interpret(state, lit_copy_string(state, module_name, strlen(module_name)), code);
 }
@@ -244,7 +244,7 @@ LitModule* lit_compile_module(LitState* state, LitString* module_name, char* cod
 		lit_init_stataments(&statements);
 
 		if (lit_parse(state->parser, module_name->chars, code, &statements)) {
-			free_statements(state, &statements);
+			lit_free_arena(&state->parser->arena);
 			return NULL;
 		}
 
@@ -261,7 +261,7 @@ LitModule* lit_compile_module(LitState* state, LitString* module_name, char* cod
 		}
 
 		module = lit_emit(state->emitter, &statements, module_name);
-		free_statements(state, &statements);
+		lit_free_arena(&state->parser->arena);
 
 		if (measure_compilation_time) {
 			printf("Emitting:       %gms\n", (double) (clock() - t) / CLOCKS_PER_SEC * 1000);
@@ -370,7 +370,7 @@ bool lit_compile_and_save_files(LitState* state, char* files[], uint num_files,
 	lit_write_uint16_t(file, num_files);
 
 	for (uint i = 0; i < num_files; i++) {
-		lit_save_module(compiled_modules[i], file);
+		lit_save_module(state, compiled_modules[i], file);
 	}
 
 	lit_write_uint16_t(file, LIT_BYTECODE_END_NUMBER);
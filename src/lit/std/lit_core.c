@@ -35,7 +35,7 @@ void lit_open_libraries(LitState* state) {
 }
 
 LIT_METHOD(invalid_constructor) {
-	lit_runtime_error_exiting(vm, "Can't create an instance of built-in type", AS_INSTANCE(instance)->klass->name);
+	lit_runtime_error(vm, "Can't create an instance of built-in type", AS_INSTANCE(instance)->klass->name);
 	return NULL_VALUE;
 }
 
@@ -47,34 +47,6 @@ LIT_METHOD(class_toString) {
 	return OBJECT_VALUE(lit_string_format(vm->state, "class @", OBJECT_VALUE(AS_CLASS(instance)->name)));
 }
 
-static int table_iterator(LitTable* table, int number) {
-	if (table->count == 0) {
-		return -1;
-	}
-
-	if (number >= (int) table->capacity) {
-		return -1;
-	}
-
-	number++;
-
-	for (; number < table->capacity; number++) {
-		if (table->entries[number].key != NULL) {
-			return number;
-		}
-	}
-
-	return -1;
-}
-
-static LitValue table_iterator_key(LitTable* table, int index) {
-	if (table->capacity <= index) {
-		return NULL_VALUE;
-	}
-
-	return OBJECT_VALUE(table->entries[index].key);
-}
-
 LIT_METHOD(class_iterator) {
 	LIT_ENSURE_ARGS(1)
 
@@ -83,7 +55,7 @@ LIT_METHOD(class_iterator) {
 	int methodsCapacity = (int) klass->methods.capacity;
 	bool fields = index >= methodsCapacity;
 
-	int value = table_iterator(fields ? &klass->static_fields : &klass->methods, fields ? index - methodsCapacity : index);
+	int value = lit_table_iterator(fields ? &klass->static_fields : &klass->methods, fields ? index - methodsCapacity : index);
 
 	if (value == -1) {
 		if (fields) {
@@ -92,7 +64,7 @@ LIT_METHOD(class_iterator) {
 
 		index++;
 		fields = true;
-		value = table_iterator(&klass->static_fields, index - methodsCapacity);
+		value = lit_table_iterator(&klass->static_fields, index - methodsCapacity);
 	}
 
 	return value == -1 ? NULL_VALUE : NUMBER_VALUE(fields ? value + methodsCapacity : value);
@@ -104,7 +76,7 @@ LIT_METHOD(class_iteratorValue) {
 	uint methodsCapacity = klass->methods.capacity;
 	bool fields = index >= methodsCapacity;
 
-	return table_iterator_key(fields ? &klass->static_fields : &klass->methods, fields ? index - methodsCapacity : index);
+	return lit_table_iterator_key(fields ? &klass->static_fields : &klass->methods, fields ? index - methodsCapacity : index);
 }
 
 LIT_METHOD(class_super) {
@@ -128,15 +100,19 @@ LIT_METHOD(class_subscript) {
 
 	if (arg_count == 2) {
 		if (!IS_STRING(args[0])) {
-			lit_runtime_error_exiting(vm, "Class index must be a string");
+			lit_runtime_error(vm, "Class index must be a string");
+			return NULL_VALUE;
 		}
 
 		lit_table_set(vm->state, &klass->static_fields, AS_STRING(args[0]), args[1]);
+		lit_invalidate_class(vm->state, klass);
+
 		return args[1];
 	}
 
 	if (!IS_STRING(args[0])) {
-		lit_runtime_error_exiting(vm, "Class index must be a string");
+		lit_runtime_error(vm, "Class index must be a string");
+		return NULL_VALUE;
 	}
 
 	LitValue value;
@@ -173,14 +149,13 @@ LIT_METHOD(object_toString) {
 		return lit_string_format(state, "@ instance", OBJECT_VALUE(klass->name));
 	}
 
-	LitTable* values = &AS_INSTANCE(instance)->fields;
+	LitInstance* object = AS_INSTANCE(instance);
+	uint value_amount = lit_instance_field_count(object);
 
-	if (values->count == 0) {
+	if (value_amount == 0) {
 		return OBJECT_CONST_STRING(state, "{}");
 	}
 
-	uint value_amount = values->count;
-
 	LitString* values_converted[value_amount];
 	LitString* keys[value_amount];
 
@@ -188,29 +163,27 @@ LIT_METHOD(object_toString) {
 	uint string_length = indentation + 2;
 
 	uint i = 0;
-	uint index = 0;
+	int index = -1;
 
-	do {
-		LitTableEntry* entry = &values->entries[index++];
+	while ((index = lit_instance_next_field(object, index)) != -1 && i < value_amount) {
+		LitString* key = lit_instance_field_name(object, index);
+		LitValue field = lit_instance_field_value(object, index);
+		LitString* value = lit_to_string(state, field, indentation);
 
-		if (entry->key != NULL) {
-			LitString* value = lit_to_string(state, entry->value, indentation);
+		lit_push_root(state, (LitObject*) value);
 
+		if (IS_STRING(field)) {
+			value = AS_STRING(lit_string_format(state, "\"@\"", OBJECT_VALUE(value)));
+			lit_pop_root(state);
 			lit_push_root(state, (LitObject*) value);
+		}
 
-			if (IS_STRING(entry->value)) {
-				value = AS_STRING(lit_string_format(state, "\"@\"", OBJECT_VALUE(value)));
-				lit_pop_root(state);
-				lit_push_root(state, (LitObject*) value);
-			}
-
-			values_converted[i] = value;
-			keys[i] = entry->key;
-			string_length += entry->key->length + 2 + value->length + (i == value_amount - 1 ? 1 : 2) + indentation;
+		values_converted[i] = value;
+		keys[i] = key;
+		string_length += key->length + 2 + value->length + (i == value_amount - 1 ? 1 : 2) + indentation;
 
-			i++;
-		}
-	} while (i < value_amount);
+		i++;
+	}
 
 	char buffer[string_length + 1];
 	memcpy(buffer, "{\n", 2);
@@ -258,23 +231,25 @@ LIT_METHOD(object_toString) {
 LIT_METHOD(object_subscript) {
 	if (!IS_INSTANCE(instance)) {
 		LitObjectType type = OBJECT_TYPE(instance);
-		lit_runtime_error_exiting(vm, "Can't modify built-in types");
+		lit_runtime_error(vm, "Can't modify built-in types");
+		return NULL_VALUE;
 	}
 
 	LitInstance* inst = AS_INSTANCE(instance);
 
 	if (!IS_STRING(args[0])) {
-		lit_runtime_error_exiting(vm, "Object index must be a string");
+		lit_runtime_error(vm, "Object index must be a string");
+		return NULL_VALUE;
 	}
 
 	if (arg_count == 2) {
-		lit_table_set(vm->state, &inst->fields, AS_STRING(args[0]), args[1]);
+		lit_instance_set(vm->state, inst, AS_STRING(args[0]), args[1]);
 		return args[1];
 	}
 
 	LitValue value;
 
-	if (lit_table_get(&inst->fields, AS_STRING(args[0]), &value)) {
+	if (lit_instance_get(inst, AS_STRING(args[0]), &value)) {
 		return value;
 	}
 
@@ -295,7 +270,7 @@ LIT_METHOD(object_iterator) {
 	LitInstance* self = AS_INSTANCE(instance);
 
 	int index = args[0] == NULL_VALUE ? -1 : AS_NUMBER(args[0]);
-	int value = table_iterator(&self->fields, index);
+	int value = lit_instance_next_field(self, index);
 
 	return value == -1 ? NULL_VALUE : NUMBER_VALUE(value);
 }
@@ -304,7 +279,8 @@ LIT_METHOD(object_iteratorValue) {
 	uint index = LIT_CHECK_NUMBER(0);
 	LitInstance* self = AS_INSTANCE(instance);
 
-	return table_iterator_key(&self->fields, index);
+	LitString* name = lit_instance_field_name(self, (int) index);
+	return name == NULL ? NULL_VALUE : OBJECT_VALUE(name);
 }
 
 /*
@@ -450,7 +426,8 @@ LIT_METHOD(string_replace) {
 	LIT_ENSURE_ARGS(2)
 
 	if (!IS_STRING(args[0]) || !IS_STRING(args[1])) {
-		lit_runtime_error_exiting(vm, "Expected 2 string arguments");
+		lit_runtime_error(vm, "Expected 2 string arguments");
+		return NULL_VALUE;
 	}
 
 	LitString* string = AS_STRING(instance);
@@ -503,7 +480,8 @@ static LitValue string_splice(LitVm* vm, LitString* string, int from, int to) {
 	to = fmin(to, length - 1);
 
 	if (from > to) {
-		lit_runtime_error_exiting(vm, "String splice from bound is larger that to bound");
+		lit_runtime_error(vm, "String splice from bound is larger that to bound");
+		return NULL_VALUE;
 	}
 
 	from = lit_uchar_offset(string->chars, from);
@@ -529,7 +507,8 @@ LIT_METHOD(string_subscript) {
 	int index = LIT_CHECK_NUMBER(0);
 
 	if (arg_count != 1) {
-		lit_runtime_error_exiting(vm, "Can't modify strings with the subscript op");
+		lit_runtime_error(vm, "Can't modify strings with the subscript op");
+		return NULL_VALUE;
 	}
 
 	if (index < 0) {
@@ -616,7 +595,8 @@ LIT_METHOD(fiber_constructor) {
 	LitValue arg = args[0];
 
 	if (arg_count < 1 || (!IS_FUNCTION(arg) && !IS_CLOSURE(arg))) {
-		lit_runtime_error_exiting(vm, "Fiber constructor expects a function as its argument");
+		lit_runtime_error(vm, "Fiber constructor expects a function as its argument");
+		return NULL_VALUE;
 	}
 
 	LitModule* module = vm->fiber->module;
@@ -652,7 +632,8 @@ LIT_METHOD(fiber_current) {
 
 static void run_fiber(LitVm* vm, LitFiber* fiber, LitValue* args, uint arg_count, bool catcher) {
 	if (is_fiber_done(fiber)) {
-		lit_runtime_error_exiting(vm, "Fiber already finished executing");
+		lit_runtime_error(vm, "Fiber already finished executing");
+		return;
 	}
 
 	fiber->parent = vm->fiber;
@@ -800,6 +781,7 @@ LIT_METHOD(module_privates) {
 	if (map->index_fn == NULL) {
 		map->index_fn = access_private;
 		lit_table_set(vm->state, &map->values, CONST_STRING(vm->state, "_module"), OBJECT_VALUE(module));
+		LIT_REMEMBER_OBJECT(vm, map)
 	}
 
 	return OBJECT_VALUE(map);
@@ -837,7 +819,8 @@ static LitValue array_splice(LitVm* vm, LitArray* array, int from, int to) {
 	}
 
 	if (from > to) {
-		lit_runtime_error_exiting(vm, "String splice from bound is larger that to bound");
+		lit_runtime_error(vm, "String splice from bound is larger that to bound");
+		return NULL_VALUE;
 	}
 
 	from = fmax(from, 0);
@@ -863,7 +846,8 @@ LIT_METHOD(array_slice) {
 LIT_METHOD(array_subscript) {
 	if (arg_count == 2) {
 		if (!IS_NUMBER(args[0])) {
-			lit_runtime_error_exiting(vm, "Array index must be a number");
+			lit_runtime_error(vm, "Array index must be a number");
+			return NULL_VALUE;
 		}
 
 		LitValues* values = &AS_ARRAY(instance)->values;
@@ -883,7 +867,7 @@ LIT_METHOD(array_subscript) {
 			return array_splice(vm, AS_ARRAY(instance), (int) range->from, (int) range->to);
 		}
 
-		lit_runtime_error_exiting(vm, "Array index must be a number");
+		lit_runtime_error(vm, "Array index must be a number");
 		return NULL_VALUE;
 	}
 
@@ -894,7 +878,7 @@ LIT_METHOD(array_subscript) {
 		index = fmax(0, values->count + index);
 	}
 
-	if (values->capacity <= (uint) index) {
+	if (values->count <= (uint) index) {
 		return NULL_VALUE;
 	}
 
@@ -938,7 +922,8 @@ LIT_METHOD(array_addAll) {
 	LIT_ENSURE_ARGS(1)
 
 	if (!IS_ARRAY(args[0])) {
-		lit_runtime_error_exiting(vm, "Expected array as the argument");
+		lit_runtime_error(vm, "Expected array as the argument");
+		return NULL_VALUE;
 	}
 
 	LitArray* array = AS_ARRAY(instance);
@@ -953,7 +938,7 @@ LIT_METHOD(array_addAll) {
 
 static int indexOf(LitArray* array, LitValue value) {
 	for (uint i = 0; i < array->values.count; i++) {
-		if (array->values.values[i] == value) {
+		if (lit_values_equal(array->values.values[i], value)) {
 			return (int) i;
 		}
 	}
@@ -1060,7 +1045,8 @@ LIT_METHOD(array_forEach) {
 	LitValue callback = args[0];
 
 	if (!IS_CALLABLE_FUNCTION(callback)) {
-		lit_runtime_error_exiting(vm, "Expected a function as the callback");
+		lit_runtime_error(vm, "Expected a function as the callback");
+		return NULL_VALUE;
 	}
 
 	LitValues* values = &AS_ARRAY(instance)->values;
@@ -1105,7 +1091,13 @@ static inline bool compare(LitState* state, LitValue a, LitValue b) {
 		return AS_NUMBER(a) < AS_NUMBER(b);
 	}
 
-	return !lit_is_falsey(lit_find_and_call_method(state, a, CONST_STRING(state, "<"), (LitValue[1]) { b }, 1).result);
+	LitClass* klass = lit_get_class_for(state, a);
+
+	if (klass == NULL || klass->operators[OPERATOR_LESS] == NULL_VALUE) {
+		return false;
+	}
+
+	return !lit_is_falsey(lit_call_method(state, a, klass->operators[OPERATOR_LESS], (LitValue[1]) { b }, 1).result);
 }
 
 static void basic_quick_sort(LitState* state, LitValue *l, int length) {
@@ -1285,7 +1277,8 @@ LIT_METHOD(map_constructor) {
 
 LIT_METHOD(map_subscript) {
 	if (!IS_STRING(args[0])) {
-		lit_runtime_error_exiting(vm, "Map index must be a string");
+		lit_runtime_error(vm, "Map index must be a string");
+		return NULL_VALUE;
 	}
 
 	LitMap* map = AS_MAP(instance);
@@ -1319,7 +1312,8 @@ LIT_METHOD(map_addAll) {
 	LIT_ENSURE_ARGS(1)
 
 	if (!IS_MAP(args[0])) {
-		lit_runtime_error_exiting(vm, "Expected map as the argument");
+		lit_runtime_error(vm, "Expected map as the argument");
+		return NULL_VALUE;
 	}
 
 	lit_map_add_all(vm->state, AS_MAP(args[0]), AS_MAP(instance));
@@ -1335,13 +1329,13 @@ LIT_METHOD(map_iterator) {
 	LIT_ENSURE_ARGS(1)
 	int index = args[0] == NULL_VALUE ? -1 : AS_NUMBER(args[0]);
 
-	int value = table_iterator(&AS_MAP(instance)->values, index);
+	int value = lit_table_iterator(&AS_MAP(instance)->values, index);
 	return value == -1 ? NULL_VALUE : NUMBER_VALUE(value);
 }
 
 LIT_METHOD(map_iteratorValue) {
 	uint index = LIT_CHECK_NUMBER(0);
-	return table_iterator_key(&AS_MAP(instance)->values, index);
+	return lit_table_iterator_key(&AS_MAP(instance)->values, index);
 }
 
 LIT_METHOD(map_forEach) {
@@ -1349,16 +1343,19 @@ LIT_METHOD(map_forEach) {
 	LitValue callback = args[0];
 
 	if (!IS_CALLABLE_FUNCTION(callback)) {
-		lit_runtime_error_exiting(vm, "Expected a function as the callback");
+		lit_runtime_error(vm, "Expected a function as the callback");
+		return NULL_VALUE;
 	}
 
-	LitTable* values = &AS_MAP(instance)->values;
+	LitMap* map = AS_MAP(instance);
+	LitTable* values = &map->values;
 
 	for (int i = 0; i < values->capacity; i++) {
 		LitTableEntry* entry = &values->entries[i];
 
 		if (entry->key != NULL) {
-			lit_call(vm->state, callback, (LitValue[2]) { OBJECT_VALUE(entry->key), entry->value }, 2);
+			LitValue value = map->index_fn != NULL ? map->index_fn(vm, map, entry->key, NULL) : entry->value;
+			lit_call(vm->state, callback, (LitValue[2]) { OBJECT_VALUE(entry->key), value }, 2);
 		}
 	}
 
@@ -1581,7 +1578,7 @@ LIT_NATIVE(openLibrary) {
 	if (strcmp(name, "network") == 0) {
 		lit_open_network_library(vm->state);
 	} else {
-		lit_runtime_error_exiting(vm, "Unknown built-in library %s", name);
+		lit_runtime_error(vm, "Unknown built-in library %s", name);
 	}
 
 	return NULL_VALUE;
@@ -1609,7 +1606,12 @@ static bool compile_and_interpret(LitVm* vm, LitString* module_name, char* sourc
 }
 
 LIT_NATIVE_PRIMITIVE(eval) {
-	char* code = (char*) LIT_CHECK_STRING(0);
+	if (arg_count < 1 || !IS_STRING(args[0])) {
+		lit_argument_error(vm, args, arg_count, 0, "a string");
+		return true;
+	}
+
+	char* code = AS_STRING(args[0])->chars;
 	return compile_and_interpret(vm, vm->fiber->module->name, code);
 }
 
@@ -1622,13 +1624,15 @@ static bool should_update_locals;
 static bool attempt_to_require_combined(LitVm* vm, LitValue* args, uint arg_count, const char* a, const char* b, bool ignore_previous);
 typedef void (*library_loader)(LitState*);
 
+// Reported errors return true as well, so that require() stops looking for the module
 static bool attempt_to_require(LitVm* vm, LitValue* args, uint arg_count, const char* path, bool ignore_previous, bool folders) {
 	size_t length = strlen(path);
 	should_update_locals = false;
 
 	if (path[length - 2] == '.' && path[length - 1] == '*') {
 		if (folders) {
-			lit_runtime_error_exiting(vm, "Can't recursively require folders (beg @egordorichev for mercy)");
+			lit_runtime_error(vm, "Can't recursively require folders (beg @egordorichev for mercy)");
+			return true;
 		}
 
 		char dir_path[length - 1];
@@ -1665,7 +1669,8 @@ static bool attempt_to_require(LitVm* vm, LitValue* args, uint arg_count, const
 			DIR* dir = opendir(module_name);
 
 			if (dir == NULL) {
-				lit_runtime_error_exiting(vm, "Failed to open folder '%s'", module_name);
+				lit_runtime_error(vm, "Failed to open folder '%s'", module_name);
+				return true;
 			}
 
 			bool found = false;
@@ -1693,7 +1698,8 @@ static bool attempt_to_require(LitVm* vm, LitValue* args, uint arg_count, const
           dir_path[length] = '.';
 
           if (!attempt_to_require(vm, args + arg_count, 0, dir_path, false, false)) {
-            lit_runtime_error_exiting(vm, "Failed to require module '%s'", name);
+            lit_runtime_error(vm, "Failed to require module '%s'", name);
+            return true;
           } else {
             found = true;
           }
@@ -1701,7 +1707,8 @@ static bool attempt_to_require(LitVm* vm, LitValue* args, uint arg_count, const
 			}
 
 			if (!found) {
-				lit_runtime_error_exiting(vm, "Folder '%s' contains no modules that can be required", module_name);
+				lit_runtime_error(vm, "Folder '%s' contains no modules that can be required", module_name);
+				return true;
 			}
 
 			return found;
@@ -1778,7 +1785,8 @@ static bool attempt_to_require(LitVm* vm, LitValue* args, uint arg_count, const
             handle = LoadLibrary(full_path);
 
             if (handle == NULL) {
-                lit_runtime_error_exiting(vm, "Unable to require '%s' library", module_name);
+                lit_runtime_error(vm, "Unable to require '%s' library", module_name);
+                return true;
             }
 
             function = (library_loader) GetProcAddress(handle, "open_lit_library");
@@ -1788,15 +1796,16 @@ static bool attempt_to_require(LitVm* vm, LitValue* args, uint arg_count, const
             handle = dlopen(full_path, RTLD_NOW | RTLD_GLOBAL);
 
             if (handle == NULL) {
-                lit_runtime_error_exiting(vm, "Unable to require '%s' library %s", module_name, dlerror());
+                lit_runtime_error(vm, "Unable to require '%s' library %s", module_name, dlerror());
+                return true;
             }
 
             function = dlsym(handle, "open_lit_library");
         #endif
 
         if (function == NULL) {
-            lit_runtime_error_exiting(vm, "Unable to require '%s' library: it's missing 'open_lit_library()'", module_name);
-            return -1;
+            lit_runtime_error(vm, "Unable to require '%s' library: it's missing 'open_lit_library()'", module_name);
+            return true;
         }
 
 		function(vm->state);
@@ -1852,7 +1861,12 @@ LitBuiltinModule modules[] = {
 LIT_NATIVE_PRIMITIVE(require) {
 	vm->fiber->return_address = args - 1;
 
-	LitString* name = LIT_CHECK_OBJECT_STRING(0);
+	if (arg_count < 1 || !IS_STRING(args[0])) {
+		lit_argument_error(vm, args, arg_count, 0, "a string");
+		return true;
+	}
+
+	LitString* name = AS_STRING(args[0]);
 
 	for (uint i = 0;; i++) {
 		LitBuiltinModule* module = &modules[i];
@@ -1912,11 +1926,13 @@ LIT_NATIVE_PRIMITIVE(require) {
 		}
 	}
 
-	lit_runtime_error_exiting(vm, "Failed to require module '%s'", name->chars);
+	lit_runtime_error(vm, "Failed to require module '%s'", name->chars);
 	return true;
 }
 
 void lit_open_core_library(LitState* state) {
+	LIT_BEGIN_RETURNING_NATIVES()
+
 	LIT_BEGIN_CLASS("Class")
 		LIT_BIND_METHOD("toString", class_toString)
 		LIT_BIND_METHOD("[]", class_subscript)
@@ -2044,9 +2060,9 @@ void lit_open_core_library(LitState* state) {
 		LIT_BIND_METHOD("clear", array_clear)
 		LIT_BIND_METHOD("iterator", array_iterator)
 		LIT_BIND_METHOD("iteratorValue", array_iteratorValue)
-		LIT_BIND_METHOD("forEach", array_forEach)
+		LIT_BIND_BORROWING_METHOD("forEach", array_forEach)
 		LIT_BIND_METHOD("join", array_join)
-		LIT_BIND_METHOD("sort", array_sort)
+		LIT_BIND_BORROWING_METHOD("sort", array_sort)
 		LIT_BIND_METHOD("clone", array_clone)
 		LIT_BIND_METHOD("toString", array_toString)
 
@@ -2064,7 +2080,7 @@ void lit_open_core_library(LitState* state) {
 		LIT_BIND_METHOD("clear", map_clear)
 		LIT_BIND_METHOD("iterator", map_iterator)
 		LIT_BIND_METHOD("iteratorValue", map_iteratorValue)
-		LIT_BIND_METHOD("forEach", map_forEach)
+		LIT_BIND_BORROWING_METHOD("forEach", map_forEach)
 		LIT_BIND_METHOD("clone", map_clone)
 		LIT_BIND_METHOD("toString", map_toString)
 
@@ -2097,4 +2113,6 @@ void lit_open_core_library(LitState* state) {
 	lit_define_native_primitive(state, "eval", eval_primitive);
 
 	lit_set_global(state, CONST_STRING(state, "globals"), OBJECT_VALUE(state->vm->globals));
+
+	LIT_END_RETURNING_NATIVES()
 }
\ No newline at end of file
@@ -41,7 +41,8 @@ LIT_METHOD(file_constructor) {
 	FILE* file = fopen(path, mode);
 
 	if (file == NULL) {
-		lit_runtime_error_exiting(vm, "Failed to open file %s with mode %s (C error: %s)", path, mode, strerror(errno));
+		lit_runtime_error(vm, "Failed to open file %s with mode %s (C error: %s)", path, mode, strerror(errno));
+		return NULL_VALUE;
 	}
 
 	LitFileData* data = LIT_INSERT_DATA(LitFileData, cleanup_file);
@@ -77,7 +78,8 @@ LIT_METHOD(file_create) {
 	FILE* file = fopen(path, "w");
 
 	if (file == NULL) {
-		lit_runtime_error_exiting(vm, "Failed to create file %s", path);
+		lit_runtime_error(vm, "Failed to create file %s", path);
+		return NULL_VALUE;
 	}
 
 	fclose(file);
@@ -322,6 +324,8 @@ LIT_METHOD(directory_listDirectories) {
 }
 
 void lit_open_file_library(LitState* state) {
+	LIT_BEGIN_RETURNING_NATIVES()
+
 	LIT_BEGIN_CLASS("File")
 		LIT_BIND_STATIC_METHOD("exists", file_exists)
 		LIT_BIND_STATIC_METHOD("getLastModified", file_getLastModified)
@@ -356,4 +360,6 @@ void lit_open_file_library(LitState* state) {
 		LIT_BIND_STATIC_METHOD("listFiles", directory_listFiles)
 		LIT_BIND_STATIC_METHOD("listDirectories", directory_listDirectories)
 	LIT_END_CLASS()
+
+	LIT_END_RETURNING_NATIVES()
 }
\ No newline at end of file
@@ -18,11 +18,32 @@ LIT_METHOD(gc_trigger) {
 	return NUMBER_VALUE(collected);
 }
 
+// Spends up to the given amount of microseconds on the collection, returns true, once it's over
+LIT_METHOD(gc_step) {
+	uint64_t budget = (uint64_t) LIT_CHECK_NUMBER(0);
+
+	vm->state->allow_gc = true;
+	bool done = lit_collect_step(vm, budget);
+	vm->state->allow_gc = false;
+
+	return BOOL_VALUE(done);
+}
+
+LIT_METHOD(gc_collecting) {
+	return BOOL_VALUE(vm->gc_phase != LIT_GC_IDLE);
+}
+
 void lit_open_gc_library(LitState* state) {
+	LIT_BEGIN_RETURNING_NATIVES()
+
 	LIT_BEGIN_CLASS("GC")
 		LIT_BIND_STATIC_GETTER("memoryUsed", gc_memory_used)
 		LIT_BIND_STATIC_GETTER("nextRound", gc_next_round)
+		LIT_BIND_STATIC_GETTER("collecting", gc_collecting)
 
 		LIT_BIND_STATIC_METHOD("trigger", gc_trigger)
+		LIT_BIND_STATIC_METHOD("step", gc_step)
 	LIT_END_CLASS()
+
+	LIT_END_RETURNING_NATIVES()
 }
\ No newline at end of file
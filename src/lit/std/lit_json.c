@@ -48,7 +48,7 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 				if (IS_ARRAY(current)) {
 					lit_values_write(vm->state, &AS_ARRAY(current)->values, OBJECT_VALUE(instance));
 				} else if (IS_INSTANCE(current)) {
-					lit_table_set(vm->state, &AS_INSTANCE(current)->fields, identifier, OBJECT_VALUE(instance));
+					lit_instance_set(vm->state, AS_INSTANCE(current), identifier, OBJECT_VALUE(instance));
 				}
 
 				current_value->value = current;
@@ -71,7 +71,7 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 				if (IS_ARRAY(current)) {
 					lit_values_write(vm->state, &AS_ARRAY(current)->values, OBJECT_VALUE(array));
 				} else if (IS_INSTANCE(current)) {
-					lit_table_set(vm->state, &AS_INSTANCE(current)->fields, identifier, OBJECT_VALUE(array));
+					lit_instance_set(vm->state, AS_INSTANCE(current), identifier, OBJECT_VALUE(array));
 				}
 
 				current_value->value = current;
@@ -114,7 +114,8 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 			case '"': {
 				if (!expecting_identifier) {
 					FREE_ALL()
-					lit_runtime_error_exiting(vm, "Unexpected string");
+					lit_runtime_error(vm, "Unexpected string");
+					return NULL_VALUE;
 				}
 
 				const char* identifier_start = ch + 1;
@@ -125,7 +126,8 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 
 				if (*ch == '\0') {
 					FREE_ALL()
-					lit_runtime_error_exiting(vm, "Unclosed string");
+					lit_runtime_error(vm, "Unclosed string");
+					return NULL_VALUE;
 				}
 
 				LitString* string = lit_copy_string(vm->state, identifier_start, ch - identifier_start);
@@ -137,7 +139,7 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 					if (IS_ARRAY(current)) {
 						lit_values_write(vm->state, &AS_ARRAY(current)->values, OBJECT_VALUE(string));
 					} else if (IS_INSTANCE(current)) {
-						lit_table_set(vm->state, &AS_INSTANCE(current)->fields, identifier, OBJECT_VALUE(string));
+						lit_instance_set(vm->state, AS_INSTANCE(current), identifier, OBJECT_VALUE(string));
 					}
 				} else {
 					expecting_colon = true;
@@ -150,7 +152,8 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 			case ':': {
 				if (!expecting_colon) {
 					FREE_ALL()
-					lit_runtime_error_exiting(vm, "Unexpected ':'");
+					lit_runtime_error(vm, "Unexpected ':'");
+					return NULL_VALUE;
 				}
 
 				expecting_colon = false;
@@ -175,7 +178,8 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 			case 't': {
 				if (!parsing_value) {
 					FREE_ALL()
-					lit_runtime_error_exiting(vm, "Unexpected identifier");
+					lit_runtime_error(vm, "Unexpected identifier");
+					return NULL_VALUE;
 				}
 
 				if (*++ch == 'r') {
@@ -184,7 +188,7 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 							if (IS_ARRAY(current)) {
 								lit_values_write(vm->state, &AS_ARRAY(current)->values, BOOL_VALUE(true));
 							} else if (IS_INSTANCE(current)) {
-								lit_table_set(vm->state, &AS_INSTANCE(current)->fields, identifier, BOOL_VALUE(true));
+								lit_instance_set(vm->state, AS_INSTANCE(current), identifier, BOOL_VALUE(true));
 							}
 
 							expecting_identifier = false;
@@ -196,15 +200,15 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 				}
 
 				FREE_ALL()
-				lit_runtime_error_exiting(vm, "Unexpected identifier");
-
-				break;
+				lit_runtime_error(vm, "Unexpected identifier");
+				return NULL_VALUE;
 			}
 
 			case 'f': {
 				if (!parsing_value) {
 					FREE_ALL()
-					lit_runtime_error_exiting(vm, "Unexpected identifier");
+					lit_runtime_error(vm, "Unexpected identifier");
+					return NULL_VALUE;
 				}
 
 				if (*++ch == 'a') {
@@ -214,7 +218,7 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 								if (IS_ARRAY(current)) {
 									lit_values_write(vm->state, &AS_ARRAY(current)->values, BOOL_VALUE(false));
 								} else if (IS_INSTANCE(current)) {
-									lit_table_set(vm->state, &AS_INSTANCE(current)->fields, identifier, BOOL_VALUE(false));
+									lit_instance_set(vm->state, AS_INSTANCE(current), identifier, BOOL_VALUE(false));
 								}
 
 								expecting_identifier = false;
@@ -227,15 +231,15 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 				}
 
 				FREE_ALL()
-				lit_runtime_error_exiting(vm, "Unexpected identifier");
-
-				break;
+				lit_runtime_error(vm, "Unexpected identifier");
+				return NULL_VALUE;
 			}
 
 			case 'n': {
 				if (!parsing_value) {
 					FREE_ALL()
-					lit_runtime_error_exiting(vm, "Unexpected identifier");
+					lit_runtime_error(vm, "Unexpected identifier");
+					return NULL_VALUE;
 				}
 
 				if (*++ch == 'u') {
@@ -244,7 +248,7 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 							if (IS_ARRAY(current)) {
 								lit_values_write(vm->state, &AS_ARRAY(current)->values, NULL_VALUE);
 							} else if (IS_INSTANCE(current)) {
-								lit_table_set(vm->state, &AS_INSTANCE(current)->fields, identifier, NULL_VALUE);
+								lit_instance_set(vm->state, AS_INSTANCE(current), identifier, NULL_VALUE);
 							}
 
 							expecting_identifier = false;
@@ -256,16 +260,16 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 				}
 
 				FREE_ALL()
-				lit_runtime_error_exiting(vm, "Unexpected identifier");
-
-				break;
+				lit_runtime_error(vm, "Unexpected identifier");
+				return NULL_VALUE;
 			}
 
 			default: {
 				if (lit_is_digit(c)) {
 					if (!parsing_value) {
 						FREE_ALL()
-						lit_runtime_error_exiting(vm, "Unexpected number");
+						lit_runtime_error(vm, "Unexpected number");
+						return NULL_VALUE;
 					}
 
 					const char* number_start = ch;
@@ -289,14 +293,15 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 					if (IS_ARRAY(current)) {
 						lit_values_write(vm->state, &AS_ARRAY(current)->values, NUMBER_VALUE(number));
 					} else if (IS_INSTANCE(current)) {
-						lit_table_set(vm->state, &AS_INSTANCE(current)->fields, identifier, NUMBER_VALUE(number));
+						lit_instance_set(vm->state, AS_INSTANCE(current), identifier, NUMBER_VALUE(number));
 					}
 
 					expecting_identifier = false;
 					ch--;
 				} else {
 					FREE_ALL()
-					lit_runtime_error_exiting(vm, "Unexpected character '%c' in JSON", c);
+					lit_runtime_error(vm, "Unexpected character '%c' in JSON", c);
+					return NULL_VALUE;
 				}
 
 				break;
@@ -306,12 +311,14 @@ LitValue lit_json_parse(LitVm* vm, LitString* string) {
 
 	if (array_depth != 0) {
 		FREE_ALL()
-		lit_runtime_error_exiting(vm, "Unclosed '['");
+		lit_runtime_error(vm, "Unclosed '['");
+		return NULL_VALUE;
 	}
 
 	if (object_depth != 0) {
 		FREE_ALL()
-		lit_runtime_error_exiting(vm, "Unclosed '{'");
+		lit_runtime_error(vm, "Unclosed '{'");
+		return NULL_VALUE;
 	}
 
 	#undef FREE_ALL
@@ -324,7 +331,8 @@ LIT_METHOD(json_parse) {
 	LIT_ENSURE_ARGS(1)
 
 	if (!IS_STRING(args[0])) {
-		lit_runtime_error_exiting(vm, "Argument #1 must be a string");
+		lit_runtime_error(vm, "Argument #1 must be a string");
+		return NULL_VALUE;
 	}
 
 	return lit_json_parse(vm, AS_STRING(args[0]));
@@ -422,41 +430,37 @@ LitString* json_instance_to_string(LitVm* vm, LitValue instance, uint indentatio
 
 	LitState* state = vm->state;
 	LitInstance* object = AS_INSTANCE(instance);
-	LitTable* values = &object->fields;
+	uint value_amount = lit_instance_field_count(object);
 
-	if (values->count == 0) {
+	if (value_amount == 0) {
 		return CONST_STRING(state, "{}");
 	}
 
-	uint value_amount = values->count;
-
 	LitString* values_converted[value_amount];
 	LitString* keys[value_amount];
 
 	uint string_length = 2 + indentation;
 
 	uint i = 0;
-	uint index = 0;
-
-	do {
-		LitTableEntry* entry = &values->entries[index++];
+	int index = -1;
 
-		if (entry->key != NULL) {
-			LitString* value = lit_json_to_string(state->vm, entry->value, indentation);
+	while ((index = lit_instance_next_field(object, index)) != -1 && i < value_amount) {
+		LitString* key = lit_instance_field_name(object, index);
+		LitValue field = lit_instance_field_value(object, index);
+		LitString* value = lit_json_to_string(state->vm, field, indentation);
 
-			lit_push_root(state, (LitObject*) value);
+		lit_push_root(state, (LitObject*) value);
 
-			if (IS_STRING(entry->value)) {
-				value = AS_STRING(lit_string_format(state, "\"@\"", OBJECT_VALUE(value)));
-			}
+		if (IS_STRING(field)) {
+			value = AS_STRING(lit_string_format(state, "\"@\"", OBJECT_VALUE(value)));
+		}
 
-			values_converted[i] = value;
-			keys[i] = entry->key;
-			string_length += entry->key->length + 4 + value->length + (i == value_amount - 1 ? 1 : 2) + indentation;
+		values_converted[i] = value;
+		keys[i] = key;
+		string_length += key->length + 4 + value->length + (i == value_amount - 1 ? 1 : 2) + indentation;
 
-			i++;
-		}
-	} while (i < value_amount);
+		i++;
+	}
 
 	char buffer[string_length + 1];
 	uint buffer_index = 2;
@@ -571,8 +575,12 @@ LIT_METHOD(json_toString) {
 }
 
 void lit_open_json_library(LitState* state) {
+	LIT_BEGIN_RETURNING_NATIVES()
+
 	LIT_BEGIN_CLASS("JSON")
 		LIT_BIND_STATIC_METHOD("parse", json_parse)
 		LIT_BIND_STATIC_METHOD("toString", json_toString)
 	LIT_END_CLASS()
+
+	LIT_END_RETURNING_NATIVES()
 }
\ No newline at end of file
@@ -110,7 +110,7 @@ static uint* extract_random_data(LitState* state, LitValue instance) {
 
 	LitValue data;
 
-	if (!lit_table_get(&AS_INSTANCE(instance)->fields, CONST_STRING(state, "_data"), &data)) {
+	if (!lit_instance_get(AS_INSTANCE(instance), CONST_STRING(state, "_data"), &data)) {
 		return 0;
 	}
 
@@ -119,7 +119,7 @@ static uint* extract_random_data(LitState* state, LitValue instance) {
 
 LIT_METHOD(random_constructor) {
 	LitUserdata* userdata = lit_create_userdata(vm->state, sizeof(uint));
-	lit_table_set(vm->state, &AS_INSTANCE(instance)->fields, CONST_STRING(vm->state, "_data"), OBJECT_VALUE(userdata));
+	lit_instance_set(vm->state, AS_INSTANCE(instance), CONST_STRING(vm->state, "_data"), OBJECT_VALUE(userdata));
 
 	uint* data = (uint*) userdata->data;
 
@@ -236,7 +236,8 @@ LIT_METHOD(random_pick) {
 				}
 			}
 		} else {
-			lit_runtime_error_exiting(vm, "Expected map or array as the argument");
+			lit_runtime_error(vm, "Expected map or array as the argument");
+			return NULL_VALUE;
 		}
 	} else {
 		return args[value % arg_count];
@@ -246,6 +247,8 @@ LIT_METHOD(random_pick) {
 }
 
 void lit_open_math_library(LitState* state) {
+	LIT_BEGIN_RETURNING_NATIVES()
+
 	LIT_BEGIN_CLASS("Math")
 		LIT_SET_STATIC_FIELD("Pi", NUMBER_VALUE(M_PI))
 		LIT_SET_STATIC_FIELD("Tau", NUMBER_VALUE(M_PI * 2))
@@ -292,4 +295,6 @@ void lit_open_math_library(LitState* state) {
 		LIT_BIND_STATIC_METHOD("chance", random_chance)
 		LIT_BIND_STATIC_METHOD("pick", random_pick)
 	LIT_END_CLASS()
+
+	LIT_END_RETURNING_NATIVES()
 }
\ No newline at end of file
@@ -151,7 +151,8 @@ static int parse_url(LitState* state, char* url, LitUrl *parsed_url) {
 	lit_reallocate(state, host_port, host_port_size, 0);
 
 	if (token != NULL) {
-		lit_runtime_error_exiting(state->vm, "Url parsing fail");
+		lit_runtime_error(state->vm, "Url parsing fail");
+		return -1;
 	}
 
 	return 0;
@@ -174,10 +175,11 @@ LIT_METHOD(networkRequest_contructor) {
 
 	if (arg_count > 3 && !IS_NULL(args[3])) {
 		if (!IS_INSTANCE(args[3])) {
-			lit_runtime_error_exiting(vm, "Headers (argument #3) must be an object");
+			lit_runtime_error(vm, "Headers (argument #3) must be an object");
+			return NULL_VALUE;
 		}
 
-		headers = &AS_INSTANCE(args[3])->fields;
+		headers = lit_instance_make_dictionary(state, AS_INSTANCE(args[3]));
 	} else {
 		allocated_headers = true;
 		headers = lit_reallocate(state, NULL, 0, sizeof(LitTable));
@@ -197,7 +199,8 @@ LIT_METHOD(networkRequest_contructor) {
 		get = true;
 	} else if (strcmp(method, "post") != 0) {
 		FREE_HEADERS()
-		lit_runtime_error_exiting(vm, "Method (argument #2) must be either 'post' or 'get'");
+		lit_runtime_error(vm, "Method (argument #2) must be either 'post' or 'get'");
+		return NULL_VALUE;
 	}
 
 	if (arg_count > 2 && !IS_NULL(args[2])) {
@@ -210,7 +213,7 @@ LIT_METHOD(networkRequest_contructor) {
 				if (IS_MAP(body_arg)) {
 					values = &AS_MAP(body_arg)->values;
 				} else {
-					values = &AS_INSTANCE(body_arg)->fields;
+					values = lit_instance_make_dictionary(state, AS_INSTANCE(body_arg));
 				}
 
 				uint value_amount = values->count;
@@ -280,7 +283,13 @@ LIT_METHOD(networkRequest_contructor) {
 	url_data.protocol = NULL;
 	url_data.port = 80;
 
-	parse_url(state, (char*) url, &url_data);
+	if (parse_url(state, (char*) url, &url_data) != 0) {
+		free_parsed_url(state, &url_data);
+		FREE_HEADERS()
+
+		return NULL_VALUE;
+	}
+
 	lit_table_set(state, headers, CONST_STRING(state, "Host"), OBJECT_CONST_STRING(state, url_data.host));
 
 	data->bytes = 0;
@@ -291,7 +300,8 @@ LIT_METHOD(networkRequest_contructor) {
 	if (https) {
 		free_parsed_url(state, &url_data);
 		FREE_HEADERS()
-		lit_runtime_error_exiting(vm, "HTTP does not support HTTPS, use a library instead");
+		lit_runtime_error(vm, "HTTP does not support HTTPS, use a library instead");
+		return NULL_VALUE;
 	}
 
 	const char* method_string = get ? "GET" : "POST";
@@ -344,7 +354,8 @@ LIT_METHOD(networkRequest_contructor) {
 	if (data->socket < 0) {
 		free_parsed_url(state, &url_data);
 		FREE_HEADERS()
-		lit_runtime_error_exiting(vm, "Error opening socket");
+		lit_runtime_error(vm, "Error opening socket");
+		return NULL_VALUE;
 	}
 
 	struct hostent* server = gethostbyname(url_data.host);
@@ -352,7 +363,8 @@ LIT_METHOD(networkRequest_contructor) {
 	if (server == NULL) {
 		free_parsed_url(state, &url_data);
 		FREE_HEADERS()
-		lit_runtime_error_exiting(vm, "Error resolving the host");
+		lit_runtime_error(vm, "Error resolving the host");
+		return NULL_VALUE;
 	}
 
 	struct sockaddr_in server_address;
@@ -366,7 +378,8 @@ LIT_METHOD(networkRequest_contructor) {
 	if (connect(data->socket, (struct sockaddr*) &server_address, sizeof(server_address)) < 0) {
 		free_parsed_url(state, &url_data);
 		FREE_HEADERS()
-		lit_runtime_error_exiting(vm, "Connection error");
+		lit_runtime_error(vm, "Connection error");
+		return NULL_VALUE;
 	}
 
 	data->total_length = data->message_length;
@@ -383,7 +396,8 @@ LIT_METHOD(networkRequest_write) {
 	int bytes = write(data->socket,data->message + data->bytes, data->total_length - data->bytes);
 
 	if (bytes < 0) {
-		lit_runtime_error_exiting(vm, "Error writing message to the socket");
+		lit_runtime_error(vm, "Error writing message to the socket");
+		return NULL_VALUE;
 	}
 
 	if (bytes != 0) {
@@ -415,7 +429,8 @@ LIT_METHOD(networkRequest_read) {
 	int bytes = read(data->socket, data->message + data->bytes, data->total_length - data->bytes);
 
 	if (bytes < 0) {
-		lit_runtime_error_exiting(vm, "Error reading response");
+		lit_runtime_error(vm, "Error reading response");
+		return NULL_VALUE;
 	}
 
 	if (bytes != 0) {
@@ -436,10 +451,10 @@ LIT_METHOD(networkRequest_read) {
 	close(data->socket);
 
 	LitInstance* response = lit_create_instance(state, state->object_class);
-	LitTable* response_table = &response->fields;
+	LitTable* response_table = lit_instance_make_dictionary(state, response);
 
 	LitInstance* headers = lit_create_instance(state, state->object_class);
-	LitTable* headers_table = &headers->fields;
+	LitTable* headers_table = lit_instance_make_dictionary(state, headers);
 
 	lit_table_set(state, response_table, CONST_STRING(state, "headers"), OBJECT_VALUE(headers));
 
@@ -517,9 +532,13 @@ LIT_METHOD(networkRequest_read) {
 }
 
 void lit_open_network_library(LitState* state) {
+	LIT_BEGIN_RETURNING_NATIVES()
+
 	LIT_BEGIN_CLASS("NetworkRequest")
 		LIT_BIND_CONSTRUCTOR(networkRequest_contructor)
 		LIT_BIND_METHOD("write", networkRequest_write)
 		LIT_BIND_METHOD("read", networkRequest_read)
 	LIT_END_CLASS()
+
+	LIT_END_RETURNING_NATIVES()
 }
\ No newline at end of file
@@ -7,7 +7,8 @@ LIT_METHOD(timer_add) {
 	LitValue callback = args[0];
 
 	if (!IS_CALLABLE_FUNCTION(callback)) {
-		lit_runtime_error_exiting(vm, "Expected a function as the callback");
+		lit_runtime_error(vm, "Expected a function as the callback");
+		return NULL_VALUE;
 	}
 
 	uint64_t delay = LIT_CHECK_NUMBER(1);
@@ -17,7 +18,11 @@ LIT_METHOD(timer_add) {
 }
 
 void lit_open_event_library(LitState* state) {
+	LIT_BEGIN_RETURNING_NATIVES()
+
 	LIT_BEGIN_CLASS("Timer")
 		LIT_BIND_STATIC_METHOD("add", timer_add)
 	LIT_END_CLASS()
+
+	LIT_END_RETURNING_NATIVES()
 }
\ No newline at end of file
@@ -155,11 +155,73 @@ LitString* lit_read_estring(LitState* state, LitEmulatedFile* file) {
 	return lit_copy_string(state, line, length);
 }
 
-static void save_chunk(FILE* file, LitChunk* chunk);
-static void load_chunk(LitState* state, LitEmulatedFile* file, LitModule* module, LitChunk* chunk);
+/*
+ * Since version 3 the strings and numbers of all the chunks in a module are written once, into a pool
+ * in front of the module code, and the chunks only refer to them by their position in it
+ */
+typedef struct {
+	LitValues values;
+	LitConstantIndex index;
+} LitConstantPool;
+
+static void collect_constants(LitState* state, LitConstantPool* pool, LitChunk* chunk) {
+	for (uint i = 0; i < chunk->constants.count; i++) {
+		LitValue constant = chunk->constants.values[i];
+
+		if (IS_FUNCTION(constant)) {
+			collect_constants(state, pool, &AS_FUNCTION(constant)->chunk);
+		} else if (lit_find_constant(&pool->index, &pool->values, constant) == -1) {
+			lit_values_write(state, &pool->values, constant);
+			lit_index_constant(state, &pool->index, &pool->values, pool->values.count - 1);
+		}
+	}
+}
+
+static void save_pool(FILE* file, LitConstantPool* pool) {
+	lit_write_uint32_t(file, pool->values.count);
+
+	for (uint i = 0; i < pool->values.count; i++) {
+		LitValue constant = pool->values.values[i];
+
+		if (IS_STRING(constant)) {
+			lit_write_uint8_t(file, (uint8_t) (OBJECT_STRING + 1));
+			lit_write_string(file, AS_STRING(constant));
+		} else if (IS_NUMBER(constant)) {
+			lit_write_uint8_t(file, 0);
+			lit_write_double(file, AS_NUMBER(constant));
+		} else {
+			UNREACHABLE
+		}
+	}
+}
+
+// Pool indexes are only as wide as the pool needs them to be, index equal to the pool size marks a function, that follows
+static void write_pool_index(FILE* file, uint pool_size, uint index) {
+	if (pool_size < UINT8_MAX) {
+		lit_write_uint8_t(file, (uint8_t) index);
+	} else if (pool_size < UINT16_MAX) {
+		lit_write_uint16_t(file, (uint16_t) index);
+	} else {
+		lit_write_uint32_t(file, index);
+	}
+}
 
-static void save_function(FILE* file, LitFunction* function) {
-	save_chunk(file, &function->chunk);
+static uint read_pool_index(LitEmulatedFile* file, uint pool_size) {
+	if (pool_size < UINT8_MAX) {
+		return lit_read_euint8_t(file);
+	} else if (pool_size < UINT16_MAX) {
+		return lit_read_euint16_t(file);
+	}
+
+	return lit_read_euint32_t(file);
+}
+
+static void save_chunk(FILE* file, LitConstantPool* pool, LitChunk* chunk);
+static void load_chunk(LitState* state, LitEmulatedFile* file, LitModule* module, LitValues* pool, LitChunk* chunk, uint8_t version);
+static void upgrade_function(LitState* state, LitFunction* function, uint8_t version);
+
+static void save_function(FILE* file, LitConstantPool* pool, LitFunction* function) {
+	save_chunk(file, pool, &function->chunk);
 	lit_write_string(file, function->name);
 
 	lit_write_uint8_t(file, function->arg_count);
@@ -168,10 +230,10 @@ static void save_function(FILE* file, LitFunction* function) {
 	lit_write_uint8_t(file, (uint16_t) function->max_registers);
 }
 
-static LitFunction* load_function(LitState* state, LitEmulatedFile* file, LitModule* module) {
+static LitFunction* load_function(LitState* state, LitEmulatedFile* file, LitModule* module, LitValues* pool, uint8_t version) {
 	LitFunction* function = lit_create_function(state, module);
 
-	load_chunk(state, file, module, &function->chunk);
+	load_chunk(state, file, module, pool, &function->chunk, version);
 	function->name = lit_read_estring(state, file);
 
 	function->arg_count = lit_read_euint8_t(file);
@@ -179,14 +241,18 @@ static LitFunction* load_function(LitState* state, LitEmulatedFile* file, LitMod
 	function->vararg = (bool) lit_read_euint8_t(file);
 	function->max_registers = lit_read_euint8_t(file);
 
+	if (version < 4) {
+		upgrade_function(state, function, version);
+	}
+
 	return function;
 }
 
-static void save_chunk(FILE* file, LitChunk* chunk) {
+static void save_chunk(FILE* file, LitConstantPool* pool, LitChunk* chunk) {
 	lit_write_uint32_t(file, chunk->count);
 
 	for (uint i = 0; i < chunk->count; i++) {
-		lit_write_uint64_t(file, chunk->code[i]);
+		lit_write_uint32_t(file, chunk->code[i]);
 	}
 
 	if (chunk->has_line_info) {
@@ -205,43 +271,228 @@ static void save_chunk(FILE* file, LitChunk* chunk) {
 	for (uint i = 0; i < chunk->constants.count; i++) {
 		LitValue constant = chunk->constants.values[i];
 
-		if (IS_OBJECT(constant)) {
-			LitObjectType type = AS_OBJECT(constant)->type;
-			lit_write_uint8_t(file, (uint8_t) (type + 1));
+		if (IS_FUNCTION(constant)) {
+			write_pool_index(file, pool->values.count, pool->values.count);
+			save_function(file, pool, AS_FUNCTION(constant));
+		} else {
+			write_pool_index(file, pool->values.count, (uint) lit_find_constant(&pool->index, &pool->values, constant));
+		}
+	}
+}
 
-			switch (type) {
-				case OBJECT_STRING: {
-					lit_write_string(file, AS_STRING(constant));
-					break;
-				}
+typedef struct {
+	uint8_t opcode;
+	uint8_t a;
+	uint16_t b;
+	uint16_t c;
+	uint32_t bx;
+	int32_t sbx;
+} LitOldInstruction;
+
+// Before version 2 the opcode was 6 bits and A was 8 bits, holding some of the constant and upvalue indexes too,
+// versions 2 and 3 had a 7 bit opcode and a 7 bit A, all of them had 9 bit B and C, each with its own constant flag
+static LitOldInstruction decode_old_instruction(uint32_t word, uint8_t version) {
+	LitOldInstruction old;
+	uint32_t rest = word >> 14; // B, C, Bx and sBx didn't move
+
+	if (version < 2) {
+		old.opcode = word & 0x3f;
+		old.a = (word >> 6) & 0xff;
+	} else {
+		old.opcode = word & 0x7f;
+		old.a = (word >> 7) & 0x7f;
+	}
 
-				case OBJECT_FUNCTION: {
-					save_function(file, AS_FUNCTION(constant));
-					break;
-				}
+	old.b = rest & 0x1ff;
+	old.c = (rest >> 9) & 0x1ff;
+	old.bx = rest & 0x3ffff;
+	old.sbx = (int32_t) ((rest >> 1) & 0x1ffff) * ((rest & 0x1) == 1 ? -1 : 1);
 
-				default: {
-					UNREACHABLE
-					break;
-				}
+	if (version < 2) {
+		if (old.opcode == OP_SET_GLOBAL || old.opcode == OP_SET_UPVALUE) {
+			old.c = old.a;
+			old.a = 0;
+		} else if (old.opcode == OP_CLASS) {
+			uint8_t name = old.a;
+
+			old.a = old.c;
+			old.c = name;
+		}
+	}
+
+	return old;
+}
+
+// The constant, that the old instruction had in an operand, that can only be a register now (or 0)
+static uint16_t get_displaced_constant(LitOldInstruction* old) {
+	if (lit_get_instruction_type(old->opcode) == LIT_INSTRUCTION_ABCK) {
+		return IS_BIT_SET(old->b, 8) ? old->b : 0;
+	}
+
+	switch (old->opcode) {
+		case OP_RANGE:
+		case OP_STATIC_FIELD:
+		case OP_METHOD:
+		case OP_PUSH_OBJECT_ELEMENT: {
+			return IS_BIT_SET(old->c, 8) ? old->c : 0;
+		}
+
+		default: return 0;
+	}
+}
+
+static bool upgrade_jump(uint* offsets, uint count, int64_t target, int64_t from, int64_t* offset) {
+	if (target < 0 || target > count) {
+		return false;
+	}
+
+	*offset = (int64_t) offsets[target] - from;
+	return true;
+}
+
+// Version 4 moved the constant flag of B and C into a shared K bit, to give A all 8 bits,
+// so the old code is formed again, with the constants, that don't fit anymore, moved into a spare register first
+static void upgrade_function(LitState* state, LitFunction* function, uint8_t version) {
+	LitChunk* chunk = &function->chunk;
+	uint count = chunk->count;
+
+	if (count == 0) {
+		return;
+	}
+
+	uint* offsets = LIT_ALLOCATE(state, uint, count + 1);
+	uint16_t* lines = LIT_ALLOCATE(state, uint16_t, count);
+	uint new_count = 0;
+	uint line_count = 0;
+
+	for (uint i = 0; i < count; i++) {
+		LitOldInstruction old = decode_old_instruction(chunk->code[i], version);
+
+		offsets[i] = new_count;
+		new_count += get_displaced_constant(&old) != 0 ? 2 : 1;
+	}
+
+	offsets[count] = new_count;
+
+	if (chunk->has_line_info) {
+		for (uint index = 0; index + 1 < chunk->line_count && line_count < count; index += 2) {
+			for (uint i = 0; i < chunk->lines[index + 1] && line_count < count; i++) {
+				lines[line_count++] = chunk->lines[index];
 			}
-		} else {
-			lit_write_uint8_t(file, 0);
-			lit_write_double(file, AS_NUMBER(constant));
 		}
 	}
+
+	while (line_count < count) {
+		lines[line_count++] = 0;
+	}
+
+	bool scratch_used = new_count > count;
+	uint8_t scratch = function->max_registers;
+	bool fits = !scratch_used || function->max_registers < UINT8_MAX;
+
+	LitChunk upgraded;
+
+	lit_init_chunk(&upgraded);
+	upgraded.has_line_info = chunk->has_line_info;
+
+	for (uint i = 0; i < count && fits; i++) {
+		LitOldInstruction old = decode_old_instruction(chunk->code[i], version);
+		uint16_t constant = get_displaced_constant(&old);
+		int64_t position = offsets[i + 1] - 1;
+		int64_t offset = 0;
+
+		if (constant != 0) {
+			lit_write_chunk(state, &upgraded, LIT_FORM_ABC_INSTRUCTION(OP_MOVE, scratch, constant, 0), lines[i]);
+
+			if (lit_get_instruction_type(old.opcode) == LIT_INSTRUCTION_ABCK) {
+				old.b = scratch;
+			} else {
+				old.c = scratch;
+			}
+		}
+
+		if (old.opcode == OP_JUMP) {
+			fits = upgrade_jump(offsets, count, (int64_t) i + 1 + old.sbx, position + 1, &offset);
+			old.sbx = (int32_t) offset;
+		} else if (old.opcode == OP_TRUE_JUMP || old.opcode == OP_FALSE_JUMP || old.opcode == OP_NULL_JUMP || old.opcode == OP_NON_NULL_JUMP) {
+			fits = upgrade_jump(offsets, count, (int64_t) i + 1 + old.bx, position + 1, &offset);
+			old.bx = (uint32_t) offset;
+		} else if (old.opcode == OP_FOR_ITER) {
+			fits = upgrade_jump(offsets, count, (int64_t) i - old.c, 0, &offset);
+			old.c = (uint16_t) (position - offset);
+		}
+
+		switch (lit_get_instruction_type(old.opcode)) {
+			case LIT_INSTRUCTION_ABX: {
+				fits = fits && old.bx <= LIT_BX_ARG_SIZE;
+				lit_write_chunk(state, &upgraded, LIT_FORM_ABX_INSTRUCTION(old.opcode, old.a, old.bx), lines[i]);
+
+				break;
+			}
+
+			case LIT_INSTRUCTION_ASBX: {
+				fits = fits && abs(old.sbx) <= LIT_SBX_ARG_SIZE;
+				lit_write_chunk(state, &upgraded, LIT_FORM_ASBX_INSTRUCTION(old.opcode, old.a, old.sbx), lines[i]);
+
+				break;
+			}
+
+			case LIT_INSTRUCTION_ABCK: {
+				fits = fits && old.b <= LIT_B_ARG_SIZE;
+				lit_write_chunk(state, &upgraded, LIT_FORM_ABC_INSTRUCTION(old.opcode, old.a, old.b, old.c), lines[i]);
+
+				break;
+			}
+
+			default: {
+				fits = fits && old.c <= LIT_C_ARG_SIZE;
+				lit_write_chunk(state, &upgraded, LIT_FORM_ABC_INSTRUCTION(old.opcode, old.a, old.b, old.c), lines[i]);
+
+				break;
+			}
+		}
+	}
+
+	LIT_FREE_ARRAY(state, uint, offsets, count + 1);
+	LIT_FREE_ARRAY(state, uint16_t, lines, count);
+
+	if (!fits) {
+		LIT_FREE_ARRAY(state, uint32_t, upgraded.code, upgraded.capacity);
+		LIT_FREE_ARRAY(state, uint16_t, upgraded.lines, upgraded.line_capacity);
+
+		if (!state->had_error) {
+			lit_error(state, COMPILE_ERROR, "Failed to read compiled code, it doesn't fit into the current instruction format, recompile it");
+		}
+
+		return;
+	}
+
+	LIT_FREE_ARRAY(state, uint32_t, chunk->code, chunk->capacity);
+	LIT_FREE_ARRAY(state, uint16_t, chunk->lines, chunk->line_capacity);
+
+	chunk->code = upgraded.code;
+	chunk->count = upgraded.count;
+	chunk->capacity = upgraded.capacity;
+	chunk->lines = upgraded.lines;
+	chunk->line_count = upgraded.line_count;
+	chunk->line_capacity = upgraded.line_capacity;
+
+	if (scratch_used) {
+		function->max_registers++;
+	}
 }
 
-static void load_chunk(LitState* state, LitEmulatedFile* file, LitModule* module, LitChunk* chunk) {
+static void load_chunk(LitState* state, LitEmulatedFile* file, LitModule* module, LitValues* pool, LitChunk* chunk, uint8_t version) {
 	lit_init_chunk(chunk);
 	uint count = lit_read_euint32_t(file);
 
-	chunk->code = (uint64_t*) lit_reallocate(state, NULL, 0, sizeof(uint64_t) * count);
+	chunk->code = (uint32_t*) lit_reallocate(state, NULL, 0, sizeof(uint32_t) * count);
 	chunk->count = count;
 	chunk->capacity = count;
 
 	for (uint i = 0; i < count; i++) {
-		chunk->code[i] = lit_read_euint64_t(file);
+		// Version 0 stored every instruction in a 64 bit word, with the upper half unused
+		chunk->code[i] = version == 0 ? (uint32_t) lit_read_euint64_t(file) : lit_read_euint32_t(file);
 	}
 
 	count = lit_read_euint32_t(file);
@@ -264,6 +515,24 @@ static void load_chunk(LitState* state, LitEmulatedFile* file, LitModule* module
 	chunk->constants.capacity = count;
 
 	for (uint i = 0; i < count; i++) {
+		if (pool != NULL) {
+			uint index = read_pool_index(file, pool->count);
+
+			if (index == pool->count) {
+				chunk->constants.values[i] = OBJECT_VALUE(load_function(state, file, module, pool, version));
+			} else if (index < pool->count) {
+				chunk->constants.values[i] = pool->values[index];
+			} else {
+				chunk->constants.values[i] = NULL_VALUE;
+
+				if (!state->had_error) {
+					lit_error(state, COMPILE_ERROR, "Failed to read compiled code, invalid constant index");
+				}
+			}
+
+			continue;
+		}
+
 		uint8_t type = lit_read_euint8_t(file);
 
 		if (type == 0) {
@@ -276,7 +545,7 @@ static void load_chunk(LitState* state, LitEmulatedFile* file, LitModule* module
 				}
 
 				case OBJECT_FUNCTION: {
-					chunk->constants.values[i] = OBJECT_VALUE(load_function(state, file, module));
+					chunk->constants.values[i] = OBJECT_VALUE(load_function(state, file, module, pool, version));
 					break;
 				}
 
@@ -289,7 +558,7 @@ static void load_chunk(LitState* state, LitEmulatedFile* file, LitModule* module
 	}
 }
 
-void lit_save_module(LitModule* module, FILE* file) {
+void lit_save_module(LitState* state, LitModule* module, FILE* file) {
 	bool disabled = lit_is_optimization_enabled(OPTIMIZATION_PRIVATE_NAMES);
 
 	lit_write_string(file, module->name);
@@ -307,7 +576,30 @@ void lit_save_module(LitModule* module, FILE* file) {
 		}
 	}
 
-	save_function(file, module->main_function);
+	LitConstantPool pool;
+
+	lit_init_values(&pool.values);
+	lit_init_constant_index(&pool.index);
+
+	collect_constants(state, &pool, &module->main_function->chunk);
+
+	save_pool(file, &pool);
+	save_function(file, &pool, module->main_function);
+
+	lit_free_values(state, &pool.values);
+	lit_free_constant_index(state, &pool.index);
+}
+
+static void load_pool(LitState* state, LitEmulatedFile* file, LitValues* pool) {
+	uint count = lit_read_euint32_t(file);
+
+	for (uint i = 0; i < count; i++) {
+		if (lit_read_euint8_t(file) == 0) {
+			lit_values_write(state, pool, NUMBER_VALUE(lit_read_edouble(file)));
+		} else {
+			lit_values_write(state, pool, OBJECT_VALUE(lit_read_estring(state, file)));
+		}
+	}
 }
 
 LitModule* lit_load_module(LitState* state, const char* input) {
@@ -348,7 +640,16 @@ LitModule* lit_load_module(LitState* state, const char* input) {
 			}
 		}
 
-		module->main_function = load_function(state, &file, module);
+		LitValues pool;
+		lit_init_values(&pool);
+
+		if (bytecode_version >= 3) {
+			load_pool(state, &file, &pool);
+		}
+
+		module->main_function = load_function(state, &file, module, bytecode_version >= 3 ? &pool : NULL, bytecode_version);
+		lit_free_values(state, &pool);
+
 		lit_table_set(state, &state->vm->modules->values, module->name, OBJECT_VALUE(module));
 
 		if (j == 0) {
@@ -356,6 +657,10 @@ LitModule* lit_load_module(LitState* state, const char* input) {
 		}
 	}
 
+	if (state->had_error) {
+		return NULL;
+	}
+
 	if (lit_read_euint16_t(&file) != LIT_BYTECODE_END_NUMBER) {
 		lit_error(state, COMPILE_ERROR, "Failed to read compiled code, unknown end number");
 		return NULL;
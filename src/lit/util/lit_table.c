@@ -183,6 +183,34 @@ void lit_table_add_all_ignoring(LitState* state, LitTable* from, LitTable* to) {
 	}
 }
 
+int lit_table_iterator(LitTable* table, int number) {
+	if (table->count == 0) {
+		return -1;
+	}
+
+	if (number >= (int) table->capacity) {
+		return -1;
+	}
+
+	number++;
+
+	for (; number < table->capacity; number++) {
+		if (table->entries[number].key != NULL) {
+			return number;
+		}
+	}
+
+	return -1;
+}
+
+LitValue lit_table_iterator_key(LitTable* table, int index) {
+	if (table->capacity <= index) {
+		return NULL_VALUE;
+	}
+
+	return OBJECT_VALUE(table->entries[index].key);
+}
+
 void lit_table_remove_white(LitTable* table) {
 	for (int i = 0; i <= table->capacity; i++) {
 		LitTableEntry* entry = &table->entries[i];
@@ -2,6 +2,85 @@
 #include "lit/mem/lit_mem.h"
 #include "lit/state/lit_state.h"
 
+#include <string.h>
+
+#define LIT_CONSTANT_INDEX_MAX_LOAD 0.5
+
+void lit_init_constant_index(LitConstantIndex* index) {
+	index->capacity = 0;
+	index->count = 0;
+	index->slots = NULL;
+}
+
+void lit_free_constant_index(LitState* state, LitConstantIndex* index) {
+	LIT_FREE_ARRAY(state, uint, index->slots, index->capacity);
+	lit_init_constant_index(index);
+}
+
+static uint hash_value(LitValue value) {
+	uint64_t hash = value;
+
+	hash ^= hash >> 33u;
+	hash *= 0xff51afd7ed558ccdu;
+	hash ^= hash >> 33u;
+
+	return (uint) hash;
+}
+
+int lit_find_constant(LitConstantIndex* index, LitValues* values, LitValue value) {
+	if (index->count == 0) {
+		return -1;
+	}
+
+	uint mask = index->capacity - 1;
+	uint slot = hash_value(value) & mask;
+
+	while (index->slots[slot] != 0) {
+		uint position = index->slots[slot] - 1;
+
+		if (values->values[position] == value) {
+			return (int) position;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	return -1;
+}
+
+static void insert_slot(LitConstantIndex* index, LitValues* values, uint position) {
+	uint mask = index->capacity - 1;
+	uint slot = hash_value(values->values[position]) & mask;
+
+	while (index->slots[slot] != 0) {
+		slot = (slot + 1) & mask;
+	}
+
+	index->slots[slot] = position + 1;
+}
+
+void lit_index_constant(LitState* state, LitConstantIndex* index, LitValues* values, uint position) {
+	if (index->count + 1 > index->capacity * LIT_CONSTANT_INDEX_MAX_LOAD) {
+		uint old_capacity = index->capacity;
+		uint* old_slots = index->slots;
+
+		index->capacity = old_capacity < 16 ? 16 : old_capacity * 2;
+		index->slots = LIT_ALLOCATE(state, uint, index->capacity);
+		memset(index->slots, 0, sizeof(uint) * index->capacity);
+
+		for (uint i = 0; i < old_capacity; i++) {
+			if (old_slots[i] != 0) {
+				insert_slot(index, values, old_slots[i] - 1);
+			}
+		}
+
+		LIT_FREE_ARRAY(state, uint, old_slots, old_capacity);
+	}
+
+	insert_slot(index, values, position);
+	index->count++;
+}
+
 void lit_init_chunk(LitChunk* chunk) {
 	chunk->count = 0;
     chunk->capacity = 0;
@@ -11,24 +90,35 @@ void lit_init_chunk(LitChunk* chunk) {
 	chunk->line_count = 0;
 	chunk->line_capacity = 0;
 	chunk->lines = NULL;
+	chunk->cache_indices = NULL;
+	chunk->caches = NULL;
+	chunk->cache_count = 0;
+	chunk->cache_capacity = 0;
 
 	lit_init_values(&chunk->constants);
+	lit_init_constant_index(&chunk->constant_index);
 }
 
 void lit_free_chunk(LitState* state, LitChunk* chunk) {
-	LIT_FREE_ARRAY(state, uint64_t, chunk->code, chunk->capacity);
+	LIT_FREE_ARRAY(state, uint32_t, chunk->code, chunk->capacity);
 	LIT_FREE_ARRAY(state, uint16_t , chunk->lines, chunk->line_capacity);
 
+	if (chunk->cache_indices != NULL) {
+		LIT_FREE_ARRAY(state, uint16_t, chunk->cache_indices, chunk->count);
+		LIT_FREE_ARRAY(state, LitInlineCache, chunk->caches, chunk->cache_capacity);
+	}
+
 	lit_free_values(state, &chunk->constants);
+	lit_free_constant_index(state, &chunk->constant_index);
 	lit_init_chunk(chunk);
 }
 
-void lit_write_chunk(LitState* state, LitChunk* chunk, uint64_t word, uint16_t line) {
+void lit_write_chunk(LitState* state, LitChunk* chunk, uint32_t word, uint16_t line) {
 	if (chunk->capacity < chunk->count + 1) {
 		uint old_capacity = chunk->capacity;
 
 		chunk->capacity = LIT_GROW_CAPACITY(old_capacity);
-		chunk->code = LIT_GROW_ARRAY(state, chunk->code, uint64_t, old_capacity, chunk->capacity);
+		chunk->code = LIT_GROW_ARRAY(state, chunk->code, uint32_t, old_capacity, chunk->capacity);
 	}
 
 	chunk->code[chunk->count] = word;
@@ -64,14 +154,15 @@ void lit_write_chunk(LitState* state, LitChunk* chunk, uint64_t word, uint16_t l
 }
 
 uint lit_chunk_add_constant(LitState* state, LitChunk* chunk, LitValue constant) {
-	for (uint i = 0; i < chunk->constants.count; i++) {
-		if (chunk->constants.values[i] == constant) {
-			return i;
-		}
+	int existing = lit_find_constant(&chunk->constant_index, &chunk->constants, constant);
+
+	if (existing != -1) {
+		return (uint) existing;
 	}
 
 	lit_push_value_root(state, constant);
 	lit_values_write(state, &chunk->constants, constant);
+	lit_index_constant(state, &chunk->constant_index, &chunk->constants, chunk->constants.count - 1);
 	lit_pop_root(state);
 
 	return chunk->constants.count - 1;
@@ -110,7 +201,7 @@ void lit_shrink_chunk(LitState* state, LitChunk* chunk) {
 		uint old_capacity = chunk->capacity;
 
 		chunk->capacity = chunk->count;
-		chunk->code = LIT_GROW_ARRAY(state, chunk->code, uint64_t, old_capacity, chunk->capacity);
+		chunk->code = LIT_GROW_ARRAY(state, chunk->code, uint32_t, old_capacity, chunk->capacity);
 	}
 
 	if (chunk->line_capacity > chunk->line_count) {
@@ -119,4 +210,51 @@ void lit_shrink_chunk(LitState* state, LitChunk* chunk) {
 		chunk->line_capacity = chunk->line_count + 2;
 		chunk->lines = LIT_GROW_ARRAY(state, chunk->lines, uint16_t, old_capacity, chunk->line_capacity);
 	}
+
+	if (chunk->constants.capacity > chunk->constants.count) {
+		uint old_capacity = chunk->constants.capacity;
+
+		chunk->constants.capacity = chunk->constants.count;
+		chunk->constants.values = LIT_GROW_ARRAY(state, chunk->constants.values, LitValue, old_capacity, chunk->constants.capacity);
+	}
+
+	lit_free_constant_index(state, &chunk->constant_index);
+}
+
+LitInlineCache* lit_chunk_get_cache(LitState* state, LitChunk* chunk, uint offset) {
+	if (chunk->cache_indices == NULL) {
+		uint16_t* indices = LIT_ALLOCATE(state, uint16_t, chunk->count);
+		memset(indices, 0, sizeof(uint16_t) * chunk->count);
+
+		chunk->cache_indices = indices;
+	}
+
+	uint index = chunk->cache_indices[offset];
+
+	if (index == 0) {
+		if (chunk->cache_count == UINT16_MAX) {
+			// Out of indexes, hand out an empty cache, that is forgotten right after the instruction
+			static LitInlineCache overflow_cache;
+			memset(&overflow_cache, 0, sizeof(LitInlineCache));
+
+			return &overflow_cache;
+		}
+
+		if (chunk->cache_capacity < chunk->cache_count + 1) {
+			uint old_capacity = chunk->cache_capacity;
+
+			chunk->cache_capacity = LIT_GROW_CAPACITY(old_capacity);
+			chunk->caches = LIT_GROW_ARRAY(state, chunk->caches, LitInlineCache, old_capacity, chunk->cache_capacity);
+		}
+
+		LitInlineCache* cache = &chunk->caches[chunk->cache_count];
+
+		memset(cache, 0, sizeof(LitInlineCache));
+		cache->slot = -1;
+
+		index = ++chunk->cache_count;
+		chunk->cache_indices[offset] = (uint16_t) index;
+	}
+
+	return &chunk->caches[index - 1];
 }
\ No newline at end of file
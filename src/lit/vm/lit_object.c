@@ -49,9 +49,20 @@ uint32_t lit_hash_string(const char* key, uint length) {
 	return hash;
 }
 
+static LitString* find_interned(LitState* state, const char* chars, uint length, uint32_t hash) {
+	LitString* interned = lit_table_find_string(&state->vm->strings, chars, length, hash);
+
+	// A dead string stays in the table, until the sweep gets to it, so it has to be brought back
+	if (interned != NULL && state->vm->gc_phase == LIT_GC_SWEEP) {
+		interned->object.marked = true;
+	}
+
+	return interned;
+}
+
 LitString* lit_take_string(LitState* state, const char* chars, uint length) {
 	uint32_t hash = lit_hash_string(chars, length);
-	LitString* interned = lit_table_find_string(&state->vm->strings, chars, length, hash);
+	LitString* interned = find_interned(state, chars, length, hash);
 
 	if (interned != NULL) {
 		return interned;
@@ -62,7 +73,7 @@ LitString* lit_take_string(LitState* state, const char* chars, uint length) {
 
 LitString* lit_copy_string(LitState* state, const char* chars, uint length) {
 	uint32_t hash = lit_hash_string(chars, length);
-	LitString* interned = lit_table_find_string(&state->vm->strings, chars, length, hash);
+	LitString* interned = find_interned(state, chars, length, hash);
 
 	if (interned != NULL) {
 		return interned;
@@ -213,11 +224,12 @@ LitValue lit_string_format(LitState* state, const char* format, ...) {
 }
 
 LitObject* lit_allocate_object(LitState* state, size_t size, LitObjectType type) {
-	LitObject* object = (LitObject*) lit_reallocate(state, NULL, 0, size);
+	LitObject* object = (LitObject*) lit_slab_allocate(state, size);
 
 	object->type = type;
-	object->marked = false;
-	object->next = state->vm->objects;
+	// Objects, created while the sweep is running, are black, so that they are never mistaken for garbage
+	object->marked = state->vm->gc_phase == LIT_GC_SWEEP;
+	LIT_SET_OBJECT_NEXT(object, state->vm->objects);
 
 	state->vm->objects = object;
 
@@ -238,6 +250,12 @@ LitFunction* lit_create_function(LitState* state, LitModule* module) {
 	function->max_registers = 0;
 	function->module = module;
 	function->vararg = false;
+	function->escape_prototype = NULL;
+
+#ifdef LIT_JIT
+	function->jit = NULL;
+	function->hotness = 0;
+#endif
 
 	return function;
 }
@@ -313,7 +331,6 @@ LitUpvalue* lit_create_upvalue(LitState* state, LitValue* slot) {
 
 	upvalue->location = slot;
 	upvalue->closed = NULL_VALUE;
-	upvalue->next = NULL;
 
 	return upvalue;
 }
@@ -359,6 +376,7 @@ LitNativeFunction* lit_create_native_function(LitState* state, LitNativeFunction
 
 	native->function = function;
 	native->name = name;
+	native->exiting = state->exiting_natives;
 
 	return native;
 }
@@ -368,6 +386,7 @@ LitNativePrimitive* lit_create_native_primitive(LitState* state, LitNativePrimit
 
 	native->function = function;
 	native->name = name;
+	native->exiting = state->exiting_natives;
 
 	return native;
 }
@@ -377,6 +396,8 @@ LitNativeMethod* lit_create_native_method(LitState* state, LitNativeMethodFn met
 
 	native->method = method;
 	native->name = name;
+	native->exiting = state->exiting_natives;
+	native->borrowing = false;
 
 	return native;
 }
@@ -386,6 +407,7 @@ LitPrimitiveMethod* lit_create_primitive_method(LitState* state, LitPrimitiveMet
 
 	native->method = method;
 	native->name = name;
+	native->exiting = state->exiting_natives;
 
 	return native;
 }
@@ -394,6 +416,7 @@ LitFiber* lit_create_fiber(LitState* state, LitModule* module, LitFunction* func
 	// Allocate in advance, just in case GC is triggered
 	uint8_t registers_allocated = function == NULL ? 1 : (uint8_t) lit_closest_power_of_two(function->max_registers);
 	LitValue* registers = LIT_ALLOCATE(state, LitValue, registers_allocated);
+	LitUpvalue** open_upvalues = LIT_ALLOCATE(state, LitUpvalue*, registers_allocated);
 
 	LitCallFrame* frames = LIT_ALLOCATE(state, LitCallFrame, LIT_INITIAL_CALL_FRAMES);
 	LitFiber* fiber = ALLOCATE_OBJECT(state, LitFiber, OBJECT_FIBER);
@@ -406,6 +429,7 @@ LitFiber* lit_create_fiber(LitState* state, LitModule* module, LitFunction* func
 
 	for (uint8_t i = 0; i < registers_allocated; i++) {
 		fiber->registers[i] = NULL_VALUE;
+		open_upvalues[i] = NULL;
 	}
 
 	fiber->registers_allocated = registers_allocated;
@@ -418,7 +442,8 @@ LitFiber* lit_create_fiber(LitState* state, LitModule* module, LitFunction* func
 	fiber->catcher = false;
 	fiber->caught = false;
 	fiber->error = NULL_VALUE;
-	fiber->open_upvalues = NULL;
+	fiber->open_upvalues = open_upvalues;
+	fiber->open_upvalue_top = 0;
 	fiber->abort = false;
 	fiber->return_address = NULL;
 
@@ -431,9 +456,11 @@ LitFiber* lit_create_fiber(LitState* state, LitModule* module, LitFunction* func
 		frame->result_ignored = false;
 		frame->return_to_c = false;
 		frame->return_address = NULL;
+		frame->tail_calls = 0;
 
 		lit_ensure_fiber_registers(state, fiber, function->max_registers);
 		frame->ip = function->chunk.code;
+		fiber->registers[0] = OBJECT_VALUE(function);
 	}
 
 	return fiber;
@@ -455,9 +482,11 @@ void lit_ensure_fiber_registers(LitState* state, LitFiber* fiber, uint needed) {
 	LitValue* old_registers = fiber->registers;
 
 	fiber->registers = (LitValue*) lit_reallocate(state, fiber->registers, sizeof(LitValue) * fiber->registers_allocated, sizeof(LitValue) * capacity);
+	fiber->open_upvalues = (LitUpvalue**) lit_reallocate(state, fiber->open_upvalues, sizeof(LitUpvalue*) * fiber->registers_allocated, sizeof(LitUpvalue*) * capacity);
 
 	for (uint i = fiber->registers_allocated; i < capacity; i++) {
 		fiber->registers[i] = NULL_VALUE;
+		fiber->open_upvalues[i] = NULL;
 	}
 
 	fiber->registers_allocated = capacity;
@@ -475,8 +504,12 @@ void lit_ensure_fiber_registers(LitState* state, LitFiber* fiber, uint needed) {
 			}
 		}
 
-		for (LitUpvalue* upvalue = fiber->open_upvalues; upvalue != NULL; upvalue = upvalue->next) {
-			upvalue->location = fiber->registers + (upvalue->location - old_registers);
+		for (uint i = 0; i < fiber->open_upvalue_top; i++) {
+			LitUpvalue* upvalue = fiber->open_upvalues[i];
+
+			if (upvalue != NULL) {
+				upvalue->location = fiber->registers + i;
+			}
 		}
 	}
 }
@@ -502,22 +535,317 @@ LitClass* lit_create_class(LitState* state, LitString* name) {
 	klass->name = name;
 	klass->init_method = NULL;
 	klass->super = NULL;
+	klass->shape = NULL;
+	klass->shape_count = 0;
+	klass->instance_slots = 0;
 
 	lit_init_table(&klass->methods);
 	lit_init_table(&klass->static_fields);
 
+	for (uint i = 0; i < OPERATOR_TOTAL; i++) {
+		klass->operators[i] = NULL_VALUE;
+	}
+
+	lit_invalidate_class(state, klass);
 	return klass;
 }
 
+void lit_invalidate_class(LitState* state, LitClass* klass) {
+	// Versions are never reused, so a new class allocated at the same address can't hit a stale cache
+	klass->version = ++state->class_version;
+}
+
+static const char* operator_names[OPERATOR_TOTAL] = {
+	"+", "-", "*", "/", "#", "%", "**",
+	"==", "<", "<=", ">", ">=", "!", "[]"
+};
+
+void lit_update_operator(LitClass* klass, LitString* name, LitValue method) {
+	if (name->length > 2) {
+		return;
+	}
+
+	for (uint i = 0; i < OPERATOR_TOTAL; i++) {
+		if (strcmp(name->chars, operator_names[i]) == 0) {
+			klass->operators[i] = method;
+			return;
+		}
+	}
+}
+
+void lit_inherit_operators(LitClass* klass, LitClass* super) {
+	for (uint i = 0; i < OPERATOR_TOTAL; i++) {
+		if (klass->operators[i] == NULL_VALUE) {
+			klass->operators[i] = super->operators[i];
+		}
+	}
+}
+
+static LitShape* create_shape(LitState* state, LitShape* parent, LitString* name) {
+	uint slot_count = parent == NULL ? 0 : parent->slot_count + 1;
+	LitString** names = NULL;
+
+	lit_push_root(state, (LitObject*) name);
+
+	if (slot_count > 0) {
+		names = LIT_ALLOCATE(state, LitString*, slot_count);
+
+		if (parent->slot_count > 0) {
+			memcpy(names, parent->names, sizeof(LitString*) * parent->slot_count);
+		}
+
+		names[slot_count - 1] = name;
+	}
+
+	LitShape* shape = LIT_ALLOCATE(state, LitShape, 1);
+	lit_pop_root(state);
+
+	shape->parent = parent;
+	shape->children = NULL;
+	shape->next = NULL;
+	shape->name = name;
+	shape->names = names;
+	shape->slot_count = slot_count;
+	shape->id = ++state->shape_id;
+
+	return shape;
+}
+
+static LitShape* shape_transition(LitState* state, LitClass* klass, LitShape* shape, LitString* name) {
+	for (LitShape* child = shape->children; child != NULL; child = child->next) {
+		if (child->name == name) {
+			return child;
+		}
+	}
+
+	if (shape->slot_count >= LIT_SHAPE_SLOTS_MAX || klass->shape_count >= LIT_CLASS_SHAPES_MAX) {
+		return NULL;
+	}
+
+	LitShape* child = create_shape(state, shape, name);
+
+	child->next = shape->children;
+	shape->children = child;
+	klass->shape_count++;
+
+	LIT_WRITE_BARRIER(state->vm, klass, OBJECT_VALUE(name))
+
+	return child;
+}
+
+int lit_shape_find(LitShape* shape, LitString* name) {
+	LitString** names = shape->names;
+
+	for (uint i = 0; i < shape->slot_count; i++) {
+		if (names[i] == name) {
+			return (int) i;
+		}
+	}
+
+	return -1;
+}
+
 LitInstance* lit_create_instance(LitState* state, LitClass* klass) {
-	LitInstance* instance = ALLOCATE_OBJECT(state, LitInstance, OBJECT_INSTANCE);
+	if (klass->shape == NULL) {
+		klass->shape = create_shape(state, NULL, NULL);
+		klass->shape_count++;
+	}
+
+	uint inline_capacity = klass->instance_slots;
+	LitInstance* instance = (LitInstance*) lit_allocate_object(state, sizeof(LitInstance) + sizeof(LitValue) * inline_capacity, OBJECT_INSTANCE);
 
 	instance->klass = klass;
-	lit_init_table(&instance->fields);
+	instance->shape = klass->shape;
+	instance->slots = instance->inline_slots;
+	instance->slot_capacity = inline_capacity;
+	instance->inline_capacity = inline_capacity;
 
+	lit_init_table(&instance->fields);
 	return instance;
 }
 
+bool lit_instance_get(LitInstance* instance, LitString* name, LitValue* value) {
+	if (instance->shape == NULL) {
+		return lit_table_get(&instance->fields, name, value);
+	}
+
+	int slot = lit_shape_find(instance->shape, name);
+
+	if (slot == -1) {
+		return false;
+	}
+
+	*value = instance->slots[slot];
+	return true;
+}
+
+bool lit_instance_get_slot(LitInstance* instance, LitString* name, LitValue** value) {
+	if (instance->shape == NULL) {
+		return lit_table_get_slot(&instance->fields, name, value);
+	}
+
+	int slot = lit_shape_find(instance->shape, name);
+
+	if (slot == -1) {
+		return false;
+	}
+
+	*value = &instance->slots[slot];
+	return true;
+}
+
+static void free_slots(LitState* state, LitInstance* instance) {
+	if (instance->slots != instance->inline_slots) {
+		LIT_FREE_ARRAY(state, LitValue, instance->slots, instance->slot_capacity);
+
+		instance->slots = instance->inline_slots;
+		instance->slot_capacity = instance->inline_capacity;
+	}
+}
+
+LitTable* lit_instance_make_dictionary(LitState* state, LitInstance* instance) {
+	LitShape* shape = instance->shape;
+
+	if (shape != NULL) {
+		// The slots are still marked through the shape, while the table is being filled
+		for (uint i = 0; i < shape->slot_count; i++) {
+			lit_table_set(state, &instance->fields, shape->names[i], instance->slots[i]);
+		}
+
+		instance->shape = NULL;
+		free_slots(state, instance);
+	}
+
+	return &instance->fields;
+}
+
+void lit_instance_set(LitState* state, LitInstance* instance, LitString* name, LitValue value) {
+	LitShape* shape = instance->shape;
+
+	if (shape == NULL) {
+		lit_table_set(state, &instance->fields, name, value);
+
+		LIT_WRITE_BARRIER(state->vm, instance, OBJECT_VALUE(name))
+		LIT_WRITE_BARRIER(state->vm, instance, value)
+
+		return;
+	}
+
+	int slot = lit_shape_find(shape, name);
+
+	if (slot != -1) {
+		instance->slots[slot] = value;
+		LIT_WRITE_BARRIER(state->vm, instance, value)
+
+		return;
+	}
+
+	lit_push_value_root(state, value);
+	LitShape* next = shape_transition(state, instance->klass, shape, name);
+
+	if (next == NULL) {
+		lit_table_set(state, lit_instance_make_dictionary(state, instance), name, value);
+		lit_pop_root(state);
+
+		LIT_WRITE_BARRIER(state->vm, instance, OBJECT_VALUE(name))
+		LIT_WRITE_BARRIER(state->vm, instance, value)
+
+		return;
+	}
+
+	uint slot_count = next->slot_count;
+
+	if (slot_count > instance->slot_capacity) {
+		uint capacity = fmin(LIT_SHAPE_SLOTS_MAX, LIT_GROW_CAPACITY(instance->slot_capacity));
+		LitValue* slots = LIT_ALLOCATE(state, LitValue, capacity);
+
+		memcpy(slots, instance->slots, sizeof(LitValue) * shape->slot_count);
+		free_slots(state, instance);
+
+		instance->slots = slots;
+		instance->slot_capacity = capacity;
+	}
+
+	lit_pop_root(state);
+
+	instance->slots[slot_count - 1] = value;
+	instance->shape = next;
+
+	LIT_WRITE_BARRIER(state->vm, instance, value)
+
+	LitClass* klass = instance->klass;
+
+	if (slot_count > klass->instance_slots && slot_count <= LIT_INSTANCE_INLINE_SLOTS_MAX) {
+		klass->instance_slots = slot_count;
+	}
+}
+
+bool lit_instance_delete(LitState* state, LitInstance* instance, LitString* name) {
+	if (instance->shape != NULL) {
+		if (lit_shape_find(instance->shape, name) == -1) {
+			return false;
+		}
+
+		// Removing fields from shapes is not supported, such instances are better off with a table
+		lit_instance_make_dictionary(state, instance);
+	}
+
+	return lit_table_delete(&instance->fields, name);
+}
+
+uint lit_instance_field_count(LitInstance* instance) {
+	return instance->shape == NULL ? (uint) instance->fields.count : instance->shape->slot_count;
+}
+
+int lit_instance_next_field(LitInstance* instance, int index) {
+	if (instance->shape != NULL) {
+		index++;
+		return index < (int) instance->shape->slot_count ? index : -1;
+	}
+
+	LitTable* table = &instance->fields;
+
+	if (table->count == 0) {
+		return -1;
+	}
+
+	for (index++; index <= table->capacity; index++) {
+		if (table->entries[index].key != NULL) {
+			return index;
+		}
+	}
+
+	return -1;
+}
+
+static bool is_valid_field(LitInstance* instance, int index) {
+	if (index < 0) {
+		return false;
+	}
+
+	if (instance->shape == NULL) {
+		return index <= instance->fields.capacity && instance->fields.entries[index].key != NULL;
+	}
+
+	return index < (int) instance->shape->slot_count;
+}
+
+LitString* lit_instance_field_name(LitInstance* instance, int index) {
+	if (!is_valid_field(instance, index)) {
+		return NULL;
+	}
+
+	return instance->shape == NULL ? instance->fields.entries[index].key : instance->shape->names[index];
+}
+
+LitValue lit_instance_field_value(LitInstance* instance, int index) {
+	if (!is_valid_field(instance, index)) {
+		return NULL_VALUE;
+	}
+
+	return instance->shape == NULL ? instance->fields.entries[index].value : instance->slots[index];
+}
+
 LitBoundMethod* lit_create_bound_method(LitState* state, LitValue receiver, LitValue method) {
 	LitBoundMethod* bound_method = ALLOCATE_OBJECT(state, LitBoundMethod, OBJECT_BOUND_METHOD);
 
@@ -527,6 +855,21 @@ LitBoundMethod* lit_create_bound_method(LitState* state, LitValue receiver, LitV
 	return bound_method;
 }
 
+bool lit_values_equal(LitValue a, LitValue b) {
+	if (a == b) {
+		return true;
+	}
+
+	if (IS_BOUND_METHOD(a) && IS_BOUND_METHOD(b)) {
+		LitBoundMethod* a_method = AS_BOUND_METHOD(a);
+		LitBoundMethod* b_method = AS_BOUND_METHOD(b);
+
+		return a_method->receiver == b_method->receiver && a_method->method == b_method->method;
+	}
+
+	return false;
+}
+
 LitArray* lit_create_array(LitState* state) {
 	LitArray* array = ALLOCATE_OBJECT(state, LitArray, OBJECT_ARRAY);
 	lit_init_values(&array->values);
@@ -554,7 +897,12 @@ bool lit_map_set(LitState* state, LitMap* map, LitString* key, LitValue value) {
 		return false;
 	}
 
-	return lit_table_set(state, &map->values, key, value);
+	bool is_new = lit_table_set(state, &map->values, key, value);
+
+	LIT_WRITE_BARRIER(state->vm, map, OBJECT_VALUE(key))
+	LIT_WRITE_BARRIER(state->vm, map, value)
+
+	return is_new;
 }
 
 bool lit_map_get(LitMap* map, LitString* key, LitValue* value) {
@@ -570,9 +918,18 @@ void lit_map_add_all(LitState* state, LitMap* from, LitMap* to) {
 		LitTableEntry* entry = &from->values.entries[i];
 
 		if (entry->key != NULL) {
-			lit_table_set(state, &to->values, entry->key, entry->value);
+			LitValue value = entry->value;
+
+			// Globals and Module.privates keep the values somewhere else too
+			if (to->index_fn != NULL) {
+				to->index_fn(state->vm, to, entry->key, &value);
+			} else {
+				lit_table_set(state, &to->values, entry->key, value);
+			}
 		}
 	}
+
+	LIT_REMEMBER_OBJECT(state->vm, to)
 }
 
 LitUserdata* lit_create_userdata(LitState* state, size_t size) {
@@ -608,8 +965,11 @@ LitField* lit_create_field(LitState* state, LitObject* getter, LitObject* setter
 	return field;
 }
 
-LitReference* lit_create_reference(LitState* state, LitValue* slot) {
+LitReference* lit_create_reference(LitState* state, LitObject* owner, LitValue* slot) {
 	LitReference* reference = ALLOCATE_OBJECT(state, LitReference, OBJECT_REFERENCE);
+
 	reference->slot = slot;
+	reference->owner = owner;
+
 	return reference;
 }
\ No newline at end of file
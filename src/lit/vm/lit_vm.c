@@ -2,6 +2,8 @@
 #include "lit/vm/lit_object.h"
 #include "lit/debug/lit_debug.h"
 #include "lit/mem/lit_mem.h"
+#include "lit/jit/lit_jit.h"
+#include "lit/util/lit_utf.h"
 
 #include <stdio.h>
 #include <math.h>
@@ -17,37 +19,111 @@
 #define PUSH_GC(state, allow) bool was_allowed = state->allow_gc; state->allow_gc = allow;
 #define POP_GC(state) state->allow_gc = was_allowed;
 
-jmp_buf jump_buffer;
-
 static void reset_vm(LitState* state, LitVm* vm) {
 	vm->state = state;
 	vm->objects = NULL;
+	vm->old_objects = NULL;
 	vm->fiber = NULL;
+	vm->native_exit_jump = NULL;
 
 	vm->gray_stack = NULL;
 	vm->gray_count = 0;
 	vm->gray_capacity = 0;
 
+	vm->remembered = NULL;
+	vm->remembered_count = 0;
+	vm->remembered_capacity = 0;
+
+	vm->gc_phase = LIT_GC_IDLE;
+	vm->gc_cursor = NULL;
+	vm->sweeping = NULL;
+	vm->marker = NULL;
+
 	lit_init_table(&vm->strings);
 
 	vm->globals = NULL;
 	vm->modules = NULL;
+
+	lit_init_table(&vm->global_slots);
+	lit_init_values(&vm->global_values);
+	lit_init_values(&vm->global_names);
+	memset(vm->bound_methods, 0, sizeof(vm->bound_methods));
+}
+
+// The map already has the values, only the writes have to reach the slots too
+static LitValue access_global(LitVm* vm, LitMap* map, LitString* name, LitValue* value) {
+	if (value != NULL) {
+		lit_set_global_slot(vm->state, lit_get_global_slot(vm->state, name), *value);
+		return *value;
+	}
+
+	LitValue global;
+	return lit_table_get(&map->values, name, &global) ? global : NULL_VALUE;
 }
 
 void lit_init_vm(LitState* state, LitVm* vm) {
 	reset_vm(state, vm);
 
 	vm->globals = lit_create_map(state);
+	vm->globals->index_fn = access_global;
 	vm->modules = lit_create_map(state);
 }
 
 void lit_free_vm(LitVm* vm) {
+	lit_set_gc_threads(vm, 1);
+
+	lit_free_table(vm->state, &vm->global_slots);
+	lit_free_values(vm->state, &vm->global_values);
+	lit_free_values(vm->state, &vm->global_names);
 	lit_free_table(vm->state, &vm->strings);
 	lit_free_objects(vm->state, vm->objects);
+	lit_free_objects(vm->state, vm->old_objects);
+	lit_free_objects(vm->state, vm->sweeping);
 
 	reset_vm(vm->state, vm);
 }
 
+bool lit_find_global_slot(LitVm* vm, LitString* name, uint* slot) {
+	LitValue index;
+
+	if (!lit_table_get(&vm->global_slots, name, &index)) {
+		return false;
+	}
+
+	*slot = (uint) AS_NUMBER(index);
+	return true;
+}
+
+uint lit_get_global_slot(LitState* state, LitString* name) {
+	LitVm* vm = state->vm;
+	uint slot;
+
+	if (lit_find_global_slot(vm, name, &slot)) {
+		return slot;
+	}
+
+	slot = vm->global_values.count;
+
+	lit_push_root(state, (LitObject*) name);
+	lit_values_write(state, &vm->global_values, NULL_VALUE);
+	lit_values_write(state, &vm->global_names, OBJECT_VALUE(name));
+	lit_table_set(state, &vm->global_slots, name, NUMBER_VALUE(slot));
+	lit_pop_root(state);
+
+	return slot;
+}
+
+void lit_set_global_slot(LitState* state, uint slot, LitValue value) {
+	LitVm* vm = state->vm;
+	LitValue name = vm->global_names.values[slot];
+
+	vm->global_values.values[slot] = value;
+	lit_table_set(state, &vm->globals->values, AS_STRING(name), value);
+
+	LIT_WRITE_BARRIER(vm, vm->globals, name)
+	LIT_WRITE_BARRIER(vm, vm->globals, value)
+}
+
 bool lit_handle_runtime_error(LitVm* vm, LitString* error_string) {
 	LitValue error = OBJECT_VALUE(error_string);
 	LitFiber* fiber = vm->fiber;
@@ -94,6 +170,10 @@ bool lit_handle_runtime_error(LitVm* vm, LitString* error_string) {
 		} else {
 			length += snprintf(NULL, 0, "\tin %s()\n", name);
 		}
+
+		if (frame->tail_calls > 0) {
+			length += snprintf(NULL, 0, "\t... %u tail calls\n", frame->tail_calls);
+		}
 	}
 
 	length += snprintf(NULL, 0, "%s", COLOR_RESET);
@@ -113,6 +193,11 @@ bool lit_handle_runtime_error(LitVm* vm, LitString* error_string) {
 		} else {
 			start += sprintf(start, "\tin %s()\n", name);
 		}
+
+		// The frames, that were reused by tail calls, are gone, so at least say how many there were
+		if (frame->tail_calls > 0) {
+			start += sprintf(start, "\t... %u tail calls\n", frame->tail_calls);
+		}
 	}
 
 	start += sprintf(start, "%s", COLOR_RESET);
@@ -148,37 +233,15 @@ bool lit_runtime_error_exiting(LitVm* vm, const char* format, ...) {
 	bool result = lit_vruntime_error(vm, format, args);
 	va_end(args);
 
-	lit_native_exit_jump();
+	lit_native_exit_jump(vm);
 	return result;
 }
 
-static bool call(LitVm* vm, register LitFunction* function, LitClosure* closure, uint8_t arg_count, uint callee_register) {
-	register LitFiber* fiber = vm->fiber;
-	assert(fiber->frame_count > 0);
-
-	if (fiber->frame_count == LIT_CALL_FRAMES_MAX) {
-		lit_runtime_error(vm, "Stack overflow");
-		return false;
-	}
-
-	if (fiber->frame_count + 1 > fiber->frame_capacity) {
-		uint new_capacity = fmin(LIT_CALL_FRAMES_MAX, fiber->frame_capacity * 2);
-		fiber->frames = (LitCallFrame*) lit_reallocate(vm->state, fiber->frames, sizeof(LitCallFrame) * fiber->frame_capacity, sizeof(LitCallFrame) * new_capacity);
-		fiber->frame_capacity = new_capacity;
-	}
-
-	register LitCallFrame* frame = &fiber->frames[fiber->frame_count++];
-	LitCallFrame* previous_frame = &fiber->frames[fiber->frame_count - 2];
-
-	frame->function = function;
-	frame->closure = closure;
-	frame->ip = function->chunk.code;
-	frame->slots = previous_frame->slots + callee_register;
-	frame->result_ignored = false;
-	frame->return_to_c = false;
-	frame->return_address = previous_frame->slots + (int) callee_register;
-
+// Makes sure the frame has room for all the registers and the callee gets the arguments it expects
+static void fill_arguments(LitVm* vm, LitCallFrame* frame, LitFunction* function, uint8_t arg_count) {
+	LitFiber* fiber = vm->fiber;
 	lit_ensure_fiber_registers(vm->state, fiber, frame->slots - fiber->registers + function->max_registers);
+
 	uint target_arg_count = function->arg_count;
 	bool vararg = function->vararg;
 
@@ -208,11 +271,42 @@ static bool call(LitVm* vm, register LitFunction* function, LitClosure* closure,
 				array->values.values[j++] = *(frame->slots + i + 1);
 			}
 
+			LIT_REMEMBER_OBJECT(vm, array)
+
 			*(frame->slots + target_arg_count) = OBJECT_VALUE(array);
 			lit_pop_root(vm->state);
 		}
 	}
+}
+
+static bool call(LitVm* vm, register LitFunction* function, LitClosure* closure, uint8_t arg_count, uint callee_register) {
+	register LitFiber* fiber = vm->fiber;
+	assert(fiber->frame_count > 0);
+
+	if (fiber->frame_count == LIT_CALL_FRAMES_MAX) {
+		lit_runtime_error(vm, "Stack overflow");
+		return false;
+	}
+
+	if (fiber->frame_count + 1 > fiber->frame_capacity) {
+		uint new_capacity = fmin(LIT_CALL_FRAMES_MAX, fiber->frame_capacity * 2);
+		fiber->frames = (LitCallFrame*) lit_reallocate(vm->state, fiber->frames, sizeof(LitCallFrame) * fiber->frame_capacity, sizeof(LitCallFrame) * new_capacity);
+		fiber->frame_capacity = new_capacity;
+	}
+
+	register LitCallFrame* frame = &fiber->frames[fiber->frame_count++];
+	LitCallFrame* previous_frame = &fiber->frames[fiber->frame_count - 2];
+
+	frame->function = function;
+	frame->closure = closure;
+	frame->ip = function->chunk.code;
+	frame->slots = previous_frame->slots + callee_register;
+	frame->result_ignored = false;
+	frame->return_to_c = false;
+	frame->return_address = previous_frame->slots + (int) callee_register;
+	frame->tail_calls = 0;
 
+	fill_arguments(vm, frame, function, arg_count);
 	return true;
 }
 
@@ -221,13 +315,6 @@ static bool call_value(LitVm* vm, uint callee_register, uint8_t arg_count, LitVa
 	LitValue callee = IS_NULL(alternate_callee) ? frame->slots[callee_register] : alternate_callee;
 	
 	if (IS_OBJECT(callee)) {
-		if (lit_set_native_exit_jump()) {
-			bool caught = vm->fiber->caught;
-			vm->fiber->caught = false;
-
-			return !caught;
-		}
-
 		switch (OBJECT_TYPE(callee)) {
 			case OBJECT_FUNCTION: {
 				return call(vm, AS_FUNCTION(callee), NULL, arg_count, callee_register);
@@ -239,18 +326,25 @@ static bool call_value(LitVm* vm, uint callee_register, uint8_t arg_count, LitVa
 			}
 
 			case OBJECT_NATIVE_FUNCTION: {
+				LitFiber* fiber = vm->fiber;
+
 				// For some reason, single line expression doesn't work
-				LitValue value = AS_NATIVE_FUNCTION(callee)->function(vm, arg_count, frame->slots + callee_register + 1);
+				LitNativeFunction* native = AS_NATIVE_FUNCTION(callee);
+				LitValue* args = frame->slots + callee_register + 1;
+				LitValue value = native->exiting ? lit_call_native_function(vm, native, arg_count, args) : native->function(vm, arg_count, args);
 				frame->slots[callee_register] = value;
 
-				return !vm->fiber->abort;
+				// A reported error either aborts the fiber or switches to the one that caught it
+				return vm->fiber == fiber && !fiber->abort;
 			}
 
 			case OBJECT_NATIVE_PRIMITIVE: {
 				PUSH_GC(vm->state, false)
 
 				LitFiber* fiber = vm->fiber;
-				bool result = AS_NATIVE_PRIMITIVE(callee)->function(vm, arg_count, frame->slots + callee_register + 1);
+				LitNativePrimitive* native = AS_NATIVE_PRIMITIVE(callee);
+				LitValue* args = frame->slots + callee_register + 1;
+				bool result = native->exiting ? lit_call_native_primitive(vm, native, arg_count, args) : native->function(vm, arg_count, args);
 
 				POP_GC(vm->state)
 				return !result;
@@ -261,21 +355,29 @@ static bool call_value(LitVm* vm, uint callee_register, uint8_t arg_count, LitVa
 
 				LitNativeMethod* method = AS_NATIVE_METHOD(callee);
 				LitFiber* fiber = vm->fiber;
+				LitValue receiver = *(frame->slots + callee_register);
 
 				// For some reason, single line expression doesn't work
-				LitValue value = method->method(vm, *(frame->slots + callee_register), arg_count, frame->slots + callee_register + 1);
+				LitValue* args = frame->slots + callee_register + 1;
+				LitValue value = method->exiting ? lit_call_native_method(vm, method, receiver, arg_count, args) : method->method(vm, receiver, arg_count, args);
 				frame->slots[callee_register] = value;
+				LIT_REMEMBER_VALUE(vm, receiver)
 
 				POP_GC(vm->state)
 
-				return !fiber->abort;
+				return vm->fiber == fiber && !fiber->abort;
 			}
 
 			case OBJECT_PRIMITIVE_METHOD: {
 				PUSH_GC(vm->state, false)
 
 				LitFiber* fiber = vm->fiber;
-				bool result = AS_PRIMITIVE_METHOD(callee)->method(vm, *(frame->slots + callee_register), arg_count, frame->slots + callee_register + 1);
+				LitValue receiver = *(frame->slots + callee_register);
+				LitPrimitiveMethod* method = AS_PRIMITIVE_METHOD(callee);
+				LitValue* args = frame->slots + callee_register + 1;
+				bool result = method->exiting ? lit_call_primitive_method(vm, method, receiver, arg_count, args) : method->method(vm, receiver, arg_count, args);
+
+				LIT_REMEMBER_VALUE(vm, receiver)
 
 				POP_GC(vm->state)
 				return !result;
@@ -299,18 +401,27 @@ static bool call_value(LitVm* vm, uint callee_register, uint8_t arg_count, LitVa
 				LitValue method = bound_method->method;
 
 				if (IS_NATIVE_METHOD(method)) {
+					LitFiber* fiber = vm->fiber;
 					PUSH_GC(vm->state, false)
 					// For some reason, single line expression doesn't work
-					LitValue value = AS_NATIVE_METHOD(method)->method(vm, bound_method->receiver, arg_count, frame->slots + callee_register + 1);
+					LitNativeMethod* native = AS_NATIVE_METHOD(method);
+					LitValue* args = frame->slots + callee_register + 1;
+					LitValue value = native->exiting ? lit_call_native_method(vm, native, bound_method->receiver, arg_count, args) : native->method(vm, bound_method->receiver, arg_count, args);
 					frame->slots[callee_register] = value;
+					LIT_REMEMBER_VALUE(vm, bound_method->receiver)
 					POP_GC(vm->state)
 
-					return !vm->fiber->abort;
+					return vm->fiber == fiber && !fiber->abort;
 				} else if (IS_PRIMITIVE_METHOD(method)) {
 					LitFiber* fiber = vm->fiber;
 					PUSH_GC(vm->state, false)
 
-					if (AS_PRIMITIVE_METHOD(method)->method(vm, bound_method->receiver, arg_count, frame->slots + callee_register + 1)) {
+					LitPrimitiveMethod* native = AS_PRIMITIVE_METHOD(method);
+					LitValue* args = frame->slots + callee_register + 1;
+					bool result = native->exiting ? lit_call_primitive_method(vm, native, bound_method->receiver, arg_count, args) : native->method(vm, bound_method->receiver, arg_count, args);
+					LIT_REMEMBER_VALUE(vm, bound_method->receiver)
+
+					if (result) {
 						POP_GC(vm->state)
 						return false;
 					}
@@ -341,41 +452,301 @@ static bool call_value(LitVm* vm, uint callee_register, uint8_t arg_count, LitVa
 }
 
 static LitUpvalue* capture_upvalue(LitState* state, LitValue* local) {
-	LitUpvalue* previous_upvalue = NULL;
-	LitUpvalue* upvalue = state->vm->fiber->open_upvalues;
+	LitFiber* fiber = state->vm->fiber;
+	uint index = local - fiber->registers;
+	LitUpvalue* upvalue = fiber->open_upvalues[index];
 
-	while (upvalue != NULL && upvalue->location > local) {
-		previous_upvalue = upvalue;
-		upvalue = upvalue->next;
+	if (upvalue != NULL) {
+		return upvalue;
 	}
 
-	if (upvalue != NULL && upvalue->location == local) {
-		return upvalue;
+	upvalue = lit_create_upvalue(state, local);
+	fiber->open_upvalues[index] = upvalue;
+
+	if (index >= fiber->open_upvalue_top) {
+		fiber->open_upvalue_top = index + 1;
 	}
 
-	LitUpvalue* created_upvalue = lit_create_upvalue(state, local);
-	created_upvalue->next = upvalue;
+	return upvalue;
+}
 
-	if (previous_upvalue == NULL) {
-		state->vm->fiber->open_upvalues = created_upvalue;
-	} else {
-		previous_upvalue->next = created_upvalue;
+// The stack functions among the arguments read our registers, so if the callee might keep them, they become real closures
+static void escape_stack_closures(LitState* state, LitValue method, LitValue* registers, uint8_t from, uint8_t count) {
+	if (IS_NATIVE_METHOD(method) && AS_NATIVE_METHOD(method)->borrowing) {
+		return;
 	}
 
-	return created_upvalue;
+	for (uint i = from; i < from + count; i++) {
+		if (!IS_FUNCTION(registers[i]) || AS_FUNCTION(registers[i])->escape_prototype == NULL) {
+			continue;
+		}
+
+		LitClosurePrototype* closure_prototype = AS_FUNCTION(registers[i])->escape_prototype;
+		LitClosure* closure = lit_create_closure(state, closure_prototype->function);
+
+		registers[i] = OBJECT_VALUE(closure);
+
+		// Only the closures, that capture nothing but locals, are put on the stack
+		for (uint j = 0; j < closure->function->upvalue_count; j++) {
+			closure->upvalues[j] = capture_upvalue(state, registers + closure_prototype->indexes[j]);
+			LIT_WRITE_BARRIER(state->vm, closure, OBJECT_VALUE(closure->upvalues[j]))
+		}
+	}
 }
 
 static void close_upvalues(register LitVm* vm, const LitValue* last) {
 	LitFiber* fiber = vm->fiber;
+	uint from = last < fiber->registers ? 0 : last - fiber->registers;
+
+	for (uint i = from; i < fiber->open_upvalue_top; i++) {
+		LitUpvalue* upvalue = fiber->open_upvalues[i];
+
+		if (upvalue != NULL) {
+			upvalue->closed = *upvalue->location;
+			upvalue->location = &upvalue->closed;
+
+			LIT_WRITE_BARRIER(vm, upvalue, upvalue->closed)
+
+			fiber->open_upvalues[i] = NULL;
+		}
+	}
+
+	if (from < fiber->open_upvalue_top) {
+		fiber->open_upvalue_top = from;
+	}
+}
+
+// Reuses the current frame for the callee, so that it returns straight to our caller
+static void tail_call(LitVm* vm, LitFunction* function, LitClosure* closure, uint8_t arg_count, uint callee_register) {
+	LitFiber* fiber = vm->fiber;
+	LitCallFrame* frame = &fiber->frames[fiber->frame_count - 1];
+
+	close_upvalues(vm, frame->slots);
+	memmove(frame->slots, frame->slots + callee_register, sizeof(LitValue) * (arg_count + 1));
+
+	frame->function = function;
+	frame->closure = closure;
+	frame->ip = function->chunk.code;
+	frame->tail_calls++;
+
+	fill_arguments(vm, frame, function, arg_count);
+}
+
+// Reading a method as a value would allocate a new bound method every time otherwise
+static inline LitValue bind_method(LitState* state, LitValue receiver, LitValue method) {
+	uint64_t hash = receiver * 31 + method;
+	LitBoundMethod** entry = &state->vm->bound_methods[(hash ^ (hash >> 17)) >> 3 & (LIT_BOUND_METHOD_CACHE_SIZE - 1)];
+	LitBoundMethod* bound_method = *entry;
+
+	if (bound_method == NULL || bound_method->receiver != receiver || bound_method->method != method) {
+		bound_method = lit_create_bound_method(state, receiver, method);
+		*entry = bound_method;
+	}
+
+	return OBJECT_VALUE(bound_method);
+}
+
+static inline LitInlineCache* get_inline_cache(LitState* state, LitChunk* chunk, uint32_t* ip) {
+	uint offset = (uint) (ip - chunk->code - 1);
+
+	if (chunk->cache_indices != NULL) {
+		uint index = chunk->cache_indices[offset];
+
+		if (index != 0) {
+			return &chunk->caches[index - 1];
+		}
+	}
+
+	return lit_chunk_get_cache(state, chunk, offset);
+}
+
+static inline bool get_instance_field(LitInlineCache* cache, LitInstance* instance, LitString* name, LitValue* value) {
+	LitShape* shape = instance->shape;
+
+	if (shape == NULL) {
+		return lit_table_get(&instance->fields, name, value);
+	}
+
+	int slot;
+
+	if (cache->shape == shape && cache->shape_id == shape->id) {
+		slot = cache->slot;
+	} else {
+		slot = lit_shape_find(shape, name);
+
+		cache->shape = shape;
+		cache->shape_id = shape->id;
+		cache->transition = NULL;
+		cache->slot = slot;
+	}
+
+	if (slot == -1) {
+		return false;
+	}
+
+	*value = instance->slots[slot];
+	return true;
+}
+
+static inline void set_instance_field(LitState* state, LitInlineCache* cache, LitInstance* instance, LitString* name, LitValue value) {
+	LitShape* shape = instance->shape;
+
+	if (shape != NULL && cache->shape == shape && cache->shape_id == shape->id) {
+		if (cache->transition == NULL) {
+			if (cache->slot != -1) {
+				instance->slots[cache->slot] = value;
+				LIT_WRITE_BARRIER(state->vm, instance, value)
+
+				return;
+			}
+		} else if ((uint) cache->slot < instance->slot_capacity) {
+			instance->slots[cache->slot] = value;
+			instance->shape = cache->transition;
+			LIT_WRITE_BARRIER(state->vm, instance, value)
+
+			return;
+		}
+	}
+
+	lit_instance_set(state, instance, name, value);
+
+	if (shape != NULL && instance->shape != NULL) {
+		cache->shape = shape;
+		cache->shape_id = shape->id;
+
+		if (instance->shape == shape) {
+			cache->transition = NULL;
+			cache->slot = lit_shape_find(shape, name);
+		} else {
+			cache->transition = instance->shape;
+			cache->slot = (int) shape->slot_count;
+		}
+	}
+}
+
+static inline bool read_inline_cache(LitInlineCache* cache, LitClass* klass, bool is_static, bool* found, LitValue* value) {
+	for (uint i = 0; i < LIT_INLINE_CACHE_SIZE; i++) {
+		LitInlineCacheEntry* entry = &cache->entries[i];
+
+		if (entry->klass == klass && entry->version == klass->version && entry->is_static == is_static) {
+			*found = entry->found;
+			*value = entry->value;
 
-	while (fiber->open_upvalues != NULL && fiber->open_upvalues->location >= last) {
-		LitUpvalue* upvalue = fiber->open_upvalues;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void write_inline_cache(LitInlineCache* cache, LitClass* klass, bool is_static, bool found, LitValue value) {
+	LitInlineCacheEntry* entry = NULL;
+
+	// Outdated entry for the same class gets reused, so that a single class can't fill the whole cache
+	for (uint i = 0; i < LIT_INLINE_CACHE_SIZE; i++) {
+		if (cache->entries[i].klass == klass && cache->entries[i].is_static == is_static) {
+			entry = &cache->entries[i];
+			break;
+		}
+	}
+
+	if (entry == NULL) {
+		entry = &cache->entries[cache->next];
+		cache->next = (cache->next + 1) % LIT_INLINE_CACHE_SIZE;
+	}
+
+	entry->klass = klass;
+	entry->version = klass->version;
+	entry->is_static = is_static;
+	entry->found = found;
+	entry->value = found ? value : NULL_VALUE;
+}
+
+// Built-in types are indexed right away, false means that the [] method has to be called
+static inline bool subscript_get(LitState* state, LitValue operand, LitValue index, LitValue* result) {
+	if (IS_ARRAY(operand)) {
+		if (!IS_NUMBER(index)) {
+			return false;
+		}
+
+		LitValues* values = &AS_ARRAY(operand)->values;
+		int i = AS_NUMBER(index);
+
+		if (i < 0) {
+			i = fmax(0, values->count + i);
+		}
+
+		*result = (uint) i < values->count ? values->values[i] : NULL_VALUE;
+		return true;
+	} else if (IS_MAP(operand)) {
+		LitMap* map = AS_MAP(operand);
+
+		if (!IS_STRING(index) || map->index_fn != NULL) {
+			return false;
+		}
+
+		if (!lit_table_get(&map->values, AS_STRING(index), result)) {
+			*result = NULL_VALUE;
+		}
+
+		return true;
+	} else if (IS_STRING(operand)) {
+		if (!IS_NUMBER(index) || AS_NUMBER(index) < 0) {
+			return false;
+		}
+
+		LitString* string = AS_STRING(operand);
+		uint i = AS_NUMBER(index);
+
+		if (i >= string->length) {
+			return false;
+		}
+
+		// Only while every char up to the index is a single byte, the index is the byte offset
+		for (uint j = 0; j <= i; j++) {
+			if ((uint8_t) string->chars[j] >= 0x80) {
+				return false;
+			}
+		}
+
+		*result = OBJECT_VALUE(lit_copy_string(state, string->chars + i, 1));
+		return true;
+	}
+
+	return false;
+}
+
+static inline bool subscript_set(LitState* state, LitValue operand, LitValue index, LitValue value) {
+	if (IS_ARRAY(operand)) {
+		if (!IS_NUMBER(index)) {
+			return false;
+		}
+
+		LitValues* values = &AS_ARRAY(operand)->values;
+		int i = AS_NUMBER(index);
+
+		if (i < 0) {
+			i = fmax(0, values->count + i);
+		}
 
-		upvalue->closed = *upvalue->location;
-		upvalue->location = &upvalue->closed;
+		lit_values_ensure_size(state, values, i + 1);
+		values->values[i] = value;
 
-		fiber->open_upvalues = upvalue->next;
+		LIT_WRITE_BARRIER(state->vm, AS_OBJECT(operand), value)
+
+		return true;
+	} else if (IS_MAP(operand)) {
+		LitMap* map = AS_MAP(operand);
+
+		if (!IS_STRING(index) || map->index_fn != NULL) {
+			return false;
+		}
+
+		lit_map_set(state, map, AS_STRING(index), value);
+		return true;
 	}
+
+	return false;
 }
 
 LitInterpretResult lit_interpret_module(LitState* state, LitModule* module) {
@@ -389,7 +760,22 @@ LitInterpretResult lit_interpret_module(LitState* state, LitModule* module) {
 	return result;
 }
 
-LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber) {
+static LitInterpretResult interpret_fiber(LitState* state, register LitFiber* fiber);
+
+LitInterpretResult lit_interpret_fiber(LitState* state, LitFiber* fiber) {
+	LitVm* vm = state->vm;
+
+	// Natives called from here on must not unwind into an exiting native further up the C stack
+	jmp_buf* exit_jump = vm->native_exit_jump;
+	vm->native_exit_jump = NULL;
+
+	LitInterpretResult result = interpret_fiber(state, fiber);
+	vm->native_exit_jump = exit_jump;
+
+	return result;
+}
+
+static LitInterpretResult interpret_fiber(LitState* state, register LitFiber* fiber) {
 	assert(fiber->frame_count > 0);
 	state->vm->fiber = fiber;
 
@@ -434,6 +820,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		}
 
 	#define RUNTIME_ERROR(format) \
+		WRITE_FRAME() \
 		if (lit_runtime_error(vm, format)) { \
 			RECOVER_STATE() \
 			DISPATCH_NEXT() \
@@ -442,6 +829,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		}
 
 	#define RUNTIME_ERROR_VARG(format, ...) \
+		WRITE_FRAME() \
 		if (lit_runtime_error(vm, format, __VA_ARGS__)) { \
 			RECOVER_STATE() \
 			DISPATCH_NEXT() \
@@ -459,86 +847,130 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	#define UNWRAP_CONSTANT(r, to, tmp) \
     registers[to] = tmp;
 
-	#define INVOKE_METHOD(reg, bv, m, arg_count) \
+	// Operator methods come straight from the class slots, no name lookup needed
+	#define INVOKE_OPERATOR(reg, bv, operator, op_string, arg_count) \
 		WRITE_FRAME() \
 		LitClass* klass = lit_get_class_for(state, bv); \
 		if (klass == NULL) { \
 			RUNTIME_ERROR("Only instances and classes have methods") \
 		} \
-		LitString* method_name = CONST_STRING(vm->state, m); \
-		LitValue method; \
-		if ((IS_INSTANCE(bv) && (lit_table_get(&AS_INSTANCE(bv)->fields, method_name, &method))) || lit_table_get(&klass->methods, method_name, &method)) { \
+		LitValue method = klass->operators[operator]; \
+		if (method != NULL_VALUE) { \
 			CALL_VALUE(method, reg, arg_count) \
 		} else { \
-			RUNTIME_ERROR_VARG("Attempt to call method '%s', that is not defined in class %s", method_name->chars, klass->name->chars) \
+			RUNTIME_ERROR_VARG("Attempt to call method '%s', that is not defined in class %s", op_string, klass->name->chars) \
 		} \
 		READ_FRAME()
 
-	#define INVOKE_METHOD_AND_CONTINUE(reg, bv, m, arg_count) \
+	#define INVOKE_OPERATOR_AND_CONTINUE(reg, bv, operator, arg_count) \
 		WRITE_FRAME() \
 		LitClass* klass = lit_get_class_for(state, bv); \
 		if (klass == NULL) { \
 			RUNTIME_ERROR("Only instances and classes have methods") \
 		} \
-		LitString* method_name = CONST_STRING(vm->state, m); \
-		LitValue method; \
-		if ((IS_INSTANCE(bv) && (lit_table_get(&AS_INSTANCE(bv)->fields, method_name, &method))) || lit_table_get(&klass->methods, method_name, &method)) { \
+		LitValue method = klass->operators[operator]; \
+		if (method != NULL_VALUE) { \
 			CALL_VALUE(method, reg, arg_count) \
 			READ_FRAME() \
       DISPATCH_NEXT() \
 		} \
 
+	// Looks up a method or a field of the klass, remembering the result for the current instruction
+	#define CACHED_LOOKUP(cache, klass, is_static, found, value, lookup) \
+		if (!read_inline_cache(cache, klass, is_static, &found, &value)) { \
+			found = lookup; \
+			write_inline_cache(cache, klass, is_static, found, value); \
+		}
+
+	#ifdef LIT_JIT
+		// Loops, that got hot, continue in native code until it reaches an instruction, that it can't handle
+		#define JIT_ENTER() \
+			if (frame->function->jit == NULL && ++frame->function->hotness == LIT_JIT_THRESHOLD) { \
+				lit_jit_compile(state, frame->function); \
+			} \
+			if (frame->function->jit != NULL) { \
+				ip = lit_jit_run(frame->function, ip, registers, privates); \
+			}
+	#endif
+
+	// Rewrites the current instruction, so that the next time it is executed by a specialized handler
+	#define QUICKEN(opcode) ip[-1] = LIT_INSTRUCTION_WITH_OPCODE(instruction, opcode);
+
 	// Instruction helpers
-	#define BINARY_INSTRUCTION(type, op, op_string) \
+	// The fused instructions fall back onto these only without two numbers, so they never get quickened
+	#define BINARY_INSTRUCTION(type, op, op_string, operator, quickened) \
     uint8_t a = LIT_INSTRUCTION_A(instruction); \
-		uint16_t b = LIT_INSTRUCTION_B(instruction); \
-		uint16_t c = LIT_INSTRUCTION_C(instruction); \
-    LitValue bv = GET_RC(b); \
+		uint8_t b = LIT_INSTRUCTION_B(instruction); \
+		uint16_t c = LIT_INSTRUCTION_CK(instruction); \
+    LitValue bv = registers[b]; \
     LitValue cv = GET_RC(c); \
 		if (IS_NUMBER(bv)) { \
 			if (!IS_NUMBER(cv)) { \
 				RUNTIME_ERROR_VARG("Attempt to use the operator %s with a number and a %s", op_string, lit_get_value_type(cv)) \
 			} \
+			QUICKEN(quickened) \
 			registers[a] = type(AS_NUMBER(bv) op AS_NUMBER(cv)); \
 		} else if (IS_NULL(bv)) { \
 			RUNTIME_ERROR_VARG("Attempt to use the operator %s on a null value", op_string) \
 		} else { \
 			WRAP_CONSTANT(b, a, tmp_a) \
       WRAP_CONSTANT(c, a + 1, tmp_b) \
-			INVOKE_METHOD(a, registers[a], op_string, 1) \
+			INVOKE_OPERATOR(a, registers[a], operator, op_string, 1) \
       UNWRAP_CONSTANT(c, a + 1, tmp_b) \
 		}
 
-	#define COMPARISON_INSTRUCTION(type, op, op_string) \
+	#define COMPARISON_INSTRUCTION(type, op, op_string, operator, quickened) \
 		uint8_t a = LIT_INSTRUCTION_A(instruction); \
-		uint16_t b = LIT_INSTRUCTION_B(instruction); \
-		uint16_t c = LIT_INSTRUCTION_C(instruction); \
-    LitValue bv = GET_RC(b); \
+		uint8_t b = LIT_INSTRUCTION_B(instruction); \
+		uint16_t c = LIT_INSTRUCTION_CK(instruction); \
+    LitValue bv = registers[b]; \
     LitValue cv = GET_RC(c); \
 		if (IS_NUMBER(bv)) { \
 			if (!IS_NUMBER(cv)) { \
 				RUNTIME_ERROR_VARG("Attempt to use the operator %s with a number and a %s", op_string, lit_get_value_type(cv)) \
 			} \
+			QUICKEN(quickened) \
 			registers[a] = type(AS_NUMBER(bv) op AS_NUMBER(cv)); \
 		} else if (IS_NULL(bv)) { \
 			RUNTIME_ERROR_VARG("Attempt to use the operator %s on a null value", op_string) \
 		} else { \
 			WRAP_CONSTANT(b, a, tmp_a) \
       WRAP_CONSTANT(c, a + 1, tmp_b) \
-			INVOKE_METHOD(a, registers[a], op_string, 1) \
+			INVOKE_OPERATOR(a, registers[a], operator, op_string, 1) \
       UNWRAP_CONSTANT(c, a + 1, tmp_b) \
 		}
 
+	// Takes the jump offset from the FALSE_JUMP, that follows the instruction,
+	// anything but two numbers is handed to the plain comparison, that will store the result for that FALSE_JUMP
+	#define COMPARISON_JUMP_INSTRUCTION(op, fallback) \
+		LitValue bv = registers[LIT_INSTRUCTION_B(instruction)]; \
+		LitValue cv = GET_RC(LIT_INSTRUCTION_CK(instruction)); \
+		if (IS_NUMBER(bv) && IS_NUMBER(cv)) { \
+			ip += AS_NUMBER(bv) op AS_NUMBER(cv) ? 1 : LIT_INSTRUCTION_BX(*ip) + 1; \
+			DISPATCH_NEXT() \
+		} \
+		goto fallback;
+
+	// Guard of the quickened instructions, anything but two numbers turns it back into the generic one
+	#define NUMBER_INSTRUCTION(type, op, generic) \
+		LitValue bv = registers[LIT_INSTRUCTION_B(instruction)]; \
+		LitValue cv = GET_RC(LIT_INSTRUCTION_CK(instruction)); \
+		if (IS_NUMBER(bv) && IS_NUMBER(cv)) { \
+			registers[LIT_INSTRUCTION_A(instruction)] = type(AS_NUMBER(bv) op AS_NUMBER(cv)); \
+			DISPATCH_NEXT() \
+		} \
+		QUICKEN(generic) \
+		goto generic;
+
 	#define BITWISE_INSTRUCTION(op, op_string) \
-    LitValue bv = GET_RC(LIT_INSTRUCTION_B(instruction)); \
-    LitValue cv = GET_RC(LIT_INSTRUCTION_C(instruction)); \
+    LitValue bv = registers[LIT_INSTRUCTION_B(instruction)]; \
+    LitValue cv = GET_RC(LIT_INSTRUCTION_CK(instruction)); \
 		if (!IS_NUMBER(bv) && !IS_NUMBER(cv)) { \
 			RUNTIME_ERROR_VARG("Operands of bitwise op %s must be two numbers, got %s and %s", op_string, lit_get_value_type(bv), lit_get_value_type(cv)) \
 		} \
 		registers[LIT_INSTRUCTION_A(instruction)] = (NUMBER_VALUE((int) AS_NUMBER(bv) op (int) AS_NUMBER(cv)));
 
 	register LitVm *vm = state->vm;
-	LitTable *globals = &vm->globals->values;
 
 	PUSH_GC(state, true)
 
@@ -551,12 +983,11 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	LitValue* privates;
 	LitUpvalue** upvalues;
 
-	register uint64_t* ip;
-	register uint64_t instruction;
+	register uint32_t* ip;
+	register uint32_t instruction;
 
 	READ_FRAME()
 	vm->fiber = fiber;
-	registers[0] = OBJECT_VALUE(frame->function);
 	TRACE_FRAME()
 
 #ifdef LIT_TRACE_EXECUTION
@@ -586,7 +1017,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	goto *dispatch_table[LIT_INSTRUCTION_OPCODE(instruction)];
 
 	CASE_CODE(MOVE) {
-		registers[LIT_INSTRUCTION_A(instruction)] = GET_RC(LIT_INSTRUCTION_B(instruction));
+		registers[LIT_INSTRUCTION_A(instruction)] = GET_RC(LIT_INSTRUCTION_BK(instruction));
 		DISPATCH_NEXT()
 	}
 
@@ -614,6 +1045,8 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 			} else {
 				closure->upvalues[i] = upvalues[index];
 			}
+
+			LIT_WRITE_BARRIER(vm, closure, OBJECT_VALUE(closure->upvalues[i]))
 		}
 
 		DISPATCH_NEXT()
@@ -623,7 +1056,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		LitArray* array = lit_create_array(state);
 		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(array);
 
-		lit_values_ensure_size_empty(state, &array->values, LIT_INSTRUCTION_B(instruction));
+		lit_values_ensure_size_empty(state, &array->values, LIT_INSTRUCTION_BX(instruction));
 		DISPATCH_NEXT()
 	}
 
@@ -633,7 +1066,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	}
 
 	CASE_CODE(RANGE) {
-		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_range(state, AS_NUMBER(GET_RC(LIT_INSTRUCTION_B(instruction))), AS_NUMBER(GET_RC(LIT_INSTRUCTION_C(instruction)))));
+		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_range(state, AS_NUMBER(GET_RC(LIT_INSTRUCTION_BK(instruction))), AS_NUMBER(registers[LIT_INSTRUCTION_C(instruction)])));
 		DISPATCH_NEXT()
 	}
 
@@ -681,31 +1114,90 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	}
 
 	CASE_CODE(ADD) {
-		BINARY_INSTRUCTION(NUMBER_VALUE, +, "+")
+		BINARY_INSTRUCTION(NUMBER_VALUE, +, "+", OPERATOR_ADD, OP_ADD_NUM)
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(SUBTRACT) {
-		BINARY_INSTRUCTION(NUMBER_VALUE, -, "-")
+		BINARY_INSTRUCTION(NUMBER_VALUE, -, "-", OPERATOR_SUBTRACT, OP_SUBTRACT_NUM)
+		DISPATCH_NEXT()
+	}
+
+	CASE_CODE(ADD_CONSTANT) {
+		LitValue bv = registers[LIT_INSTRUCTION_B(instruction)];
+
+		if (IS_NUMBER(bv)) {
+			registers[LIT_INSTRUCTION_A(instruction)] = NUMBER_VALUE(AS_NUMBER(bv) + AS_NUMBER(GET_RC(LIT_INSTRUCTION_CK(instruction))));
+			DISPATCH_NEXT()
+		}
+
+		goto OP_ADD;
+	}
+
+	CASE_CODE(SUBTRACT_CONSTANT) {
+		LitValue bv = registers[LIT_INSTRUCTION_B(instruction)];
+
+		if (IS_NUMBER(bv)) {
+			registers[LIT_INSTRUCTION_A(instruction)] = NUMBER_VALUE(AS_NUMBER(bv) - AS_NUMBER(GET_RC(LIT_INSTRUCTION_CK(instruction))));
+			DISPATCH_NEXT()
+		}
+
+		goto OP_SUBTRACT;
+	}
+
+	CASE_CODE(INCREMENT_LOCAL) {
+		uint8_t a = LIT_INSTRUCTION_A(instruction);
+		int32_t sbx = LIT_INSTRUCTION_SBX(instruction);
+		LitValue value = registers[a];
+
+		if (IS_NUMBER(value)) {
+			registers[a] = NUMBER_VALUE(AS_NUMBER(value) + sbx);
+		} else if (IS_NULL(value)) {
+			RUNTIME_ERROR_VARG("Attempt to use the operator %s on a null value", sbx < 0 ? "-" : "+")
+		} else {
+			// Negative steps come from subtraction, so the right operator gets called
+			LitValue tmp = registers[a + 1];
+			registers[a + 1] = NUMBER_VALUE(abs(sbx));
+
+			INVOKE_OPERATOR(a, value, sbx < 0 ? OPERATOR_SUBTRACT : OPERATOR_ADD, sbx < 0 ? "-" : "+", 1)
+			registers[a + 1] = tmp;
+		}
+
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(MULTIPLY) {
-		BINARY_INSTRUCTION(NUMBER_VALUE, *, "*")
+		BINARY_INSTRUCTION(NUMBER_VALUE, *, "*", OPERATOR_MULTIPLY, OP_MULTIPLY_NUM)
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(DIVIDE) {
-		BINARY_INSTRUCTION(NUMBER_VALUE, /, "/")
+		BINARY_INSTRUCTION(NUMBER_VALUE, /, "/", OPERATOR_DIVIDE, OP_DIVIDE_NUM)
 		DISPATCH_NEXT()
 	}
 
+	CASE_CODE(ADD_NUM) {
+		NUMBER_INSTRUCTION(NUMBER_VALUE, +, OP_ADD)
+	}
+
+	CASE_CODE(SUBTRACT_NUM) {
+		NUMBER_INSTRUCTION(NUMBER_VALUE, -, OP_SUBTRACT)
+	}
+
+	CASE_CODE(MULTIPLY_NUM) {
+		NUMBER_INSTRUCTION(NUMBER_VALUE, *, OP_MULTIPLY)
+	}
+
+	CASE_CODE(DIVIDE_NUM) {
+		NUMBER_INSTRUCTION(NUMBER_VALUE, /, OP_DIVIDE)
+	}
+
 	CASE_CODE(FLOOR_DIVIDE) {
 		uint8_t a = LIT_INSTRUCTION_A(instruction);
-		uint16_t b = LIT_INSTRUCTION_B(instruction);
-		uint16_t c = LIT_INSTRUCTION_C(instruction);
+		uint8_t b = LIT_INSTRUCTION_B(instruction);
+		uint16_t c = LIT_INSTRUCTION_CK(instruction);
 
-    LitValue bv = GET_RC(b);
+    LitValue bv = registers[b];
     LitValue cv = GET_RC(c);
 
 		if (IS_NUMBER(bv) && IS_NUMBER(cv)) {
@@ -713,7 +1205,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		} else {
 			WRAP_CONSTANT(b, a, tmp_a)
       WRAP_CONSTANT(c, a + 1, tmp_b)
-			INVOKE_METHOD(a, registers[a], "#", 1)
+			INVOKE_OPERATOR(a, registers[a], OPERATOR_FLOOR_DIVIDE, "#", 1)
 			UNWRAP_CONSTANT(c, a + 1, tmp_b)
 		}
 
@@ -722,10 +1214,10 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 
 	CASE_CODE(MOD) {
 		uint8_t a = LIT_INSTRUCTION_A(instruction);
-		uint16_t b = LIT_INSTRUCTION_B(instruction);
-		uint16_t c = LIT_INSTRUCTION_C(instruction);
+		uint8_t b = LIT_INSTRUCTION_B(instruction);
+		uint16_t c = LIT_INSTRUCTION_CK(instruction);
 
-		LitValue bv = GET_RC(b);
+		LitValue bv = registers[b];
 		LitValue cv = GET_RC(c);
 
 		if (IS_NUMBER(bv) && IS_NUMBER(cv)) {
@@ -733,7 +1225,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		} else {
 			WRAP_CONSTANT(b, a, tmp_a)
 			WRAP_CONSTANT(c, a + 1, tmp_b)
-			INVOKE_METHOD(a, registers[a], "%", 1)
+			INVOKE_OPERATOR(a, registers[a], OPERATOR_MOD, "%", 1)
 			UNWRAP_CONSTANT(c, a + 1, tmp_b)
 		}
 
@@ -742,10 +1234,10 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 
 	CASE_CODE(POWER) {
 		uint8_t a = LIT_INSTRUCTION_A(instruction);
-		uint16_t b = LIT_INSTRUCTION_B(instruction);
-		uint16_t c = LIT_INSTRUCTION_C(instruction);
+		uint8_t b = LIT_INSTRUCTION_B(instruction);
+		uint16_t c = LIT_INSTRUCTION_CK(instruction);
 
-		LitValue bv = GET_RC(b);
+		LitValue bv = registers[b];
 		LitValue cv = GET_RC(c);
 
 		if (IS_NUMBER(bv) && IS_NUMBER(cv)) {
@@ -753,13 +1245,65 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		} else {
 			WRAP_CONSTANT(b, a, tmp_a)
 			WRAP_CONSTANT(c, a + 1, tmp_b)
-			INVOKE_METHOD(a, registers[a], "**", 1)
+			INVOKE_OPERATOR(a, registers[a], OPERATOR_POWER, "**", 1)
 			UNWRAP_CONSTANT(c, a + 1, tmp_b)
 		}
 
 		DISPATCH_NEXT()
 	}
 
+	CASE_CODE(SQUARE) {
+		LitValue bv = registers[LIT_INSTRUCTION_B(instruction)];
+
+		if (IS_NUMBER(bv)) {
+			registers[LIT_INSTRUCTION_A(instruction)] = NUMBER_VALUE(AS_NUMBER(bv) * AS_NUMBER(bv));
+			DISPATCH_NEXT()
+		}
+
+		goto OP_POWER;
+	}
+
+	// Multiplying by the reciprocal of a power of two gives the exact same result, as dividing by it
+	CASE_CODE(DIVIDE_POWER_OF_TWO) {
+		LitValue bv = registers[LIT_INSTRUCTION_B(instruction)];
+
+		if (IS_NUMBER(bv)) {
+			registers[LIT_INSTRUCTION_A(instruction)] = NUMBER_VALUE(AS_NUMBER(bv) * AS_NUMBER(constants[LIT_INSTRUCTION_C(instruction) + 1]));
+			DISPATCH_NEXT()
+		}
+
+		goto OP_DIVIDE;
+	}
+
+	CASE_CODE(FLOOR_DIVIDE_POWER_OF_TWO) {
+		LitValue bv = registers[LIT_INSTRUCTION_B(instruction)];
+
+		if (IS_NUMBER(bv)) {
+			registers[LIT_INSTRUCTION_A(instruction)] = NUMBER_VALUE(floor(AS_NUMBER(bv) * AS_NUMBER(constants[LIT_INSTRUCTION_C(instruction) + 1])));
+			DISPATCH_NEXT()
+		}
+
+		goto OP_FLOOR_DIVIDE;
+	}
+
+	// Positive integers are masked, the rest (including the negative ones, that keep their sign) use fmod()
+	CASE_CODE(MOD_POWER_OF_TWO) {
+		LitValue bv = registers[LIT_INSTRUCTION_B(instruction)];
+
+		if (IS_NUMBER(bv)) {
+			double number = AS_NUMBER(bv);
+
+			if (number >= 0 && number < 9007199254740992.0 && number == (double) (int64_t) number) {
+				int64_t mask = (int64_t) AS_NUMBER(constants[LIT_INSTRUCTION_C(instruction)]) - 1;
+
+				registers[LIT_INSTRUCTION_A(instruction)] = NUMBER_VALUE((double) ((int64_t) number & mask));
+				DISPATCH_NEXT()
+			}
+		}
+
+		goto OP_MOD;
+	}
+
 	CASE_CODE(LSHIFT) {
 		BITWISE_INSTRUCTION(<<, "<<")
 		DISPATCH_NEXT()
@@ -786,7 +1330,15 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	}
 
 	CASE_CODE(JUMP) {
-		ip += LIT_INSTRUCTION_SBX(instruction);
+		int32_t offset = LIT_INSTRUCTION_SBX(instruction);
+		ip += offset;
+
+		#ifdef LIT_JIT
+			if (offset < 0) {
+				JIT_ENTER()
+			}
+		#endif
+
 		DISPATCH_NEXT()
 	}
 
@@ -824,44 +1376,88 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 
 	CASE_CODE(EQUAL) {
 		uint8_t a = LIT_INSTRUCTION_A(instruction);
-		uint16_t b = LIT_INSTRUCTION_B(instruction);
-		uint16_t c = LIT_INSTRUCTION_C(instruction);
+		uint8_t b = LIT_INSTRUCTION_B(instruction);
+		uint16_t c = LIT_INSTRUCTION_CK(instruction);
 
-		LitValue bv = GET_RC(LIT_INSTRUCTION_B(instruction));
+		LitValue bv = registers[b];
 
 		if (IS_INSTANCE(bv)) {
 			WRAP_CONSTANT(b, a, tmp_a)
 			WRAP_CONSTANT(c, a + 1, tmp_b)
-			INVOKE_METHOD_AND_CONTINUE(a, registers[a], "==", 1)
+			INVOKE_OPERATOR_AND_CONTINUE(a, registers[a], OPERATOR_EQUAL, 1)
 			UNWRAP_CONSTANT(c, a + 1, tmp_b)
 		}
 
-		registers[a] = BOOL_VALUE(bv == GET_RC(c));
+		LitValue cv = GET_RC(c);
+		registers[a] = BOOL_VALUE(bv == cv || (IS_BOUND_METHOD(bv) && lit_values_equal(bv, cv)));
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(LESS) {
-		COMPARISON_INSTRUCTION(BOOL_VALUE, <, "<")
+		COMPARISON_INSTRUCTION(BOOL_VALUE, <, "<", OPERATOR_LESS, OP_LESS_NUM)
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(LESS_EQUAL) {
-		COMPARISON_INSTRUCTION(BOOL_VALUE, <=, "<=")
+		COMPARISON_INSTRUCTION(BOOL_VALUE, <=, "<=", OPERATOR_LESS_EQUAL, OP_LESS_EQUAL_NUM)
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(GREATER) {
-		COMPARISON_INSTRUCTION(BOOL_VALUE, >, ">")
+		COMPARISON_INSTRUCTION(BOOL_VALUE, >, ">", OPERATOR_GREATER, OP_GREATER_NUM)
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(GREATER_EQUAL) {
-		COMPARISON_INSTRUCTION(BOOL_VALUE, >=, ">=")
+		COMPARISON_INSTRUCTION(BOOL_VALUE, >=, ">=", OPERATOR_GREATER_EQUAL, OP_GREATER_EQUAL_NUM)
+		DISPATCH_NEXT()
+	}
+
+	CASE_CODE(EQUAL_JUMP) {
+		LitValue bv = registers[LIT_INSTRUCTION_B(instruction)];
+
+		if (IS_INSTANCE(bv) || IS_BOUND_METHOD(bv)) {
+			goto OP_EQUAL;
+		}
+
+		ip += bv == GET_RC(LIT_INSTRUCTION_CK(instruction)) ? 1 : LIT_INSTRUCTION_BX(*ip) + 1;
 		DISPATCH_NEXT()
 	}
 
+	CASE_CODE(LESS_JUMP) {
+		COMPARISON_JUMP_INSTRUCTION(<, OP_LESS)
+	}
+
+	CASE_CODE(LESS_EQUAL_JUMP) {
+		COMPARISON_JUMP_INSTRUCTION(<=, OP_LESS_EQUAL)
+	}
+
+	CASE_CODE(GREATER_JUMP) {
+		COMPARISON_JUMP_INSTRUCTION(>, OP_GREATER)
+	}
+
+	CASE_CODE(GREATER_EQUAL_JUMP) {
+		COMPARISON_JUMP_INSTRUCTION(>=, OP_GREATER_EQUAL)
+	}
+
+	CASE_CODE(LESS_NUM) {
+		NUMBER_INSTRUCTION(BOOL_VALUE, <, OP_LESS)
+	}
+
+	CASE_CODE(LESS_EQUAL_NUM) {
+		NUMBER_INSTRUCTION(BOOL_VALUE, <=, OP_LESS_EQUAL)
+	}
+
+	CASE_CODE(GREATER_NUM) {
+		NUMBER_INSTRUCTION(BOOL_VALUE, >, OP_GREATER)
+	}
+
+	CASE_CODE(GREATER_EQUAL_NUM) {
+		NUMBER_INSTRUCTION(BOOL_VALUE, >=, OP_GREATER_EQUAL)
+	}
+
 	CASE_CODE(NEGATE) {
-		LitValue value = GET_RC(LIT_INSTRUCTION_B(instruction));
+		LitValue value = GET_RC(LIT_INSTRUCTION_BK(instruction));
 
 		if (!IS_NUMBER(value)) {
 			// Don't even ask me why
@@ -878,11 +1474,11 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	}
 
 	CASE_CODE(NOT) {
-		uint8_t b = LIT_INSTRUCTION_B(instruction);
+		uint16_t b = LIT_INSTRUCTION_BK(instruction);
 		LitValue value = GET_RC(b);
 
 		if (IS_INSTANCE(value)) {
-			INVOKE_METHOD_AND_CONTINUE(b, value, "!", 0)
+			INVOKE_OPERATOR_AND_CONTINUE(b, value, OPERATOR_NOT, 0)
 		}
 
 		registers[LIT_INSTRUCTION_A(instruction)] = BOOL_VALUE(lit_is_falsey(value));
@@ -890,7 +1486,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	}
 
 	CASE_CODE(BNOT) {
-		LitValue value = GET_RC(LIT_INSTRUCTION_B(instruction));
+		LitValue value = GET_RC(LIT_INSTRUCTION_BK(instruction));
 
 		if (!IS_NUMBER(value)) {
 			RUNTIME_ERROR("Operand must be a number")
@@ -900,23 +1496,131 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		DISPATCH_NEXT()
 	}
 
+	// The name gets resolved to a slot only once, slots too big to fit into the instruction keep going through the name
 	CASE_CODE(SET_GLOBAL) {
-		lit_table_set(state, globals, AS_STRING(constants[LIT_INSTRUCTION_A(instruction)]), GET_RC(LIT_INSTRUCTION_BX(instruction)));
+		uint slot = lit_get_global_slot(state, AS_STRING(constants[LIT_INSTRUCTION_C(instruction)]));
+
+		if (slot <= LIT_C_ARG_SIZE) {
+			ip[-1] = LIT_FORM_ABC_INSTRUCTION(OP_SET_GLOBAL_SLOT, 0, LIT_INSTRUCTION_BK(instruction), slot);
+		}
+
+		lit_set_global_slot(state, slot, GET_RC(LIT_INSTRUCTION_BK(instruction)));
 		DISPATCH_NEXT()
 	}
 
+	// Reading a global, that was never written, doesn't create a slot, it stays null until defined
 	CASE_CODE(GET_GLOBAL) {
-		LitValue *reg = &registers[LIT_INSTRUCTION_A(instruction)];
+		uint slot;
 
-		if (!lit_table_get(globals, AS_STRING(constants[LIT_INSTRUCTION_BX(instruction)]), reg)) {
-			*reg = NULL_VALUE;
+		if (!lit_find_global_slot(vm, AS_STRING(constants[LIT_INSTRUCTION_BX(instruction)]), &slot)) {
+			registers[LIT_INSTRUCTION_A(instruction)] = NULL_VALUE;
+			DISPATCH_NEXT()
 		}
 
+		if (slot <= LIT_BX_ARG_SIZE) {
+			ip[-1] = LIT_FORM_ABX_INSTRUCTION(OP_GET_GLOBAL_SLOT, LIT_INSTRUCTION_A(instruction), slot);
+		}
+
+		registers[LIT_INSTRUCTION_A(instruction)] = vm->global_values.values[slot];
+		DISPATCH_NEXT()
+	}
+
+	// Follows the same rules as the iterator() and iteratorValue() methods in lit_core.c
+	CASE_CODE(FOR_ITER) {
+		uint8_t a = LIT_INSTRUCTION_A(instruction);
+		LitValue sequence = registers[a];
+		LitValue iterator = registers[a + 1];
+		LitValue value;
+
+		if (IS_RANGE(sequence)) {
+			LitRange* range = AS_RANGE(sequence);
+			int number = range->from;
+
+			if (IS_NUMBER(iterator)) {
+				number = AS_NUMBER(iterator);
+
+				if (range->to > range->from ? number >= range->to : number <= range->to) {
+					DISPATCH_NEXT()
+				}
+
+				number += (range->from - range->to) > 0 ? -1 : 1;
+			}
+
+			iterator = value = NUMBER_VALUE(number);
+		} else if (IS_ARRAY(sequence)) {
+			LitValues* values = &AS_ARRAY(sequence)->values;
+			int number = 0;
+
+			if (IS_NUMBER(iterator)) {
+				number = AS_NUMBER(iterator) + 1;
+			}
+
+			if (number >= (int) values->count) {
+				DISPATCH_NEXT()
+			}
+
+			iterator = NUMBER_VALUE(number);
+			value = values->values[number];
+		} else if (IS_MAP(sequence)) {
+			LitTable* table = &AS_MAP(sequence)->values;
+			int number = lit_table_iterator(table, IS_NULL(iterator) ? -1 : AS_NUMBER(iterator));
+
+			if (number == -1) {
+				DISPATCH_NEXT()
+			}
+
+			iterator = NUMBER_VALUE(number);
+			value = lit_table_iterator_key(table, number);
+		} else if (IS_STRING(sequence)) {
+			LitString* string = AS_STRING(sequence);
+			int number = 0;
+
+			if (IS_NUMBER(iterator)) {
+				number = AS_NUMBER(iterator);
+
+				do {
+					number++;
+				} while (number < (int) string->length && (string->chars[number] & 0xc0) == 0x80);
+			}
+
+			if (number >= (int) string->length) {
+				DISPATCH_NEXT()
+			}
+
+			iterator = NUMBER_VALUE(number);
+
+			WRITE_FRAME()
+			value = OBJECT_VALUE(lit_ustring_code_point_at(state, string, number));
+		} else {
+			ip -= LIT_INSTRUCTION_C(instruction) + 1;
+			DISPATCH_NEXT()
+		}
+
+		registers[a + 1] = iterator;
+		registers[LIT_INSTRUCTION_B(instruction)] = value;
+
+		// Skip the exit jump
+		ip++;
+		DISPATCH_NEXT()
+	}
+
+	CASE_CODE(SET_GLOBAL_SLOT) {
+		lit_set_global_slot(state, LIT_INSTRUCTION_C(instruction), GET_RC(LIT_INSTRUCTION_BK(instruction)));
+		DISPATCH_NEXT()
+	}
+
+	CASE_CODE(GET_GLOBAL_SLOT) {
+		registers[LIT_INSTRUCTION_A(instruction)] = vm->global_values.values[LIT_INSTRUCTION_BX(instruction)];
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(SET_UPVALUE) {
-		*frame->closure->upvalues[LIT_INSTRUCTION_A(instruction)]->location = GET_RC(LIT_INSTRUCTION_BX(instruction));
+		LitUpvalue* upvalue = frame->closure->upvalues[LIT_INSTRUCTION_C(instruction)];
+		LitValue value = GET_RC(LIT_INSTRUCTION_BK(instruction));
+
+		*upvalue->location = value;
+		LIT_WRITE_BARRIER(vm, upvalue, value)
+
 		DISPATCH_NEXT()
 	}
 
@@ -925,6 +1629,16 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		DISPATCH_NEXT()
 	}
 
+	CASE_CODE(GET_PARENT_LOCAL) {
+		registers[LIT_INSTRUCTION_A(instruction)] = (frame - 1)->slots[LIT_INSTRUCTION_BX(instruction)];
+		DISPATCH_NEXT()
+	}
+
+	CASE_CODE(SET_PARENT_LOCAL) {
+		(frame - 1)->slots[LIT_INSTRUCTION_C(instruction)] = GET_RC(LIT_INSTRUCTION_BK(instruction));
+		DISPATCH_NEXT()
+	}
+
 	CASE_CODE(SET_PRIVATE) {
 		uint8_t a = LIT_INSTRUCTION_A(instruction);
 		uint32_t b = LIT_INSTRUCTION_BX(instruction);
@@ -942,24 +1656,40 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		WRITE_FRAME()
 
 		if (!call_value(vm, LIT_INSTRUCTION_A(instruction), LIT_INSTRUCTION_B(instruction) - 1, NULL_VALUE)) {
-			RETURN_ERROR()
+			RECOVER_STATE()
 		}
 
 		READ_FRAME()
 		DISPATCH_NEXT()
 	}
 
+	CASE_CODE(TAIL_CALL) {
+		uint8_t a = LIT_INSTRUCTION_A(instruction);
+		LitValue callee = registers[a];
+
+		if (IS_FUNCTION(callee) || IS_CLOSURE(callee)) {
+			LitClosure* closure = IS_CLOSURE(callee) ? AS_CLOSURE(callee) : NULL;
+			tail_call(vm, closure == NULL ? AS_FUNCTION(callee) : closure->function, closure, LIT_INSTRUCTION_B(instruction) - 1, a);
+
+			READ_FRAME()
+			TRACE_FRAME()
+			DISPATCH_NEXT()
+		}
+
+		goto OP_CALL;
+	}
+
 	CASE_CODE(CLOSE_UPVALUE) {
 		close_upvalues(vm, &registers[LIT_INSTRUCTION_A(instruction)] - 1);
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(CLASS) {
-		LitString* name = AS_STRING(constants[LIT_INSTRUCTION_A(instruction)]);
+		LitString* name = AS_STRING(constants[LIT_INSTRUCTION_CK(instruction)]);
 		LitClass* klass = lit_create_class(state, name);
 
-		registers[LIT_INSTRUCTION_C(instruction)] = OBJECT_VALUE(klass);
-		lit_table_set(state, &vm->globals->values, name, OBJECT_VALUE(klass));
+		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(klass);
+		lit_set_global_slot(state, lit_get_global_slot(state, name), OBJECT_VALUE(klass));
 
 		uint16_t b = LIT_INSTRUCTION_B(instruction);
 
@@ -968,6 +1698,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 
 			lit_table_add_all(state, &klass->super->methods, &klass->methods);
 			lit_table_add_all(state, &klass->super->static_fields, &klass->static_fields);
+			lit_inherit_operators(klass, klass->super);
 		} else {
 			LitValue super = registers[--b];
 
@@ -982,25 +1713,46 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 
 			lit_table_add_all(state, &super_klass->methods, &klass->methods);
 			lit_table_add_all(state, &klass->super->static_fields, &klass->static_fields);
+			lit_inherit_operators(klass, super_klass);
 		}
 
+		// The inherited tables might have been filled after a collection promoted the class
+		LIT_REMEMBER_OBJECT(vm, klass)
+		lit_invalidate_class(state, klass);
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(STATIC_FIELD) {
-		lit_table_set(state, &AS_CLASS(registers[LIT_INSTRUCTION_A(instruction)])->static_fields, AS_STRING(constants[LIT_INSTRUCTION_B(instruction)]), GET_RC(LIT_INSTRUCTION_C(instruction)));
+		LitClass* klass = AS_CLASS(registers[LIT_INSTRUCTION_A(instruction)]);
+		LitValue name = constants[LIT_INSTRUCTION_BK(instruction)];
+		LitValue value = registers[LIT_INSTRUCTION_C(instruction)];
+
+		lit_table_set(state, &klass->static_fields, AS_STRING(name), value);
+		LIT_WRITE_BARRIER(vm, klass, name)
+		LIT_WRITE_BARRIER(vm, klass, value)
+
+		lit_invalidate_class(state, klass);
+
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(METHOD) {
 		LitClass* klass = AS_CLASS(registers[LIT_INSTRUCTION_A(instruction)]);
-		LitString* name = AS_STRING(constants[LIT_INSTRUCTION_B(instruction)]);
+		LitString* name = AS_STRING(constants[LIT_INSTRUCTION_BK(instruction)]);
+		LitValue method = registers[LIT_INSTRUCTION_C(instruction)];
 
 		if ((klass->init_method == NULL || (klass->super != NULL && klass->init_method == ((LitClass*) klass->super)->init_method)) && name->length == 11 && memcmp(name->chars, "constructor", 11) == 0) {
-			klass->init_method = AS_OBJECT(GET_RC(LIT_INSTRUCTION_C(instruction)));
+			klass->init_method = AS_OBJECT(method);
 		}
 
-		lit_table_set(state, &klass->methods, name, GET_RC(LIT_INSTRUCTION_C(instruction)));
+		lit_table_set(state, &klass->methods, name, method);
+		lit_update_operator(klass, name, method);
+
+		LIT_WRITE_BARRIER(vm, klass, OBJECT_VALUE(name))
+		LIT_WRITE_BARRIER(vm, klass, method)
+
+		lit_invalidate_class(state, klass);
+
 		DISPATCH_NEXT()
 	}
 
@@ -1012,14 +1764,19 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		}
 
 		LitValue value;
-		LitString *name = AS_STRING(constants[LIT_INSTRUCTION_C(instruction)]);
+		bool found;
+
+		LitString *name = AS_STRING(constants[LIT_INSTRUCTION_CK(instruction)]);
 		uint8_t result_reg = LIT_INSTRUCTION_A(instruction);
+		LitInlineCache* cache = get_inline_cache(state, current_chunk, ip);
 
 		if (IS_INSTANCE(object)) {
 			LitInstance *instance = AS_INSTANCE(object);
 
-			if (!lit_table_get(&instance->fields, name, &value)) {
-				if (lit_table_get(&instance->klass->methods, name, &value)) {
+			if (!get_instance_field(cache, instance, name, &value)) {
+				CACHED_LOOKUP(cache, instance->klass, false, found, value, lit_table_get(&instance->klass->methods, name, &value))
+
+				if (found) {
 					if (IS_FIELD(value)) {
 						LitField *field = AS_FIELD(value);
 
@@ -1027,12 +1784,14 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 							RUNTIME_ERROR_VARG("Class %s does not have a getter for the field %s", instance->klass->name->chars, name->chars)
 						}
 
+						// The getter takes this from A, that doesn't have to be the same register as B
+						registers[result_reg] = object;
 						WRITE_FRAME()
 						CALL_VALUE(OBJECT_VALUE(AS_FIELD(value)->getter), result_reg, 0)
 						READ_FRAME()
 						DISPATCH_NEXT()
 					} else {
-						value = OBJECT_VALUE(lit_create_bound_method(state, object, value));
+						value = bind_method(state, object, value);
 					}
 				} else {
 					value = NULL_VALUE;
@@ -1040,10 +1799,11 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 			}
 		} else if (IS_CLASS(object)) {
 			LitClass *klass = AS_CLASS(object);
+			CACHED_LOOKUP(cache, klass, true, found, value, lit_table_get(&klass->static_fields, name, &value))
 
-			if (lit_table_get(&klass->static_fields, name, &value)) {
+			if (found) {
 				if (IS_NATIVE_METHOD(value) || IS_PRIMITIVE_METHOD(value)) {
-					value = OBJECT_VALUE(lit_create_bound_method(state, object, value));
+					value = bind_method(state, object, value);
 				} else if (IS_FIELD(value)) {
 					LitField* field = AS_FIELD(value);
 
@@ -1051,6 +1811,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 						RUNTIME_ERROR_VARG("Class %s does not have a getter for the field %s", klass->name->chars, name->chars)
 					}
 
+					registers[result_reg] = object;
 					WRITE_FRAME()
 					CALL_VALUE(OBJECT_VALUE(field->getter), result_reg, 0)
 					READ_FRAME()
@@ -1066,7 +1827,9 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 				RUNTIME_ERROR("Only instances and classes have fields")
 			}
 
-			if (lit_table_get(&klass->methods, name, &value)) {
+			CACHED_LOOKUP(cache, klass, false, found, value, lit_table_get(&klass->methods, name, &value))
+
+			if (found) {
 				if (IS_FIELD(value)) {
 					LitField *field = AS_FIELD(value);
 
@@ -1074,12 +1837,13 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 						RUNTIME_ERROR_VARG("Class %s does not have a getter for the field %s", klass->name->chars, name->chars)
 					}
 
+					registers[result_reg] = object;
 					WRITE_FRAME()
 					CALL_VALUE(OBJECT_VALUE(AS_FIELD(value)->getter), result_reg, 0)
 					READ_FRAME()
 					DISPATCH_NEXT()
 				} else if (IS_NATIVE_METHOD(value) || IS_PRIMITIVE_METHOD(value)) {
-					value = OBJECT_VALUE(lit_create_bound_method(state, object, value));
+					value = bind_method(state, object, value);
 				}
 			} else {
 				value = NULL_VALUE;
@@ -1093,12 +1857,12 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	CASE_CODE(GET_SUPER_METHOD) {
 		LitValue instance = registers[LIT_INSTRUCTION_B(instruction)];
 		LitClass* klass = AS_CLASS(instance);
-		LitString* method_name = AS_STRING(constants[LIT_INSTRUCTION_C(instruction)]);
+		LitString* method_name = AS_STRING(constants[LIT_INSTRUCTION_CK(instruction)]);
 
 		LitValue value;
 
 		if (lit_table_get(&klass->methods, method_name, &value) || lit_table_get(&klass->static_fields, method_name, &value)) {
-			value = OBJECT_VALUE(lit_create_bound_method(state, registers[LIT_INSTRUCTION_A(instruction)], value));
+			value = bind_method(state, registers[LIT_INSTRUCTION_A(instruction)], value);
 		} else {
 			value = NULL_VALUE;
 		}
@@ -1116,8 +1880,9 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		}
 
 		LitValue value = registers[LIT_INSTRUCTION_C(instruction)];
-		int b = LIT_INSTRUCTION_B(instruction);
-		LitString *field_name = AS_STRING(constants[LIT_INSTRUCTION_B(instruction)]);
+		LitString *field_name = AS_STRING(constants[LIT_INSTRUCTION_BK(instruction)]);
+		LitInlineCache* cache = get_inline_cache(state, current_chunk, ip);
+		bool found;
 
 		if (IS_CLASS(instance)) {
 			LitClass *klass = AS_CLASS(instance);
@@ -1140,12 +1905,19 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 				lit_table_delete(&klass->static_fields, field_name);
 			} else {
 				lit_table_set(state, &klass->static_fields, field_name, value);
+
+				LIT_WRITE_BARRIER(vm, klass, OBJECT_VALUE(field_name))
+				LIT_WRITE_BARRIER(vm, klass, value)
 			}
+
+			lit_invalidate_class(state, klass);
 		} else if (IS_INSTANCE(instance)) {
 			LitInstance *inst = AS_INSTANCE(instance);
 			LitValue setter;
 
-			if (lit_table_get(&inst->klass->methods, field_name, &setter) && IS_FIELD(setter)) {
+			CACHED_LOOKUP(cache, inst->klass, false, found, setter, lit_table_get(&inst->klass->methods, field_name, &setter))
+
+			if (found && IS_FIELD(setter)) {
 				LitField *field = AS_FIELD(setter);
 
 				if (field->setter == NULL) {
@@ -1159,9 +1931,9 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 			}
 
 			if (IS_NULL(value)) {
-				lit_table_delete(&inst->fields, field_name);
+				lit_instance_delete(state, inst, field_name);
 			} else {
-				lit_table_set(state, &inst->fields, field_name, value);
+				set_instance_field(state, cache, inst, field_name, value);
 			}
 		} else {
 			LitClass *klass = lit_get_class_for(state, instance);
@@ -1171,8 +1943,9 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 			}
 
 			LitValue setter;
+			CACHED_LOOKUP(cache, klass, false, found, setter, lit_table_get(&klass->methods, field_name, &setter))
 
-			if (lit_table_get(&klass->methods, field_name, &setter) && IS_FIELD(setter)) {
+			if (found && IS_FIELD(setter)) {
 				LitField *field = AS_FIELD(setter);
 
 				if (field->setter == NULL) {
@@ -1194,7 +1967,7 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 
 	CASE_CODE(IS) {
 		uint8_t result_reg = LIT_INSTRUCTION_A(instruction);
-		LitValue instance = GET_RC(LIT_INSTRUCTION_B(instruction));
+		LitValue instance = registers[LIT_INSTRUCTION_B(instruction)];
 
 		if (IS_NULL(instance)) {
 			registers[result_reg] = FALSE_VALUE;
@@ -1203,8 +1976,9 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 
 		LitClass* instance_klass = lit_get_class_for(state, instance);
 		LitValue klass;
+		uint slot;
 
-		if (!lit_table_get(globals, AS_STRING(constants[LIT_INSTRUCTION_C(instruction)]), &klass)) {
+		if (!lit_find_global_slot(vm, AS_STRING(constants[LIT_INSTRUCTION_CK(instruction)]), &slot) || IS_NULL(klass = vm->global_values.values[slot])) {
 			registers[result_reg] = FALSE_VALUE;
 			DISPATCH_NEXT()
 		}
@@ -1229,10 +2003,12 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		DISPATCH_NEXT()
 	}
 
+	CASE_CODE(INVOKE_BORROWED)
 	CASE_CODE(INVOKE) {
 		WRITE_FRAME()
 
 		uint8_t result_reg = LIT_INSTRUCTION_A(instruction);
+		bool borrowed = LIT_INSTRUCTION_OPCODE(instruction) == OP_INVOKE_BORROWED;
 		LitValue instance = registers[result_reg];
 
 		if (IS_NULL(instance)) {
@@ -1245,15 +2021,33 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 			RUNTIME_ERROR("Only instances and classes have methods")
 		}
 
-		LitString* method_name = AS_STRING(constants[LIT_INSTRUCTION_C(instruction)]);
+		LitString* method_name = AS_STRING(constants[LIT_INSTRUCTION_CK(instruction)]);
 		int arg_count = LIT_INSTRUCTION_B(instruction) - 1;
 		LitValue method;
+		LitInlineCache* cache = get_inline_cache(state, current_chunk, ip);
+		bool found;
+
+		if (IS_INSTANCE(instance) && get_instance_field(cache, AS_INSTANCE(instance), method_name, &method)) {
+			if (borrowed) {
+				escape_stack_closures(state, method, registers, result_reg + 1, arg_count);
+			}
 
-		if (IS_INSTANCE(instance) && (lit_table_get(&AS_INSTANCE(instance)->fields, method_name, &method))) {
-			CALL_VALUE(method, result_reg, arg_count)
-		} else if (IS_CLASS(instance) && lit_table_get(&klass->static_fields, method_name, &method)) {
 			CALL_VALUE(method, result_reg, arg_count)
-		} else if (lit_table_get(&klass->methods, method_name, &method)) {
+			READ_FRAME()
+			DISPATCH_NEXT()
+		}
+
+		if (IS_CLASS(instance)) {
+			CACHED_LOOKUP(cache, klass, true, found, method, lit_table_get(&klass->static_fields, method_name, &method) || lit_table_get(&klass->methods, method_name, &method))
+		} else {
+			CACHED_LOOKUP(cache, klass, false, found, method, lit_table_get(&klass->methods, method_name, &method))
+		}
+
+		if (found) {
+			if (borrowed) {
+				escape_stack_closures(state, method, registers, result_reg + 1, arg_count);
+			}
+
 			CALL_VALUE(method, result_reg, arg_count)
 		} else {
 			RUNTIME_ERROR_VARG("Attempt to call method '%s', that is not defined in class %s", method_name->chars, klass->name->chars)
@@ -1279,11 +2073,15 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 			RUNTIME_ERROR("Only instances and classes have methods")
 		}
 
-		LitString* method_name = AS_STRING(constants[LIT_INSTRUCTION_C(instruction)]);
+		LitString* method_name = AS_STRING(constants[LIT_INSTRUCTION_CK(instruction)]);
 		int arg_count = LIT_INSTRUCTION_B(instruction) - 1;
 		LitValue method;
+		bool found;
 
-		if (lit_table_get(&klass->methods, method_name, &method) || lit_table_get(&klass->static_fields, method_name, &method)) {
+		LitInlineCache* cache = get_inline_cache(state, current_chunk, ip);
+		CACHED_LOOKUP(cache, klass, false, found, method, lit_table_get(&klass->methods, method_name, &method) || lit_table_get(&klass->static_fields, method_name, &method))
+
+		if (found) {
 			for (uint i = result_reg + 1; i <= result_reg + (uint) arg_count; i++) {
 				registers[i] = registers[i + 1];
 			}
@@ -1301,7 +2099,11 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		uint8_t result_reg = LIT_INSTRUCTION_A(instruction);
 		LitValue instance = GET_RC(result_reg);
 
-		INVOKE_METHOD(result_reg, instance, "[]", 1)
+		if (subscript_get(state, instance, registers[result_reg + 1], &registers[result_reg])) {
+			DISPATCH_NEXT()
+		}
+
+		INVOKE_OPERATOR(result_reg, instance, OPERATOR_SUBSCRIPT, "[]", 1)
 		DISPATCH_NEXT()
 	}
 
@@ -1309,26 +2111,37 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		uint8_t result_reg = LIT_INSTRUCTION_A(instruction);
 		LitValue instance = GET_RC(result_reg);
 
-		INVOKE_METHOD(result_reg, instance, "[]", 2)
+		if (subscript_set(state, instance, registers[result_reg + 1], registers[result_reg + 2])) {
+			registers[result_reg] = registers[result_reg + 2];
+			DISPATCH_NEXT()
+		}
+
+		INVOKE_OPERATOR(result_reg, instance, OPERATOR_SUBSCRIPT, "[]", 2)
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(PUSH_ARRAY_ELEMENT) {
-		LitValues* array = &AS_ARRAY(registers[LIT_INSTRUCTION_A(instruction)])->values;
-		array->values[array->count++] = GET_RC(LIT_INSTRUCTION_BX(instruction));
+		LitArray* array = AS_ARRAY(registers[LIT_INSTRUCTION_A(instruction)]);
+		LitValue value = GET_RC(LIT_INSTRUCTION_BX(instruction));
+
+		array->values.values[array->values.count++] = value;
+		LIT_WRITE_BARRIER(vm, array, value)
 
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(PUSH_OBJECT_ELEMENT) {
 		LitValue operand = registers[LIT_INSTRUCTION_A(instruction)];
-		LitString* key = AS_STRING(constants[LIT_INSTRUCTION_B(instruction)]);
+		LitString* key = AS_STRING(constants[LIT_INSTRUCTION_BK(instruction)]);
 		LitValue value = registers[LIT_INSTRUCTION_C(instruction)];
 
 		if (IS_MAP(operand)) {
 			lit_table_set(state, &AS_MAP(operand)->values, key, value);
+
+			LIT_WRITE_BARRIER(vm, AS_OBJECT(operand), OBJECT_VALUE(key))
+			LIT_WRITE_BARRIER(vm, AS_OBJECT(operand), value)
 		} else if (IS_INSTANCE(operand)) {
-			lit_table_set(state, &AS_INSTANCE(operand)->fields, key, value);
+			lit_instance_set(state, AS_INSTANCE(operand), key, value);
 		} else {
 			RUNTIME_ERROR_VARG("slotted an object or a map as the operand, got %s", lit_get_value_type(operand))
 		}
@@ -1338,10 +2151,10 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 
 	CASE_CODE(REFERENCE_GLOBAL) {
 		LitString* name = AS_STRING(constants[LIT_INSTRUCTION_BX(instruction)]);
-		LitValue* value;
+		uint slot;
 
-		if (lit_table_get_slot(&vm->globals->values, name, &value)) {
-			registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_reference(state, value));
+		if (lit_find_global_slot(vm, name, &slot)) {
+			registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_reference(state, (LitObject*) vm->globals, &vm->global_values.values[slot]));
 		} else {
 			RUNTIME_ERROR("Attempt to reference a null value")
 		}
@@ -1350,17 +2163,17 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	}
 
 	CASE_CODE(REFERENCE_PRIVATE) {
-		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_reference(state, &privates[LIT_INSTRUCTION_BX(instruction)]));
+		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_reference(state, (LitObject*) fiber->module, &privates[LIT_INSTRUCTION_BX(instruction)]));
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(REFERENCE_LOCAL) {
-		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_reference(state, &registers[LIT_INSTRUCTION_B(instruction)]));
+		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_reference(state, (LitObject*) fiber, &registers[LIT_INSTRUCTION_B(instruction)]));
 		DISPATCH_NEXT()
 	}
 
 	CASE_CODE(REFERENCE_UPVALUE) {
-		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_reference(state, upvalues[LIT_INSTRUCTION_BX(instruction)]->location));
+		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_reference(state, (LitObject*) upvalues[LIT_INSTRUCTION_BX(instruction)], upvalues[LIT_INSTRUCTION_BX(instruction)]->location));
 		DISPATCH_NEXT()
 	}
 
@@ -1372,17 +2185,17 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 		}
 
 		LitValue* value;
-		LitString* name = AS_STRING(constants[LIT_INSTRUCTION_C(instruction)]);
+		LitString* name = AS_STRING(constants[LIT_INSTRUCTION_CK(instruction)]);
 
 		if (IS_INSTANCE(object)) {
-			if (!lit_table_get_slot(&AS_INSTANCE(object)->fields, name, &value)) {
+			if (!lit_instance_get_slot(AS_INSTANCE(object), name, &value)) {
 				RUNTIME_ERROR("Attempt to reference a null value")
 			}
 		} else {
 			RUNTIME_ERROR("You can only reference fields of real instances")
 		}
 
-		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_reference(state, value));
+		registers[LIT_INSTRUCTION_A(instruction)] = OBJECT_VALUE(lit_create_reference(state, AS_OBJECT(object), value));
 		DISPATCH_NEXT()
 	}
 
@@ -1393,7 +2206,21 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 			RUNTIME_ERROR("Provided value is not a reference")
 		}
 
-		*AS_REFERENCE(reference)->slot = registers[LIT_INSTRUCTION_B(instruction)];
+		LitReference* target = AS_REFERENCE(reference);
+		LitValue value = registers[LIT_INSTRUCTION_B(instruction)];
+
+		*target->slot = value;
+
+		if (target->owner == (LitObject*) vm->globals) {
+			LitValue* slot = target->slot;
+
+			// The map has to see the new value too
+			if (slot >= vm->global_values.values && slot < vm->global_values.values + vm->global_values.count) {
+				lit_set_global_slot(state, slot - vm->global_values.values, value);
+			}
+		} else if (target->owner != NULL) {
+			LIT_WRITE_BARRIER(vm, target->owner, value)
+		}
 		DISPATCH_NEXT()
 	}
 
@@ -1402,10 +2229,14 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 
 	#undef BITWISE_INSTRUCTION
 	#undef COMPARISON_INSTRUCTION
+	#undef COMPARISON_JUMP_INSTRUCTION
+	#undef NUMBER_INSTRUCTION
+	#undef QUICKEN
 	#undef BINARY_INSTRUCTION
 	#undef UNWRAP_CONSTANT
 	#undef WRAP_CONSTANT
 
+	#undef CACHED_LOOKUP
 	#undef GET_RC
 	#undef RUNTIME_ERROR_VARG
 	#undef RUNTIME_ERROR
@@ -1418,10 +2249,49 @@ LitInterpretResult lit_interpret_fiber(LitState* state, register LitFiber* fiber
 	#undef RETURN_ERROR
 }
 
-void lit_native_exit_jump() {
-	longjmp(jump_buffer, 1);
+void lit_native_exit_jump(LitVm* vm) {
+	if (vm->native_exit_jump != NULL) {
+		longjmp(*vm->native_exit_jump, 1);
+	}
 }
 
+/*
+ * Exiting natives get a jump target for lit_runtime_error_exiting(), the rest run with none,
+ * so that they never unwind into a native further up the C stack
+ */
+#define CALL_NATIVE(native, type, error_value, call) \
+	jmp_buf exit_jump; \
+	jmp_buf* previous_exit_jump = vm->native_exit_jump; \
+	vm->native_exit_jump = native->exiting ? &exit_jump : NULL; \
+	\
+	if (native->exiting && setjmp(exit_jump)) { \
+		vm->native_exit_jump = previous_exit_jump; \
+		return error_value; \
+	} \
+	\
+	type result = call; \
+	vm->native_exit_jump = previous_exit_jump; \
+	\
+	return result;
+
+LitValue lit_call_native_function(LitVm* vm, LitNativeFunction* native, uint arg_count, LitValue* args) {
+	CALL_NATIVE(native, LitValue, NULL_VALUE, native->function(vm, arg_count, args))
+}
+
+bool lit_call_native_primitive(LitVm* vm, LitNativePrimitive* native, uint arg_count, LitValue* args) {
+	CALL_NATIVE(native, bool, true, native->function(vm, arg_count, args))
+}
+
+LitValue lit_call_native_method(LitVm* vm, LitNativeMethod* native, LitValue instance, uint arg_count, LitValue* args) {
+	CALL_NATIVE(native, LitValue, NULL_VALUE, native->method(vm, instance, arg_count, args))
+}
+
+bool lit_call_primitive_method(LitVm* vm, LitPrimitiveMethod* native, LitValue instance, uint arg_count, LitValue* args) {
+	CALL_NATIVE(native, bool, true, native->method(vm, instance, arg_count, args))
+}
+
+#undef CALL_NATIVE
+
 #undef PUSH_GC
 #undef POP_GC
 #undef LIT_TRACE_FRAME
\ No newline at end of file
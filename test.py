@@ -12,6 +12,7 @@ import io
 from subprocess import Popen, PIPE
 import sys
 import os
+import tempfile
 
 # Runs the tests.
 REPO_DIR = dirname(realpath(__file__))
@@ -23,6 +24,8 @@ RUNTIME_ERROR_EXPECT = re.compile(r'// Exception: (.+)')
 SYNTAX_ERROR_RE = re.compile(r'\[.*line (\d+)\] (Error.+)')
 STACK_TRACE_RE = re.compile(r'\[line (\d+)\]')
 NONTEST_RE = re.compile(r'// Ignore')
+JIT_RE = re.compile(r'// Jit$')
+BYTECODE_RE = re.compile(r'// Bytecode(?:: (.+))?$')
 
 passed = 0
 failed = 0
@@ -31,6 +34,7 @@ expectations = 0
 
 interpreter = None
 filter_path = None
+jit_supported = None
 
 INTERPRETERS = {}
 C_SUITES = []
@@ -62,6 +66,8 @@ class Test:
         self.runtime_error_message = None
         self.exit_code = 0
         self.failures = []
+        self.jit = False
+        self.bytecode = None
 
 
     def parse(self):
@@ -132,6 +138,16 @@ class Test:
                     # Not a test file at all, so ignore it.
                     return False
 
+                match = JIT_RE.search(line)
+                if match:
+                    # Runs in the interpreter too, if lit was built without the JIT.
+                    self.jit = True
+
+                match = BYTECODE_RE.search(line)
+                if match:
+                    # Runs from the given .lbc file, or from one, that the test gets compiled into first.
+                    self.bytecode = match.group(1) or ""
+
                 line_num += 1
 
 
@@ -140,8 +156,20 @@ class Test:
 
 
     def run(self):
+        if self.bytecode == "":
+            self.run_compiled()
+            return
+
+        path = self.path
+
+        if self.bytecode:
+            path = join(dirname(self.path), self.bytecode)
+
         # Invoke the interpreter and run the test.
-        args = ["./dist/lit", self.path]
+        args = ["./dist/lit", path]
+
+        if self.jit and supports_jit():
+            args.insert(1, "--jit")
 
         proc = Popen(args, stdin=PIPE, stdout=PIPE, stderr=PIPE)
 
@@ -149,6 +177,25 @@ class Test:
         self.validate(proc.returncode, out, err)
 
 
+    def run_compiled(self):
+        handle, path = tempfile.mkstemp(suffix=".lbc")
+        os.close(handle)
+
+        try:
+            proc = Popen(["./dist/lit", self.path, "-o", path], stdin=PIPE, stdout=PIPE, stderr=PIPE)
+            out, err = proc.communicate()
+
+            if proc.returncode != 0:
+                self.validate(proc.returncode, out, err)
+                return
+
+            proc = Popen(["./dist/lit", path], stdin=PIPE, stdout=PIPE, stderr=PIPE)
+            out, err = proc.communicate()
+            self.validate(proc.returncode, out, err)
+        finally:
+            os.remove(path)
+
+
     def validate(self, exit_code, out, err):
         if self.compile_errors and self.runtime_error_message:
             self.fail("Test error: Cannot expect both compile and runtime errors.")
@@ -276,6 +323,18 @@ class Test:
         self.failures.append(message)
 
 
+def supports_jit():
+    global jit_supported
+
+    if jit_supported is None:
+        # Builds without the JIT complain about the flag on stderr.
+        proc = Popen(["./dist/lit", "--jit", "--help"], stdin=PIPE, stdout=PIPE, stderr=PIPE)
+        out, err = proc.communicate()
+        jit_supported = proc.returncode == 0 and len(err) == 0
+
+    return jit_supported
+
+
 def color_text(text, color):
     """Converts text to a string and wraps it in the ANSI escape sequence for
     color, if supported."""